@@ -0,0 +1,241 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_bench_instance.c - Cross-core publish and receive throughput of single yamc instance
+ *
+ * One thread parses incoming PUBLISH packets while another one publishes QoS0 packets through the same instance,
+ * each pinned to its own CPU. Threads don't share any mutable state by design, so the only thing slowing them down
+ * compared to running alone is cache line ping-pong inside yamc_instance_t.
+ * In qos1 mode incoming packets are QoS1 and acknowledged by auto_ack with keepalive enabled, so receiving thread writes
+ * PUBACKs and acknowledgement state while publishing thread updates keepalive and tx buffer.
+ * Usage: yamc_bench_instance [seconds] [rx CPU] [tx CPU] [qos0|qos1]
+ * Build with "make bench", it produces yamc_bench_instance and yamc_bench_instance_packed (YAMC_CACHE_ALIGNED empty).
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "yamc.h"
+#include "yamc_port.h"
+
+#define BENCH_TOPIC "bench/instance"
+#define BENCH_PAYLOAD_LEN 16
+#define BENCH_RX_PKTS_PER_CALL 16
+#define BENCH_DEFAULT_SECONDS 3
+#define BENCH_KEEPALIVE_S 60
+
+// yamc instance shared by both threads, static so it is aligned as declared
+static yamc_instance_t yamc_instance;
+
+static uint8_t rx_pkt_buff[1024];
+static uint8_t tx_pkt_buff[1024];
+
+// encoded PUBLISH packets fed to parser
+static uint8_t rx_data[BENCH_RX_PKTS_PER_CALL * 64];
+static uint32_t rx_data_len;
+
+static volatile int stop_now;
+
+typedef struct
+{
+	int		 cpu;
+	uint64_t ops;
+
+} __attribute__((aligned(YAMC_CACHE_LINE_LEN))) bench_thread_t;
+
+static void bench_disconnect(void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+}
+
+static yamc_retcode_t bench_write(void* p_ctx, const uint8_t* const p_buff, uint32_t buff_len)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+	YAMC_UNUSED_PARAMETER(p_buff);
+	YAMC_UNUSED_PARAMETER(buff_len);
+
+	return YAMC_RET_SUCCESS;
+}
+
+// coarse clock is read without system call
+static uint32_t bench_timestamp(void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+
+	return (uint32_t)ts.tv_sec * 1000u + (uint32_t)(ts.tv_nsec / 1000000L);
+}
+
+static void bench_pkt_handler(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data, void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_instance);
+	YAMC_UNUSED_PARAMETER(p_pkt_data);
+	YAMC_UNUSED_PARAMETER(p_ctx);
+}
+
+static void bench_pin(int cpu)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+
+	int err_code = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+	if (err_code != 0) YAMC_ERROR_PRINTF("Can't pin thread to CPU %d, results may be skewed\n", cpu);
+}
+
+static void* bench_rx_thread(void* p_arg)
+{
+	bench_thread_t* const p_thread = p_arg;
+
+	bench_pin(p_thread->cpu);
+
+	uint64_t ops = 0;
+	while (!stop_now)
+	{
+		yamc_parse_buff(&yamc_instance, rx_data, rx_data_len);
+		ops += BENCH_RX_PKTS_PER_CALL;
+	}
+
+	p_thread->ops = ops;
+	return NULL;
+}
+
+static void* bench_tx_thread(void* p_arg)
+{
+	bench_thread_t* const p_thread = p_arg;
+
+	bench_pin(p_thread->cpu);
+
+	static const uint8_t payload[BENCH_PAYLOAD_LEN];
+
+	const yamc_publish_data_t pub = {
+		.topic	= {.str = (const uint8_t*)BENCH_TOPIC, .len = sizeof(BENCH_TOPIC) - 1},
+		.QOS	  = YAMC_QOS_LVL0,
+		.p_data   = payload,
+		.data_len = sizeof(payload),
+	};
+
+	uint64_t ops = 0;
+	while (!stop_now)
+	{
+		yamc_publish(&yamc_instance, &pub);
+		ops++;
+	}
+
+	p_thread->ops = ops;
+	return NULL;
+}
+
+// run enabled threads for given time, returns elapsed seconds
+static double bench_run(bench_thread_t* const p_rx, bench_thread_t* const p_tx, unsigned int seconds)
+{
+	pthread_t rx_tid, tx_tid;
+	struct timespec start, end;
+
+	stop_now = 0;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	if (p_rx != NULL) pthread_create(&rx_tid, NULL, bench_rx_thread, p_rx);
+	if (p_tx != NULL) pthread_create(&tx_tid, NULL, bench_tx_thread, p_tx);
+
+	sleep(seconds);
+	stop_now = 1;
+
+	if (p_rx != NULL) pthread_join(rx_tid, NULL);
+	if (p_tx != NULL) pthread_join(tx_tid, NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (double)(end.tv_sec - start.tv_sec) + (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+int main(int argc, char** argv)
+{
+	const unsigned int seconds = (argc > 1) ? (unsigned int)atoi(argv[1]) : BENCH_DEFAULT_SECONDS;
+	const int		   rx_cpu  = (argc > 2) ? atoi(argv[2]) : 0;
+	const int		   tx_cpu  = (argc > 3) ? atoi(argv[3]) : 1;
+	const bool		   qos1	= (argc > 4) && strcmp(argv[4], "qos1") == 0;
+
+	const yamc_handler_cfg_t handler_cfg = {
+		.disconnect  = bench_disconnect,
+		.write		 = bench_write,
+		.pkt_handler = bench_pkt_handler,
+		.timestamp   = qos1 ? bench_timestamp : NULL,
+	};
+
+	const yamc_buff_cfg_t buff_cfg = {
+		.p_rx_buff   = rx_pkt_buff,
+		.rx_buff_len = sizeof(rx_pkt_buff),
+		.p_tx_buff   = tx_pkt_buff,
+		.tx_buff_len = sizeof(tx_pkt_buff),
+	};
+
+	yamc_init(&yamc_instance, &handler_cfg, &buff_cfg);
+	yamc_instance.parser_enables.PUBLISH = 1;
+
+	// CONNECT starts keepalive, written to nowhere
+	if (qos1)
+	{
+		yamc_instance.options.auto_ack = 1;
+
+		const yamc_connect_data_t connect_data = {.clean_session = true, .keepalive_timeout_s = BENCH_KEEPALIVE_S};
+		yamc_connect(&yamc_instance, &connect_data);
+	}
+
+	// incoming data: back to back QoS0 PUBLISH packets or QoS1 ones with distinct ids
+	static const uint8_t	  payload[BENCH_PAYLOAD_LEN];
+	const yamc_publish_data_t rx_pub = {
+		.topic	= {.str = (const uint8_t*)BENCH_TOPIC, .len = sizeof(BENCH_TOPIC) - 1},
+		.QOS	  = qos1 ? YAMC_QOS_LVL1 : YAMC_QOS_LVL0,
+		.p_data   = payload,
+		.data_len = sizeof(payload),
+	};
+
+	for (uint32_t i = 0; i < BENCH_RX_PKTS_PER_CALL; i++)
+	{
+		const uint16_t packet_id = qos1 ? (uint16_t)(i + 1) : 0;
+		rx_data_len += yamc_publish_encode(&rx_pub, packet_id, &rx_data[rx_data_len], sizeof(rx_data) - rx_data_len);
+	}
+
+	const long cpu_cnt = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpu_cnt < 2) YAMC_ERROR_PRINTF("Only %ld CPU online, threads can't run on separate cores\n", cpu_cnt);
+
+	printf("yamc_instance_t: %zu bytes, parser_state at %zu, rx_acks at %zu, tx_buff at %zu, YAMC_CACHE_ALIGNED %s, incoming %s\n",
+		   sizeof(yamc_instance_t), offsetof(yamc_instance_t, parser_state), offsetof(yamc_instance_t, rx_acks),
+		   offsetof(yamc_instance_t, tx_buff), (offsetof(yamc_instance_t, tx_buff) % YAMC_CACHE_LINE_LEN == 0) ? "on" : "off",
+		   qos1 ? "QoS1 with auto_ack" : "QoS0");
+
+	bench_thread_t rx = {.cpu = rx_cpu};
+	bench_thread_t tx = {.cpu = tx_cpu};
+
+	double elapsed = bench_run(&rx, NULL, seconds);
+	const double rx_alone = (double)rx.ops / elapsed;
+
+	elapsed = bench_run(NULL, &tx, seconds);
+	const double tx_alone = (double)tx.ops / elapsed;
+
+	elapsed = bench_run(&rx, &tx, seconds);
+	const double rx_both = (double)rx.ops / elapsed;
+	const double tx_both = (double)tx.ops / elapsed;
+
+	printf("receive alone:  %12.0f pkt/s\n", rx_alone);
+	printf("publish alone:  %12.0f pkt/s\n", tx_alone);
+	printf("receive shared: %12.0f pkt/s (%.0f%%), CPU %d\n", rx_both, 100.0 * rx_both / rx_alone, rx_cpu);
+	printf("publish shared: %12.0f pkt/s (%.0f%%), CPU %d\n", tx_both, 100.0 * tx_both / tx_alone, tx_cpu);
+
+	return 0;
+}
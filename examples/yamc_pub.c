@@ -3,6 +3,9 @@
  *
  * yamc_pub.c - Simple MQTT client example. Publishes message to MQTT server and quits.
  *
+ * Multiple copies of the message are pipelined, up to YAMC_INFLIGHT_WINDOW QoS>0 messages stay unacknowledged.
+ * With --store unacknowledged messages are kept in a file and resent by next run with --no-clean-session.
+ *
  * Author: Michal Lower <https://github.com/keton>
  * 
  * Licensed under MIT License (see LICENSE file in main repo directory)
@@ -19,7 +22,9 @@
 #include "yamc_pub_cmdline.h"
 
 static volatile bool connack_received = false;
-static volatile bool publish_complete = false;
+
+// number of QoS>0 messages acknowledged by server, updated by rx thread
+static uint32_t messages_complete = 0;
 
 static inline void yamc_handle_connack(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
 {
@@ -34,31 +39,6 @@ static inline void yamc_handle_connack(yamc_instance_t* const p_instance, const
 	connack_received = true;
 }
 
-static inline void yamc_handle_pub_x(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
-{
-	yamc_retcode_t ret = YAMC_RET_SUCCESS;
-
-	switch (p_pkt_data->pkt_type)
-	{
-		case YAMC_PKT_PUBREC:
-			ret = yamc_pubrel(p_instance, p_pkt_data->pkt_data.pubrec.packet_id);
-			break;
-
-		case YAMC_PKT_PUBREL:
-			ret = yamc_pubcomp(p_instance, p_pkt_data->pkt_data.pubrel.packet_id);
-			break;
-
-		default:
-			break;
-	}
-
-	if (ret != YAMC_RET_SUCCESS)
-	{
-		YAMC_ERROR_PRINTF("Error sending QoS message: %u\n", ret);
-		exit(-1);
-	}
-}
-
 static void yamc_pub_pkt_handler(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data, void* p_ctx)
 {
 	YAMC_UNUSED_PARAMETER(p_ctx);
@@ -70,20 +50,22 @@ static void yamc_pub_pkt_handler(yamc_instance_t* const p_instance, const yamc_m
 			yamc_handle_connack(p_instance, p_pkt_data);
 			break;
 
-		case YAMC_PKT_PUBREC:
-		case YAMC_PKT_PUBREL:
-			yamc_handle_pub_x(p_instance, p_pkt_data);
-			break;
-		case YAMC_PKT_PUBACK:
-		case YAMC_PKT_PUBCOMP:
-			publish_complete = true;
-			break;
-
 		default:
 			break;
 	}
 }
 
+// PUBACK or PUBCOMP of a message has been received
+static void yamc_pub_complete_handler(yamc_instance_t* const p_instance, uint16_t packet_id, void* p_msg_ctx, void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_instance);
+	YAMC_UNUSED_PARAMETER(packet_id);
+	YAMC_UNUSED_PARAMETER(p_msg_ctx);
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	messages_complete++;
+}
+
 int main(int argc, char** argv)
 {
 	struct yamc_pub_args_info args_info;
@@ -97,12 +79,25 @@ int main(int argc, char** argv)
 	memset(&yamc_net_core, 0, sizeof(yamc_net_core));
 	yamc_net_core_connect(&yamc_net_core, args_info.host_arg, args_info.port_arg, yamc_pub_pkt_handler);
 
+	// message delivery is reported by in-flight tracking
+	yamc_net_core.instance.handlers.pub_complete = yamc_pub_complete_handler;
+
+	// let the library handle QoS acknowledgements
+	yamc_net_core.instance.options.auto_ack = true;
+
 	// enable pkt_handler for following packet types
 	yamc_net_core.instance.parser_enables.CONNACK = true;
-	yamc_net_core.instance.parser_enables.PUBACK  = true;
-	yamc_net_core.instance.parser_enables.PUBCOMP = true;
-	yamc_net_core.instance.parser_enables.PUBREL  = true;
-	yamc_net_core.instance.parser_enables.PUBREC  = true;
+
+	// unacknowledged messages survive restart, clean session discards the ones left by previous run
+	yamc_mmap_store_t store;
+	uint16_t		  restored_cnt = 0;
+
+	if (args_info.store_arg)
+	{
+		if (yamc_mmap_store_open(&store, args_info.store_arg, YAMC_INFLIGHT_WINDOW, YAMC_MMAP_STORE_SLOT_LEN) != YAMC_RET_SUCCESS) exit(-1);
+
+		restored_cnt = yamc_net_core_attach_store(&yamc_net_core, &store, args_info.no_clean_session_flag);
+	}
 
 	// send MQTT connect packet
 	yamc_retcode_t		ret;
@@ -141,7 +136,11 @@ int main(int argc, char** argv)
 		yamc_char_to_mqtt_str(args_info.will_msg_arg, &connect_data.will_message);
 	}
 
+	// timer thread sends keepalive pings, instance is shared with it
+	yamc_net_core_lock(&yamc_net_core);
 	ret = yamc_connect(&yamc_net_core.instance, &connect_data);
+	yamc_net_core_unlock(&yamc_net_core);
+
 	if (ret != YAMC_RET_SUCCESS)
 	{
 		YAMC_ERROR_PRINTF("Error sending connect packet: %u\n", ret);
@@ -154,6 +153,20 @@ int main(int argc, char** argv)
 		usleep(5000);
 	}
 
+	// resend messages left unacknowledged by previous run with DUP flag set
+	if (restored_cnt > 0)
+	{
+		yamc_net_core_lock(&yamc_net_core);
+		ret = yamc_retransmit(&yamc_net_core.instance, 0);
+		yamc_net_core_unlock(&yamc_net_core);
+
+		if (ret != YAMC_RET_SUCCESS)
+		{
+			YAMC_ERROR_PRINTF("Error resending stored messages: %u\n", ret);
+			exit(-1);
+		}
+	}
+
 	// send MQTT publish packet
 	yamc_publish_data_t publish_data;
 	memset(&publish_data, 0, sizeof(yamc_publish_data_t));
@@ -164,24 +177,30 @@ int main(int argc, char** argv)
 	//payload can be empty
 	if (args_info.message_arg) yamc_publish_set_char_payload(args_info.message_arg, &publish_data);
 
-	ret = yamc_publish(&yamc_net_core.instance, &publish_data);
-	if (ret != YAMC_RET_SUCCESS)
+	// messages are sent back to back, publish blocks only when in-flight window is full
+	for (int i = 0; i < args_info.count_arg; i++)
 	{
-		YAMC_ERROR_PRINTF("Error sending publish packet: %u\n", ret);
-		exit(-1);
+		ret = yamc_net_core_publish(&yamc_net_core, &publish_data);
+		if (ret != YAMC_RET_SUCCESS)
+		{
+			YAMC_ERROR_PRINTF("Error sending publish packet: %u\n", ret);
+			exit(-1);
+		}
 	}
 
-	//for qos 0 there will be no confirmation
-	if (args_info.qos_arg == 0) publish_complete = true;
+	//wait for confirmation of remaining messages, for qos 0 there will be none
+	yamc_net_core_wait_inflight(&yamc_net_core);
 
-	//wait for publish confirmation packet to arrive
-	while (!publish_complete)
+	if (args_info.qos_arg > 0 && messages_complete != (uint32_t)args_info.count_arg + restored_cnt)
 	{
-		usleep(5000);
+		YAMC_ERROR_PRINTF("Only %u of %u messages were acknowledged\n", messages_complete, (uint32_t)args_info.count_arg + restored_cnt);
+		exit(-1);
 	}
 
 	// cleanup
 	yamc_net_core_disconnect(&yamc_net_core);
 
+	if (args_info.store_arg) yamc_mmap_store_close(&store);
+
 	return 0;
 }
@@ -27,9 +27,9 @@
 
 const char *yamc_pub_args_info_purpose = "";
 
-const char *yamc_pub_args_info_usage = "Usage: yamc_pub {-h hostname} {-p port} -t topic {-m message} -q qos_level {-c\nclientId}";
+const char *yamc_pub_args_info_usage = "Usage: yamc_pub {-h hostname} {-p port} -t topic {-m message} {-n count} -q\nqos_level {-c clientId}";
 
-const char *yamc_pub_args_info_versiontext = "yamc_pub is a simple MQTT client. It will publish single message and exit.\n\nYAMC (Yet Another MQTT Client) is released under MIT License by Michal Lower\n<https://github.com/keton/yamc>.";
+const char *yamc_pub_args_info_versiontext = "yamc_pub is a simple MQTT client. It will publish message and exit.\n\nYAMC (Yet Another MQTT Client) is released under MIT License by Michal Lower\n<https://github.com/keton/yamc>.";
 
 const char *yamc_pub_args_info_description = "";
 
@@ -42,6 +42,7 @@ const char *yamc_pub_args_info_help[] = {
   "  -P, --password=password       Password to login to host",
   "  -t, --topic=mqtt_topic        MQTT topic to publish message to.",
   "  -m, --message=message_content MQTT message to publish.",
+  "  -n, --count=count             Number of times message is published.\n                                  (default=`1')",
   "  -c, --client-id=client_id     MQTT Client ID",
   "  -q, --qos=qos_level           QoS level for the message.  (possible\n                                  values=\"0\", \"1\", \"2\" default=`0')",
   "  -N, --no-clean-session        Specify this to disable clean session flag.\n                                  (default=off)",
@@ -50,12 +51,14 @@ const char *yamc_pub_args_info_help[] = {
   "      --will-msg=message_content\n                                MQTT will message.",
   "  -W, --will-remain             Specify this to enable will remain flag.\n                                  (default=off)",
   "      --will-qos=qos_level      QoS level for the message.  (possible\n                                  values=\"0\", \"1\", \"2\" default=`0')",
+  "  -s, --store=filename          File persisting unacknowledged QoS>0 messages,\n                                  they are resent on next run with\n                                  --no-clean-session.",
     0
 };
 
 typedef enum {ARG_NO
   , ARG_FLAG
   , ARG_STRING
+  , ARG_INT
   , ARG_SHORT
 } yamc_pub_cmd_parser_arg_type;
 
@@ -88,6 +91,7 @@ void clear_given (struct yamc_pub_args_info *args_info)
   args_info->password_given = 0 ;
   args_info->topic_given = 0 ;
   args_info->message_given = 0 ;
+  args_info->count_given = 0 ;
   args_info->client_id_given = 0 ;
   args_info->qos_given = 0 ;
   args_info->no_clean_session_given = 0 ;
@@ -96,6 +100,7 @@ void clear_given (struct yamc_pub_args_info *args_info)
   args_info->will_msg_given = 0 ;
   args_info->will_remain_given = 0 ;
   args_info->will_qos_given = 0 ;
+  args_info->store_given = 0 ;
 }
 
 static
@@ -114,6 +119,8 @@ void clear_args (struct yamc_pub_args_info *args_info)
   args_info->topic_orig = NULL;
   args_info->message_arg = NULL;
   args_info->message_orig = NULL;
+  args_info->count_arg = 1;
+  args_info->count_orig = NULL;
   args_info->client_id_arg = NULL;
   args_info->client_id_orig = NULL;
   args_info->qos_arg = 0;
@@ -128,6 +135,8 @@ void clear_args (struct yamc_pub_args_info *args_info)
   args_info->will_remain_flag = 0;
   args_info->will_qos_arg = 0;
   args_info->will_qos_orig = NULL;
+  args_info->store_arg = NULL;
+  args_info->store_orig = NULL;
   
 }
 
@@ -144,14 +153,16 @@ void init_args_info(struct yamc_pub_args_info *args_info)
   args_info->password_help = yamc_pub_args_info_help[5] ;
   args_info->topic_help = yamc_pub_args_info_help[6] ;
   args_info->message_help = yamc_pub_args_info_help[7] ;
-  args_info->client_id_help = yamc_pub_args_info_help[8] ;
-  args_info->qos_help = yamc_pub_args_info_help[9] ;
-  args_info->no_clean_session_help = yamc_pub_args_info_help[10] ;
-  args_info->keepalive_timeout_help = yamc_pub_args_info_help[11] ;
-  args_info->will_topic_help = yamc_pub_args_info_help[12] ;
-  args_info->will_msg_help = yamc_pub_args_info_help[13] ;
-  args_info->will_remain_help = yamc_pub_args_info_help[14] ;
-  args_info->will_qos_help = yamc_pub_args_info_help[15] ;
+  args_info->count_help = yamc_pub_args_info_help[8] ;
+  args_info->client_id_help = yamc_pub_args_info_help[9] ;
+  args_info->qos_help = yamc_pub_args_info_help[10] ;
+  args_info->no_clean_session_help = yamc_pub_args_info_help[11] ;
+  args_info->keepalive_timeout_help = yamc_pub_args_info_help[12] ;
+  args_info->will_topic_help = yamc_pub_args_info_help[13] ;
+  args_info->will_msg_help = yamc_pub_args_info_help[14] ;
+  args_info->will_remain_help = yamc_pub_args_info_help[15] ;
+  args_info->will_qos_help = yamc_pub_args_info_help[16] ;
+  args_info->store_help = yamc_pub_args_info_help[17] ;
   
 }
 
@@ -246,6 +257,7 @@ yamc_pub_cmd_parser_release (struct yamc_pub_args_info *args_info)
   free_string_field (&(args_info->topic_orig));
   free_string_field (&(args_info->message_arg));
   free_string_field (&(args_info->message_orig));
+  free_string_field (&(args_info->count_orig));
   free_string_field (&(args_info->client_id_arg));
   free_string_field (&(args_info->client_id_orig));
   free_string_field (&(args_info->qos_orig));
@@ -255,6 +267,8 @@ yamc_pub_cmd_parser_release (struct yamc_pub_args_info *args_info)
   free_string_field (&(args_info->will_msg_arg));
   free_string_field (&(args_info->will_msg_orig));
   free_string_field (&(args_info->will_qos_orig));
+  free_string_field (&(args_info->store_arg));
+  free_string_field (&(args_info->store_orig));
   
   
 
@@ -342,6 +356,8 @@ yamc_pub_cmd_parser_dump(FILE *outfile, struct yamc_pub_args_info *args_info)
     write_into_file(outfile, "topic", args_info->topic_orig, 0);
   if (args_info->message_given)
     write_into_file(outfile, "message", args_info->message_orig, 0);
+  if (args_info->count_given)
+    write_into_file(outfile, "count", args_info->count_orig, 0);
   if (args_info->client_id_given)
     write_into_file(outfile, "client-id", args_info->client_id_orig, 0);
   if (args_info->qos_given)
@@ -358,6 +374,8 @@ yamc_pub_cmd_parser_dump(FILE *outfile, struct yamc_pub_args_info *args_info)
     write_into_file(outfile, "will-remain", 0, 0 );
   if (args_info->will_qos_given)
     write_into_file(outfile, "will-qos", args_info->will_qos_orig, yamc_pub_cmd_parser_will_qos_values);
+  if (args_info->store_given)
+    write_into_file(outfile, "store", args_info->store_orig, 0);
   
 
   i = EXIT_SUCCESS;
@@ -568,6 +586,9 @@ int update_arg(void *field, char **orig_field,
   case ARG_FLAG:
     *((int *)field) = !*((int *)field);
     break;
+  case ARG_INT:
+    if (val) *((int *)field) = strtol (val, &stop_char, 0);
+    break;
   case ARG_SHORT:
     if (val) *((short *)field) = (short)strtol (val, &stop_char, 0);
     break;
@@ -585,6 +606,7 @@ int update_arg(void *field, char **orig_field,
 
   /* check numeric conversion */
   switch(arg_type) {
+  case ARG_INT:
   case ARG_SHORT:
     if (val && !(stop_char && *stop_char == '\0')) {
       fprintf(stderr, "%s: invalid numeric value: %s\n", package_name, val);
@@ -661,6 +683,7 @@ yamc_pub_cmd_parser_internal (
         { "password",	1, NULL, 'P' },
         { "topic",	1, NULL, 't' },
         { "message",	1, NULL, 'm' },
+        { "count",	1, NULL, 'n' },
         { "client-id",	1, NULL, 'c' },
         { "qos",	1, NULL, 'q' },
         { "no-clean-session",	0, NULL, 'N' },
@@ -669,10 +692,11 @@ yamc_pub_cmd_parser_internal (
         { "will-msg",	1, NULL, 0 },
         { "will-remain",	0, NULL, 'W' },
         { "will-qos",	1, NULL, 0 },
+        { "store",	1, NULL, 's' },
         { 0,  0, 0, 0 }
       };
 
-      c = getopt_long (argc, argv, "Vh:p:u:P:t:m:c:q:NW", long_options, &option_index);
+      c = getopt_long (argc, argv, "Vh:p:u:P:t:m:n:c:q:NWs:", long_options, &option_index);
 
       if (c == -1) break;	/* Exit from `while (1)' loop.  */
 
@@ -754,6 +778,18 @@ yamc_pub_cmd_parser_internal (
               additional_error))
             goto failure;
         
+          break;
+        case 'n':	/* Number of times message is published..  */
+        
+        
+          if (update_arg( (void *)&(args_info->count_arg), 
+               &(args_info->count_orig), &(args_info->count_given),
+              &(local_args_info.count_given), optarg, 0, "1", ARG_INT,
+              check_ambiguity, override, 0, 0,
+              "count", 'n',
+              additional_error))
+            goto failure;
+        
           break;
         case 'c':	/* MQTT Client ID.  */
         
@@ -799,6 +835,18 @@ yamc_pub_cmd_parser_internal (
             goto failure;
         
           break;
+        case 's':	/* File persisting unacknowledged QoS>0 messages, they are resent on next run with --no-clean-session..  */
+        
+        
+          if (update_arg( (void *)&(args_info->store_arg), 
+               &(args_info->store_orig), &(args_info->store_given),
+              &(local_args_info.store_given), optarg, 0, 0, ARG_STRING,
+              check_ambiguity, override, 0, 0,
+              "store", 's',
+              additional_error))
+            goto failure;
+        
+          break;
 
         case 0:	/* Long option with no short option */
           if (strcmp (long_options[option_index].name, "help") == 0) {
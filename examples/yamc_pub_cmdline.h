@@ -57,6 +57,9 @@ struct yamc_pub_args_info
   char * message_arg;	/**< @brief MQTT message to publish..  */
   char * message_orig;	/**< @brief MQTT message to publish. original value given at command line.  */
   const char *message_help; /**< @brief MQTT message to publish. help description.  */
+  int count_arg;	/**< @brief Number of times message is published. (default='1').  */
+  char * count_orig;	/**< @brief Number of times message is published. original value given at command line.  */
+  const char *count_help; /**< @brief Number of times message is published. help description.  */
   char * client_id_arg;	/**< @brief MQTT Client ID.  */
   char * client_id_orig;	/**< @brief MQTT Client ID original value given at command line.  */
   const char *client_id_help; /**< @brief MQTT Client ID help description.  */
@@ -79,6 +82,9 @@ struct yamc_pub_args_info
   short will_qos_arg;	/**< @brief QoS level for the message. (default='0').  */
   char * will_qos_orig;	/**< @brief QoS level for the message. original value given at command line.  */
   const char *will_qos_help; /**< @brief QoS level for the message. help description.  */
+  char * store_arg;	/**< @brief File persisting unacknowledged QoS>0 messages, they are resent on next run with --no-clean-session..  */
+  char * store_orig;	/**< @brief File persisting unacknowledged QoS>0 messages, they are resent on next run with --no-clean-session. original value given at command line.  */
+  const char *store_help; /**< @brief File persisting unacknowledged QoS>0 messages, they are resent on next run with --no-clean-session. help description.  */
   
   unsigned int help_given ;	/**< @brief Whether help was given.  */
   unsigned int version_given ;	/**< @brief Whether version was given.  */
@@ -88,6 +94,7 @@ struct yamc_pub_args_info
   unsigned int password_given ;	/**< @brief Whether password was given.  */
   unsigned int topic_given ;	/**< @brief Whether topic was given.  */
   unsigned int message_given ;	/**< @brief Whether message was given.  */
+  unsigned int count_given ;	/**< @brief Whether count was given.  */
   unsigned int client_id_given ;	/**< @brief Whether client-id was given.  */
   unsigned int qos_given ;	/**< @brief Whether qos was given.  */
   unsigned int no_clean_session_given ;	/**< @brief Whether no-clean-session was given.  */
@@ -96,6 +103,7 @@ struct yamc_pub_args_info
   unsigned int will_msg_given ;	/**< @brief Whether will-msg was given.  */
   unsigned int will_remain_given ;	/**< @brief Whether will-remain was given.  */
   unsigned int will_qos_given ;	/**< @brief Whether will-qos was given.  */
+  unsigned int store_given ;	/**< @brief Whether store was given.  */
 
 } ;
 
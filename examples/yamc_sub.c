@@ -15,12 +15,27 @@
 #include <unistd.h>
 
 #include "yamc.h"
+#include "yamc_dispatch.h"
 #include "yamc_net_core.h"
 #include "yamc_sub_cmdline.h"
+#include "yamc_topic_trie.h"
+
+// messages waiting for workers at most, receive thread stops reading when all are queued
+#define YAMC_SUB_DISPATCH_SLAB_CNT 256
+
+// topic and payload bytes copied without heap allocation
+#define YAMC_SUB_DISPATCH_SLAB_LEN 256
 
 static volatile bool connack_received = false;
 static volatile bool suback_received  = false;
 
+// --workers > 0: messages are printed by worker threads
+static yamc_dispatch_t dispatch;
+static bool			   dispatch_enabled = false;
+
+// one subscription per -t filter, trie isn't modified after subscribing so workers can walk it concurrently
+static yamc_topic_trie_t trie;
+
 static inline void yamc_handle_connack(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
 {
 	YAMC_UNUSED_PARAMETER(p_instance);
@@ -34,60 +49,63 @@ static inline void yamc_handle_connack(yamc_instance_t* const p_instance, const
 	connack_received = true;
 }
 
-static inline void yamc_handle_pub_x(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
+// called by trie for each -t filter matching message topic, p_ctx is the filter
+static void yamc_handle_filter(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data, void* p_ctx)
 {
-	yamc_retcode_t ret = YAMC_RET_SUCCESS;
-
-	switch (p_pkt_data->pkt_type)
-	{
-		case YAMC_PKT_PUBREC:
-			ret = yamc_pubrel(p_instance, p_pkt_data->pkt_data.pubrec.packet_id);
-			break;
+	YAMC_UNUSED_PARAMETER(p_instance);
 
-		case YAMC_PKT_PUBREL:
-			ret = yamc_pubcomp(p_instance, p_pkt_data->pkt_data.pubrel.packet_id);
-			break;
+	const yamc_mqtt_pkt_publish_t* const p_data = &p_pkt_data->pkt_data.publish;
 
-		default:
-			break;
-	}
+	YAMC_DEBUG_PRINTF("[%s] \"%.*s\": \"%.*s\"\n", (const char*)p_ctx, p_data->topic_name.len, p_data->topic_name.str,
+					  p_data->payload.data_len, p_data->payload.p_data);
+}
 
-	if (ret != YAMC_RET_SUCCESS)
+static void yamc_route_publish(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
+{
+	if (yamc_topic_trie_dispatch(&trie, p_instance, p_pkt_data) == 0)
 	{
-		YAMC_ERROR_PRINTF("Error sending QoS message: %u\n", ret);
-		exit(-1);
+		const yamc_mqtt_pkt_publish_t* const p_data = &p_pkt_data->pkt_data.publish;
+
+		YAMC_DEBUG_PRINTF("Message on topic \"%.*s\" doesn't match any filter\n", p_data->topic_name.len, p_data->topic_name.str);
 	}
 }
 
-static inline void yamc_handle_publish(const yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
+// QoS acknowledgements are sent by the library
+static inline void yamc_handle_publish(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
 {
 	YAMC_ASSERT(p_instance != NULL);
 	YAMC_ASSERT(p_pkt_data != NULL);
 
-	const yamc_mqtt_pkt_publish_t* const p_data = &p_pkt_data->pkt_data.publish;
+	// copy is queued to worker picked by topic, so messages of each topic are printed in order they came
+	if (dispatch_enabled)
+	{
+		if (yamc_dispatch_publish(&dispatch, p_pkt_data) != YAMC_RET_SUCCESS) YAMC_ERROR_PRINTF("Message dropped\n");
+		return;
+	}
 
-	YAMC_DEBUG_PRINTF("\"%.*s\": \"%.*s\"\n", p_data->topic_name.len, p_data->topic_name.str, p_data->payload.data_len,
-					  p_data->payload.p_data);
+	yamc_route_publish(p_instance, p_pkt_data);
+}
 
-	yamc_retcode_t ret=YAMC_RET_SUCCESS;
+// called on worker thread, copied message is routed the same way as on receive thread
+static void yamc_handle_dispatched(const yamc_dispatch_msg_t* const p_msg, uint32_t worker, void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(worker);
+	YAMC_UNUSED_PARAMETER(p_ctx);
 
-	//send puback for QoS1
-	if (p_pkt_data->flags.QOS == YAMC_QOS_LVL1)
-	{
-		ret = yamc_puback(p_instance, p_data->packet_id);
-	}
+	yamc_mqtt_pkt_data_t pkt_data;
+	memset(&pkt_data, 0, sizeof(pkt_data));
 
-	//send pubrec for QoS2
-	if (p_pkt_data->flags.QOS == YAMC_QOS_LVL2)
-	{
-		ret = yamc_pubrec(p_instance, p_data->packet_id);
-	}
+	pkt_data.pkt_type						   = YAMC_PKT_PUBLISH;
+	pkt_data.flags.QOS						   = p_msg->QOS;
+	pkt_data.flags.DUP						   = p_msg->DUP;
+	pkt_data.flags.RETAIN					   = p_msg->RETAIN;
+	pkt_data.pkt_data.publish.topic_name	   = p_msg->topic;
+	pkt_data.pkt_data.publish.packet_id		   = p_msg->packet_id;
+	pkt_data.pkt_data.publish.payload.p_data   = p_msg->p_data;
+	pkt_data.pkt_data.publish.payload.data_len = p_msg->data_len;
 
-	if (ret != YAMC_RET_SUCCESS)
-	{
-		YAMC_ERROR_PRINTF("Error sending QoS packet: %u\n", ret);
-		exit(-1);
-	}
+	// instance belongs to receive thread
+	yamc_route_publish(NULL, &pkt_data);
 }
 
 static inline void yamc_handle_suback(const yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
@@ -120,11 +138,6 @@ static void yamc_pub_pkt_handler(yamc_instance_t* const p_instance, const yamc_m
 			yamc_handle_connack(p_instance, p_pkt_data);
 			break;
 
-		case YAMC_PKT_PUBREC:
-		case YAMC_PKT_PUBREL:
-			yamc_handle_pub_x(p_instance, p_pkt_data);
-			break;
-
 		case YAMC_PKT_SUBACK:
 			yamc_handle_suback(p_instance, p_pkt_data);
 			break;
@@ -147,16 +160,24 @@ int main(int argc, char** argv)
 		exit(1);
 	}
 
+	if (args_info.workers_arg > 0)
+	{
+		if (yamc_dispatch_init(&dispatch, args_info.workers_arg, YAMC_SUB_DISPATCH_SLAB_CNT, YAMC_SUB_DISPATCH_SLAB_LEN,
+							   yamc_handle_dispatched, NULL) != YAMC_RET_SUCCESS)
+			exit(-1);
+
+		dispatch_enabled = true;
+	}
+
 	yamc_net_core_t yamc_net_core;
 	memset(&yamc_net_core, 0, sizeof(yamc_net_core));
 	yamc_net_core_connect(&yamc_net_core, args_info.host_arg, args_info.port_arg, yamc_pub_pkt_handler);
 
+	// let the library handle QoS acknowledgements
+	yamc_net_core.instance.options.auto_ack = true;
+
 	// enable pkt_handler for following packet types
 	yamc_net_core.instance.parser_enables.CONNACK = true;
-	yamc_net_core.instance.parser_enables.PUBACK  = true;
-	yamc_net_core.instance.parser_enables.PUBCOMP = true;
-	yamc_net_core.instance.parser_enables.PUBREL  = true;
-	yamc_net_core.instance.parser_enables.PUBREC  = true;
 	yamc_net_core.instance.parser_enables.PUBLISH = true;
 	yamc_net_core.instance.parser_enables.SUBACK  = true;
 
@@ -197,7 +218,11 @@ int main(int argc, char** argv)
 		yamc_char_to_mqtt_str(args_info.will_msg_arg, &connect_data.will_message);
 	}
 
+	// timer thread sends keepalive pings, instance is shared with it
+	yamc_net_core_lock(&yamc_net_core);
 	ret = yamc_connect(&yamc_net_core.instance, &connect_data);
+	yamc_net_core_unlock(&yamc_net_core);
+
 	if (ret != YAMC_RET_SUCCESS)
 	{
 		YAMC_ERROR_PRINTF("Error sending connect packet: %u\n", ret);
@@ -212,20 +237,48 @@ int main(int argc, char** argv)
 
 	size_t						 subscribe_buff_len = args_info.topic_given * sizeof(yamc_subscribe_data_t);
 	yamc_subscribe_data_t* const subscribe_data		= malloc(subscribe_buff_len);
+	yamc_topic_sub_t* const		 topic_subs			= calloc(args_info.topic_given, sizeof(yamc_topic_sub_t));
+
+	// every filter level takes at most one node, root takes one more
+	uint32_t nodes_len = 1;
+	for (unsigned int i = 0; i < args_info.topic_given; i++)
+		for (const char* p_char = args_info.topic_arg[i]; *p_char != '\0'; p_char++) nodes_len += (*p_char == '/') ? 1 : 0;
+	nodes_len += args_info.topic_given;
+
+	uint32_t edges_len = 1;
+	while (edges_len < 2 * nodes_len) edges_len <<= 1;
+
+	yamc_topic_node_t* const topic_nodes = malloc(nodes_len * sizeof(yamc_topic_node_t));
+	uint32_t* const			 topic_edges = malloc(edges_len * sizeof(uint32_t));
 
-	if (!subscribe_data)
+	if (!subscribe_data || !topic_subs || !topic_nodes || !topic_edges)
 	{
-		YAMC_ERROR_PRINTF("Failed to allocate %zu bytes!\n", subscribe_buff_len);
+		YAMC_ERROR_PRINTF("Failed to allocate subscription buffers!\n");
 		exit(-1);
 	}
 
+	yamc_topic_trie_init(&trie, topic_nodes, nodes_len, topic_edges, edges_len);
+
 	for (unsigned int i = 0; i < args_info.topic_given; i++)
 	{
 		yamc_char_to_mqtt_str(args_info.topic_arg[i], &subscribe_data[i].topic);
 		subscribe_data[i].qos = args_info.qos_arg;
+
+		topic_subs[i].filter  = subscribe_data[i].topic;
+		topic_subs[i].handler = yamc_handle_filter;
+		topic_subs[i].p_ctx	  = args_info.topic_arg[i];
+
+		if (yamc_topic_trie_add(&trie, &topic_subs[i]) != YAMC_RET_SUCCESS)
+		{
+			YAMC_ERROR_PRINTF("Invalid topic filter: %s\n", args_info.topic_arg[i]);
+			exit(-1);
+		}
 	}
 
+	yamc_net_core_lock(&yamc_net_core);
 	ret = yamc_subscribe(&yamc_net_core.instance, subscribe_data, args_info.topic_given);
+	yamc_net_core_unlock(&yamc_net_core);
+
 	if (ret != YAMC_RET_SUCCESS)
 	{
 		YAMC_ERROR_PRINTF("Error sending subscribe packet: %u\n", ret);
@@ -239,21 +292,17 @@ int main(int argc, char** argv)
 		usleep(5000);
 	}
 
-	// repeatedly send ping request to keep connection alive
-	while (!yamc_net_core_should_exit(&yamc_net_core))
-	{
-		ret = yamc_ping(&yamc_net_core.instance);
-		if (ret != YAMC_RET_SUCCESS)
-		{
-			YAMC_ERROR_PRINTF("Error sending pingreq packet: %u\n", ret);
-			exit(-1);
-		}
+	// yamc sends ping requests while connection is idle, wait for Ctrl+C or connection loss
+	yamc_net_core_wait_exit(&yamc_net_core);
 
-		sleep(args_info.keepalive_timeout_arg / 2);
-	}
-
-	// cleanup
+	// cleanup, messages already queued to workers are printed
 	yamc_net_core_disconnect(&yamc_net_core);
 
+	if (dispatch_enabled) yamc_dispatch_free(&dispatch);
+
+	free(topic_edges);
+	free(topic_nodes);
+	free(topic_subs);
+
 	return 0;
 }
@@ -49,6 +49,7 @@ const char *yamc_sub_args_info_help[] = {
   "      --will-msg=message_content\n                                MQTT will message.",
   "  -W, --will-remain             Specify this to enable will remain flag.\n                                  (default=off)",
   "      --will-qos=qos_level      QoS level for the message.  (possible\n                                  values=\"0\", \"1\", \"2\" default=`0')",
+  "      --workers=worker_cnt      Process received messages on this many worker\n                                  threads, 0: on receive thread.  (default=`0')",
     0
 };
 
@@ -94,6 +95,7 @@ void clear_given (struct yamc_sub_args_info *args_info)
   args_info->will_msg_given = 0 ;
   args_info->will_remain_given = 0 ;
   args_info->will_qos_given = 0 ;
+  args_info->workers_given = 0 ;
 }
 
 static
@@ -124,6 +126,8 @@ void clear_args (struct yamc_sub_args_info *args_info)
   args_info->will_remain_flag = 0;
   args_info->will_qos_arg = 0;
   args_info->will_qos_orig = NULL;
+  args_info->workers_arg = 0;
+  args_info->workers_orig = NULL;
   
 }
 
@@ -149,6 +153,7 @@ void init_args_info(struct yamc_sub_args_info *args_info)
   args_info->will_msg_help = yamc_sub_args_info_help[12] ;
   args_info->will_remain_help = yamc_sub_args_info_help[13] ;
   args_info->will_qos_help = yamc_sub_args_info_help[14] ;
+  args_info->workers_help = yamc_sub_args_info_help[15] ;
   
 }
 
@@ -294,6 +299,7 @@ yamc_sub_cmd_parser_release (struct yamc_sub_args_info *args_info)
   free_string_field (&(args_info->will_msg_arg));
   free_string_field (&(args_info->will_msg_orig));
   free_string_field (&(args_info->will_qos_orig));
+  free_string_field (&(args_info->workers_orig));
   
   
 
@@ -402,6 +408,8 @@ yamc_sub_cmd_parser_dump(FILE *outfile, struct yamc_sub_args_info *args_info)
     write_into_file(outfile, "will-remain", 0, 0 );
   if (args_info->will_qos_given)
     write_into_file(outfile, "will-qos", args_info->will_qos_orig, yamc_sub_cmd_parser_will_qos_values);
+  if (args_info->workers_given)
+    write_into_file(outfile, "workers", args_info->workers_orig, 0);
   
 
   i = EXIT_SUCCESS;
@@ -982,6 +990,7 @@ yamc_sub_cmd_parser_internal (
         { "will-msg",	1, NULL, 0 },
         { "will-remain",	0, NULL, 'W' },
         { "will-qos",	1, NULL, 0 },
+        { "workers",	1, NULL, 0 },
         { 0,  0, 0, 0 }
       };
 
@@ -1160,6 +1169,20 @@ yamc_sub_cmd_parser_internal (
                 additional_error))
               goto failure;
           
+          }
+          /* Process received messages on this many worker threads, 0: on receive thread..  */
+          else if (strcmp (long_options[option_index].name, "workers") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->workers_arg), 
+                 &(args_info->workers_orig), &(args_info->workers_given),
+                &(local_args_info.workers_given), optarg, 0, "0", ARG_SHORT,
+                check_ambiguity, override, 0, 0,
+                "workers", '-',
+                additional_error))
+              goto failure;
+          
           }
           
           break;
@@ -78,6 +78,9 @@ struct yamc_sub_args_info
   short will_qos_arg;	/**< @brief QoS level for the message. (default='0').  */
   char * will_qos_orig;	/**< @brief QoS level for the message. original value given at command line.  */
   const char *will_qos_help; /**< @brief QoS level for the message. help description.  */
+  short workers_arg;	/**< @brief Process received messages on this many worker threads, 0: on receive thread. (default='0').  */
+  char * workers_orig;	/**< @brief Process received messages on this many worker threads, 0: on receive thread. original value given at command line.  */
+  const char *workers_help; /**< @brief Process received messages on this many worker threads, 0: on receive thread. help description.  */
   
   unsigned int help_given ;	/**< @brief Whether help was given.  */
   unsigned int version_given ;	/**< @brief Whether version was given.  */
@@ -94,6 +97,7 @@ struct yamc_sub_args_info
   unsigned int will_msg_given ;	/**< @brief Whether will-msg was given.  */
   unsigned int will_remain_given ;	/**< @brief Whether will-remain was given.  */
   unsigned int will_qos_given ;	/**< @brief Whether will-qos was given.  */
+  unsigned int workers_given ;	/**< @brief Whether workers was given.  */
 
 } ;
 
@@ -0,0 +1,50 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_test.h - Minimal unit test helpers
+ *
+ * Every tests/yamc_test_*.c file is built into separate program by "make test". Program runs its test functions
+ * with YAMC_TEST_RUN() and returns yamc_test_result(), non-zero exit code stops "make test".
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#ifndef __YAMC_TEST_H__
+#define __YAMC_TEST_H__
+
+#include <stdio.h>
+
+static unsigned int yamc_test_check_cnt;
+static unsigned int yamc_test_fail_cnt;
+
+/// record check result, failed check is reported with its location but test continues
+#define YAMC_TEST_CHECK(cond)                                                                \
+	do                                                                                       \
+	{                                                                                        \
+		yamc_test_check_cnt++;                                                               \
+		if (!(cond))                                                                         \
+		{                                                                                    \
+			yamc_test_fail_cnt++;                                                            \
+			fprintf(stderr, "%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, __func__, #cond); \
+		}                                                                                    \
+	} while (0)
+
+/// run test function and print its result
+#define YAMC_TEST_RUN(test)                                                               \
+	do                                                                                    \
+	{                                                                                     \
+		const unsigned int fail_cnt = yamc_test_fail_cnt;                                 \
+		test();                                                                           \
+		printf("  %-48s %s\n", #test, (fail_cnt == yamc_test_fail_cnt) ? "ok" : "FAILED"); \
+	} while (0)
+
+/// print summary, returns program exit code
+static inline int yamc_test_result(const char* const p_name)
+{
+	printf("%s: %u checks, %u failed\n", p_name, yamc_test_check_cnt, yamc_test_fail_cnt);
+
+	return (yamc_test_fail_cnt == 0) ? 0 : 1;
+}
+
+#endif /* __YAMC_TEST_H__ */
@@ -0,0 +1,194 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_test_dispatch.c - Worker pool dispatch unit tests
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "yamc.h"
+#include "yamc_dispatch.h"
+#include "yamc_test.h"
+
+#define TEST_WORKER_CNT 3
+#define TEST_TOPIC_CNT 8
+#define TEST_MSG_CNT 20000
+#define TEST_SLAB_CNT 4
+#define TEST_SLAB_LEN 16
+
+static yamc_dispatch_t dispatch;
+
+// per topic sequence check, each topic is handled by single worker
+static uint32_t next_seq[TEST_TOPIC_CNT];
+static uint32_t topic_worker[TEST_TOPIC_CNT];
+static uint32_t error_cnt;
+static uint32_t handled_cnt;
+
+// worker handlers wait here while gate is closed
+static sem_t		gate;
+static int			gate_closed;
+
+static yamc_retcode_t test_publish(uint32_t topic, uint32_t seq, uint32_t data_len)
+{
+	char	topic_str[16];
+	uint8_t payload[64];
+
+	snprintf(topic_str, sizeof(topic_str), "t/%u", topic);
+
+	memset(payload, (int)seq, sizeof(payload));
+	memcpy(payload, &seq, sizeof(seq));
+
+	yamc_mqtt_pkt_data_t pkt_data;
+	memset(&pkt_data, 0, sizeof(pkt_data));
+
+	pkt_data.pkt_type						 = YAMC_PKT_PUBLISH;
+	pkt_data.flags.QOS						 = YAMC_QOS_LVL1;
+	pkt_data.pkt_data.publish.topic_name.str = (const uint8_t*)topic_str;
+	pkt_data.pkt_data.publish.topic_name.len = strlen(topic_str);
+	pkt_data.pkt_data.publish.packet_id		 = (uint16_t)(seq + 1);
+	pkt_data.pkt_data.publish.payload.p_data   = payload;
+	pkt_data.pkt_data.publish.payload.data_len = data_len;
+
+	return yamc_dispatch_publish(&dispatch, &pkt_data);
+}
+
+static void test_handler(const yamc_dispatch_msg_t* const p_msg, uint32_t worker, void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	if (__atomic_load_n(&gate_closed, __ATOMIC_ACQUIRE)) sem_wait(&gate);
+
+	uint32_t seq = 0;
+
+	// topic isn't null terminated, payload follows it
+	const uint32_t topic = (p_msg->topic.len == 3) ? (uint32_t)(p_msg->topic.str[2] - '0') : UINT32_MAX;
+
+	if (topic >= TEST_TOPIC_CNT)
+	{
+		__atomic_fetch_add(&error_cnt, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	memcpy(&seq, p_msg->p_data, sizeof(seq));
+
+	// payload copy is intact, also when it didn't fit into slab
+	for (uint32_t i = sizeof(seq); i < p_msg->data_len; i++)
+		if (p_msg->p_data[i] != (uint8_t)seq) __atomic_fetch_add(&error_cnt, 1, __ATOMIC_RELAXED);
+
+	// only worker of the topic touches its entries
+	if (topic_worker[topic] == UINT32_MAX) topic_worker[topic] = worker;
+
+	if (seq != next_seq[topic] || worker != topic_worker[topic] || p_msg->packet_id != (uint16_t)(seq + 1) ||
+		p_msg->QOS != YAMC_QOS_LVL1)
+		__atomic_fetch_add(&error_cnt, 1, __ATOMIC_RELAXED);
+
+	next_seq[topic] = seq + 1;
+
+	__atomic_fetch_add(&handled_cnt, 1, __ATOMIC_RELEASE);
+}
+
+static void test_reset(void)
+{
+	memset(next_seq, 0, sizeof(next_seq));
+	error_cnt   = 0;
+	handled_cnt = 0;
+	__atomic_store_n(&gate_closed, 0, __ATOMIC_RELEASE);
+
+	// worker is picked by topic hash, it's recorded on first message of each topic
+	for (uint32_t topic = 0; topic < TEST_TOPIC_CNT; topic++) topic_worker[topic] = UINT32_MAX;
+
+	YAMC_TEST_CHECK(yamc_dispatch_init(&dispatch, TEST_WORKER_CNT, TEST_SLAB_CNT, TEST_SLAB_LEN, test_handler, NULL) ==
+					YAMC_RET_SUCCESS);
+}
+
+// worker of each topic gets its messages in order they were published, short and long ones alike
+static void test_dispatch_order(void)
+{
+	test_reset();
+
+	for (uint32_t i = 0; i < TEST_MSG_CNT; i++)
+	{
+		const uint32_t topic = (i * 7u) % TEST_TOPIC_CNT;
+
+		// every 5th message is longer than slab
+		YAMC_TEST_CHECK(test_publish(topic, i / TEST_TOPIC_CNT, (i % 5 == 0) ? 64 : 8) == YAMC_RET_SUCCESS);
+	}
+
+	yamc_dispatch_free(&dispatch);
+
+	YAMC_TEST_CHECK(error_cnt == 0);
+	YAMC_TEST_CHECK(handled_cnt == TEST_MSG_CNT);
+
+	for (uint32_t topic = 0; topic < TEST_TOPIC_CNT; topic++) YAMC_TEST_CHECK(next_seq[topic] == TEST_MSG_CNT / TEST_TOPIC_CNT);
+}
+
+// number of messages queued by publisher thread
+static uint32_t queued_cnt;
+
+static void* test_publisher_thread(void* p_arg)
+{
+	YAMC_UNUSED_PARAMETER(p_arg);
+
+	for (uint32_t i = 0; i < TEST_SLAB_CNT + 2; i++)
+	{
+		// checks aren't thread safe, failure is counted instead
+		if (test_publish(0, i, 8) != YAMC_RET_SUCCESS) __atomic_fetch_add(&error_cnt, 1, __ATOMIC_RELAXED);
+
+		__atomic_store_n(&queued_cnt, i + 1, __ATOMIC_RELEASE);
+	}
+
+	return NULL;
+}
+
+// receive thread waits while all slabs are in use and continues once worker returns one
+static void test_dispatch_exhaust(void)
+{
+	test_reset();
+
+	sem_init(&gate, 0, 0);
+	__atomic_store_n(&gate_closed, 1, __ATOMIC_RELEASE);
+	queued_cnt	= 0;
+
+	// all messages go to the same worker, first one gets stuck in handler holding its slab
+	pthread_t tid;
+	pthread_create(&tid, NULL, test_publisher_thread, NULL);
+
+	usleep(100000);
+	YAMC_TEST_CHECK(__atomic_load_n(&queued_cnt, __ATOMIC_ACQUIRE) == TEST_SLAB_CNT);
+	YAMC_TEST_CHECK(__atomic_load_n(&handled_cnt, __ATOMIC_ACQUIRE) == 0);
+
+	// one handled message makes room for exactly one more
+	sem_post(&gate);
+
+	usleep(100000);
+	YAMC_TEST_CHECK(__atomic_load_n(&queued_cnt, __ATOMIC_ACQUIRE) == TEST_SLAB_CNT + 1);
+	YAMC_TEST_CHECK(__atomic_load_n(&handled_cnt, __ATOMIC_ACQUIRE) == 1);
+
+	// worker blocked in handler has to be let through once more
+	__atomic_store_n(&gate_closed, 0, __ATOMIC_RELEASE);
+	sem_post(&gate);
+
+	pthread_join(tid, NULL);
+	yamc_dispatch_free(&dispatch);
+	sem_destroy(&gate);
+
+	YAMC_TEST_CHECK(error_cnt == 0);
+	YAMC_TEST_CHECK(handled_cnt == TEST_SLAB_CNT + 2);
+	YAMC_TEST_CHECK(next_seq[0] == TEST_SLAB_CNT + 2);
+}
+
+int main(void)
+{
+	YAMC_TEST_RUN(test_dispatch_order);
+	YAMC_TEST_RUN(test_dispatch_exhaust);
+
+	return yamc_test_result("yamc_test_dispatch");
+}
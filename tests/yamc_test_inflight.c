@@ -0,0 +1,327 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_test_inflight.c - In-flight table unit tests: window limit, slot reuse, acknowledgements and retransmission
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "yamc.h"
+#include "yamc_test.h"
+
+#define TEST_INFLIGHT_LEN 4
+#define TEST_WINDOW 16
+
+static yamc_instance_t		 instance;
+static uint8_t				 rx_buff[64];
+static uint8_t				 tx_buff[256];
+static yamc_inflight_entry_t inflight[TEST_INFLIGHT_LEN];
+static uint32_t				 bitmap[YAMC_PKT_ID_BITMAP_WORDS(TEST_WINDOW)];
+
+static uint8_t  tx_log[1024];
+static uint32_t tx_log_len;
+static uint32_t now_ms;
+
+static void*	completed[16];
+static uint16_t completed_ids[16];
+static uint32_t completed_cnt;
+
+static void test_disconnect(void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+}
+
+static yamc_retcode_t test_write(void* p_ctx, const uint8_t* const p_buff, uint32_t buff_len)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	if (tx_log_len + buff_len <= sizeof(tx_log))
+	{
+		memcpy(&tx_log[tx_log_len], p_buff, buff_len);
+		tx_log_len += buff_len;
+	}
+
+	return YAMC_RET_SUCCESS;
+}
+
+static void test_pkt_handler(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data, void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_instance);
+	YAMC_UNUSED_PARAMETER(p_pkt_data);
+	YAMC_UNUSED_PARAMETER(p_ctx);
+}
+
+static uint32_t test_timestamp(void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	return now_ms;
+}
+
+static void test_pub_complete(yamc_instance_t* const p_instance, uint16_t packet_id, void* p_msg_ctx, void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_instance);
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	if (completed_cnt == sizeof(completed) / sizeof(completed[0])) return;
+
+	completed_ids[completed_cnt] = packet_id;
+	completed[completed_cnt++]	 = p_msg_ctx;
+}
+
+static void test_init(void)
+{
+	const yamc_handler_cfg_t handler_cfg = {
+		.disconnect   = test_disconnect,
+		.write		  = test_write,
+		.pkt_handler  = test_pkt_handler,
+		.timestamp	  = test_timestamp,
+		.pub_complete = test_pub_complete,
+	};
+
+	const yamc_buff_cfg_t buff_cfg = {
+		.p_rx_buff		 = rx_buff,
+		.rx_buff_len	 = sizeof(rx_buff),
+		.p_tx_buff		 = tx_buff,
+		.tx_buff_len	 = sizeof(tx_buff),
+		.p_inflight		 = inflight,
+		.inflight_len	 = TEST_INFLIGHT_LEN,
+		.p_pkt_id_bitmap = bitmap,
+		.pkt_id_window	 = TEST_WINDOW,
+	};
+
+	yamc_init(&instance, &handler_cfg, &buff_cfg);
+	instance.options.auto_ack = 1;
+
+	tx_log_len	  = 0;
+	now_ms		  = 1000;
+	completed_cnt = 0;
+}
+
+static yamc_retcode_t test_publish(yamc_qos_lvl_t qos, void* p_msg_ctx)
+{
+	yamc_publish_data_t pub = {.QOS = qos, .p_data = (const uint8_t*)"data", .data_len = 4, .p_msg_ctx = p_msg_ctx};
+	yamc_char_to_mqtt_str("t", &pub.topic);
+
+	return yamc_publish(&instance, &pub);
+}
+
+// feed PUBACK, PUBREC or PUBCOMP from server
+static void test_ack(yamc_pkt_type_t type, uint16_t packet_id)
+{
+	const uint8_t pkt[] = {(uint8_t)(type << 4), 0x02, (uint8_t)(packet_id >> 8), (uint8_t)packet_id};
+
+	yamc_parse_buff(&instance, pkt, sizeof(pkt));
+}
+
+// window limits unacknowledged packets, each PUBACK makes room for next one
+static void test_inflight_window(void)
+{
+	test_init();
+
+	for (uintptr_t i = 1; i <= TEST_INFLIGHT_LEN; i++) YAMC_TEST_CHECK(test_publish(YAMC_QOS_LVL1, (void*)i) == YAMC_RET_SUCCESS);
+
+	YAMC_TEST_CHECK(test_publish(YAMC_QOS_LVL1, NULL) == YAMC_RET_WOULD_BLOCK);
+
+	// QoS0 doesn't need room in window
+	YAMC_TEST_CHECK(test_publish(YAMC_QOS_LVL0, NULL) == YAMC_RET_SUCCESS);
+
+	test_ack(YAMC_PKT_PUBACK, 1);
+
+	YAMC_TEST_CHECK(completed_cnt == 1 && completed_ids[0] == 1 && completed[0] == (void*)1);
+	YAMC_TEST_CHECK(yamc_inflight_pending(&instance) == TEST_INFLIGHT_LEN - 1);
+	YAMC_TEST_CHECK(test_publish(YAMC_QOS_LVL1, (void*)5) == YAMC_RET_SUCCESS);
+
+	// PUBACK for unknown id is ignored
+	test_ack(YAMC_PKT_PUBACK, 1);
+	YAMC_TEST_CHECK(completed_cnt == 1);
+
+	for (uint16_t id = 2; id <= TEST_INFLIGHT_LEN + 1; id++) test_ack(YAMC_PKT_PUBACK, id);
+
+	YAMC_TEST_CHECK(completed_cnt == TEST_INFLIGHT_LEN + 1);
+	YAMC_TEST_CHECK(completed[TEST_INFLIGHT_LEN] == (void*)5);
+	YAMC_TEST_CHECK(yamc_inflight_pending(&instance) == 0);
+}
+
+// QoS2 flow: PUBREC is answered with PUBREL, PUBCOMP completes delivery
+static void test_inflight_qos2(void)
+{
+	test_init();
+
+	YAMC_TEST_CHECK(test_publish(YAMC_QOS_LVL2, (void*)7) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(inflight[0].state == YAMC_INFLIGHT_WAIT_PUBREC);
+
+	tx_log_len = 0;
+	test_ack(YAMC_PKT_PUBREC, 1);
+
+	static const uint8_t pubrel[] = {0x62, 0x02, 0x00, 0x01};
+	YAMC_TEST_CHECK(tx_log_len == sizeof(pubrel) && memcmp(tx_log, pubrel, sizeof(pubrel)) == 0);
+	YAMC_TEST_CHECK(inflight[0].state == YAMC_INFLIGHT_WAIT_PUBCOMP);
+	YAMC_TEST_CHECK(completed_cnt == 0);
+
+	// PUBACK doesn't complete QoS2 delivery
+	test_ack(YAMC_PKT_PUBACK, 1);
+	YAMC_TEST_CHECK(completed_cnt == 0);
+
+	test_ack(YAMC_PKT_PUBCOMP, 1);
+	YAMC_TEST_CHECK(completed_cnt == 1 && completed[0] == (void*)7);
+	YAMC_TEST_CHECK(yamc_inflight_pending(&instance) == 0);
+}
+
+// only packets older than timeout are resent, with DUP flag
+static void test_inflight_retransmit(void)
+{
+	test_init();
+
+	test_publish(YAMC_QOS_LVL1, NULL);
+	now_ms += 500;
+	test_publish(YAMC_QOS_LVL1, NULL);
+
+	tx_log_len = 0;
+	now_ms += 600;
+
+	YAMC_TEST_CHECK(yamc_retransmit(&instance, 1000) == YAMC_RET_SUCCESS);
+
+	// first packet only: PUBLISH, DUP, QoS1, packet id 1
+	static const uint8_t dup_pub[] = {0x3A, 0x09, 0x00, 0x01, 't', 0x00, 0x01, 'd', 'a', 't', 'a'};
+	YAMC_TEST_CHECK(tx_log_len == sizeof(dup_pub) && memcmp(tx_log, dup_pub, sizeof(dup_pub)) == 0);
+
+	// retransmission restarts timeout
+	tx_log_len = 0;
+	YAMC_TEST_CHECK(yamc_retransmit(&instance, 1000) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(tx_log_len == 0);
+
+	// 0 resends everything
+	YAMC_TEST_CHECK(yamc_retransmit(&instance, 0) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(tx_log_len == 2 * sizeof(dup_pub));
+}
+
+// resent message keeps packet id of earlier transmission
+static void test_inflight_resend_id(void)
+{
+	test_init();
+
+	yamc_publish_data_t pub = {.QOS = YAMC_QOS_LVL1, .DUP = true, .p_data = (const uint8_t*)"data", .data_len = 4, .packet_id = 9};
+	yamc_char_to_mqtt_str("t", &pub.topic);
+
+	YAMC_TEST_CHECK(yamc_publish(&instance, &pub) == YAMC_RET_SUCCESS);
+
+	static const uint8_t dup_pub[] = {0x3A, 0x09, 0x00, 0x01, 't', 0x00, 0x09, 'd', 'a', 't', 'a'};
+	YAMC_TEST_CHECK(tx_log_len == sizeof(dup_pub) && memcmp(tx_log, dup_pub, sizeof(dup_pub)) == 0);
+
+	// id is reserved until acknowledged
+	for (uint16_t id = 1; id < TEST_INFLIGHT_LEN; id++) test_publish(YAMC_QOS_LVL1, NULL);
+	test_ack(YAMC_PKT_PUBACK, 9);
+
+	YAMC_TEST_CHECK(completed_cnt == 1 && completed_ids[0] == 9);
+	YAMC_TEST_CHECK(bitmap[0] == 0x07);
+}
+
+// persisted entries are restored into their slots, packet ids stay reserved
+static void test_inflight_restore(void)
+{
+	test_init();
+
+	const yamc_inflight_entry_t entry = {
+		.state	   = YAMC_INFLIGHT_WAIT_PUBACK,
+		.packet_id = 3,
+		.topic	   = {.str = (const uint8_t*)"t", .len = 1},
+	};
+
+	YAMC_TEST_CHECK(yamc_inflight_restore(&instance, 2, &entry) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(yamc_inflight_restore(&instance, 2, &entry) == YAMC_RET_INVALID_DATA);
+	YAMC_TEST_CHECK(yamc_inflight_restore(&instance, TEST_INFLIGHT_LEN, &entry) == YAMC_RET_INVALID_DATA);
+
+	YAMC_TEST_CHECK(instance.inflight.oldest == 2 && instance.inflight.newest == 2 && yamc_inflight_pending(&instance) == 1);
+
+	// restored id is not handed out again, remaining slots are used
+	for (uint32_t i = 0; i < 3; i++) test_publish(YAMC_QOS_LVL1, NULL);
+
+	YAMC_TEST_CHECK(inflight[0].packet_id == 1 && inflight[1].packet_id == 2 && inflight[3].packet_id == 4);
+	YAMC_TEST_CHECK(instance.inflight.oldest == 2 && instance.inflight.newest == 3);
+
+	test_ack(YAMC_PKT_PUBACK, 3);
+	YAMC_TEST_CHECK(completed_cnt == 1 && completed_ids[0] == 3);
+
+	// slot of acknowledged restored entry is reused
+	YAMC_TEST_CHECK(test_publish(YAMC_QOS_LVL1, NULL) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(inflight[2].packet_id == 5 && instance.inflight.oldest == 0 && instance.inflight.newest == 2);
+}
+
+// packet id of n-th PUBLISH retransmitted with yamc_retransmit(), packets are 11 bytes long
+static uint16_t test_retransmitted_id(uint32_t n)
+{
+	return (uint16_t)((tx_log[n * 11 + 5] << 8) | tx_log[n * 11 + 6]);
+}
+
+// lost PUBACK of oldest packet doesn't block slots of newer acknowledged packets
+static void test_inflight_out_of_order(void)
+{
+	test_init();
+
+	for (uint32_t i = 0; i < TEST_INFLIGHT_LEN; i++) test_publish(YAMC_QOS_LVL1, NULL);
+
+	for (uint16_t id = 2; id <= TEST_INFLIGHT_LEN; id++) test_ack(YAMC_PKT_PUBACK, id);
+
+	YAMC_TEST_CHECK(yamc_inflight_pending(&instance) == 1);
+
+	for (uint32_t i = 1; i < TEST_INFLIGHT_LEN; i++) YAMC_TEST_CHECK(test_publish(YAMC_QOS_LVL1, NULL) == YAMC_RET_SUCCESS);
+
+	YAMC_TEST_CHECK(test_publish(YAMC_QOS_LVL1, NULL) == YAMC_RET_WOULD_BLOCK);
+
+	// send order is kept across reused slots
+	tx_log_len = 0;
+	YAMC_TEST_CHECK(yamc_retransmit(&instance, 0) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(tx_log_len == TEST_INFLIGHT_LEN * 11);
+	YAMC_TEST_CHECK(test_retransmitted_id(0) == 1 && test_retransmitted_id(1) == 5 && test_retransmitted_id(2) == 6 &&
+					test_retransmitted_id(3) == 7);
+
+	// acknowledgements in any order complete all packets
+	test_ack(YAMC_PKT_PUBACK, 6);
+	test_ack(YAMC_PKT_PUBACK, 1);
+	test_ack(YAMC_PKT_PUBACK, 7);
+	test_ack(YAMC_PKT_PUBACK, 5);
+
+	YAMC_TEST_CHECK(completed_cnt == 2 * TEST_INFLIGHT_LEN - 1 && yamc_inflight_pending(&instance) == 0);
+}
+
+// scheduler reports time until oldest packet expires
+static void test_inflight_retransmit_poll(void)
+{
+	test_init();
+
+	YAMC_TEST_CHECK(yamc_retransmit_poll(&instance, now_ms, 1000) == UINT32_MAX);
+
+	test_publish(YAMC_QOS_LVL1, NULL);
+	now_ms += 500;
+	test_publish(YAMC_QOS_LVL1, NULL);
+
+	tx_log_len = 0;
+	YAMC_TEST_CHECK(yamc_retransmit_poll(&instance, now_ms + 100, 1000) == 400);
+	YAMC_TEST_CHECK(tx_log_len == 0);
+
+	// first packet expires, second one is due 500 ms later
+	YAMC_TEST_CHECK(yamc_retransmit_poll(&instance, now_ms + 500, 1000) == 500);
+	YAMC_TEST_CHECK(tx_log_len == 11 && test_retransmitted_id(0) == 1);
+
+	test_ack(YAMC_PKT_PUBACK, 1);
+	test_ack(YAMC_PKT_PUBACK, 2);
+	YAMC_TEST_CHECK(yamc_retransmit_poll(&instance, now_ms + 500, 1000) == UINT32_MAX);
+}
+
+int main(void)
+{
+	YAMC_TEST_RUN(test_inflight_window);
+	YAMC_TEST_RUN(test_inflight_qos2);
+	YAMC_TEST_RUN(test_inflight_retransmit);
+	YAMC_TEST_RUN(test_inflight_resend_id);
+	YAMC_TEST_RUN(test_inflight_restore);
+	YAMC_TEST_RUN(test_inflight_out_of_order);
+	YAMC_TEST_RUN(test_inflight_retransmit_poll);
+
+	return yamc_test_result("yamc_test_inflight");
+}
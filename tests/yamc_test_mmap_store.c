@@ -0,0 +1,345 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_test_mmap_store.c - Memory mapped store unit tests: messages and their states survive reopening in send order
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "yamc.h"
+#include "yamc_mmap_store.h"
+#include "yamc_test.h"
+
+#define TEST_SLOTS_CNT 4
+#define TEST_WINDOW 16
+#define TEST_SLOT_DATA_LEN 100
+#define TEST_PAYLOAD_LEN 32
+
+static yamc_instance_t		 instance;
+static uint8_t				 rx_buff[64];
+static uint8_t				 tx_buff[256];
+static yamc_inflight_entry_t inflight[TEST_SLOTS_CNT];
+static uint32_t				 bitmap[YAMC_PKT_ID_BITMAP_WORDS(TEST_WINDOW)];
+
+static yamc_mmap_store_t store;
+static char				 store_dir[] = "/tmp/yamc_test_mmap_store_XXXXXX";
+static char				 store_path[PATH_MAX];
+
+static uint8_t  tx_log[1024];
+static uint32_t tx_log_len;
+
+// packets found in tx log, payload of PUBLISH starts with message sequence number
+typedef struct
+{
+	yamc_pkt_type_t type;
+	bool			dup;
+	uint16_t		packet_id;
+	uint8_t			seq;
+
+} test_sent_t;
+
+static test_sent_t sent[16];
+static uint32_t	sent_cnt;
+
+static void test_disconnect(void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+}
+
+static yamc_retcode_t test_write(void* p_ctx, const uint8_t* const p_buff, uint32_t buff_len)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	if (tx_log_len + buff_len > sizeof(tx_log)) return YAMC_RET_INVALID_STATE;
+
+	memcpy(&tx_log[tx_log_len], p_buff, buff_len);
+	tx_log_len += buff_len;
+
+	return YAMC_RET_SUCCESS;
+}
+
+static void test_pkt_handler(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data, void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_instance);
+	YAMC_UNUSED_PARAMETER(p_pkt_data);
+	YAMC_UNUSED_PARAMETER(p_ctx);
+}
+
+static uint32_t test_timestamp(void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	return 1000;
+}
+
+// in-flight table is persisted the same way net core does it
+static void test_inflight_save(void* p_ctx, uint16_t slot, const yamc_inflight_entry_t* const p_entry)
+{
+	yamc_mmap_store_save((yamc_mmap_store_t*)p_ctx, slot, p_entry);
+}
+
+static void test_inflight_release(void* p_ctx, uint16_t slot)
+{
+	yamc_mmap_store_release((yamc_mmap_store_t*)p_ctx, slot);
+}
+
+// fresh instance, as after restart
+static void test_instance_init(void)
+{
+	const yamc_handler_cfg_t handler_cfg = {
+		.disconnect		  = test_disconnect,
+		.write			  = test_write,
+		.pkt_handler	  = test_pkt_handler,
+		.timestamp		  = test_timestamp,
+		.inflight_save	  = test_inflight_save,
+		.inflight_release = test_inflight_release,
+		.p_handler_ctx	  = &store,
+	};
+
+	const yamc_buff_cfg_t buff_cfg = {
+		.p_rx_buff		 = rx_buff,
+		.rx_buff_len	 = sizeof(rx_buff),
+		.p_tx_buff		 = tx_buff,
+		.tx_buff_len	 = sizeof(tx_buff),
+		.p_inflight		 = inflight,
+		.inflight_len	 = TEST_SLOTS_CNT,
+		.p_pkt_id_bitmap = bitmap,
+		.pkt_id_window	 = TEST_WINDOW,
+	};
+
+	yamc_init(&instance, &handler_cfg, &buff_cfg);
+
+	tx_log_len = 0;
+}
+
+// returns packet id of sent message
+static uint16_t test_publish(const yamc_qos_lvl_t qos, const uint8_t seq)
+{
+	uint8_t payload[TEST_PAYLOAD_LEN];
+	memset(payload, seq, sizeof(payload));
+
+	yamc_publish_data_t pub = {.QOS = qos, .p_data = payload, .data_len = sizeof(payload)};
+	yamc_char_to_mqtt_str("store/test", &pub.topic);
+
+	YAMC_TEST_CHECK(yamc_publish(&instance, &pub) == YAMC_RET_SUCCESS);
+
+	return instance.last_packet_id;
+}
+
+// feed PUBACK, PUBREC or PUBCOMP from server
+static void test_ack(const yamc_pkt_type_t type, const uint16_t packet_id)
+{
+	const uint8_t pkt[] = {(uint8_t)(type << 4), 0x02, (uint8_t)(packet_id >> 8), (uint8_t)packet_id};
+
+	yamc_parse_buff(&instance, pkt, sizeof(pkt));
+}
+
+// split tx log into packets, returns false if it's garbled
+static bool test_sent_decode(void)
+{
+	sent_cnt = 0;
+
+	uint32_t pos = 0;
+	while (pos + 2 <= tx_log_len && sent_cnt < sizeof(sent) / sizeof(sent[0]))
+	{
+		const uint8_t  hdr			 = tx_log[pos];
+		const uint32_t remaining_len = tx_log[pos + 1];  // test packets are short
+		const uint8_t* p_var		 = &tx_log[pos + 2];
+
+		if (remaining_len & 0x80 || pos + 2 + remaining_len > tx_log_len) return false;
+
+		test_sent_t* const p_sent = &sent[sent_cnt++];
+		p_sent->type			  = (yamc_pkt_type_t)(hdr >> 4);
+		p_sent->dup				  = (hdr & 0x08) != 0;
+		p_sent->seq				  = 0;
+
+		if (p_sent->type == YAMC_PKT_PUBLISH)
+		{
+			const uint32_t topic_len = ((uint32_t)p_var[0] << 8) | p_var[1];
+			const uint32_t data_off	 = 2 + topic_len + 2;
+
+			if (data_off + TEST_PAYLOAD_LEN != remaining_len || memcmp(&p_var[2], "store/test", topic_len) != 0) return false;
+
+			p_sent->packet_id = ((uint16_t)p_var[2 + topic_len] << 8) | p_var[2 + topic_len + 1];
+			p_sent->seq		  = p_var[data_off];
+
+			for (uint32_t i = data_off; i < remaining_len; i++)
+			{
+				if (p_var[i] != p_sent->seq) return false;
+			}
+		}
+		else
+		{
+			if (remaining_len != 2) return false;
+
+			p_sent->packet_id = ((uint16_t)p_var[0] << 8) | p_var[1];
+		}
+
+		pos += 2 + remaining_len;
+	}
+
+	return pos == tx_log_len;
+}
+
+static void test_reopen(void)
+{
+	yamc_mmap_store_close(&store);
+	YAMC_TEST_CHECK(yamc_mmap_store_open(&store, store_path, TEST_SLOTS_CNT, TEST_SLOT_DATA_LEN) == YAMC_RET_SUCCESS);
+
+	test_instance_init();
+}
+
+// stored messages are restored in send order regardless of slots they took and sequence number wrap around
+static void test_mmap_store_restore(void)
+{
+	YAMC_TEST_CHECK(yamc_mmap_store_open(&store, store_path, TEST_SLOTS_CNT, TEST_SLOT_DATA_LEN) == YAMC_RET_SUCCESS);
+	test_instance_init();
+
+	YAMC_TEST_CHECK(yamc_mmap_store_restore(&store, &instance) == 0);
+
+	// sequence numbers wrap around while messages are stored
+	store.next_seq = UINT32_MAX - 1;
+
+	uint16_t ids[5];
+	ids[0] = test_publish(YAMC_QOS_LVL1, 0);
+	ids[1] = test_publish(YAMC_QOS_LVL1, 1);
+	ids[2] = test_publish(YAMC_QOS_LVL2, 2);
+	ids[3] = test_publish(YAMC_QOS_LVL2, 3);
+
+	// second slot is reused by newest message
+	test_ack(YAMC_PKT_PUBACK, ids[1]);
+	ids[4] = test_publish(YAMC_QOS_LVL1, 4);
+	YAMC_TEST_CHECK(inflight[1].packet_id == ids[4]);
+
+	// only PUBREL is resent for QoS2 message received by server
+	test_ack(YAMC_PKT_PUBREC, ids[2]);
+
+	test_reopen();
+
+	YAMC_TEST_CHECK(yamc_mmap_store_restore(&store, &instance) == 4);
+	YAMC_TEST_CHECK(yamc_inflight_pending(&instance) == 4);
+	YAMC_TEST_CHECK(store.next_seq == 3);
+
+	YAMC_TEST_CHECK(inflight[0].state == YAMC_INFLIGHT_WAIT_PUBACK && inflight[0].packet_id == ids[0]);
+	YAMC_TEST_CHECK(inflight[1].state == YAMC_INFLIGHT_WAIT_PUBACK && inflight[1].packet_id == ids[4]);
+	YAMC_TEST_CHECK(inflight[2].state == YAMC_INFLIGHT_WAIT_PUBCOMP && inflight[2].packet_id == ids[2]);
+	YAMC_TEST_CHECK(inflight[3].state == YAMC_INFLIGHT_WAIT_PUBREC && inflight[3].packet_id == ids[3]);
+
+	YAMC_TEST_CHECK(yamc_retransmit(&instance, 0) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_sent_decode());
+	YAMC_TEST_CHECK(sent_cnt == 4);
+
+	if (sent_cnt == 4)
+	{
+		YAMC_TEST_CHECK(sent[0].type == YAMC_PKT_PUBLISH && sent[0].dup && sent[0].packet_id == ids[0] && sent[0].seq == 0);
+		YAMC_TEST_CHECK(sent[1].type == YAMC_PKT_PUBREL && sent[1].packet_id == ids[2]);
+		YAMC_TEST_CHECK(sent[2].type == YAMC_PKT_PUBLISH && sent[2].dup && sent[2].packet_id == ids[3] && sent[2].seq == 3);
+		YAMC_TEST_CHECK(sent[3].type == YAMC_PKT_PUBLISH && sent[3].dup && sent[3].packet_id == ids[4] && sent[3].seq == 4);
+	}
+
+	// acknowledged messages don't survive next restart, new one is stored after restored ones
+	test_ack(YAMC_PKT_PUBACK, ids[0]);
+	test_ack(YAMC_PKT_PUBCOMP, ids[2]);
+	const uint16_t new_id = test_publish(YAMC_QOS_LVL1, 5);
+
+	test_reopen();
+
+	YAMC_TEST_CHECK(yamc_mmap_store_restore(&store, &instance) == 3);
+
+	tx_log_len = 0;
+	YAMC_TEST_CHECK(yamc_retransmit(&instance, 0) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_sent_decode());
+	YAMC_TEST_CHECK(sent_cnt == 3);
+
+	if (sent_cnt == 3)
+	{
+		YAMC_TEST_CHECK(sent[0].packet_id == ids[3] && sent[0].seq == 3);
+		YAMC_TEST_CHECK(sent[1].packet_id == ids[4] && sent[1].seq == 4);
+		YAMC_TEST_CHECK(sent[2].packet_id == new_id && sent[2].seq == 5);
+	}
+
+	// clean session drops everything
+	yamc_mmap_store_clear(&store);
+	test_reopen();
+	YAMC_TEST_CHECK(yamc_mmap_store_restore(&store, &instance) == 0);
+
+	yamc_mmap_store_close(&store);
+}
+
+// file created with different geometry is refused, store is restored only into table of the same length
+static void test_mmap_store_geometry(void)
+{
+	yamc_mmap_store_t other;
+
+	YAMC_TEST_CHECK(yamc_mmap_store_open(&other, store_path, TEST_SLOTS_CNT + 1, TEST_SLOT_DATA_LEN) == YAMC_RET_INVALID_DATA);
+
+	// slot length is aligned, file size alone doesn't tell the difference
+	YAMC_TEST_CHECK(yamc_mmap_store_open(&other, store_path, TEST_SLOTS_CNT, TEST_SLOT_DATA_LEN + 1) == YAMC_RET_INVALID_DATA);
+
+	YAMC_TEST_CHECK(yamc_mmap_store_open(&store, store_path, TEST_SLOTS_CNT, TEST_SLOT_DATA_LEN) == YAMC_RET_SUCCESS);
+
+	YAMC_TEST_CHECK(yamc_mmap_store_fits(&store, 10, TEST_SLOT_DATA_LEN - 10));
+	YAMC_TEST_CHECK(!yamc_mmap_store_fits(&store, 10, TEST_SLOT_DATA_LEN - 9));
+
+	test_instance_init();
+	test_publish(YAMC_QOS_LVL1, 0);
+
+	// in-flight table shorter than store
+	static yamc_instance_t		 short_instance;
+	static yamc_inflight_entry_t short_inflight[TEST_SLOTS_CNT - 1];
+	static uint32_t				 short_bitmap[YAMC_PKT_ID_BITMAP_WORDS(TEST_WINDOW)];
+
+	const yamc_handler_cfg_t handler_cfg = {
+		.disconnect	 = test_disconnect,
+		.write		 = test_write,
+		.pkt_handler = test_pkt_handler,
+		.timestamp	 = test_timestamp,
+	};
+
+	const yamc_buff_cfg_t buff_cfg = {
+		.p_rx_buff		 = rx_buff,
+		.rx_buff_len	 = sizeof(rx_buff),
+		.p_tx_buff		 = tx_buff,
+		.tx_buff_len	 = sizeof(tx_buff),
+		.p_inflight		 = short_inflight,
+		.inflight_len	 = TEST_SLOTS_CNT - 1,
+		.p_pkt_id_bitmap = short_bitmap,
+		.pkt_id_window	 = TEST_WINDOW,
+	};
+
+	yamc_init(&short_instance, &handler_cfg, &buff_cfg);
+	YAMC_TEST_CHECK(yamc_mmap_store_restore(&store, &short_instance) == 0);
+
+	test_reopen();
+	YAMC_TEST_CHECK(yamc_mmap_store_restore(&store, &instance) == 1);
+
+	yamc_mmap_store_close(&store);
+}
+
+int main(void)
+{
+	if (mkdtemp(store_dir) == NULL)
+	{
+		perror("mkdtemp");
+		return 1;
+	}
+
+	snprintf(store_path, sizeof(store_path), "%s/store", store_dir);
+
+	YAMC_TEST_RUN(test_mmap_store_restore);
+	YAMC_TEST_RUN(test_mmap_store_geometry);
+
+	unlink(store_path);
+	rmdir(store_dir);
+
+	return yamc_test_result("yamc_test_mmap_store");
+}
@@ -0,0 +1,137 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_test_mpsc.c - Multi-producer single-consumer queue unit tests
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "yamc_mpsc.h"
+#include "yamc_test.h"
+
+#define TEST_PRODUCER_CNT 4
+#define TEST_NODE_CNT 100000  // per producer
+
+typedef struct
+{
+	yamc_mpsc_node_t node;  // has to stay first
+	uint32_t		 producer;
+	uint32_t		 seq;
+
+} test_node_t;
+
+static yamc_mpsc_t queue;
+static test_node_t nodes[TEST_PRODUCER_CNT][TEST_NODE_CNT];
+
+// empty queue returns nothing, also after it was drained
+static void test_mpsc_empty(void)
+{
+	yamc_mpsc_init(&queue);
+
+	YAMC_TEST_CHECK(yamc_mpsc_pop(&queue) == NULL);
+
+	yamc_mpsc_push(&queue, &nodes[0][0].node);
+	YAMC_TEST_CHECK(yamc_mpsc_pop(&queue) == &nodes[0][0].node);
+	YAMC_TEST_CHECK(yamc_mpsc_pop(&queue) == NULL);
+	YAMC_TEST_CHECK(yamc_mpsc_pop(&queue) == NULL);
+}
+
+// nodes come out in push order, popping last node and pushing it again works
+static void test_mpsc_fifo(void)
+{
+	yamc_mpsc_init(&queue);
+
+	for (uint32_t i = 0; i < 10; i++) yamc_mpsc_push(&queue, &nodes[0][i].node);
+	for (uint32_t i = 0; i < 10; i++) YAMC_TEST_CHECK(yamc_mpsc_pop(&queue) == &nodes[0][i].node);
+
+	YAMC_TEST_CHECK(yamc_mpsc_pop(&queue) == NULL);
+
+	// node is pushed again right after consumer got it, as free lists do
+	for (uint32_t i = 0; i < 100; i++)
+	{
+		yamc_mpsc_push(&queue, &nodes[0][i % 3].node);
+
+		YAMC_TEST_CHECK(yamc_mpsc_pop(&queue) == &nodes[0][i % 3].node);
+		YAMC_TEST_CHECK(yamc_mpsc_pop(&queue) == NULL);
+	}
+
+	yamc_mpsc_push(&queue, &nodes[0][0].node);
+	yamc_mpsc_push(&queue, &nodes[0][1].node);
+	YAMC_TEST_CHECK(yamc_mpsc_pop(&queue) == &nodes[0][0].node);
+
+	yamc_mpsc_push(&queue, &nodes[0][0].node);
+	YAMC_TEST_CHECK(yamc_mpsc_pop(&queue) == &nodes[0][1].node);
+	YAMC_TEST_CHECK(yamc_mpsc_pop(&queue) == &nodes[0][0].node);
+	YAMC_TEST_CHECK(yamc_mpsc_pop(&queue) == NULL);
+}
+
+static void* test_producer(void* p_ctx)
+{
+	const uint32_t producer = (uint32_t)(uintptr_t)p_ctx;
+
+	for (uint32_t i = 0; i < TEST_NODE_CNT; i++)
+	{
+		nodes[producer][i].producer = producer;
+		nodes[producer][i].seq		= i;
+
+		yamc_mpsc_push(&queue, &nodes[producer][i].node);
+	}
+
+	return NULL;
+}
+
+// every node pushed by concurrent producers is popped once, each producer's nodes keep their order
+static void test_mpsc_threads(void)
+{
+	yamc_mpsc_init(&queue);
+	memset(nodes, 0, sizeof(nodes));
+
+	pthread_t tid[TEST_PRODUCER_CNT];
+	for (uint32_t i = 0; i < TEST_PRODUCER_CNT; i++) pthread_create(&tid[i], NULL, test_producer, (void*)(uintptr_t)i);
+
+	uint32_t next_seq[TEST_PRODUCER_CNT];
+	uint32_t error_cnt = 0;
+	uint32_t pop_cnt   = 0;
+
+	memset(next_seq, 0, sizeof(next_seq));
+
+	while (pop_cnt < TEST_PRODUCER_CNT * TEST_NODE_CNT)
+	{
+		test_node_t* const p_node = (test_node_t*)yamc_mpsc_pop(&queue);
+
+		if (p_node == NULL)
+		{
+			sched_yield();
+			continue;
+		}
+
+		if (p_node->producer >= TEST_PRODUCER_CNT || p_node->seq != next_seq[p_node->producer])
+			error_cnt++;
+		else
+			next_seq[p_node->producer]++;
+
+		pop_cnt++;
+	}
+
+	for (uint32_t i = 0; i < TEST_PRODUCER_CNT; i++) pthread_join(tid[i], NULL);
+
+	YAMC_TEST_CHECK(error_cnt == 0);
+	YAMC_TEST_CHECK(yamc_mpsc_pop(&queue) == NULL);
+
+	for (uint32_t i = 0; i < TEST_PRODUCER_CNT; i++) YAMC_TEST_CHECK(next_seq[i] == TEST_NODE_CNT);
+}
+
+int main(void)
+{
+	YAMC_TEST_RUN(test_mpsc_empty);
+	YAMC_TEST_RUN(test_mpsc_fifo);
+	YAMC_TEST_RUN(test_mpsc_threads);
+
+	return yamc_test_result("yamc_test_mpsc");
+}
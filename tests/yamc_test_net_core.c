@@ -0,0 +1,318 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_test_net_core.c - Net core tx path unit tests, packets are checked by local server thread
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "yamc.h"
+#include "yamc_net_core.h"
+#include "yamc_test.h"
+
+#define TEST_ASYNC_LEN 32
+#define TEST_BIG_CNT 2000
+#define TEST_BIG_LEN (4 * YAMC_TX_PKT_MAX_LEN + 100)
+#define TEST_BATCH_CNT 1000
+#define TEST_BATCH_PKT_CNT 10
+#define TEST_BATCH_LEN 300
+
+// packet kinds written by test, each has its own topic and payload byte
+typedef enum
+{
+	TEST_PKT_ASYNC,
+	TEST_PKT_BIG,
+	TEST_PKT_BATCH,
+	TEST_PKT_KIND_CNT
+} test_pkt_kind_t;
+
+static const char* const topics[TEST_PKT_KIND_CNT] = {"async", "big", "batch"};
+static const uint8_t	 fills[TEST_PKT_KIND_CNT]  = {'a', 'B', 'b'};
+
+static yamc_net_core_t net_core;
+static int			   listen_fd = -1;
+static int			   listen_port;
+
+// results of server thread, read after it's joined
+static uint32_t rx_cnt[TEST_PKT_KIND_CNT];
+static uint32_t rx_error_cnt;
+static uint32_t rx_disconnect_cnt;
+
+// async publisher runs until main thread is done
+static int		async_stop;
+static uint32_t async_cnt;
+static uint32_t async_fail_cnt;
+
+static void test_pkt_handler(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data, void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_instance);
+	YAMC_UNUSED_PARAMETER(p_pkt_data);
+	YAMC_UNUSED_PARAMETER(p_ctx);
+}
+
+static bool test_read_exact(const int fd, uint8_t* const p_buff, const uint32_t len)
+{
+	uint32_t pos = 0;
+	while (pos < len)
+	{
+		const ssize_t n = read(fd, &p_buff[pos], len - pos);
+		if (n <= 0) return false;
+
+		pos += n;
+	}
+
+	return true;
+}
+
+// check one packet, returns false at end of stream or if stream is garbled
+static bool test_read_pkt(const int fd)
+{
+	static uint8_t buff[TEST_BIG_LEN + 64];
+
+	uint8_t hdr;
+	if (!test_read_exact(fd, &hdr, 1)) return false;
+
+	uint32_t remaining_len = 0;
+	for (uint32_t shift = 0;; shift += 7)
+	{
+		uint8_t len_byte;
+		if (!test_read_exact(fd, &len_byte, 1) || shift > 21) return false;
+
+		remaining_len |= (uint32_t)(len_byte & 0x7F) << shift;
+		if (!(len_byte & 0x80)) break;
+	}
+
+	if (hdr == 0xE0 && remaining_len == 0)
+	{
+		rx_disconnect_cnt++;
+		return true;
+	}
+
+	// only QoS0 PUBLISH packets are sent before DISCONNECT
+	if (hdr != 0x30 || remaining_len < 2 || remaining_len > sizeof(buff) || !test_read_exact(fd, buff, remaining_len))
+	{
+		rx_error_cnt++;
+		return false;
+	}
+
+	const uint32_t topic_len = ((uint32_t)buff[0] << 8) | buff[1];
+
+	for (uint32_t kind = 0; kind < TEST_PKT_KIND_CNT; kind++)
+	{
+		if (topic_len != strlen(topics[kind]) || 2 + topic_len > remaining_len || memcmp(&buff[2], topics[kind], topic_len) != 0)
+			continue;
+
+		for (uint32_t i = 2 + topic_len; i < remaining_len; i++)
+		{
+			if (buff[i] != fills[kind])
+			{
+				rx_error_cnt++;
+				return false;
+			}
+		}
+
+		rx_cnt[kind]++;
+		return true;
+	}
+
+	rx_error_cnt++;
+	return false;
+}
+
+// accept connection from net core and check its byte stream until it's closed
+static void* test_server_thread(void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	const int fd = accept(listen_fd, NULL, NULL);
+	if (fd < 0)
+	{
+		rx_error_cnt++;
+		return NULL;
+	}
+
+	while (test_read_pkt(fd)) continue;
+
+	// garbled stream is drained so client isn't blocked
+	uint8_t drain[256];
+	while (read(fd, drain, sizeof(drain)) > 0) continue;
+
+	close(fd);
+
+	return NULL;
+}
+
+static void test_publish_data(yamc_publish_data_t* const p_data, const test_pkt_kind_t kind, uint8_t* const p_payload,
+							  const uint32_t len)
+{
+	memset(p_data, 0, sizeof(yamc_publish_data_t));
+	memset(p_payload, fills[kind], len);
+
+	p_data->QOS = YAMC_QOS_LVL0;
+	yamc_char_to_mqtt_str(topics[kind], &p_data->topic);
+	p_data->p_data	= p_payload;
+	p_data->data_len = len;
+}
+
+// QoS0 messages queued for tx thread while main thread publishes through yamc instance
+static void* test_async_thread(void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	uint8_t				payload[TEST_ASYNC_LEN];
+	yamc_publish_data_t data;
+	test_publish_data(&data, TEST_PKT_ASYNC, payload, sizeof(payload));
+
+	while (!__atomic_load_n(&async_stop, __ATOMIC_ACQUIRE))
+	{
+		const yamc_retcode_t ret = yamc_net_core_publish_async(&net_core, &data);
+
+		if (ret == YAMC_RET_SUCCESS)
+			__atomic_fetch_add(&async_cnt, 1, __ATOMIC_RELEASE);
+		else if (ret == YAMC_RET_WOULD_BLOCK)
+			sched_yield();
+		else
+			async_fail_cnt++;
+	}
+
+	return NULL;
+}
+
+static void test_listen(void)
+{
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family		 = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	socklen_t addr_len = sizeof(addr);
+
+	listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+	YAMC_TEST_CHECK(listen_fd >= 0);
+	YAMC_TEST_CHECK(bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+	YAMC_TEST_CHECK(listen(listen_fd, 1) == 0);
+	YAMC_TEST_CHECK(getsockname(listen_fd, (struct sockaddr*)&addr, &addr_len) == 0);
+
+	listen_port = ntohs(addr.sin_port);
+}
+
+static void test_session_begin(pthread_t* const p_server_tid, pthread_t* const p_async_tid, const bool use_writev)
+{
+	memset(rx_cnt, 0, sizeof(rx_cnt));
+	rx_error_cnt	  = 0;
+	rx_disconnect_cnt = 0;
+	async_stop		  = 0;
+	async_cnt		  = 0;
+	async_fail_cnt	  = 0;
+
+	pthread_create(p_server_tid, NULL, test_server_thread, NULL);
+
+	yamc_net_core_connect(&net_core, "127.0.0.1", listen_port, test_pkt_handler);
+
+	// write handler alone makes yamc write long fields separately from rest of the packet
+	if (!use_writev)
+	{
+		yamc_net_core_lock(&net_core);
+		net_core.instance.handlers.writev = NULL;
+		yamc_net_core_unlock(&net_core);
+	}
+
+	pthread_create(p_async_tid, NULL, test_async_thread, NULL);
+
+	// tx thread is busy by the time main thread starts publishing
+	while (__atomic_load_n(&async_cnt, __ATOMIC_ACQUIRE) == 0) sched_yield();
+}
+
+static void test_session_end(const pthread_t server_tid, const pthread_t async_tid)
+{
+	__atomic_store_n(&async_stop, 1, __ATOMIC_RELEASE);
+	pthread_join(async_tid, NULL);
+
+	yamc_net_core_wait_inflight(&net_core);
+	yamc_net_core_disconnect(&net_core);
+
+	pthread_join(server_tid, NULL);
+
+	YAMC_TEST_CHECK(async_fail_cnt == 0);
+	YAMC_TEST_CHECK(rx_error_cnt == 0);
+	YAMC_TEST_CHECK(async_cnt > 0);
+	YAMC_TEST_CHECK(rx_cnt[TEST_PKT_ASYNC] == async_cnt);
+	YAMC_TEST_CHECK(rx_disconnect_cnt == 1);
+}
+
+// PUBLISH longer than tx buffer is written in parts, queued packets must not get in between
+static void test_net_core_big_publish(void)
+{
+	static uint8_t		payload[TEST_BIG_LEN];
+	yamc_publish_data_t data;
+	test_publish_data(&data, TEST_PKT_BIG, payload, sizeof(payload));
+
+	pthread_t server_tid, async_tid;
+	test_session_begin(&server_tid, &async_tid, false);
+
+	uint32_t fail_cnt = 0;
+	for (uint32_t i = 0; i < TEST_BIG_CNT; i++)
+	{
+		if (yamc_net_core_publish(&net_core, &data) != YAMC_RET_SUCCESS) fail_cnt++;
+	}
+
+	test_session_end(server_tid, async_tid);
+
+	YAMC_TEST_CHECK(fail_cnt == 0);
+	YAMC_TEST_CHECK(rx_cnt[TEST_PKT_BIG] == TEST_BIG_CNT);
+}
+
+// batch is flushed whenever tx buffer fills up, usually in the middle of a packet
+static void test_net_core_batch(void)
+{
+	uint8_t				payload[TEST_BATCH_LEN];
+	yamc_publish_data_t data;
+	test_publish_data(&data, TEST_PKT_BATCH, payload, sizeof(payload));
+
+	pthread_t server_tid, async_tid;
+	test_session_begin(&server_tid, &async_tid, true);
+
+	uint32_t fail_cnt = 0;
+	for (uint32_t i = 0; i < TEST_BATCH_CNT; i++)
+	{
+		yamc_net_core_lock(&net_core);
+
+		yamc_batch_begin(&net_core.instance);
+		for (uint32_t j = 0; j < TEST_BATCH_PKT_CNT; j++)
+		{
+			if (yamc_publish(&net_core.instance, &data) != YAMC_RET_SUCCESS) fail_cnt++;
+		}
+		if (yamc_batch_end(&net_core.instance) != YAMC_RET_SUCCESS) fail_cnt++;
+
+		yamc_net_core_unlock(&net_core);
+	}
+
+	test_session_end(server_tid, async_tid);
+
+	YAMC_TEST_CHECK(fail_cnt == 0);
+	YAMC_TEST_CHECK(rx_cnt[TEST_PKT_BATCH] == TEST_BATCH_CNT * TEST_BATCH_PKT_CNT);
+}
+
+int main(void)
+{
+	test_listen();
+
+	YAMC_TEST_RUN(test_net_core_big_publish);
+	YAMC_TEST_RUN(test_net_core_batch);
+
+	close(listen_fd);
+
+	return yamc_test_result("yamc_test_net_core");
+}
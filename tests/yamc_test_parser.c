@@ -0,0 +1,623 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_test_parser.c - yamc_parse_buff() unit tests
+ *
+ * The same packet sequence is fed in one buffer, byte by byte and split at every pair of positions.
+ * Decoded packets have to be identical in all cases.
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "yamc.h"
+#include "yamc_test.h"
+
+#define TEST_EVENTS_MAX 32
+#define TEST_TOPIC_MAX 32
+
+// decoded packet as seen by packet handler
+typedef struct
+{
+	yamc_pkt_type_t type;
+	uint8_t			qos;
+	uint16_t		packet_id;
+	uint8_t			topic[TEST_TOPIC_MAX];
+	uint32_t		topic_len;
+	uint32_t		data_len;
+	uint32_t		data_hash;
+	uint8_t			in_place;  // payload points into buffer passed to yamc_parse_buff()
+
+} test_event_t;
+
+static test_event_t events[TEST_EVENTS_MAX];
+static uint32_t		events_cnt;
+
+// buffer currently passed to yamc_parse_buff()
+static const uint8_t* p_parse_buff;
+static uint32_t		  parse_buff_len;
+
+static uint8_t  tx_log[1024];
+static uint32_t tx_log_len;
+static uint32_t write_cnt;
+static uint32_t disconnect_cnt;
+static uint32_t grow_cnt;
+static uint32_t filter_cnt;
+static const char* p_filter_drop;  // topic rejected by topic filter, NULL: all accepted
+
+// streamed payload
+static uint32_t stream_begin_cnt;
+static uint32_t stream_end_cnt;
+static uint32_t stream_total_len;
+static uint32_t stream_len;
+static uint32_t stream_hash;
+
+static uint8_t rx_buff[256];
+static uint8_t tx_buff[256];
+static uint8_t grown_buff[1024];
+
+static yamc_instance_t instance;
+
+// packet sequence and its expected decoding
+static uint8_t		stream[1024];
+static uint32_t		stream_data_len;
+static test_event_t expected[TEST_EVENTS_MAX];
+static uint32_t		expected_cnt;
+
+// FNV-1a, chunks can be hashed one after another
+static uint32_t test_hash(uint32_t hash, const uint8_t* const p_data, uint32_t len)
+{
+	for (uint32_t i = 0; i < len; i++)
+	{
+		hash ^= p_data[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+#define TEST_HASH_INIT 2166136261u
+
+static void test_disconnect(void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	disconnect_cnt++;
+}
+
+static yamc_retcode_t test_write(void* p_ctx, const uint8_t* const p_buff, uint32_t buff_len)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	if (tx_log_len + buff_len <= sizeof(tx_log))
+	{
+		memcpy(&tx_log[tx_log_len], p_buff, buff_len);
+		tx_log_len += buff_len;
+	}
+
+	write_cnt++;
+	return YAMC_RET_SUCCESS;
+}
+
+static void test_pkt_handler(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data, void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_instance);
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	if (events_cnt == TEST_EVENTS_MAX) return;
+
+	test_event_t* const p_event = &events[events_cnt++];
+	memset(p_event, 0, sizeof(test_event_t));
+
+	p_event->type = p_pkt_data->pkt_type;
+	p_event->qos  = p_pkt_data->flags.QOS;
+
+	switch (p_pkt_data->pkt_type)
+	{
+		case YAMC_PKT_PUBLISH:
+		{
+			const yamc_mqtt_pkt_publish_t* const p_publish = &p_pkt_data->pkt_data.publish;
+
+			p_event->packet_id = p_publish->packet_id;
+			p_event->topic_len = p_publish->topic_name.len;
+			memcpy(p_event->topic, p_publish->topic_name.str, p_publish->topic_name.len);
+
+			p_event->data_len  = p_publish->payload.data_len;
+			p_event->data_hash = test_hash(TEST_HASH_INIT, p_publish->payload.p_data, p_publish->payload.data_len);
+			p_event->in_place  = p_publish->payload.data_len > 0 && p_publish->payload.p_data >= p_parse_buff &&
+								p_publish->payload.p_data < p_parse_buff + parse_buff_len;
+			break;
+		}
+
+		case YAMC_PKT_PUBACK:
+			p_event->packet_id = p_pkt_data->pkt_data.puback.packet_id;
+			break;
+
+		case YAMC_PKT_SUBACK:
+			p_event->packet_id = p_pkt_data->pkt_data.suback.pkt_id;
+			p_event->data_len  = p_pkt_data->pkt_data.suback.payload.retcodes_len;
+			break;
+
+		default:
+			break;
+	}
+}
+
+static void test_stream_begin(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data, void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_instance);
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	stream_begin_cnt++;
+	stream_total_len = p_pkt_data->pkt_data.publish.payload.data_len;
+	stream_len		 = 0;
+	stream_hash		 = TEST_HASH_INIT;
+}
+
+static void test_stream_chunk(yamc_instance_t* const p_instance, const uint8_t* const p_chunk, uint32_t chunk_len, void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_instance);
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	stream_len += chunk_len;
+	stream_hash = test_hash(stream_hash, p_chunk, chunk_len);
+}
+
+static void test_stream_end(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data, void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_instance);
+	YAMC_UNUSED_PARAMETER(p_pkt_data);
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	stream_end_cnt++;
+}
+
+// counts calls, rejects p_filter_drop topic
+static bool test_topic_filter(yamc_instance_t* const p_instance, const yamc_mqtt_string* const p_topic, void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_instance);
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	filter_cnt++;
+
+	return p_filter_drop == NULL || p_topic->len != strlen(p_filter_drop) || memcmp(p_topic->str, p_filter_drop, p_topic->len) != 0;
+}
+
+static uint8_t* test_rx_buff_grow(void* p_ctx, uint32_t required_len, uint32_t* const p_new_len)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	grow_cnt++;
+
+	if (required_len > sizeof(grown_buff)) return NULL;
+
+	*p_new_len = sizeof(grown_buff);
+	return grown_buff;
+}
+
+// fresh instance, all packet types enabled
+static void test_init(uint32_t rx_buff_len, bool streaming, bool grow)
+{
+	const yamc_handler_cfg_t handler_cfg = {
+		.disconnect   = test_disconnect,
+		.write		  = test_write,
+		.pkt_handler  = test_pkt_handler,
+		.stream_begin = streaming ? test_stream_begin : NULL,
+		.stream_chunk = streaming ? test_stream_chunk : NULL,
+		.stream_end   = streaming ? test_stream_end : NULL,
+		.rx_buff_grow = grow ? test_rx_buff_grow : NULL,
+	};
+
+	const yamc_buff_cfg_t buff_cfg = {
+		.p_rx_buff   = rx_buff,
+		.rx_buff_len = rx_buff_len,
+		.p_tx_buff   = tx_buff,
+		.tx_buff_len = sizeof(tx_buff),
+	};
+
+	yamc_init(&instance, &handler_cfg, &buff_cfg);
+
+	memset(&instance.parser_enables, 0xFF, sizeof(instance.parser_enables));
+
+	events_cnt		 = 0;
+	tx_log_len		 = 0;
+	write_cnt		 = 0;
+	disconnect_cnt	 = 0;
+	grow_cnt		 = 0;
+	filter_cnt		 = 0;
+	p_filter_drop	 = NULL;
+	stream_begin_cnt = 0;
+	stream_end_cnt	 = 0;
+}
+
+static void test_parse(const uint8_t* const p_buff, uint32_t len)
+{
+	p_parse_buff   = p_buff;
+	parse_buff_len = len;
+
+	yamc_parse_buff(&instance, p_buff, len);
+}
+
+// append raw packet without handler visible payload
+static void stream_add_raw(const uint8_t* const p_pkt, uint32_t len, yamc_pkt_type_t type, uint16_t packet_id, uint32_t data_len)
+{
+	memcpy(&stream[stream_data_len], p_pkt, len);
+	stream_data_len += len;
+
+	test_event_t* const p_event = &expected[expected_cnt++];
+	memset(p_event, 0, sizeof(test_event_t));
+
+	p_event->type	   = type;
+	p_event->packet_id = packet_id;
+	p_event->data_len  = data_len;
+}
+
+static void stream_add_publish(const char* const p_topic, yamc_qos_lvl_t qos, uint16_t packet_id, const uint8_t* const p_data,
+							   uint32_t data_len)
+{
+	yamc_publish_data_t pub = {.QOS = qos, .p_data = p_data, .data_len = data_len};
+	yamc_char_to_mqtt_str(p_topic, &pub.topic);
+
+	stream_data_len += yamc_publish_encode(&pub, packet_id, &stream[stream_data_len], sizeof(stream) - stream_data_len);
+
+	test_event_t* const p_event = &expected[expected_cnt++];
+	memset(p_event, 0, sizeof(test_event_t));
+
+	p_event->type	   = YAMC_PKT_PUBLISH;
+	p_event->qos	   = qos;
+	p_event->packet_id = packet_id;
+	p_event->topic_len = pub.topic.len;
+	memcpy(p_event->topic, pub.topic.str, pub.topic.len);
+	p_event->data_len  = data_len;
+	p_event->data_hash = test_hash(TEST_HASH_INIT, p_data, data_len);
+}
+
+// mix of packet types and lengths, last PUBLISH has 2 byte remaining length field
+static void stream_build(void)
+{
+	static const uint8_t connack[]  = {0x20, 0x02, 0x00, 0x00};
+	static const uint8_t puback[]   = {0x40, 0x02, 0x00, 0x03};
+	static const uint8_t suback[]   = {0x90, 0x04, 0x00, 0x04, 0x00, 0x01};
+	static const uint8_t pingresp[] = {0xD0, 0x00};
+
+	static uint8_t long_payload[200];
+	for (uint32_t i = 0; i < sizeof(long_payload); i++) long_payload[i] = (uint8_t)(i * 7);
+
+	stream_data_len = 0;
+	expected_cnt	= 0;
+
+	stream_add_raw(connack, sizeof(connack), YAMC_PKT_CONNACK, 0, 0);
+	stream_add_publish("a/b", YAMC_QOS_LVL0, 0, (const uint8_t*)"hello", 5);
+	stream_add_publish("sensors/temperature", YAMC_QOS_LVL1, 7, long_payload, 100);
+	stream_add_raw(puback, sizeof(puback), YAMC_PKT_PUBACK, 3, 0);
+	stream_add_raw(suback, sizeof(suback), YAMC_PKT_SUBACK, 4, 2);
+	stream_add_raw(pingresp, sizeof(pingresp), YAMC_PKT_PINGRESP, 0, 0);
+	stream_add_publish("x", YAMC_QOS_LVL0, 0, NULL, 0);
+	stream_add_publish("q2", YAMC_QOS_LVL2, 9, (const uint8_t*)"abc", 3);
+	stream_add_publish("long", YAMC_QOS_LVL0, 0, long_payload, sizeof(long_payload));
+}
+
+// compare decoded packets with expected ones, payload placement is not compared
+static bool events_match(void)
+{
+	if (events_cnt != expected_cnt) return false;
+
+	for (uint32_t i = 0; i < events_cnt; i++)
+	{
+		const test_event_t* const p_got = &events[i];
+		const test_event_t* const p_exp = &expected[i];
+
+		if (p_got->type != p_exp->type || p_got->qos != p_exp->qos || p_got->packet_id != p_exp->packet_id ||
+			p_got->topic_len != p_exp->topic_len || memcmp(p_got->topic, p_exp->topic, p_got->topic_len) != 0 ||
+			p_got->data_len != p_exp->data_len)
+			return false;
+
+		if (p_got->type == YAMC_PKT_PUBLISH && p_got->data_hash != p_exp->data_hash) return false;
+	}
+
+	return true;
+}
+
+static void test_parser_contiguous(void)
+{
+	test_init(sizeof(rx_buff), false, false);
+
+	test_parse(stream, stream_data_len);
+
+	YAMC_TEST_CHECK(events_match());
+	YAMC_TEST_CHECK(instance.parser_state == YAMC_PARSER_IDLE);
+	YAMC_TEST_CHECK(disconnect_cnt == 0);
+
+	// whole buffer present: PUBLISH payloads are passed without copying
+	for (uint32_t i = 0; i < events_cnt; i++)
+		if (events[i].type == YAMC_PKT_PUBLISH && events[i].data_len > 0) YAMC_TEST_CHECK(events[i].in_place);
+}
+
+static void test_parser_byte_by_byte(void)
+{
+	test_init(sizeof(rx_buff), false, false);
+
+	for (uint32_t i = 0; i < stream_data_len; i++) test_parse(&stream[i], 1);
+
+	YAMC_TEST_CHECK(events_match());
+	YAMC_TEST_CHECK(instance.parser_state == YAMC_PARSER_IDLE);
+	YAMC_TEST_CHECK(disconnect_cnt == 0);
+}
+
+// three buffers split at every pair of positions
+static void test_parser_every_split(void)
+{
+	uint32_t mismatch_cnt = 0;
+
+	for (uint32_t first = 1; first < stream_data_len; first++)
+	{
+		for (uint32_t second = first; second < stream_data_len; second++)
+		{
+			test_init(sizeof(rx_buff), false, false);
+
+			test_parse(stream, first);
+			if (second > first) test_parse(&stream[first], second - first);
+			test_parse(&stream[second], stream_data_len - second);
+
+			if (!events_match() || instance.parser_state != YAMC_PARSER_IDLE || disconnect_cnt != 0) mismatch_cnt++;
+		}
+	}
+
+	YAMC_TEST_CHECK(mismatch_cnt == 0);
+}
+
+// split packets longer than rx buffer are skipped without streaming handlers, following packets are still decoded
+static void test_parser_skip_long(void)
+{
+	test_init(64, false, false);
+
+	for (uint32_t i = 0; i < stream_data_len; i += 20)
+		test_parse(&stream[i], (stream_data_len - i < 20) ? stream_data_len - i : 20);
+
+	// only PUBLISH with 100 and 200 byte payloads don't fit
+	YAMC_TEST_CHECK(events_cnt == expected_cnt - 2);
+	YAMC_TEST_CHECK(events_cnt > 0 && events[events_cnt - 1].type == YAMC_PKT_PUBLISH && events[events_cnt - 1].packet_id == 9);
+	YAMC_TEST_CHECK(instance.parser_state == YAMC_PARSER_IDLE);
+	YAMC_TEST_CHECK(disconnect_cnt == 0);
+}
+
+// payload of split PUBLISH longer than rx buffer is passed to stream handlers in chunks
+static void test_parser_stream_long(void)
+{
+	static uint8_t payload[300];
+	for (uint32_t i = 0; i < sizeof(payload); i++) payload[i] = (uint8_t)(i ^ 0x5A);
+
+	yamc_publish_data_t pub = {.QOS = YAMC_QOS_LVL1, .p_data = payload, .data_len = sizeof(payload)};
+	yamc_char_to_mqtt_str("stream/topic", &pub.topic);
+
+	uint8_t		   pkt[512];
+	const uint32_t pkt_len = yamc_publish_encode(&pub, 42, pkt, sizeof(pkt));
+
+	for (uint32_t chunk = 1; chunk <= 64; chunk++)
+	{
+		test_init(32, true, false);
+
+		for (uint32_t i = 0; i < pkt_len; i += chunk) test_parse(&pkt[i], (pkt_len - i < chunk) ? pkt_len - i : chunk);
+
+		YAMC_TEST_CHECK(stream_begin_cnt == 1 && stream_end_cnt == 1);
+		YAMC_TEST_CHECK(stream_total_len == sizeof(payload) && stream_len == sizeof(payload));
+		YAMC_TEST_CHECK(stream_hash == test_hash(TEST_HASH_INIT, payload, sizeof(payload)));
+		YAMC_TEST_CHECK(events_cnt == 0);
+		YAMC_TEST_CHECK(instance.parser_state == YAMC_PARSER_IDLE);
+	}
+
+	// whole packet in one buffer is decoded in place regardless of rx buffer length
+	test_init(32, true, false);
+	test_parse(pkt, pkt_len);
+
+	YAMC_TEST_CHECK(stream_begin_cnt == 0);
+	YAMC_TEST_CHECK(events_cnt == 1 && events[0].in_place && events[0].data_len == sizeof(payload));
+}
+
+// packet longer than rx buffer is copied to buffer provided by grow handler
+static void test_parser_grow(void)
+{
+	test_init(64, false, true);
+
+	for (uint32_t i = 0; i < stream_data_len; i += 50)
+		test_parse(&stream[i], (stream_data_len - i < 50) ? stream_data_len - i : 50);
+
+	YAMC_TEST_CHECK(events_match());
+	YAMC_TEST_CHECK(grow_cnt > 0);
+	YAMC_TEST_CHECK(instance.rx_pkt.var_data.data == grown_buff);
+}
+
+// packets whole in input buffer are decoded in place, receive buffer is not grown for them
+static void test_parser_grow_in_place(void)
+{
+	test_init(64, false, true);
+
+	test_parse(stream, stream_data_len);
+
+	YAMC_TEST_CHECK(events_match());
+	YAMC_TEST_CHECK(grow_cnt == 0);
+	YAMC_TEST_CHECK(instance.rx_pkt.var_data.data == rx_buff);
+}
+
+// acks of all QoS>0 PUBLISH packets in one buffer are written together
+static void test_parser_auto_ack(void)
+{
+	test_init(sizeof(rx_buff), false, false);
+	instance.options.auto_ack = 1;
+
+	test_parse(stream, stream_data_len);
+
+	static const uint8_t acks[] = {0x40, 0x02, 0x00, 0x07, 0x50, 0x02, 0x00, 0x09};
+
+	YAMC_TEST_CHECK(write_cnt == 1);
+	YAMC_TEST_CHECK(tx_log_len == sizeof(acks) && memcmp(tx_log, acks, sizeof(acks)) == 0);
+
+	// redelivered QoS2 PUBLISH is acknowledged again but not passed to handler
+	events_cnt = 0;
+	tx_log_len = 0;
+
+	yamc_publish_data_t pub = {.QOS = YAMC_QOS_LVL2, .DUP = true, .p_data = (const uint8_t*)"abc", .data_len = 3};
+	yamc_char_to_mqtt_str("q2", &pub.topic);
+
+	uint8_t		   pkt[32];
+	const uint32_t pkt_len = yamc_publish_encode(&pub, 9, pkt, sizeof(pkt));
+
+	test_parse(pkt, pkt_len);
+
+	YAMC_TEST_CHECK(events_cnt == 0);
+	YAMC_TEST_CHECK(tx_log_len == 4 && memcmp(tx_log, &acks[4], 4) == 0);
+}
+
+// new session on server starts its QoS2 packet ids over, previous ones are forgotten
+static void test_parser_qos2_session(void)
+{
+	static const uint8_t session_present[] = {0x20, 0x02, 0x01, 0x00};
+	static const uint8_t clean_session[]   = {0x20, 0x02, 0x00, 0x00};
+
+	test_init(sizeof(rx_buff), false, false);
+	instance.options.auto_ack = 1;
+
+	yamc_publish_data_t pub = {.QOS = YAMC_QOS_LVL2, .p_data = (const uint8_t*)"abc", .data_len = 3};
+	yamc_char_to_mqtt_str("q2", &pub.topic);
+
+	uint8_t		   pkt[32];
+	const uint32_t pkt_len = yamc_publish_encode(&pub, 9, pkt, sizeof(pkt));
+
+	test_parse(pkt, pkt_len);
+	YAMC_TEST_CHECK(events_cnt == 1);
+
+	// resumed session: same id is still a redelivery
+	test_parse(session_present, sizeof(session_present));
+	test_parse(pkt, pkt_len);
+	YAMC_TEST_CHECK(events_cnt == 2 && events[1].type == YAMC_PKT_CONNACK);
+
+	// clean session: same id is a new message
+	test_parse(clean_session, sizeof(clean_session));
+	test_parse(pkt, pkt_len);
+	YAMC_TEST_CHECK(events_cnt == 4 && events[3].type == YAMC_PKT_PUBLISH && events[3].packet_id == 9);
+	YAMC_TEST_CHECK(instance.qos2_rx.cnt == 1);
+}
+
+// malformed remaining length disconnects
+static void test_parser_malformed(void)
+{
+	static const uint8_t bad_len[] = {0x30, 0xFF, 0xFF, 0xFF, 0xFF, 0x01};
+	static const uint8_t bad_type[] = {0x00, 0x00};
+
+	test_init(sizeof(rx_buff), false, false);
+	test_parse(bad_len, sizeof(bad_len));
+	YAMC_TEST_CHECK(disconnect_cnt == 1);
+	YAMC_TEST_CHECK(events_cnt == 0);
+
+	test_init(sizeof(rx_buff), false, false);
+	test_parse(bad_type, sizeof(bad_type));
+	YAMC_TEST_CHECK(disconnect_cnt == 1);
+	YAMC_TEST_CHECK(events_cnt == 0);
+}
+
+// topic filter sees every PUBLISH once however it's split, rejected one isn't decoded
+static void test_parser_topic_filter(void)
+{
+	uint32_t mismatch_cnt = 0;
+
+	for (uint32_t chunk = 1; chunk <= stream_data_len; chunk++)
+	{
+		test_init(sizeof(rx_buff), false, false);
+		instance.handlers.topic_filter = test_topic_filter;
+
+		for (uint32_t i = 0; i < stream_data_len; i += chunk)
+			test_parse(&stream[i], (stream_data_len - i < chunk) ? stream_data_len - i : chunk);
+
+		if (!events_match() || filter_cnt != 5 || instance.parser_state != YAMC_PARSER_IDLE) mismatch_cnt++;
+
+		test_init(sizeof(rx_buff), false, false);
+		instance.handlers.topic_filter = test_topic_filter;
+		p_filter_drop				   = "sensors/temperature";
+
+		for (uint32_t i = 0; i < stream_data_len; i += chunk)
+			test_parse(&stream[i], (stream_data_len - i < chunk) ? stream_data_len - i : chunk);
+
+		if (events_cnt != expected_cnt - 1 || filter_cnt != 5 || instance.parser_state != YAMC_PARSER_IDLE) mismatch_cnt++;
+
+		for (uint32_t i = 0; i < events_cnt; i++)
+			if (events[i].type == YAMC_PKT_PUBLISH && events[i].packet_id == 7) mismatch_cnt++;
+	}
+
+	YAMC_TEST_CHECK(mismatch_cnt == 0);
+}
+
+// feed buffer in chunks until connection is closed
+static void test_parse_chunks(const uint8_t* const p_buff, uint32_t len, uint32_t chunk)
+{
+	for (uint32_t i = 0; i < len && disconnect_cnt == 0; i += chunk) test_parse(&p_buff[i], (len - i < chunk) ? len - i : chunk);
+}
+
+// PUBLISH with zero length topic is malformed, connection is closed without acknowledgement, topic filter and stream
+// handlers never see it and packet after it isn't processed
+static void test_parser_empty_topic(void)
+{
+	// QoS0 and QoS1 with empty topic, each followed by valid PUBLISH
+	static const uint8_t qos0[] = {0x30, 0x05, 0x00, 0x00, 'a', 'b', 'c', 0x30, 0x04, 0x00, 0x01, 'x', 'y'};
+	static const uint8_t qos1[] = {0x32, 0x07, 0x00, 0x00, 0x00, 0x05, 'a', 'b', 'c', 0x30, 0x04, 0x00, 0x01, 'x', 'y'};
+
+	static const uint8_t* const pkts[]	 = {qos0, qos1};
+	static const uint32_t		pkts_len[] = {sizeof(qos0), sizeof(qos1)};
+
+	// payload longer than rx buffer goes to stream handlers
+	uint8_t		   long_pkt[64] = {0x32, 44, 0x00, 0x00, 0x00, 0x06};
+	const uint32_t long_pkt_len = 2 + 44;
+
+	for (uint32_t chunk = 1; chunk <= sizeof(qos1); chunk++)
+	{
+		for (uint32_t pkt = 0; pkt < 2; pkt++)
+		{
+			for (uint32_t filter = 0; filter < 2; filter++)
+			{
+				test_init(sizeof(rx_buff), false, false);
+				instance.options.auto_ack = 1;
+				if (filter) instance.handlers.topic_filter = test_topic_filter;
+
+				test_parse_chunks(pkts[pkt], pkts_len[pkt], chunk);
+
+				YAMC_TEST_CHECK(disconnect_cnt == 1);
+				YAMC_TEST_CHECK(events_cnt == 0);
+				YAMC_TEST_CHECK(filter_cnt == 0);
+				YAMC_TEST_CHECK(tx_log_len == 0);
+				YAMC_TEST_CHECK(instance.parser_state == YAMC_PARSER_IDLE);
+			}
+		}
+
+		test_init(16, true, false);
+		instance.options.auto_ack = 1;
+
+		test_parse_chunks(long_pkt, long_pkt_len, chunk);
+
+		YAMC_TEST_CHECK(disconnect_cnt == 1);
+		YAMC_TEST_CHECK(stream_begin_cnt == 0 && stream_end_cnt == 0);
+		YAMC_TEST_CHECK(tx_log_len == 0);
+		YAMC_TEST_CHECK(instance.parser_state == YAMC_PARSER_IDLE);
+	}
+}
+
+int main(void)
+{
+	stream_build();
+
+	YAMC_TEST_RUN(test_parser_contiguous);
+	YAMC_TEST_RUN(test_parser_byte_by_byte);
+	YAMC_TEST_RUN(test_parser_every_split);
+	YAMC_TEST_RUN(test_parser_skip_long);
+	YAMC_TEST_RUN(test_parser_stream_long);
+	YAMC_TEST_RUN(test_parser_grow);
+	YAMC_TEST_RUN(test_parser_grow_in_place);
+	YAMC_TEST_RUN(test_parser_auto_ack);
+	YAMC_TEST_RUN(test_parser_qos2_session);
+	YAMC_TEST_RUN(test_parser_malformed);
+	YAMC_TEST_RUN(test_parser_topic_filter);
+	YAMC_TEST_RUN(test_parser_empty_topic);
+
+	return yamc_test_result("yamc_test_parser");
+}
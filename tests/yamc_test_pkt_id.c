@@ -0,0 +1,218 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_test_pkt_id.c - Packet id allocator unit tests
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "yamc.h"
+#include "yamc_pkt_id.h"
+#include "yamc_test.h"
+
+#define TEST_WINDOW 40
+
+static yamc_instance_t instance;
+static uint8_t		   rx_buff[64];
+static uint32_t		   bitmap[YAMC_PKT_ID_BITMAP_WORDS(TEST_WINDOW)];
+
+static void test_disconnect(void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+}
+
+static yamc_retcode_t test_write(void* p_ctx, const uint8_t* const p_buff, uint32_t buff_len)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+	YAMC_UNUSED_PARAMETER(p_buff);
+	YAMC_UNUSED_PARAMETER(buff_len);
+
+	return YAMC_RET_SUCCESS;
+}
+
+static void test_pkt_handler(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data, void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_instance);
+	YAMC_UNUSED_PARAMETER(p_pkt_data);
+	YAMC_UNUSED_PARAMETER(p_ctx);
+}
+
+static void test_init(uint32_t* const p_bitmap, uint16_t window)
+{
+	const yamc_handler_cfg_t handler_cfg = {
+		.disconnect  = test_disconnect,
+		.write		 = test_write,
+		.pkt_handler = test_pkt_handler,
+	};
+
+	const yamc_buff_cfg_t buff_cfg = {
+		.p_rx_buff		 = rx_buff,
+		.rx_buff_len	 = sizeof(rx_buff),
+		.p_pkt_id_bitmap = p_bitmap,
+		.pkt_id_window	 = window,
+	};
+
+	yamc_init(&instance, &handler_cfg, &buff_cfg);
+}
+
+// without bitmap ids are counted up, 0 is skipped on wrap around
+static void test_pkt_id_counter(void)
+{
+	test_init(NULL, 0);
+
+	YAMC_TEST_CHECK(yamc_pkt_id_alloc(&instance, YAMC_PKT_PUBACK) == 1);
+	YAMC_TEST_CHECK(yamc_pkt_id_alloc(&instance, YAMC_PKT_PUBACK) == 2);
+
+	instance.last_packet_id = YAMC_PKT_ID_MAX;
+	YAMC_TEST_CHECK(yamc_pkt_id_alloc(&instance, YAMC_PKT_PUBACK) == 1);
+}
+
+// every id of the window is handed out once, then allocator reports exhaustion
+static void test_pkt_id_exhaust(void)
+{
+	test_init(bitmap, TEST_WINDOW);
+
+	for (uint16_t id = 1; id <= TEST_WINDOW; id++) YAMC_TEST_CHECK(yamc_pkt_id_alloc(&instance, YAMC_PKT_PUBACK) == id);
+
+	YAMC_TEST_CHECK(yamc_pkt_id_alloc(&instance, YAMC_PKT_PUBACK) == 0);
+
+	// released id is the only free one
+	yamc_pkt_id_release(&instance, 5, YAMC_PKT_PUBACK);
+	YAMC_TEST_CHECK(yamc_pkt_id_alloc(&instance, YAMC_PKT_PUBACK) == 5);
+	YAMC_TEST_CHECK(yamc_pkt_id_alloc(&instance, YAMC_PKT_PUBACK) == 0);
+}
+
+// search continues after last assigned id and wraps around to id 1
+static void test_pkt_id_wrap(void)
+{
+	test_init(bitmap, TEST_WINDOW);
+
+	for (uint16_t id = 1; id <= TEST_WINDOW; id++) yamc_pkt_id_alloc(&instance, YAMC_PKT_PUBACK);
+
+	yamc_pkt_id_release(&instance, 1, YAMC_PKT_PUBACK);
+	yamc_pkt_id_release(&instance, 3, YAMC_PKT_PUBACK);
+	yamc_pkt_id_release(&instance, TEST_WINDOW, YAMC_PKT_PUBACK);
+
+	// last assigned id is TEST_WINDOW, so search wraps around
+	YAMC_TEST_CHECK(yamc_pkt_id_alloc(&instance, YAMC_PKT_PUBACK) == 1);
+
+	// freshly released TEST_WINDOW is reused only after 3
+	YAMC_TEST_CHECK(yamc_pkt_id_alloc(&instance, YAMC_PKT_PUBACK) == 3);
+	YAMC_TEST_CHECK(yamc_pkt_id_alloc(&instance, YAMC_PKT_PUBACK) == TEST_WINDOW);
+	YAMC_TEST_CHECK(yamc_pkt_id_alloc(&instance, YAMC_PKT_PUBACK) == 0);
+}
+
+// reserved ids are skipped, ids outside of window and 0 are ignored
+static void test_pkt_id_reserve(void)
+{
+	test_init(bitmap, TEST_WINDOW);
+
+	yamc_pkt_id_reserve(&instance, 1, YAMC_PKT_PUBACK);
+	yamc_pkt_id_reserve(&instance, 2, YAMC_PKT_PUBACK);
+	yamc_pkt_id_reserve(&instance, 0, YAMC_PKT_PUBACK);
+	yamc_pkt_id_reserve(&instance, TEST_WINDOW + 1, YAMC_PKT_PUBACK);
+
+	YAMC_TEST_CHECK(yamc_pkt_id_alloc(&instance, YAMC_PKT_PUBACK) == 3);
+
+	yamc_pkt_id_release(&instance, 0, YAMC_PKT_PUBACK);
+	yamc_pkt_id_release(&instance, TEST_WINDOW + 1, YAMC_PKT_PUBACK);
+
+	uint32_t used_cnt = 0;
+	for (uint32_t i = 0; i < YAMC_PKT_ID_USE_WORDS(TEST_WINDOW); i++) used_cnt += __builtin_popcount(bitmap[i]);
+
+	YAMC_TEST_CHECK(used_cnt == 3);
+}
+
+// id is released only by acknowledgement finishing flow it was allocated for
+static void test_pkt_id_ack_type(void)
+{
+	test_init(bitmap, TEST_WINDOW);
+
+	YAMC_TEST_CHECK(yamc_pkt_id_alloc(&instance, YAMC_PKT_PUBACK) == 1);
+	YAMC_TEST_CHECK(yamc_pkt_id_alloc(&instance, YAMC_PKT_PUBCOMP) == 2);
+	YAMC_TEST_CHECK(yamc_pkt_id_alloc(&instance, YAMC_PKT_SUBACK) == 3);
+	YAMC_TEST_CHECK(yamc_pkt_id_alloc(&instance, YAMC_PKT_UNSUBACK) == 4);
+
+	// stray acknowledgements of other flows
+	yamc_pkt_id_release(&instance, 1, YAMC_PKT_SUBACK);
+	yamc_pkt_id_release(&instance, 2, YAMC_PKT_PUBACK);
+	yamc_pkt_id_release(&instance, 3, YAMC_PKT_UNSUBACK);
+	yamc_pkt_id_release(&instance, 4, YAMC_PKT_PUBCOMP);
+
+	YAMC_TEST_CHECK(bitmap[0] == 0x0F);
+
+	yamc_pkt_id_release(&instance, 1, YAMC_PKT_PUBACK);
+	yamc_pkt_id_release(&instance, 2, YAMC_PKT_PUBCOMP);
+	yamc_pkt_id_release(&instance, 3, YAMC_PKT_SUBACK);
+	yamc_pkt_id_release(&instance, 4, YAMC_PKT_UNSUBACK);
+
+	YAMC_TEST_CHECK(bitmap[0] == 0);
+
+	// reused id takes type of new flow
+	yamc_pkt_id_reserve(&instance, 1, YAMC_PKT_PUBCOMP);
+	yamc_pkt_id_release(&instance, 1, YAMC_PKT_PUBACK);
+	YAMC_TEST_CHECK(bitmap[0] == 0x01);
+	yamc_pkt_id_release(&instance, 1, YAMC_PKT_PUBCOMP);
+	YAMC_TEST_CHECK(bitmap[0] == 0);
+}
+
+// random allocations and releases never hand out id in use
+static void test_pkt_id_random(void)
+{
+	test_init(bitmap, TEST_WINDOW);
+
+	uint8_t  in_use[TEST_WINDOW + 1];
+	uint32_t in_use_cnt = 0;
+	uint32_t seed		= 12345;
+	uint32_t error_cnt  = 0;
+
+	memset(in_use, 0, sizeof(in_use));
+
+	for (uint32_t i = 0; i < 100000; i++)
+	{
+		seed = seed * 1103515245u + 12345u;
+
+		if ((seed >> 16) % 3 != 0)
+		{
+			const uint16_t id = yamc_pkt_id_alloc(&instance, YAMC_PKT_PUBACK);
+
+			if (id == 0)
+			{
+				if (in_use_cnt != TEST_WINDOW) error_cnt++;
+				continue;
+			}
+
+			if (id > TEST_WINDOW || in_use[id]) error_cnt++;
+
+			in_use[id] = 1;
+			in_use_cnt++;
+		}
+		else if (in_use_cnt > 0)
+		{
+			uint16_t id = (seed >> 8) % TEST_WINDOW + 1;
+			while (!in_use[id]) id = (id % TEST_WINDOW) + 1;
+
+			yamc_pkt_id_release(&instance, id, YAMC_PKT_PUBACK);
+			in_use[id] = 0;
+			in_use_cnt--;
+		}
+	}
+
+	YAMC_TEST_CHECK(error_cnt == 0);
+}
+
+int main(void)
+{
+	YAMC_TEST_RUN(test_pkt_id_counter);
+	YAMC_TEST_RUN(test_pkt_id_exhaust);
+	YAMC_TEST_RUN(test_pkt_id_wrap);
+	YAMC_TEST_RUN(test_pkt_id_reserve);
+	YAMC_TEST_RUN(test_pkt_id_ack_type);
+	YAMC_TEST_RUN(test_pkt_id_random);
+
+	return yamc_test_result("yamc_test_pkt_id");
+}
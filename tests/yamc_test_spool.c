@@ -0,0 +1,461 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_test_spool.c - Spool unit tests: ring wrap, spill to segment files, refill order and requeue after reconnection
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "yamc.h"
+#include "yamc_port.h"
+#include "yamc_spool.h"
+#include "yamc_test.h"
+
+#define TEST_INFLIGHT_LEN 8
+#define TEST_WINDOW 16
+#define TEST_PAYLOAD_LEN 40
+#define TEST_SENT_MAX 256
+
+// segment test spills enough to fill more than two segment files
+#define TEST_SEG_PAYLOAD_LEN 60000
+#define TEST_SEG_MSG_CNT (2 * YAMC_SPOOL_SEGMENT_LEN / TEST_SEG_PAYLOAD_LEN + 20)
+
+static yamc_instance_t		 instance;
+static uint8_t				 rx_buff[64];
+static uint8_t				 tx_buff[256];
+static yamc_inflight_entry_t inflight[TEST_INFLIGHT_LEN];
+static uint32_t				 bitmap[YAMC_PKT_ID_BITMAP_WORDS(TEST_WINDOW)];
+
+static yamc_spool_t spool;
+static uint64_t		ring[(TEST_SEG_PAYLOAD_LEN * 2) / sizeof(uint64_t)];
+static char			seg_dir[] = "/tmp/yamc_test_spool_XXXXXX";
+
+// everything written by instance, decoded by test_sent_decode()
+static uint8_t  tx_log[(TEST_SEG_MSG_CNT + 1) * (TEST_SEG_PAYLOAD_LEN + 64)];
+static uint32_t tx_log_len;
+
+// PUBLISH packets found in tx log
+typedef struct
+{
+	uint8_t  qos;
+	bool	 dup;
+	uint16_t packet_id;
+	uint32_t seq;
+
+} test_sent_t;
+
+static test_sent_t sent[TEST_SENT_MAX];
+static uint32_t	sent_cnt;
+
+// user contexts of acknowledged messages, as seen by publish complete handler
+static void*	completed[TEST_SENT_MAX];
+static uint32_t completed_cnt;
+
+static void test_disconnect(void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+}
+
+static yamc_retcode_t test_write(void* p_ctx, const uint8_t* const p_buff, uint32_t buff_len)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	if (tx_log_len + buff_len > sizeof(tx_log)) return YAMC_RET_INVALID_STATE;
+
+	memcpy(&tx_log[tx_log_len], p_buff, buff_len);
+	tx_log_len += buff_len;
+
+	return YAMC_RET_SUCCESS;
+}
+
+static void test_pkt_handler(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data, void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_instance);
+	YAMC_UNUSED_PARAMETER(p_pkt_data);
+	YAMC_UNUSED_PARAMETER(p_ctx);
+}
+
+static uint32_t test_timestamp(void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	return 1000;
+}
+
+// spool releases its record and hands over context of original message, like net core handler does
+static void test_pub_complete(yamc_instance_t* const p_instance, uint16_t packet_id, void* p_msg_ctx, void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_instance);
+	YAMC_UNUSED_PARAMETER(packet_id);
+	YAMC_UNUSED_PARAMETER(p_ctx);
+
+	YAMC_TEST_CHECK(yamc_spool_complete(&spool, &p_msg_ctx));
+
+	if (completed_cnt < TEST_SENT_MAX) completed[completed_cnt++] = p_msg_ctx;
+}
+
+// fresh instance, as after reconnection
+static void test_instance_init(void)
+{
+	const yamc_handler_cfg_t handler_cfg = {
+		.disconnect	  = test_disconnect,
+		.write		  = test_write,
+		.pkt_handler  = test_pkt_handler,
+		.timestamp	  = test_timestamp,
+		.pub_complete = test_pub_complete,
+	};
+
+	const yamc_buff_cfg_t buff_cfg = {
+		.p_rx_buff		 = rx_buff,
+		.rx_buff_len	 = sizeof(rx_buff),
+		.p_tx_buff		 = tx_buff,
+		.tx_buff_len	 = sizeof(tx_buff),
+		.p_inflight		 = inflight,
+		.inflight_len	 = TEST_INFLIGHT_LEN,
+		.p_pkt_id_bitmap = bitmap,
+		.pkt_id_window	 = TEST_WINDOW,
+	};
+
+	yamc_init(&instance, &handler_cfg, &buff_cfg);
+
+	tx_log_len = 0;
+}
+
+static void test_init(const uint32_t ring_len, const uint32_t spill_threshold)
+{
+	test_instance_init();
+
+	yamc_spool_init(&spool, (uint8_t*)ring, ring_len, spill_threshold, seg_dir);
+
+	completed_cnt = 0;
+}
+
+// message sequence number is stored at payload start, user context carries it too
+static yamc_retcode_t test_put(const yamc_qos_lvl_t qos, const uint32_t seq, const uint32_t payload_len)
+{
+	static uint8_t payload[TEST_SEG_PAYLOAD_LEN];
+
+	memset(payload, (int)seq, payload_len);
+	memcpy(payload, &seq, sizeof(seq));
+
+	yamc_publish_data_t pub = {.QOS = qos, .p_data = payload, .data_len = payload_len, .p_msg_ctx = (void*)(uintptr_t)(seq + 1)};
+	yamc_char_to_mqtt_str("t", &pub.topic);
+
+	return yamc_spool_put(&spool, &pub);
+}
+
+static void test_puback(const uint16_t packet_id)
+{
+	const uint8_t pkt[] = {(uint8_t)(YAMC_PKT_PUBACK << 4), 0x02, (uint8_t)(packet_id >> 8), (uint8_t)packet_id};
+
+	yamc_parse_buff(&instance, pkt, sizeof(pkt));
+}
+
+// split tx log into PUBLISH packets, returns false if it contains anything else
+static bool test_sent_decode(void)
+{
+	sent_cnt = 0;
+
+	uint32_t pos = 0;
+	while (pos < tx_log_len)
+	{
+		const uint8_t hdr = tx_log[pos++];
+
+		uint32_t remaining_len = 0;
+		for (uint32_t shift = 0; pos < tx_log_len; shift += 7)
+		{
+			const uint8_t len_byte = tx_log[pos++];
+
+			remaining_len |= (uint32_t)(len_byte & 0x7F) << shift;
+			if (!(len_byte & 0x80)) break;
+		}
+
+		if ((hdr >> 4) != YAMC_PKT_PUBLISH || pos + remaining_len > tx_log_len || sent_cnt == TEST_SENT_MAX) return false;
+
+		const uint8_t* const p_var = &tx_log[pos];
+		const uint8_t		 qos   = (hdr >> 1) & 0x03;
+		uint32_t			 off   = 2 + (((uint32_t)p_var[0] << 8) | p_var[1]);
+
+		sent[sent_cnt].qos		 = qos;
+		sent[sent_cnt].dup		 = (hdr & 0x08) != 0;
+		sent[sent_cnt].packet_id = 0;
+
+		if (qos != YAMC_QOS_LVL0)
+		{
+			sent[sent_cnt].packet_id = ((uint16_t)p_var[off] << 8) | p_var[off + 1];
+			off += 2;
+		}
+
+		if (off + sizeof(uint32_t) > remaining_len) return false;
+
+		memcpy(&sent[sent_cnt].seq, &p_var[off], sizeof(uint32_t));
+		sent_cnt++;
+
+		pos += remaining_len;
+	}
+
+	return true;
+}
+
+static bool test_seg_exists(const uint32_t seg)
+{
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/yamc_spool_%08u.seg", seg_dir, seg);
+
+	return access(path, F_OK) == 0;
+}
+
+// record that doesn't fit at ring end leaves skip marker, its space is accounted until tail passes it
+static void test_spool_wrap(void)
+{
+	// ring length of first record gives length of all records of the same size
+	test_init(sizeof(ring), sizeof(ring));
+	YAMC_TEST_CHECK(test_put(YAMC_QOS_LVL1, 0, TEST_PAYLOAD_LEN) == YAMC_RET_SUCCESS);
+	const uint32_t rec_len = spool.used;
+
+	// four records and gap too small for fifth one
+	const uint32_t gap = 8;
+	test_init(4 * rec_len + gap, 4 * rec_len + gap);
+
+	for (uint32_t seq = 0; seq < 4; seq++) YAMC_TEST_CHECK(test_put(YAMC_QOS_LVL1, seq, TEST_PAYLOAD_LEN) == YAMC_RET_SUCCESS);
+
+	YAMC_TEST_CHECK(spool.used == 4 * rec_len);
+	YAMC_TEST_CHECK(spool.head == 4 * rec_len);
+
+	YAMC_TEST_CHECK(yamc_spool_drain(&spool, &instance) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_sent_decode());
+	YAMC_TEST_CHECK(sent_cnt == 4);
+
+	uint16_t ids[8];
+	for (uint32_t i = 0; i < sent_cnt; i++)
+	{
+		YAMC_TEST_CHECK(sent[i].seq == i);
+		YAMC_TEST_CHECK(!sent[i].dup);
+		ids[i] = sent[i].packet_id;
+	}
+
+	// acknowledged records at tail are released
+	test_puback(ids[0]);
+	test_puback(ids[1]);
+
+	YAMC_TEST_CHECK(spool.rec_cnt == 2);
+	YAMC_TEST_CHECK(spool.tail == 2 * rec_len);
+	YAMC_TEST_CHECK(spool.used == 2 * rec_len);
+
+	// fifth record doesn't fit at ring end, sixth fills space freed at ring start
+	YAMC_TEST_CHECK(test_put(YAMC_QOS_LVL1, 4, TEST_PAYLOAD_LEN) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(spool.head == rec_len);
+	YAMC_TEST_CHECK(spool.used == 3 * rec_len + gap);
+
+	YAMC_TEST_CHECK(test_put(YAMC_QOS_LVL1, 5, TEST_PAYLOAD_LEN) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(spool.head == 2 * rec_len);
+	YAMC_TEST_CHECK(spool.used == 4 * rec_len + gap);
+	YAMC_TEST_CHECK(spool.disk_cnt == 0);
+
+	// full ring spills to disk
+	YAMC_TEST_CHECK(test_put(YAMC_QOS_LVL1, 6, TEST_PAYLOAD_LEN) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(spool.disk_cnt == 1);
+	YAMC_TEST_CHECK(spool.rec_cnt == 4);
+
+	tx_log_len = 0;
+	YAMC_TEST_CHECK(yamc_spool_drain(&spool, &instance) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_sent_decode());
+	YAMC_TEST_CHECK(sent_cnt == 2);
+	YAMC_TEST_CHECK(sent[0].seq == 4);
+	YAMC_TEST_CHECK(sent[1].seq == 5);
+	ids[4] = sent[0].packet_id;
+	ids[5] = sent[1].packet_id;
+
+	// spilled record waits for ring space
+	YAMC_TEST_CHECK(spool.disk_cnt == 1);
+
+	// tail passes skip marker, its space is released with it
+	test_puback(ids[2]);
+	test_puback(ids[3]);
+
+	YAMC_TEST_CHECK(spool.rec_cnt == 2);
+	YAMC_TEST_CHECK(spool.tail == 0);
+	YAMC_TEST_CHECK(spool.used == 2 * rec_len);
+
+	test_puback(ids[4]);
+	test_puback(ids[5]);
+
+	YAMC_TEST_CHECK(spool.rec_cnt == 0);
+	YAMC_TEST_CHECK(spool.used == 0);
+
+	tx_log_len = 0;
+	YAMC_TEST_CHECK(yamc_spool_drain(&spool, &instance) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_sent_decode());
+	YAMC_TEST_CHECK(sent_cnt == 1);
+	YAMC_TEST_CHECK(sent[0].seq == 6);
+	YAMC_TEST_CHECK(spool.disk_cnt == 0);
+
+	test_puback(sent[0].packet_id);
+
+	YAMC_TEST_CHECK(yamc_spool_is_empty(&spool));
+	YAMC_TEST_CHECK(completed_cnt == 7);
+	for (uint32_t i = 0; i < completed_cnt; i++) YAMC_TEST_CHECK(completed[i] == (void*)(uintptr_t)(i + 1));
+
+	yamc_spool_close(&spool);
+}
+
+// messages above threshold go to disk, later ones follow them there to keep order
+static void test_spool_threshold(void)
+{
+	test_init(sizeof(ring), sizeof(ring));
+	YAMC_TEST_CHECK(test_put(YAMC_QOS_LVL0, 0, TEST_PAYLOAD_LEN) == YAMC_RET_SUCCESS);
+	const uint32_t rec_len = spool.used;
+
+	test_init(sizeof(ring), 2 * rec_len);
+
+	YAMC_TEST_CHECK(test_put(YAMC_QOS_LVL0, 0, TEST_PAYLOAD_LEN) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_put(YAMC_QOS_LVL0, 1, TEST_PAYLOAD_LEN) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(spool.rec_cnt == 2);
+	YAMC_TEST_CHECK(spool.disk_cnt == 0);
+
+	YAMC_TEST_CHECK(test_put(YAMC_QOS_LVL0, 2, TEST_PAYLOAD_LEN) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(spool.rec_cnt == 2);
+	YAMC_TEST_CHECK(spool.disk_cnt == 1);
+	YAMC_TEST_CHECK(test_seg_exists(spool.wr_seg));
+
+	// shorter message would fit under threshold, but it's newer than spilled one
+	YAMC_TEST_CHECK(test_put(YAMC_QOS_LVL0, 3, sizeof(uint32_t)) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(spool.rec_cnt == 2);
+	YAMC_TEST_CHECK(spool.disk_cnt == 2);
+
+	// message that can never fit the ring is refused
+	yamc_publish_data_t too_long = {.QOS = YAMC_QOS_LVL0, .p_data = (const uint8_t*)ring, .data_len = sizeof(ring)};
+	yamc_char_to_mqtt_str("t", &too_long.topic);
+	YAMC_TEST_CHECK(yamc_spool_put(&spool, &too_long) == YAMC_RET_INVALID_DATA);
+
+	const uint32_t seg = spool.wr_seg;
+
+	YAMC_TEST_CHECK(yamc_spool_drain(&spool, &instance) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_sent_decode());
+	YAMC_TEST_CHECK(sent_cnt == 4);
+	for (uint32_t i = 0; i < sent_cnt; i++) YAMC_TEST_CHECK(sent[i].seq == i);
+
+	// drained segment file is removed
+	YAMC_TEST_CHECK(yamc_spool_is_empty(&spool));
+	YAMC_TEST_CHECK(spool.used == 0);
+	YAMC_TEST_CHECK(!test_seg_exists(seg));
+
+	yamc_spool_close(&spool);
+}
+
+// refill continues from next segment file once current one is drained
+static void test_spool_segments(void)
+{
+	// nothing is kept in ring, every message is spilled
+	test_init(sizeof(ring), 0);
+
+	for (uint32_t seq = 0; seq < TEST_SEG_MSG_CNT; seq++)
+		YAMC_TEST_CHECK(test_put(YAMC_QOS_LVL0, seq, TEST_SEG_PAYLOAD_LEN) == YAMC_RET_SUCCESS);
+
+	YAMC_TEST_CHECK(spool.disk_cnt == TEST_SEG_MSG_CNT);
+	YAMC_TEST_CHECK(spool.wr_seg - spool.rd_seg >= 2);
+
+	const uint32_t first_seg = spool.rd_seg;
+	const uint32_t last_seg	 = spool.wr_seg;
+
+	YAMC_TEST_CHECK(yamc_spool_drain(&spool, &instance) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_sent_decode());
+	YAMC_TEST_CHECK(sent_cnt == TEST_SEG_MSG_CNT);
+
+	uint32_t order_err_cnt = 0;
+	for (uint32_t i = 0; i < sent_cnt; i++)
+	{
+		if (sent[i].seq != i) order_err_cnt++;
+	}
+	YAMC_TEST_CHECK(order_err_cnt == 0);
+
+	YAMC_TEST_CHECK(yamc_spool_is_empty(&spool));
+	for (uint32_t seg = first_seg; seg != last_seg + 1; seg++) YAMC_TEST_CHECK(!test_seg_exists(seg));
+
+	yamc_spool_close(&spool);
+}
+
+// after reconnection unacknowledged messages are sent again in original order, acknowledged ones are skipped
+static void test_spool_requeue(void)
+{
+	test_init(sizeof(ring), sizeof(ring));
+
+	for (uint32_t seq = 0; seq < 5; seq++) YAMC_TEST_CHECK(test_put(YAMC_QOS_LVL1, seq, TEST_PAYLOAD_LEN) == YAMC_RET_SUCCESS);
+
+	YAMC_TEST_CHECK(yamc_spool_drain(&spool, &instance) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_sent_decode());
+	YAMC_TEST_CHECK(sent_cnt == 5);
+
+	uint16_t ids[5];
+	for (uint32_t i = 0; i < 5; i++) ids[i] = sent[i].packet_id;
+
+	// acknowledgements out of order, oldest record stays unacknowledged
+	test_puback(ids[1]);
+	test_puback(ids[3]);
+	YAMC_TEST_CHECK(spool.rec_cnt == 5);
+
+	// connection lost, new instance gets spool requeued
+	test_instance_init();
+	yamc_spool_requeue(&spool);
+	YAMC_TEST_CHECK(spool.pending_cnt == 3);
+
+	YAMC_TEST_CHECK(yamc_spool_drain(&spool, &instance) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_sent_decode());
+	YAMC_TEST_CHECK(sent_cnt == 3);
+
+	static const uint32_t resent_seq[3] = {0, 2, 4};
+	for (uint32_t i = 0; i < sent_cnt && i < 3; i++)
+	{
+		YAMC_TEST_CHECK(sent[i].seq == resent_seq[i]);
+		YAMC_TEST_CHECK(sent[i].dup);
+		YAMC_TEST_CHECK(sent[i].packet_id == ids[resent_seq[i]]);
+	}
+
+	// nothing is sent twice
+	tx_log_len = 0;
+	YAMC_TEST_CHECK(yamc_spool_drain(&spool, &instance) == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(tx_log_len == 0);
+
+	// space is released up to oldest unacknowledged record
+	test_puback(ids[4]);
+	test_puback(ids[0]);
+	YAMC_TEST_CHECK(spool.rec_cnt == 3);
+	YAMC_TEST_CHECK(spool.tail != 0);
+
+	test_puback(ids[2]);
+	YAMC_TEST_CHECK(yamc_spool_is_empty(&spool));
+	YAMC_TEST_CHECK(spool.used == 0);
+
+	static const uint32_t completed_seq[5] = {1, 3, 4, 0, 2};
+	YAMC_TEST_CHECK(completed_cnt == 5);
+	for (uint32_t i = 0; i < completed_cnt; i++) YAMC_TEST_CHECK(completed[i] == (void*)(uintptr_t)(completed_seq[i] + 1));
+
+	yamc_spool_close(&spool);
+}
+
+int main(void)
+{
+	if (mkdtemp(seg_dir) == NULL)
+	{
+		perror("mkdtemp");
+		return 1;
+	}
+
+	YAMC_TEST_RUN(test_spool_wrap);
+	YAMC_TEST_RUN(test_spool_threshold);
+	YAMC_TEST_RUN(test_spool_segments);
+	YAMC_TEST_RUN(test_spool_requeue);
+
+	rmdir(seg_dir);
+
+	return yamc_test_result("yamc_test_spool");
+}
@@ -0,0 +1,217 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_test_timer_wheel.c - Timer wheel unit tests
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "yamc.h"
+#include "yamc_test.h"
+#include "yamc_timer_wheel.h"
+
+#define TEST_TICK_MS 10
+#define TEST_TIMER_CNT 200
+
+typedef struct
+{
+	yamc_timer_t timer;
+	uint32_t	 start_ms;
+	uint32_t	 timeout_ms;
+	uint32_t	 fired_ms;
+	uint32_t	 fired_cnt;
+	uint32_t	 restart_cnt;  // handler starts timer again this many times
+
+} test_timer_t;
+
+static yamc_timer_wheel_t wheel;
+static test_timer_t		  timers[TEST_TIMER_CNT];
+
+static void test_handler(yamc_timer_t* const p_timer, void* p_ctx)
+{
+	test_timer_t* const p_test = (test_timer_t*)p_ctx;
+
+	YAMC_TEST_CHECK(p_timer == &p_test->timer);
+	YAMC_TEST_CHECK(!yamc_timer_is_running(p_timer));
+
+	p_test->fired_ms = wheel.now_ms;
+	p_test->fired_cnt++;
+
+	if (p_test->restart_cnt > 0)
+	{
+		p_test->restart_cnt--;
+		p_test->start_ms = wheel.now_ms;
+		yamc_timer_start(&wheel, p_timer, p_test->timeout_ms);
+	}
+}
+
+static void test_timer_start(test_timer_t* const p_test, uint32_t now_ms, uint32_t timeout_ms)
+{
+	yamc_timer_init(&p_test->timer, test_handler, p_test);
+
+	p_test->start_ms   = now_ms;
+	p_test->timeout_ms = timeout_ms;
+
+	yamc_timer_start(&wheel, &p_test->timer, timeout_ms);
+}
+
+// advance wheel in 1 ms steps until until_ms, returns time reached
+static uint32_t test_run(uint32_t now_ms, uint32_t until_ms)
+{
+	while (now_ms != until_ms) yamc_timer_wheel_advance(&wheel, ++now_ms);
+
+	return now_ms;
+}
+
+// timer never fires early and at most 2 ticks late
+static void test_timer_wheel_expiry(void)
+{
+	memset(timers, 0, sizeof(timers));
+	yamc_timer_wheel_init(&wheel, TEST_TICK_MS, 0);
+
+	test_timer_start(&timers[0], 0, 25);
+	test_timer_start(&timers[1], 0, 30);
+
+	uint32_t now_ms = test_run(0, 29);
+	YAMC_TEST_CHECK(timers[0].fired_cnt == 0);
+	YAMC_TEST_CHECK(timers[1].fired_cnt == 0);
+
+	now_ms = test_run(now_ms, 30 + 2 * TEST_TICK_MS);
+	YAMC_TEST_CHECK(timers[0].fired_cnt == 1);
+	YAMC_TEST_CHECK(timers[0].fired_ms >= 30);
+	YAMC_TEST_CHECK(timers[1].fired_cnt == 1);
+	YAMC_TEST_CHECK(timers[1].fired_ms >= 30);
+
+	test_run(now_ms, 1000);
+	YAMC_TEST_CHECK(timers[0].fired_cnt == 1);
+	YAMC_TEST_CHECK(timers[1].fired_cnt == 1);
+}
+
+// stopped timer doesn't fire, restarted one counts its timeout from restart
+static void test_timer_wheel_stop_restart(void)
+{
+	memset(timers, 0, sizeof(timers));
+	yamc_timer_wheel_init(&wheel, TEST_TICK_MS, 0);
+
+	test_timer_start(&timers[0], 0, 100);
+	test_timer_start(&timers[1], 0, 100);
+
+	uint32_t now_ms = test_run(0, 50);
+
+	yamc_timer_stop(&timers[0].timer);
+	YAMC_TEST_CHECK(!yamc_timer_is_running(&timers[0].timer));
+
+	// stopping stopped timer does nothing
+	yamc_timer_stop(&timers[0].timer);
+
+	yamc_timer_start(&wheel, &timers[1].timer, 100);
+
+	now_ms = test_run(now_ms, 149);
+	YAMC_TEST_CHECK(timers[1].fired_cnt == 0);
+
+	test_run(now_ms, 1000);
+	YAMC_TEST_CHECK(timers[0].fired_cnt == 0);
+	YAMC_TEST_CHECK(timers[1].fired_cnt == 1);
+	YAMC_TEST_CHECK(timers[1].fired_ms >= 150 && timers[1].fired_ms <= 150 + 2 * TEST_TICK_MS);
+}
+
+// handler starts its timer again
+static void test_timer_wheel_periodic(void)
+{
+	memset(timers, 0, sizeof(timers));
+	yamc_timer_wheel_init(&wheel, TEST_TICK_MS, 0);
+
+	timers[0].restart_cnt = 9;
+	test_timer_start(&timers[0], 0, 40);
+
+	test_run(0, 1000);
+	YAMC_TEST_CHECK(timers[0].fired_cnt == 10);
+	YAMC_TEST_CHECK(timers[0].fired_ms >= 400 && timers[0].fired_ms <= 400 + 20 * TEST_TICK_MS);
+	YAMC_TEST_CHECK(!yamc_timer_is_running(&timers[0].timer));
+}
+
+// wheel catching up after long pause fires expired timers once, timeouts longer than wheel range are capped
+static void test_timer_wheel_catch_up(void)
+{
+	memset(timers, 0, sizeof(timers));
+	yamc_timer_wheel_init(&wheel, TEST_TICK_MS, 0);
+
+	const uint32_t range_ms = (1u << (YAMC_TIMER_WHEEL_LEVELS * YAMC_TIMER_WHEEL_BITS)) * TEST_TICK_MS;
+
+	test_timer_start(&timers[0], 0, 70000);
+	test_timer_start(&timers[1], 0, UINT32_MAX);
+
+	yamc_timer_wheel_advance(&wheel, 100000);
+	YAMC_TEST_CHECK(timers[0].fired_cnt == 1);
+	YAMC_TEST_CHECK(timers[1].fired_cnt == 0);
+
+	yamc_timer_wheel_advance(&wheel, range_ms);
+	YAMC_TEST_CHECK(timers[1].fired_cnt == 1);
+}
+
+// timers spread over all levels fire once, never early and at most 2 ticks late, also across time wrap around
+static void test_timer_wheel_random(void)
+{
+	memset(timers, 0, sizeof(timers));
+
+	uint32_t	   now_ms	= UINT32_MAX - 50000u;
+	const uint32_t start_ms = now_ms;
+	uint32_t	   seed		= 12345;
+
+	yamc_timer_wheel_init(&wheel, TEST_TICK_MS, now_ms);
+
+	for (uint32_t i = 0; i < TEST_TIMER_CNT; i++)
+	{
+		seed = seed * 1103515245u + 12345u;
+
+		// every 4th timer is started later and some get stopped
+		if (i % 4 == 3) continue;
+
+		test_timer_start(&timers[i], now_ms, (seed >> 8) % 200000u);
+	}
+
+	now_ms = test_run(now_ms, start_ms + 7);
+
+	for (uint32_t i = 3; i < TEST_TIMER_CNT; i += 4)
+	{
+		seed = seed * 1103515245u + 12345u;
+		test_timer_start(&timers[i], now_ms, (seed >> 8) % 100000u);
+	}
+
+	for (uint32_t i = 0; i < TEST_TIMER_CNT; i += 10) yamc_timer_stop(&timers[i].timer);
+
+	test_run(now_ms, start_ms + 250000u);
+
+	uint32_t error_cnt = 0;
+
+	for (uint32_t i = 0; i < TEST_TIMER_CNT; i++)
+	{
+		if (i % 10 == 0)
+		{
+			if (timers[i].fired_cnt != 0) error_cnt++;
+			continue;
+		}
+
+		const uint32_t elapsed_ms = timers[i].fired_ms - timers[i].start_ms;
+
+		if (timers[i].fired_cnt != 1) error_cnt++;
+		if (elapsed_ms < timers[i].timeout_ms || elapsed_ms > timers[i].timeout_ms + 2 * TEST_TICK_MS) error_cnt++;
+	}
+
+	YAMC_TEST_CHECK(error_cnt == 0);
+}
+
+int main(void)
+{
+	YAMC_TEST_RUN(test_timer_wheel_expiry);
+	YAMC_TEST_RUN(test_timer_wheel_stop_restart);
+	YAMC_TEST_RUN(test_timer_wheel_periodic);
+	YAMC_TEST_RUN(test_timer_wheel_catch_up);
+	YAMC_TEST_RUN(test_timer_wheel_random);
+
+	return yamc_test_result("yamc_test_timer_wheel");
+}
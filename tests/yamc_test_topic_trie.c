@@ -0,0 +1,251 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_test_topic_trie.c - Topic filter trie unit tests
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "yamc.h"
+#include "yamc_test.h"
+#include "yamc_topic_trie.h"
+
+#define TEST_NODES_LEN 64
+#define TEST_EDGES_LEN 128
+#define TEST_SUB_CNT 60
+
+static yamc_topic_trie_t trie;
+static yamc_topic_node_t nodes[TEST_NODES_LEN];
+static uint32_t			 edges[TEST_EDGES_LEN];
+static yamc_topic_sub_t  subs[TEST_SUB_CNT];
+static char				 filters[TEST_SUB_CNT][16];
+
+// bit per subscription index whose handler was called
+static uint64_t hit_mask;
+
+static void test_handler(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data, void* p_ctx)
+{
+	YAMC_UNUSED_PARAMETER(p_instance);
+	YAMC_UNUSED_PARAMETER(p_pkt_data);
+
+	hit_mask |= 1ull << (uint32_t)(uintptr_t)p_ctx;
+}
+
+static yamc_retcode_t test_add(uint32_t idx, const char* const p_filter)
+{
+	snprintf(filters[idx], sizeof(filters[idx]), "%s", p_filter);
+
+	memset(&subs[idx], 0, sizeof(yamc_topic_sub_t));
+	yamc_char_to_mqtt_str(filters[idx], &subs[idx].filter);
+	subs[idx].handler = test_handler;
+	subs[idx].p_ctx	  = (void*)(uintptr_t)idx;
+
+	return yamc_topic_trie_add(&trie, &subs[idx]);
+}
+
+// returns mask of subscriptions matching topic, match() has to agree with dispatch()
+static uint64_t test_dispatch(const char* const p_topic)
+{
+	yamc_mqtt_pkt_data_t pkt_data;
+	memset(&pkt_data, 0, sizeof(pkt_data));
+
+	pkt_data.pkt_type = YAMC_PKT_PUBLISH;
+	yamc_char_to_mqtt_str(p_topic, &pkt_data.pkt_data.publish.topic_name);
+
+	hit_mask = 0;
+
+	const uint32_t cnt = yamc_topic_trie_dispatch(&trie, NULL, &pkt_data);
+
+	YAMC_TEST_CHECK(cnt == (uint32_t)__builtin_popcountll(hit_mask));
+	YAMC_TEST_CHECK(yamc_topic_trie_match(&trie, &pkt_data.pkt_data.publish.topic_name) == (hit_mask != 0));
+
+	return hit_mask;
+}
+
+static uint32_t test_free_node_cnt(void)
+{
+	uint32_t cnt = 0;
+	for (uint32_t idx = trie.free_node; idx != 0; idx = nodes[idx].next_sibling) cnt++;
+
+	return cnt;
+}
+
+static uint32_t test_edge_cnt(void)
+{
+	uint32_t cnt = 0;
+	for (uint32_t slot = 0; slot < TEST_EDGES_LEN; slot++) cnt += (edges[slot] != 0) ? 1 : 0;
+
+	return cnt;
+}
+
+#define BIT(idx) (1ull << (idx))
+
+// + matches exactly one level, # any number of levels including parent one, wildcards at first level skip $ topics
+static void test_topic_trie_wildcards(void)
+{
+	yamc_topic_trie_init(&trie, nodes, TEST_NODES_LEN, edges, TEST_EDGES_LEN);
+
+	YAMC_TEST_CHECK(test_add(0, "a/b") == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_add(1, "a/+") == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_add(2, "a/#") == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_add(3, "#") == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_add(4, "+/b") == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_add(5, "a/+/c") == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_add(6, "$SYS/#") == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_add(7, "a/b/#") == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_add(8, "+") == YAMC_RET_SUCCESS);
+
+	YAMC_TEST_CHECK(test_dispatch("a/b") == (BIT(0) | BIT(1) | BIT(2) | BIT(3) | BIT(4) | BIT(7)));
+	YAMC_TEST_CHECK(test_dispatch("a") == (BIT(2) | BIT(3) | BIT(8)));
+	YAMC_TEST_CHECK(test_dispatch("a/x/c") == (BIT(2) | BIT(3) | BIT(5)));
+	YAMC_TEST_CHECK(test_dispatch("a//c") == (BIT(2) | BIT(3) | BIT(5)));
+	YAMC_TEST_CHECK(test_dispatch("a/b/c/d") == (BIT(2) | BIT(3) | BIT(7)));
+	YAMC_TEST_CHECK(test_dispatch("b/b") == (BIT(3) | BIT(4)));
+	YAMC_TEST_CHECK(test_dispatch("$SYS/x") == BIT(6));
+	YAMC_TEST_CHECK(test_dispatch("$SYS") == BIT(6));
+	YAMC_TEST_CHECK(test_dispatch("$other") == 0);
+
+	// other packet types are ignored
+	yamc_mqtt_pkt_data_t pkt_data;
+	memset(&pkt_data, 0, sizeof(pkt_data));
+	pkt_data.pkt_type = YAMC_PKT_SUBACK;
+
+	YAMC_TEST_CHECK(yamc_topic_trie_dispatch(&trie, NULL, &pkt_data) == 0);
+}
+
+// wildcard has to take whole level and # has to be the last one
+static void test_topic_trie_invalid(void)
+{
+	yamc_topic_trie_init(&trie, nodes, TEST_NODES_LEN, edges, TEST_EDGES_LEN);
+
+	YAMC_TEST_CHECK(test_add(0, "") == YAMC_RET_INVALID_DATA);
+	YAMC_TEST_CHECK(test_add(0, "a/b#") == YAMC_RET_INVALID_DATA);
+	YAMC_TEST_CHECK(test_add(0, "a/#/b") == YAMC_RET_INVALID_DATA);
+	YAMC_TEST_CHECK(test_add(0, "+a/b") == YAMC_RET_INVALID_DATA);
+
+	YAMC_TEST_CHECK(test_free_node_cnt() == TEST_NODES_LEN - 1);
+	YAMC_TEST_CHECK(test_edge_cnt() == 0);
+}
+
+// removed subscription stops matching, shared nodes stay and keep valid level strings, unused ones are released
+static void test_topic_trie_remove(void)
+{
+	yamc_topic_trie_init(&trie, nodes, TEST_NODES_LEN, edges, TEST_EDGES_LEN);
+
+	YAMC_TEST_CHECK(test_add(0, "a/b/c") == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_add(1, "a/b/d") == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_add(2, "a/+") == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_add(3, "a/+") == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_free_node_cnt() == TEST_NODES_LEN - 1 - 5);
+
+	// nodes a and b hold level strings of first filter, it can be reused by user once removed
+	yamc_topic_trie_remove(&trie, &subs[0]);
+	memset(filters[0], 'x', strlen(filters[0]));
+
+	YAMC_TEST_CHECK(test_dispatch("a/b/c") == 0);
+	YAMC_TEST_CHECK(test_dispatch("a/b/d") == BIT(1));
+	YAMC_TEST_CHECK(test_free_node_cnt() == TEST_NODES_LEN - 1 - 4);
+
+	// same filter registered twice
+	YAMC_TEST_CHECK(test_dispatch("a/b") == (BIT(2) | BIT(3)));
+	yamc_topic_trie_remove(&trie, &subs[2]);
+	YAMC_TEST_CHECK(test_dispatch("a/b") == BIT(3));
+
+	// removing subscription again does nothing
+	yamc_topic_trie_remove(&trie, &subs[2]);
+	YAMC_TEST_CHECK(test_dispatch("a/b") == BIT(3));
+
+	yamc_topic_trie_remove(&trie, &subs[3]);
+	yamc_topic_trie_remove(&trie, &subs[1]);
+
+	YAMC_TEST_CHECK(test_dispatch("a/b/d") == 0);
+	YAMC_TEST_CHECK(test_free_node_cnt() == TEST_NODES_LEN - 1);
+	YAMC_TEST_CHECK(test_edge_cnt() == 0);
+}
+
+// failed add leaves no nodes behind
+static void test_topic_trie_exhaust(void)
+{
+	yamc_topic_trie_init(&trie, nodes, 4, edges, 8);
+
+	YAMC_TEST_CHECK(test_add(0, "a/b") == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_add(1, "x/y") == YAMC_RET_INVALID_STATE);
+	YAMC_TEST_CHECK(test_free_node_cnt() == 1);
+
+	YAMC_TEST_CHECK(test_add(1, "a/c") == YAMC_RET_SUCCESS);
+	YAMC_TEST_CHECK(test_dispatch("a/c") == BIT(1));
+	YAMC_TEST_CHECK(test_dispatch("x/y") == 0);
+	YAMC_TEST_CHECK(test_free_node_cnt() == 0);
+}
+
+// siblings collide in small hash table, removing entries from probe chains keeps the rest reachable
+static void test_topic_trie_backward_shift(void)
+{
+	yamc_topic_trie_init(&trie, nodes, TEST_NODES_LEN, edges, TEST_EDGES_LEN);
+
+	char topic[16];
+
+	YAMC_TEST_CHECK(test_add(0, "l") == YAMC_RET_SUCCESS);
+
+	for (uint32_t i = 1; i < TEST_SUB_CNT; i++)
+	{
+		snprintf(topic, sizeof(topic), "l/%u", i);
+		YAMC_TEST_CHECK(test_add(i, topic) == YAMC_RET_SUCCESS);
+	}
+
+	// test is meaningful only if some entries are displaced from their home slots
+	uint32_t displaced_cnt = 0;
+	for (uint32_t slot = 0; slot < TEST_EDGES_LEN; slot++)
+		if (edges[slot] != 0 && (nodes[edges[slot]].hash & trie.edges_mask) != slot) displaced_cnt++;
+
+	YAMC_TEST_CHECK(displaced_cnt > 0);
+	YAMC_TEST_CHECK(test_edge_cnt() == TEST_SUB_CNT);
+
+	for (uint32_t i = 1; i < TEST_SUB_CNT; i += 2) yamc_topic_trie_remove(&trie, &subs[i]);
+
+	uint32_t error_cnt = 0;
+
+	for (uint32_t i = 1; i < TEST_SUB_CNT; i++)
+	{
+		snprintf(topic, sizeof(topic), "l/%u", i);
+		if (test_dispatch(topic) != ((i % 2 == 0) ? BIT(i) : 0)) error_cnt++;
+	}
+
+	YAMC_TEST_CHECK(error_cnt == 0);
+
+	// released nodes are reused
+	for (uint32_t i = 1; i < TEST_SUB_CNT; i += 2)
+	{
+		snprintf(topic, sizeof(topic), "l/%u", i);
+		YAMC_TEST_CHECK(test_add(i, topic) == YAMC_RET_SUCCESS);
+	}
+
+	for (uint32_t i = 1; i < TEST_SUB_CNT; i++)
+	{
+		snprintf(topic, sizeof(topic), "l/%u", i);
+		if (test_dispatch(topic) != BIT(i)) error_cnt++;
+	}
+
+	YAMC_TEST_CHECK(error_cnt == 0);
+
+	for (uint32_t i = 0; i < TEST_SUB_CNT; i++) yamc_topic_trie_remove(&trie, &subs[i]);
+
+	YAMC_TEST_CHECK(test_free_node_cnt() == TEST_NODES_LEN - 1);
+	YAMC_TEST_CHECK(test_edge_cnt() == 0);
+}
+
+int main(void)
+{
+	YAMC_TEST_RUN(test_topic_trie_wildcards);
+	YAMC_TEST_RUN(test_topic_trie_invalid);
+	YAMC_TEST_RUN(test_topic_trie_remove);
+	YAMC_TEST_RUN(test_topic_trie_exhaust);
+	YAMC_TEST_RUN(test_topic_trie_backward_shift);
+
+	return yamc_test_result("yamc_test_topic_trie");
+}
@@ -21,7 +21,7 @@ static inline void yamc_handle_connack(const yamc_instance_t* const p_instance,
 					  p_pkt_data->pkt_data.connack.return_code);
 }
 
-static inline void yamc_handle_publish(const yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
+static inline void yamc_handle_publish(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
 {
 	YAMC_ASSERT(p_instance != NULL);
 	YAMC_ASSERT(p_pkt_data != NULL);
@@ -54,7 +54,7 @@ static inline void yamc_handle_publish(const yamc_instance_t* const p_instance,
 	}
 }
 
-static inline void yamc_handle_pub_x(const yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
+static inline void yamc_handle_pub_x(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
 {
 	YAMC_ASSERT(p_instance != NULL);
 	YAMC_ASSERT(p_pkt_data != NULL);
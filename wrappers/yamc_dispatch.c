@@ -0,0 +1,241 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_dispatch.c - Hands incoming PUBLISH messages over to pool of worker threads
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "yamc_dispatch.h"
+
+// slabs are padded to whole cache lines, so workers touching neighbouring slabs don't share lines
+#define YAMC_DISPATCH_SLAB_STRIDE(slab_len) \
+	((sizeof(yamc_dispatch_slab_t) + (slab_len) + YAMC_CACHE_LINE_LEN - 1) & ~(size_t)(YAMC_CACHE_LINE_LEN - 1))
+
+static inline yamc_dispatch_slab_t* yamc_dispatch_slab(const yamc_dispatch_t* const p_dispatch, uint32_t idx)
+{
+	return (yamc_dispatch_slab_t*)&p_dispatch->p_slabs[(size_t)idx * YAMC_DISPATCH_SLAB_STRIDE(p_dispatch->slab_len)];
+}
+
+// FNV-1a
+static uint32_t yamc_dispatch_topic_hash(const yamc_mqtt_string* const p_topic)
+{
+	uint32_t hash = 2166136261u;
+
+	for (uint32_t i = 0; i < p_topic->len; i++)
+	{
+		hash ^= p_topic->str[i];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static void yamc_dispatch_sem_wait(sem_t* const p_sem)
+{
+	while (sem_wait(p_sem) != 0 && errno == EINTR)
+		;
+}
+
+static void* yamc_dispatch_worker_thread(void* p_arg)
+{
+	yamc_dispatch_worker_t* const p_worker   = p_arg;
+	yamc_dispatch_t* const		  p_dispatch = p_worker->p_dispatch;
+
+	while (1)
+	{
+		yamc_dispatch_sem_wait(&p_worker->ready);
+
+		// every message is posted once, extra post with empty ring means stop
+		if (p_worker->tail == __atomic_load_n(&p_worker->head, __ATOMIC_ACQUIRE)) break;
+
+		yamc_dispatch_slab_t* const p_slab = p_worker->p_slots[p_worker->tail & p_dispatch->ring_mask];
+		p_worker->tail++;
+
+		p_dispatch->handler(&p_slab->msg, p_worker->idx, p_dispatch->p_ctx);
+
+		free(p_slab->p_ext);
+		p_slab->p_ext = NULL;
+
+		yamc_mpsc_push(&p_dispatch->free_list, &p_slab->node);
+		sem_post(&p_dispatch->free_cnt);
+	}
+
+	return NULL;
+}
+
+// stop first worker_cnt workers after they process queued messages
+static void yamc_dispatch_stop_workers(yamc_dispatch_t* const p_dispatch, uint32_t worker_cnt)
+{
+	for (uint32_t i = 0; i < worker_cnt; i++) sem_post(&p_dispatch->p_workers[i].ready);
+
+	for (uint32_t i = 0; i < worker_cnt; i++)
+	{
+		pthread_join(p_dispatch->p_workers[i].tid, NULL);
+		sem_destroy(&p_dispatch->p_workers[i].ready);
+		free(p_dispatch->p_workers[i].p_slots);
+	}
+}
+
+static void yamc_dispatch_release(yamc_dispatch_t* const p_dispatch)
+{
+	sem_destroy(&p_dispatch->free_cnt);
+
+	free(p_dispatch->p_workers);
+	free(p_dispatch->p_slabs);
+
+	p_dispatch->p_workers = NULL;
+	p_dispatch->p_slabs   = NULL;
+}
+
+yamc_retcode_t yamc_dispatch_init(yamc_dispatch_t* const p_dispatch, uint32_t worker_cnt, uint32_t slab_cnt, uint32_t slab_len,
+								  yamc_dispatch_handler_t handler, void* p_ctx)
+{
+	YAMC_ASSERT(p_dispatch != NULL);
+	YAMC_ASSERT(worker_cnt > 0);
+	YAMC_ASSERT(slab_cnt > 0 && slab_cnt <= (1u << 31));
+	YAMC_ASSERT(handler != NULL);
+
+	memset(p_dispatch, 0, sizeof(yamc_dispatch_t));
+
+	p_dispatch->worker_cnt = worker_cnt;
+	p_dispatch->slab_len   = slab_len;
+	p_dispatch->handler	= handler;
+	p_dispatch->p_ctx	  = p_ctx;
+
+	uint32_t ring_len = 1;
+	while (ring_len < slab_cnt) ring_len <<= 1;
+	p_dispatch->ring_mask = ring_len - 1;
+
+	const size_t slabs_size = (size_t)slab_cnt * YAMC_DISPATCH_SLAB_STRIDE(slab_len);
+
+	p_dispatch->p_slabs   = aligned_alloc(YAMC_CACHE_LINE_LEN, slabs_size);
+	p_dispatch->p_workers = aligned_alloc(YAMC_CACHE_LINE_LEN, worker_cnt * sizeof(yamc_dispatch_worker_t));
+
+	sem_init(&p_dispatch->free_cnt, 0, slab_cnt);
+
+	if (p_dispatch->p_slabs == NULL || p_dispatch->p_workers == NULL)
+	{
+		YAMC_ERROR_PRINTF("Can't allocate dispatch slab pool\n");
+		yamc_dispatch_release(p_dispatch);
+		return YAMC_RET_INVALID_STATE;
+	}
+
+	yamc_mpsc_init(&p_dispatch->free_list);
+
+	for (uint32_t i = 0; i < slab_cnt; i++)
+	{
+		yamc_dispatch_slab_t* const p_slab = yamc_dispatch_slab(p_dispatch, i);
+
+		p_slab->p_ext = NULL;
+		yamc_mpsc_push(&p_dispatch->free_list, &p_slab->node);
+	}
+
+	memset(p_dispatch->p_workers, 0, worker_cnt * sizeof(yamc_dispatch_worker_t));
+
+	for (uint32_t i = 0; i < worker_cnt; i++)
+	{
+		yamc_dispatch_worker_t* const p_worker = &p_dispatch->p_workers[i];
+
+		p_worker->idx		 = i;
+		p_worker->p_dispatch = p_dispatch;
+		p_worker->p_slots	= malloc(ring_len * sizeof(yamc_dispatch_slab_t*));
+
+		sem_init(&p_worker->ready, 0, 0);
+
+		if (p_worker->p_slots == NULL || pthread_create(&p_worker->tid, NULL, yamc_dispatch_worker_thread, p_worker) != 0)
+		{
+			YAMC_ERROR_PRINTF("Can't start dispatch worker\n");
+
+			sem_destroy(&p_worker->ready);
+			free(p_worker->p_slots);
+
+			yamc_dispatch_stop_workers(p_dispatch, i);
+			yamc_dispatch_release(p_dispatch);
+			return YAMC_RET_INVALID_STATE;
+		}
+	}
+
+	return YAMC_RET_SUCCESS;
+}
+
+yamc_retcode_t yamc_dispatch_publish(yamc_dispatch_t* const p_dispatch, const yamc_mqtt_pkt_data_t* const p_pkt_data)
+{
+	YAMC_ASSERT(p_dispatch != NULL);
+	YAMC_ASSERT(p_pkt_data != NULL);
+
+	if (p_pkt_data->pkt_type != YAMC_PKT_PUBLISH) return YAMC_RET_SUCCESS;
+
+	const yamc_mqtt_pkt_publish_t* const p_publish = &p_pkt_data->pkt_data.publish;
+
+	const uint32_t topic_len = p_publish->topic_name.len;
+	const uint32_t data_len  = p_publish->payload.data_len;
+
+	// wait for workers to return slab when pool is exhausted
+	yamc_dispatch_sem_wait(&p_dispatch->free_cnt);
+
+	// slab is counted once its push completes, pop fails only while another push is linking its node
+	yamc_mpsc_node_t* p_node;
+	while ((p_node = yamc_mpsc_pop(&p_dispatch->free_list)) == NULL) sched_yield();
+
+	yamc_dispatch_slab_t* const p_slab = (yamc_dispatch_slab_t*)p_node;
+
+	uint8_t* p_copy = (uint8_t*)(p_slab + 1);
+
+	if (topic_len + data_len > p_dispatch->slab_len)
+	{
+		p_slab->p_ext = malloc((size_t)topic_len + data_len);
+		if (p_slab->p_ext == NULL)
+		{
+			YAMC_ERROR_PRINTF("Can't allocate %u bytes for dispatched message\n", topic_len + data_len);
+
+			yamc_mpsc_push(&p_dispatch->free_list, &p_slab->node);
+			sem_post(&p_dispatch->free_cnt);
+			return YAMC_RET_INVALID_STATE;
+		}
+
+		p_copy = p_slab->p_ext;
+	}
+
+	memcpy(p_copy, p_publish->topic_name.str, topic_len);
+	if (data_len > 0) memcpy(&p_copy[topic_len], p_publish->payload.p_data, data_len);
+
+	p_slab->msg.topic.str = p_copy;
+	p_slab->msg.topic.len = topic_len;
+	p_slab->msg.p_data	= &p_copy[topic_len];
+	p_slab->msg.data_len  = data_len;
+	p_slab->msg.packet_id = p_publish->packet_id;
+	p_slab->msg.QOS		  = p_pkt_data->flags.QOS;
+	p_slab->msg.DUP		  = p_pkt_data->flags.DUP;
+	p_slab->msg.RETAIN	= p_pkt_data->flags.RETAIN;
+
+	yamc_dispatch_worker_t* const p_worker =
+		&p_dispatch->p_workers[yamc_dispatch_topic_hash(&p_publish->topic_name) % p_dispatch->worker_cnt];
+
+	// ring holds whole pool, there is always room for a slab
+	const uint32_t head = p_worker->head;
+
+	p_worker->p_slots[head & p_dispatch->ring_mask] = p_slab;
+	__atomic_store_n(&p_worker->head, head + 1, __ATOMIC_RELEASE);
+
+	sem_post(&p_worker->ready);
+
+	return YAMC_RET_SUCCESS;
+}
+
+void yamc_dispatch_free(yamc_dispatch_t* const p_dispatch)
+{
+	YAMC_ASSERT(p_dispatch != NULL);
+
+	if (p_dispatch->p_workers == NULL) return;
+
+	yamc_dispatch_stop_workers(p_dispatch, p_dispatch->worker_cnt);
+
+	yamc_dispatch_release(p_dispatch);
+}
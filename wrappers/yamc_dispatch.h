@@ -0,0 +1,110 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_dispatch.h - Hands incoming PUBLISH messages over to pool of worker threads
+ *
+ * Call yamc_dispatch_publish() from packet handler instead of processing message on receive thread. Topic and payload
+ * are copied to slab from preallocated pool and queued to one of the workers, chosen by topic hash. Messages with the same
+ * topic are always processed by the same worker, so their order is kept. Each worker has its own single producer single
+ * consumer ring, only receive thread pushes to rings. When pool runs out of slabs receive thread waits for workers,
+ * which stops reading from socket and lets TCP flow control slow down the server.
+ *
+ * Messages are acknowledged by yamc when they are parsed, before workers process them.
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#ifndef __YAMC_DISPATCH_H__
+#define __YAMC_DISPATCH_H__
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "yamc.h"
+#include "yamc_mpsc.h"
+#include "yamc_port.h"
+
+/// Message passed to worker, valid until handler returns
+typedef struct
+{
+	yamc_mqtt_string topic;		 ///< publish topic
+	const uint8_t*   p_data;	 ///< payload data
+	uint32_t		 data_len;   ///< payload data length
+	uint16_t		 packet_id;  ///< packet id, 0 for QoS0
+	yamc_qos_lvl_t   QOS;		 ///< QoS level
+	bool			 DUP;		 ///< packet DUP flag
+	bool			 RETAIN;	 ///< packet RETAIN flag
+
+} yamc_dispatch_msg_t;
+
+/// Message handler, called on worker thread
+typedef void (*yamc_dispatch_handler_t)(const yamc_dispatch_msg_t* const p_msg, uint32_t worker, void* p_ctx);
+
+struct yamc_dispatch_s;
+
+typedef struct
+{
+	yamc_mpsc_node_t node;  // free list link
+	uint8_t*		 p_ext;  // heap copy of message longer than slab, NULL if it fits
+	yamc_dispatch_msg_t msg;
+
+} yamc_dispatch_slab_t;
+
+typedef struct
+{
+	// written by receive thread only
+	uint32_t head YAMC_CACHE_ALIGNED;
+
+	// written by worker only
+	uint32_t tail YAMC_CACHE_ALIGNED;
+
+	yamc_dispatch_slab_t** p_slots YAMC_CACHE_ALIGNED;  // ring of queued messages
+	sem_t				   ready;						 // posted once per queued message and once on stop
+	pthread_t			   tid;
+	uint32_t			   idx;
+	struct yamc_dispatch_s* p_dispatch;
+
+} yamc_dispatch_worker_t;
+
+typedef struct yamc_dispatch_s
+{
+	yamc_dispatch_worker_t* p_workers;
+	uint32_t				worker_cnt;
+	uint32_t				ring_mask;  // ring length - 1, rings hold whole pool so they never overflow
+
+	uint8_t*	p_slabs;	// slab pool memory
+	uint32_t	slab_len;   // message bytes per slab
+	yamc_mpsc_t free_list;  // workers return slabs here, receive thread takes them
+	sem_t		free_cnt;   // number of slabs on free list
+
+	yamc_dispatch_handler_t handler;
+	void*					p_ctx;
+
+} yamc_dispatch_t;
+
+/**
+ * \brief allocate slab pool and start workers
+ *
+ * \param worker_cnt number of worker threads
+ * \param slab_cnt number of messages queued at most, receive thread waits when all are in use
+ * \param slab_len topic and payload bytes stored in slab, longer messages are copied to heap
+ * \return YAMC_RET_SUCCESS or YAMC_RET_INVALID_STATE if memory can't be allocated or threads can't be started
+ */
+yamc_retcode_t yamc_dispatch_init(yamc_dispatch_t* const p_dispatch, uint32_t worker_cnt, uint32_t slab_cnt, uint32_t slab_len,
+								  yamc_dispatch_handler_t handler, void* p_ctx);
+
+/**
+ * \brief copy PUBLISH packet and queue it to its topic's worker, call from packet handler
+ *
+ * Other packet types are ignored. Only one thread may call this function.
+ *
+ * \return YAMC_RET_SUCCESS or YAMC_RET_INVALID_STATE if message longer than slab can't be copied
+ */
+yamc_retcode_t yamc_dispatch_publish(yamc_dispatch_t* const p_dispatch, const yamc_mqtt_pkt_data_t* const p_pkt_data);
+
+/// process queued messages, stop workers and release memory
+void yamc_dispatch_free(yamc_dispatch_t* const p_dispatch);
+
+#endif /* __YAMC_DISPATCH_H__ */
@@ -92,7 +92,7 @@ static inline void yamc_handle_suback(const yamc_instance_t* const p_instance, c
 	}
 
 	// overwrite decoded data so program has chance to crash on bad memory allocation
-	memset_s(p_data->payload.p_retcodes, 0, p_data->payload.retcodes_len);
+	memset_s((uint8_t*)p_data->payload.p_retcodes, 0, p_data->payload.retcodes_len);
 }
 
 static inline void yamc_handle_pingresp(const yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
@@ -0,0 +1,368 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_mmap_store.c - Persists unacknowledged QoS>0 PUBLISH packets in memory mapped file on Unix platform
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "yamc_mmap_store.h"
+#include "yamc.h"
+#include "yamc_port.h"
+
+#define YAMC_MMAP_STORE_MAGIC 0x594D5354  // "YMST"
+#define YAMC_MMAP_STORE_VERSION 1
+
+// file header, slots follow
+typedef struct
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t slots_cnt;
+	uint32_t slot_data_len;
+
+} yamc_mmap_store_hdr_t;
+
+// fixed size slot, topic and payload follow
+typedef struct
+{
+	uint32_t seq;		 // store order of the message
+	uint16_t packet_id;  // packet identifier
+	uint8_t  state;		 // yamc_inflight_state_t, written last so partially stored slot stays free
+	uint8_t  retain;	 // packet RETAIN flag
+	uint16_t topic_len;  // topic length
+	uint16_t reserved;
+	uint32_t data_len;  // payload length
+	uint8_t  data[];	// topic followed by payload
+
+} yamc_mmap_store_slot_t;
+
+// slots are 8 byte aligned
+#define YAMC_MMAP_STORE_ALIGN(x) (((x) + 7u) & ~(uint32_t)7u)
+
+static inline yamc_mmap_store_slot_t* yamc_mmap_store_slot(const yamc_mmap_store_t* const p_store, const uint16_t slot)
+{
+	YAMC_ASSERT(p_store != NULL);
+	YAMC_ASSERT(slot < p_store->slots_cnt);
+
+	return (yamc_mmap_store_slot_t*)(p_store->p_map + sizeof(yamc_mmap_store_hdr_t) + (size_t)slot * p_store->slot_size);
+}
+
+// returns true if slot holds complete message that fits the slot
+static inline bool yamc_mmap_store_slot_valid(const yamc_mmap_store_t* const p_store, const yamc_mmap_store_slot_t* const p_slot)
+{
+	YAMC_ASSERT(p_store != NULL);
+	YAMC_ASSERT(p_slot != NULL);
+
+	if (p_slot->state != YAMC_INFLIGHT_WAIT_PUBACK && p_slot->state != YAMC_INFLIGHT_WAIT_PUBREC &&
+		p_slot->state != YAMC_INFLIGHT_WAIT_PUBCOMP)
+		return false;
+
+	return p_slot->packet_id != 0 && (uint64_t)p_slot->topic_len + p_slot->data_len <= p_store->slot_data_len;
+}
+
+/**
+ * \brief create zeroed store file with complete header
+ *
+ * File is prepared under temporary name and renamed when complete, crash never leaves half initialized store behind.
+ */
+static yamc_retcode_t yamc_mmap_store_create(const yamc_mmap_store_t* const p_store, const char* const path)
+{
+	YAMC_ASSERT(p_store != NULL);
+	YAMC_ASSERT(path != NULL);
+
+	char tmp_path[PATH_MAX];
+
+	if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path))
+	{
+		YAMC_ERROR_PRINTF("Store file path %s is too long\n", path);
+		return YAMC_RET_INVALID_DATA;
+	}
+
+	const int fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (fd < 0)
+	{
+		YAMC_ERROR_PRINTF("Error creating store file %s: %s\n", tmp_path, strerror(errno));
+		return YAMC_RET_INVALID_STATE;
+	}
+
+	const yamc_mmap_store_hdr_t hdr = {
+		.magic		   = YAMC_MMAP_STORE_MAGIC,
+		.version	   = YAMC_MMAP_STORE_VERSION,
+		.slots_cnt	 = p_store->slots_cnt,
+		.slot_data_len = p_store->slot_data_len,
+	};
+
+	// zeroed slots are free
+	if (ftruncate(fd, p_store->map_len) < 0 || pwrite(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) || fsync(fd) < 0)
+	{
+		YAMC_ERROR_PRINTF("Error writing store file %s: %s\n", tmp_path, strerror(errno));
+		close(fd);
+		unlink(tmp_path);
+		return YAMC_RET_INVALID_STATE;
+	}
+
+	close(fd);
+
+	if (rename(tmp_path, path) < 0)
+	{
+		YAMC_ERROR_PRINTF("Error renaming store file %s: %s\n", tmp_path, strerror(errno));
+		unlink(tmp_path);
+		return YAMC_RET_INVALID_STATE;
+	}
+
+	return YAMC_RET_SUCCESS;
+}
+
+yamc_retcode_t yamc_mmap_store_open(yamc_mmap_store_t* const p_store, const char* const path, uint16_t slots_cnt, uint32_t slot_data_len)
+{
+	YAMC_ASSERT(p_store != NULL);
+	YAMC_ASSERT(path != NULL);
+	YAMC_ASSERT(slots_cnt > 0);
+
+	memset(p_store, 0, sizeof(yamc_mmap_store_t));
+
+	p_store->slots_cnt	 = slots_cnt;
+	p_store->slot_data_len = slot_data_len;
+	p_store->slot_size	 = YAMC_MMAP_STORE_ALIGN(sizeof(yamc_mmap_store_slot_t) + slot_data_len);
+	p_store->map_len	   = sizeof(yamc_mmap_store_hdr_t) + (size_t)slots_cnt * p_store->slot_size;
+
+	p_store->fd = open(path, O_RDWR | O_CLOEXEC);
+
+	if (p_store->fd < 0 && errno == ENOENT)
+	{
+		const yamc_retcode_t ret = yamc_mmap_store_create(p_store, path);
+		if (ret != YAMC_RET_SUCCESS) return ret;
+
+		p_store->fd = open(path, O_RDWR | O_CLOEXEC);
+	}
+
+	if (p_store->fd < 0)
+	{
+		YAMC_ERROR_PRINTF("Error opening store file %s: %s\n", path, strerror(errno));
+		return YAMC_RET_INVALID_STATE;
+	}
+
+	struct stat st;
+	if (fstat(p_store->fd, &st) < 0)
+	{
+		YAMC_ERROR_PRINTF("Error reading store file %s: %s\n", path, strerror(errno));
+		close(p_store->fd);
+		return YAMC_RET_INVALID_STATE;
+	}
+
+	if ((size_t)st.st_size != p_store->map_len)
+	{
+		YAMC_ERROR_PRINTF("Store file %s has unexpected size\n", path);
+		close(p_store->fd);
+		return YAMC_RET_INVALID_DATA;
+	}
+
+	p_store->p_map = mmap(NULL, p_store->map_len, PROT_READ | PROT_WRITE, MAP_SHARED, p_store->fd, 0);
+	if (p_store->p_map == MAP_FAILED)
+	{
+		YAMC_ERROR_PRINTF("Error mapping store file %s: %s\n", path, strerror(errno));
+		close(p_store->fd);
+		return YAMC_RET_INVALID_STATE;
+	}
+
+	const yamc_mmap_store_hdr_t* const p_hdr = (const yamc_mmap_store_hdr_t*)p_store->p_map;
+
+	if (p_hdr->magic != YAMC_MMAP_STORE_MAGIC || p_hdr->version != YAMC_MMAP_STORE_VERSION || p_hdr->slots_cnt != slots_cnt ||
+		p_hdr->slot_data_len != slot_data_len)
+	{
+		YAMC_ERROR_PRINTF("Store file %s was created with different parameters\n", path);
+		munmap(p_store->p_map, p_store->map_len);
+		close(p_store->fd);
+		return YAMC_RET_INVALID_DATA;
+	}
+
+	return YAMC_RET_SUCCESS;
+}
+
+// returns true if message with given topic and payload length fits store slot
+bool yamc_mmap_store_fits(const yamc_mmap_store_t* const p_store, uint32_t topic_len, uint32_t data_len)
+{
+	YAMC_ASSERT(p_store != NULL);
+
+	return (uint64_t)topic_len + data_len <= p_store->slot_data_len;
+}
+
+// copy in-flight entry to its slot, called from yamc for each sent QoS>0 PUBLISH
+void yamc_mmap_store_save(yamc_mmap_store_t* const p_store, uint16_t slot, const yamc_inflight_entry_t* const p_entry)
+{
+	YAMC_ASSERT(p_store != NULL);
+	YAMC_ASSERT(p_entry != NULL);
+
+	yamc_mmap_store_slot_t* const p_slot = yamc_mmap_store_slot(p_store, slot);
+
+	// QoS2 PUBREC received, only PUBREL is resent from now on
+	if (p_entry->state == YAMC_INFLIGHT_WAIT_PUBCOMP && p_slot->packet_id == p_entry->packet_id && p_slot->state != YAMC_INFLIGHT_FREE)
+	{
+		__atomic_store_n(&p_slot->state, YAMC_INFLIGHT_WAIT_PUBCOMP, __ATOMIC_RELEASE);
+		return;
+	}
+
+	// publisher checks yamc_mmap_store_fits() before sending, slot is never left with stale message
+	if (!yamc_mmap_store_fits(p_store, p_entry->topic.len, p_entry->data_len))
+	{
+		YAMC_ERROR_PRINTF("Message with packet id %u is too long to be stored, it won't survive restart\n", p_entry->packet_id);
+		yamc_mmap_store_release(p_store, slot);
+		return;
+	}
+
+	p_slot->state = YAMC_INFLIGHT_FREE;
+
+	memcpy(p_slot->data, p_entry->topic.str, p_entry->topic.len);
+	if (p_entry->data_len) memcpy(p_slot->data + p_entry->topic.len, p_entry->p_data, p_entry->data_len);
+
+	p_slot->seq		  = p_store->next_seq++;
+	p_slot->packet_id = p_entry->packet_id;
+	p_slot->retain	= p_entry->RETAIN;
+	p_slot->topic_len = p_entry->topic.len;
+	p_slot->data_len  = p_entry->data_len;
+
+	__atomic_store_n(&p_slot->state, (uint8_t)p_entry->state, __ATOMIC_RELEASE);
+
+	// mapping survives process crash without any syscall, hint kernel to start writeback now and then
+	if (++p_store->unsynced_cnt >= YAMC_MMAP_STORE_SYNC_EVERY)
+	{
+		msync(p_store->p_map, p_store->map_len, MS_ASYNC);
+		p_store->unsynced_cnt = 0;
+	}
+}
+
+// mark slot free after message was acknowledged
+void yamc_mmap_store_release(yamc_mmap_store_t* const p_store, uint16_t slot)
+{
+	YAMC_ASSERT(p_store != NULL);
+
+	__atomic_store_n(&yamc_mmap_store_slot(p_store, slot)->state, YAMC_INFLIGHT_FREE, __ATOMIC_RELEASE);
+}
+
+// load stored messages into in-flight table
+uint16_t yamc_mmap_store_restore(yamc_mmap_store_t* const p_store, yamc_instance_t* const p_instance)
+{
+	YAMC_ASSERT(p_store != NULL);
+	YAMC_ASSERT(p_instance != NULL);
+
+	if (p_instance->inflight.entries_len != p_store->slots_cnt)
+	{
+		YAMC_ERROR_PRINTF("Store has %u slots, in-flight table has %u entries\n", p_store->slots_cnt, p_instance->inflight.entries_len);
+		return 0;
+	}
+
+	// in-flight table reuses slots in any order, oldest message starts send order
+	bool	 found	  = false;
+	uint16_t oldest   = 0;
+	uint32_t last_seq = 0;
+
+	for (uint16_t i = 0; i < p_store->slots_cnt; i++)
+	{
+		const yamc_mmap_store_slot_t* const p_slot = yamc_mmap_store_slot(p_store, i);
+
+		if (!yamc_mmap_store_slot_valid(p_store, p_slot)) continue;
+
+		// sequence numbers are allowed to wrap around
+		if (!found || (int32_t)(p_slot->seq - yamc_mmap_store_slot(p_store, oldest)->seq) < 0) oldest = i;
+		if (!found || (int32_t)(p_slot->seq - last_seq) > 0) last_seq = p_slot->seq;
+
+		found = true;
+	}
+
+	if (!found) return 0;
+
+	p_store->next_seq = last_seq + 1;
+
+	const uint32_t first_seq	= yamc_mmap_store_slot(p_store, oldest)->seq;
+	uint16_t	   restored_cnt = 0;
+	uint32_t	   prev_dist	= 0;
+
+	// restore in store order, table is short so next message is searched from scratch each time
+	for (bool first = true;; first = false)
+	{
+		bool	 next_found = false;
+		uint16_t idx		= 0;
+		uint32_t next_dist  = 0;
+
+		for (uint16_t i = 0; i < p_store->slots_cnt; i++)
+		{
+			const yamc_mmap_store_slot_t* const p_slot = yamc_mmap_store_slot(p_store, i);
+
+			if (!yamc_mmap_store_slot_valid(p_store, p_slot)) continue;
+
+			const uint32_t dist = p_slot->seq - first_seq;
+
+			if (!first && dist <= prev_dist) continue;
+			if (next_found && dist >= next_dist) continue;
+
+			next_found = true;
+			idx		   = i;
+			next_dist  = dist;
+		}
+
+		if (!next_found) break;
+
+		prev_dist = next_dist;
+
+		const yamc_mmap_store_slot_t* const p_slot = yamc_mmap_store_slot(p_store, idx);
+
+		yamc_inflight_entry_t entry = {.state	 = (yamc_inflight_state_t)p_slot->state,
+									   .packet_id = p_slot->packet_id,
+									   .RETAIN	= p_slot->retain,
+									   .topic	 = {.str = p_slot->data, .len = p_slot->topic_len},
+									   .p_data	= p_slot->data + p_slot->topic_len,
+									   .data_len  = p_slot->data_len};
+
+		if (yamc_inflight_restore(p_instance, idx, &entry) == YAMC_RET_SUCCESS)
+			restored_cnt++;
+		else
+			YAMC_ERROR_PRINTF("Stored message with packet id %u can't be restored\n", p_slot->packet_id);
+	}
+
+	return restored_cnt;
+}
+
+// drop all stored messages
+void yamc_mmap_store_clear(yamc_mmap_store_t* const p_store)
+{
+	YAMC_ASSERT(p_store != NULL);
+
+	for (uint16_t i = 0; i < p_store->slots_cnt; i++) yamc_mmap_store_release(p_store, i);
+}
+
+// write mapping back to file and wait for completion
+void yamc_mmap_store_sync(yamc_mmap_store_t* const p_store)
+{
+	YAMC_ASSERT(p_store != NULL);
+
+	if (msync(p_store->p_map, p_store->map_len, MS_SYNC) < 0) YAMC_ERROR_PRINTF("Error syncing store file: %s\n", strerror(errno));
+
+	p_store->unsynced_cnt = 0;
+}
+
+// sync and unmap store file
+void yamc_mmap_store_close(yamc_mmap_store_t* const p_store)
+{
+	YAMC_ASSERT(p_store != NULL);
+
+	if (p_store->p_map == NULL) return;
+
+	yamc_mmap_store_sync(p_store);
+
+	munmap(p_store->p_map, p_store->map_len);
+	close(p_store->fd);
+
+	p_store->p_map = NULL;
+}
@@ -0,0 +1,72 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_mmap_store.h - Persists unacknowledged QoS>0 PUBLISH packets in memory mapped file on Unix platform
+ *
+ * File holds one fixed size slot per in-flight table entry. Messages are copied to the mapping when sent
+ * and slot is marked free on acknowledgement, page cache writes them back asynchronously.
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#ifndef __YAMC_MMAP_STORE_H__
+#define __YAMC_MMAP_STORE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "yamc.h"
+
+typedef struct
+{
+	int		 fd;			 // store file descriptor
+	uint8_t* p_map;			 // shared file mapping
+	size_t	 map_len;		 // mapping length
+	uint32_t slot_size;		 // slot length: slot header, topic and payload
+	uint32_t slot_data_len;  // maximum topic + payload length
+	uint16_t slots_cnt;		 // number of slots, has to match in-flight table length
+	uint32_t next_seq;		 // sequence number of next stored message, orders slots on restore
+	uint32_t unsynced_cnt;   // messages stored since last msync()
+
+} yamc_mmap_store_t;
+
+/**
+ * \brief open or create store file
+ *
+ * Existing file has to have the same geometry, it is never truncated. New file is created under "<path>.tmp" and
+ * renamed once its header is written.
+ *
+ * \return YAMC_RET_SUCCESS, YAMC_RET_INVALID_DATA if file was created with different parameters,
+ * YAMC_RET_INVALID_STATE on I/O error
+ */
+yamc_retcode_t yamc_mmap_store_open(yamc_mmap_store_t* const p_store, const char* const path, uint16_t slots_cnt, uint32_t slot_data_len);
+
+/// returns true if message with given topic and payload length fits store slot
+bool yamc_mmap_store_fits(const yamc_mmap_store_t* const p_store, uint32_t topic_len, uint32_t data_len);
+
+/// copy in-flight entry to its slot or update delivery state of already stored one
+void yamc_mmap_store_save(yamc_mmap_store_t* const p_store, uint16_t slot, const yamc_inflight_entry_t* const p_entry);
+
+/// mark slot free after message was acknowledged
+void yamc_mmap_store_release(yamc_mmap_store_t* const p_store, uint16_t slot);
+
+/**
+ * \brief load stored messages into in-flight table of freshly initialized instance
+ *
+ * Topic and payload of restored entries point into the mapping, store must stay open while they are in flight.
+ * Send them with yamc_retransmit(p_instance, 0) once connection with clean_session=false is accepted.
+ *
+ * \return number of restored messages
+ */
+uint16_t yamc_mmap_store_restore(yamc_mmap_store_t* const p_store, yamc_instance_t* const p_instance);
+
+/// drop all stored messages, i.e. when connecting with clean session
+void yamc_mmap_store_clear(yamc_mmap_store_t* const p_store);
+
+/// write mapping back to file and wait for completion
+void yamc_mmap_store_sync(yamc_mmap_store_t* const p_store);
+
+/// sync and unmap store file
+void yamc_mmap_store_close(yamc_mmap_store_t* const p_store);
+
+#endif /* __YAMC_MMAP_STORE_H__ */
@@ -0,0 +1,89 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_mpsc.h - Lock-free intrusive multi-producer single-consumer queue
+ *
+ * Any number of threads can push nodes, only one thread pops them. Push is single atomic exchange and never fails,
+ * nodes are embedded in user structures so queue doesn't allocate memory.
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#ifndef __YAMC_MPSC_H__
+#define __YAMC_MPSC_H__
+
+#include <stddef.h>
+
+typedef struct yamc_mpsc_node_s
+{
+	struct yamc_mpsc_node_s* p_next;
+
+} yamc_mpsc_node_t;
+
+typedef struct
+{
+	yamc_mpsc_node_t* p_head;  // last pushed node, producers swap it atomically
+	yamc_mpsc_node_t* p_tail;  // next node to pop, consumer only
+	yamc_mpsc_node_t  stub;	// keeps queue non-empty so push never touches tail
+
+} yamc_mpsc_t;
+
+static inline void yamc_mpsc_init(yamc_mpsc_t* const p_queue)
+{
+	p_queue->stub.p_next = NULL;
+	p_queue->p_head		 = &p_queue->stub;
+	p_queue->p_tail		 = &p_queue->stub;
+}
+
+/// append node, can be called from any thread
+static inline void yamc_mpsc_push(yamc_mpsc_t* const p_queue, yamc_mpsc_node_t* const p_node)
+{
+	__atomic_store_n(&p_node->p_next, NULL, __ATOMIC_RELAXED);
+
+	yamc_mpsc_node_t* const p_prev = __atomic_exchange_n(&p_queue->p_head, p_node, __ATOMIC_ACQ_REL);
+
+	// node is reachable by consumer once linked to previous one
+	__atomic_store_n(&p_prev->p_next, p_node, __ATOMIC_RELEASE);
+}
+
+/**
+ * \brief remove oldest node, consumer thread only
+ *
+ * \return node or NULL if queue is empty or producer is between its exchange and link, node pushed that way shows up shortly
+ */
+static inline yamc_mpsc_node_t* yamc_mpsc_pop(yamc_mpsc_t* const p_queue)
+{
+	yamc_mpsc_node_t* p_tail = p_queue->p_tail;
+	yamc_mpsc_node_t* p_next = __atomic_load_n(&p_tail->p_next, __ATOMIC_ACQUIRE);
+
+	// skip stub
+	if (p_tail == &p_queue->stub)
+	{
+		if (p_next == NULL) return NULL;
+
+		p_queue->p_tail = p_next;
+		p_tail			= p_next;
+		p_next			= __atomic_load_n(&p_next->p_next, __ATOMIC_ACQUIRE);
+	}
+
+	if (p_next != NULL)
+	{
+		p_queue->p_tail = p_next;
+		return p_tail;
+	}
+
+	// push in progress
+	if (p_tail != __atomic_load_n(&p_queue->p_head, __ATOMIC_ACQUIRE)) return NULL;
+
+	// last node can be taken only with another node behind it, put stub back
+	yamc_mpsc_push(p_queue, &p_queue->stub);
+
+	p_next = __atomic_load_n(&p_tail->p_next, __ATOMIC_ACQUIRE);
+	if (p_next == NULL) return NULL;
+
+	p_queue->p_tail = p_next;
+	return p_tail;
+}
+
+#endif /* __YAMC_MPSC_H__ */
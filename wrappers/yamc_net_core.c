@@ -9,9 +9,15 @@
  * 
  */
 
+// pthread_timedjoin_np()
+#define _GNU_SOURCE
+
+#include <errno.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -20,65 +26,116 @@
 #include <string.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <time.h>
 #include <unistd.h>
 
 #include "yamc_net_core.h"
 #include "yamc.h"
 #include "yamc_port.h"
+#include "yamc_read_len.h"
+
+// incoming packet timeout
+#define YAMC_TIMEOUT_MS 30000  // milliseconds
+
+// longest sleep of timeout timer, bounds how late checks notice packet started arriving or PUBLISH sent meanwhile
+#define YAMC_TIMEOUT_CHECK_MAX_MS 5000  // milliseconds
+
+// first timeout check after connect, keepalive interval set by CONNECT is known to the check that follows
+#define YAMC_TIMEOUT_CHECK_FIRST_MS 1000  // milliseconds
 
-// timeout timer settings
-#define YAMC_TIMEOUT_S 30  // seconds
-#define YAMC_TIMEOUT_NS 0  // nanoseconds
+// maximum time server gets to close connection after DISCONNECT
+#define YAMC_WAIT_CLOSE_S 1  // seconds
+
+// maximum time blocked waiting for incoming data before exit flags are checked again
+#define YAMC_WAIT_RX_NS 100000000L  // nanoseconds
 
 //global exit flag. If set all rx threads will exit
 static volatile bool global_exit_now = false;
 
-// timeout timer signal handler
-static void yamc_net_core_timeout_handler(sigval_t sigval)
+// monotonic millisecond timestamp, wraps around
+static uint32_t yamc_net_core_timestamp(void* p_ctx)
 {
-	YAMC_UNUSED_PARAMETER(sigval);
+	YAMC_UNUSED_PARAMETER(p_ctx);
 
-	YAMC_ERROR_PRINTF("Timeout!\n");
-	fflush(stderr);
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
 
-	exit(-1);
+	return (uint32_t)ts.tv_sec * 1000u + (uint32_t)(ts.tv_nsec / 1000000L);
 }
 
-// start/prolong timeout timer wrapper
-static void yamc_net_core_timeout_pat(void* p_ctx)
+static void yamc_net_core_disconnect_handler(void* p_ctx)
 {
 	YAMC_ASSERT(p_ctx != NULL);
-	yamc_net_core_t* const p_net_core = (yamc_net_core_t*)p_ctx;
+	yamc_net_core_t* p_net_core = (yamc_net_core_t*)p_ctx;
+
+	YAMC_ERROR_PRINTF("yamc requested to drop connection!\n");
+
+	// wakes up rx thread blocked in read(), socket is closed by yamc_net_core_disconnect()
+	shutdown(p_net_core->server_socket, SHUT_RDWR);
+	p_net_core->exit_now = true;
+}
+
+// arm one shot timeout timer, thread running timeout handler is started only when timer expires
+static void yamc_net_core_arm_timer(yamc_net_core_t* const p_net_core, uint32_t delay_ms)
+{
+	// zero would disarm timer
+	if (delay_ms == 0) delay_ms = 1;
+	if (delay_ms > YAMC_TIMEOUT_CHECK_MAX_MS) delay_ms = YAMC_TIMEOUT_CHECK_MAX_MS;
 
 	struct itimerspec its;
 	memset(&its, 0, sizeof(struct itimerspec));
-	its.it_value.tv_sec  = YAMC_TIMEOUT_S;
-	its.it_value.tv_nsec = YAMC_TIMEOUT_NS;
+	its.it_value.tv_sec  = delay_ms / 1000;
+	its.it_value.tv_nsec = (delay_ms % 1000) * 1000000L;
 
-	int err_code = timer_settime(p_net_core->timeout_timer, 0, &its, NULL);
-	if (err_code < 0)
+	if (timer_settime(p_net_core->timeout_timer, 0, &its, NULL) < 0)
 	{
 		YAMC_ERROR_PRINTF("Timer error\n");
 		exit(-1);
 	}
 }
 
-// stop timeout timer
-static void yamc_net_core_timeout_stop(void* p_ctx)
+// incoming packet timeout and keepalive check, yamc only records timestamps so sending or parsing doesn't touch the timer
+static void yamc_net_core_timeout_handler(sigval_t sigval)
 {
-	YAMC_ASSERT(p_ctx != NULL);
-	yamc_net_core_t* const p_net_core = (yamc_net_core_t*)p_ctx;
+	yamc_net_core_t* const p_net_core = (yamc_net_core_t*)sigval.sival_ptr;
+	const uint32_t		   now_ms	 = yamc_net_core_timestamp(p_net_core);
 
-	struct itimerspec its;
-	memset(&its, 0, sizeof(struct itimerspec));
+	pthread_mutex_lock(&p_net_core->lock);
 
-	int err_code = timer_settime(p_net_core->timeout_timer, 0, &its, NULL);
-	if (err_code < 0)
+	// timer is deleted only after exit flag is set, so it's not re-armed past that point
+	if (!p_net_core->exit_now)
 	{
-		YAMC_ERROR_PRINTF("Timer error\n");
-		exit(-1);
+		uint32_t next_ms = yamc_rx_timeout_left(&p_net_core->instance, now_ms, YAMC_TIMEOUT_MS);
+
+		if (next_ms == 0)
+		{
+			YAMC_ERROR_PRINTF("Timeout!\n");
+			yamc_net_core_disconnect_handler(p_net_core);
+		}
+		else
+		{
+			// packets written by tx thread count as connection activity too
+			const uint32_t tx_write_ms = __atomic_load_n(&p_net_core->tx_write_ms, __ATOMIC_ACQUIRE);
+			if ((int32_t)(tx_write_ms - p_net_core->instance.keepalive.tx_ms) > 0) p_net_core->instance.keepalive.tx_ms = tx_write_ms;
+
+			pthread_mutex_lock(&p_net_core->tx_lock);
+
+			// PINGREQ is sent only on idle connection, missing PINGRESP calls disconnect handler
+			const uint32_t keepalive_ms = yamc_keepalive_poll(&p_net_core->instance, now_ms);
+			if (keepalive_ms < next_ms) next_ms = keepalive_ms;
+
+			// unacknowledged QoS>0 PUBLISH packets are resent with DUP flag
+			const uint32_t retransmit_ms = yamc_retransmit_poll(&p_net_core->instance, now_ms, YAMC_RETRANSMIT_TIMEOUT_MS);
+			if (retransmit_ms < next_ms) next_ms = retransmit_ms;
+
+			pthread_mutex_unlock(&p_net_core->tx_lock);
+
+			if (!p_net_core->exit_now) yamc_net_core_arm_timer(p_net_core, next_ms);
+		}
 	}
+
+	pthread_mutex_unlock(&p_net_core->lock);
 }
 
 // timeout timer setup
@@ -95,43 +152,100 @@ static void yamc_net_core_setup_timer(yamc_net_core_t* const p_net_core)
 	sev.sigev_signo			  = SIGRTMIN;						// signal type
 	sev.sigev_notify		  = SIGEV_THREAD;					// call timeout handler as if it was starting a new thread
 	sev.sigev_notify_function = yamc_net_core_timeout_handler;  // set timeout handler
+	sev.sigev_value.sival_ptr = p_net_core;
 
-	if ((err_code = timer_create(CLOCK_REALTIME, &sev, &p_net_core->timeout_timer)) < 0)
+	if ((err_code = timer_create(CLOCK_MONOTONIC, &sev, &p_net_core->timeout_timer)) < 0)
 	{
 		YAMC_ERROR_PRINTF("ERROR setting up timeout timer: %s\n", strerror(err_code));
 		exit(-1);
 	}
+
+	// timer is one shot, handler re-arms it for next due check
+	yamc_net_core_arm_timer(p_net_core, YAMC_TIMEOUT_CHECK_FIRST_MS);
 }
 
-// write to socket wrapper
+// write to socket wrapper, caller holds tx lock for the whole packet
 static yamc_retcode_t yamc_net_core_write(void* p_ctx, const uint8_t* const buff, uint32_t len)
 {
 	YAMC_ASSERT(p_ctx != NULL);
 
 	yamc_net_core_t* p_net_core = (yamc_net_core_t*)p_ctx;
 
-	ssize_t n = write(p_net_core->server_socket, buff, len);
-	if (n < 0)
+	yamc_retcode_t ret = YAMC_RET_SUCCESS;
+
+	// write() may send less than requested, continue from first unsent byte
+	uint32_t pos = 0;
+	while (pos < len)
 	{
-		YAMC_ERROR_PRINTF("Error writing to socket:%s\n", strerror(n));
-		return YAMC_RET_INVALID_STATE;
+		ssize_t n = write(p_net_core->server_socket, &buff[pos], len - pos);
+		if (n < 0)
+		{
+			if (errno == EINTR) continue;
+
+			YAMC_ERROR_PRINTF("Error writing to socket:%s\n", strerror(errno));
+			ret = YAMC_RET_INVALID_STATE;
+			break;
+		}
+
+		pos += n;
 	}
-	if (n != len)
+
+	return ret;
+}
+
+// write all segments to socket, iov is modified, caller holds tx lock
+static yamc_retcode_t yamc_net_core_write_iov(yamc_net_core_t* const p_net_core, struct iovec* const iov, const uint32_t iov_len)
+{
+	YAMC_ASSERT(p_net_core != NULL);
+	YAMC_ASSERT(iov != NULL);
+
+	// writev() may send less than requested, continue from first unsent byte
+	uint32_t iov_idx = 0;
+	while (iov_idx < iov_len)
 	{
-		YAMC_ERROR_PRINTF("Warning: Incomplete socket write!");
+		ssize_t n = writev(p_net_core->server_socket, &iov[iov_idx], iov_len - iov_idx);
+		if (n < 0)
+		{
+			if (errno == EINTR) continue;
+
+			YAMC_ERROR_PRINTF("Error writing to socket:%s\n", strerror(errno));
+			return YAMC_RET_INVALID_STATE;
+		}
+
+		while (iov_idx < iov_len && (size_t)n >= iov[iov_idx].iov_len)
+		{
+			n -= iov[iov_idx].iov_len;
+			iov_idx++;
+		}
+
+		if (iov_idx < iov_len)
+		{
+			iov[iov_idx].iov_base = (uint8_t*)iov[iov_idx].iov_base + n;
+			iov[iov_idx].iov_len -= n;
+		}
 	}
+
 	return YAMC_RET_SUCCESS;
 }
 
-static void yamc_net_core_disconnect_handler(void* p_ctx)
+// scatter/gather write to socket wrapper, caller holds tx lock for the whole packet
+static yamc_retcode_t yamc_net_core_writev(void* p_ctx, const yamc_iovec_t* const p_iov, uint32_t iov_len)
 {
 	YAMC_ASSERT(p_ctx != NULL);
+	YAMC_ASSERT(p_iov != NULL);
+	YAMC_ASSERT(iov_len <= YAMC_TX_IOV_MAX);
+
 	yamc_net_core_t* p_net_core = (yamc_net_core_t*)p_ctx;
 
-	YAMC_ERROR_PRINTF("yamc requested to drop connection!\n");
+	struct iovec iov[YAMC_TX_IOV_MAX];
 
-	close(p_net_core->server_socket);
-	p_net_core->exit_now = true;
+	for (uint32_t i = 0; i < iov_len; i++)
+	{
+		iov[i].iov_base = (void*)p_iov[i].p_data;
+		iov[i].iov_len  = p_iov[i].len;
+	}
+
+	return yamc_net_core_write_iov(p_net_core, iov, iov_len);
 }
 
 // receive data from socket thread
@@ -141,33 +255,123 @@ static void* yamc_net_core_rx_thread(void* p_ctx)
 
 	yamc_net_core_t* p_net_core = (yamc_net_core_t*)p_ctx;
 
-	// buffer for incoming data
-	uint8_t rx_buff[10];
+	// buffer for incoming data, whatever is available is parsed in one go
+	uint8_t rx_buff[YAMC_NET_READ_BUFF_LEN];
+
+	yamc_read_len_t read_len;
+	yamc_read_len_init(&read_len);
 
 	// how many bytes were received in single read operation or read() error code
 	int rx_bytes = 0;
 
 	do
 	{
-		// zero rx buffer
-		memset(rx_buff, 0, sizeof(rx_buff));
-
-		rx_bytes = read(p_net_core->server_socket, rx_buff, sizeof(rx_buff));
+		rx_bytes = read(p_net_core->server_socket, rx_buff, read_len.len);
 
 		// there was error code thrown by read()
 		if (rx_bytes < 0)
 		{
-			YAMC_ERROR_PRINTF("TCP read() error: %s\n", strerror(rx_bytes));
+			YAMC_ERROR_PRINTF("TCP read() error: %s\n", strerror(errno));
 			p_net_core->exit_now = true;
 			pthread_exit(&rx_bytes);
 		}
 
-		// process buffer here
-		if (rx_bytes > 0) yamc_parse_buff(&p_net_core->instance, rx_buff, rx_bytes);
+		// process buffer here, wake up publishers waiting for acknowledgements
+		if (rx_bytes > 0)
+		{
+			yamc_read_len_update(&read_len, rx_bytes);
+
+			// parser sends acknowledgements, packet handlers may send too
+			pthread_mutex_lock(&p_net_core->lock);
+			pthread_mutex_lock(&p_net_core->tx_lock);
+			yamc_parse_buff(&p_net_core->instance, rx_buff, rx_bytes);
+
+			// acknowledgements made room in in-flight window
+			if (p_net_core->p_spool != NULL && !p_net_core->exit_now) yamc_spool_drain(p_net_core->p_spool, &p_net_core->instance);
+
+			pthread_mutex_unlock(&p_net_core->tx_lock);
+			pthread_cond_broadcast(&p_net_core->rx_done);
+			pthread_mutex_unlock(&p_net_core->lock);
+		}
 
 	} while (rx_bytes > 0);
 
+	pthread_mutex_lock(&p_net_core->lock);
 	p_net_core->exit_now = true;
+	pthread_cond_broadcast(&p_net_core->rx_done);
+	pthread_mutex_unlock(&p_net_core->lock);
+
+	return NULL;
+}
+
+// return tx slot bit to producers
+static void yamc_net_core_tx_slot_free(yamc_net_core_t* const p_net_core, const yamc_net_core_tx_slot_t* const p_slot)
+{
+	const uint32_t idx = p_slot - p_net_core->tx_slots;
+
+	__atomic_fetch_and(&p_net_core->tx_slot_used[idx / 32], ~(1u << (idx % 32)), __ATOMIC_RELEASE);
+}
+
+// write queued packets in batches, only tx lock is taken so yamc instance stays available to other threads meanwhile
+static void* yamc_net_core_tx_thread(void* p_ctx)
+{
+	YAMC_ASSERT(p_ctx != NULL);
+
+	yamc_net_core_t* p_net_core = (yamc_net_core_t*)p_ctx;
+
+	yamc_net_core_tx_slot_t* batch[YAMC_NET_TX_BATCH_MAX];
+	struct iovec			 iov[YAMC_NET_TX_BATCH_MAX];
+
+	do
+	{
+		while (sem_wait(&p_net_core->tx_wake) < 0 && errno == EINTR) continue;
+
+		uint32_t pending = __atomic_load_n(&p_net_core->tx_pending, __ATOMIC_ACQUIRE);
+
+		while (pending > 0)
+		{
+			// only packets already counted are taken, counter never goes below zero
+			uint32_t cnt = 0;
+			while (cnt < pending && cnt < YAMC_NET_TX_BATCH_MAX)
+			{
+				yamc_mpsc_node_t* const p_node = yamc_mpsc_pop(&p_net_core->tx_queue);
+				if (p_node == NULL)
+				{
+					// producer is linking its packet, don't wait for it if there's something to write
+					if (cnt > 0) break;
+
+					sched_yield();
+					continue;
+				}
+
+				batch[cnt]			= (yamc_net_core_tx_slot_t*)p_node;
+				iov[cnt].iov_base = batch[cnt]->data;
+				iov[cnt].iov_len  = batch[cnt]->len;
+				cnt++;
+			}
+
+			// packets queued after connection was lost are dropped
+			if (!p_net_core->exit_now)
+			{
+				pthread_mutex_lock(&p_net_core->tx_lock);
+				const yamc_retcode_t ret = yamc_net_core_write_iov(p_net_core, iov, cnt);
+				pthread_mutex_unlock(&p_net_core->tx_lock);
+
+				if (ret == YAMC_RET_SUCCESS)
+					__atomic_store_n(&p_net_core->tx_write_ms, yamc_net_core_timestamp(p_net_core), __ATOMIC_RELEASE);
+				else
+					yamc_net_core_disconnect_handler(p_net_core);
+			}
+
+			for (uint32_t i = 0; i < cnt; i++) yamc_net_core_tx_slot_free(p_net_core, batch[i]);
+
+			// waiters in yamc_net_core_wait_inflight() wake up periodically, so signal doesn't need the lock
+			pending = __atomic_sub_fetch(&p_net_core->tx_pending, cnt, __ATOMIC_ACQ_REL);
+			if (pending == 0) pthread_cond_broadcast(&p_net_core->rx_done);
+		}
+
+	} while (!__atomic_load_n(&p_net_core->tx_exit, __ATOMIC_ACQUIRE));
+
 	return NULL;
 }
 
@@ -237,15 +441,31 @@ static void yamc_net_core_setup_sigint_handler(void)
 	sigaction(SIGTERM, &sigint_action, NULL);
 }
 
+// release spool space of acknowledged message before user handler sees it
+static void yamc_net_core_spool_pub_complete(yamc_instance_t* const p_instance, uint16_t packet_id, void* p_msg_ctx, void* p_ctx)
+{
+	YAMC_ASSERT(p_ctx != NULL);
+	yamc_net_core_t* const p_net_core = (yamc_net_core_t*)p_ctx;
+
+	yamc_spool_complete(p_net_core->p_spool, &p_msg_ctx);
+
+	if (p_net_core->pub_complete != NULL) p_net_core->pub_complete(p_instance, packet_id, p_msg_ctx, p_ctx);
+}
+
 void yamc_net_core_connect(yamc_net_core_t* const p_net_core, const char* const hostname, const int port, yamc_pkt_handler_t pkt_handler)
 {
 	YAMC_ASSERT(p_net_core != NULL);
 	YAMC_ASSERT(pkt_handler != NULL);
 
+	// spool outlives connection, its unacknowledged messages are published again once new connection is accepted
+	yamc_spool_t* const				  p_spool	  = p_net_core->p_spool;
+	const yamc_pub_complete_handler_t pub_complete = p_net_core->pub_complete;
+
 	memset(p_net_core, 0, sizeof(yamc_net_core_t));
 
-	// setup timeout timer
-	yamc_net_core_setup_timer(p_net_core);
+	pthread_mutex_init(&p_net_core->lock, NULL);
+	pthread_mutex_init(&p_net_core->tx_lock, NULL);
+	pthread_cond_init(&p_net_core->rx_done, NULL);
 
 	// setup socket and connect to server
 	yamc_net_core_setup_socket(p_net_core, hostname, port);
@@ -255,15 +475,293 @@ void yamc_net_core_connect(yamc_net_core_t* const p_net_core, const char* const
 
 	yamc_handler_cfg_t handler_cfg = {.disconnect	= yamc_net_core_disconnect_handler,
 									  .write		 = yamc_net_core_write,
-									  .timeout_pat   = yamc_net_core_timeout_pat,
-									  .timeout_stop  = yamc_net_core_timeout_stop,
+									  .writev		 = yamc_net_core_writev,
 									  .pkt_handler   = pkt_handler,
+									  .timestamp	 = yamc_net_core_timestamp,
 									  .p_handler_ctx = p_net_core};
 
-	yamc_init(&p_net_core->instance, &handler_cfg);
+	yamc_buff_cfg_t buff_cfg = {.p_rx_buff		 = p_net_core->rx_pkt_buff,
+								.rx_buff_len	 = sizeof(p_net_core->rx_pkt_buff),
+								.p_tx_buff		 = p_net_core->tx_pkt_buff,
+								.tx_buff_len	 = sizeof(p_net_core->tx_pkt_buff),
+								.p_inflight		 = p_net_core->inflight,
+								.inflight_len	 = YAMC_INFLIGHT_WINDOW,
+								.p_pkt_id_bitmap = p_net_core->pkt_id_bitmap,
+								.pkt_id_window	 = YAMC_PKT_ID_WINDOW};
+
+	yamc_init(&p_net_core->instance, &handler_cfg, &buff_cfg);
+
+	if (p_spool != NULL)
+	{
+		p_net_core->p_spool						   = p_spool;
+		p_net_core->pub_complete				   = pub_complete;
+		p_net_core->instance.handlers.pub_complete = yamc_net_core_spool_pub_complete;
+
+		yamc_spool_requeue(p_spool);
+	}
+
+	// setup timeout timer
+	yamc_net_core_setup_timer(p_net_core);
+
+	// create threads
+	yamc_mpsc_init(&p_net_core->tx_queue);
+	sem_init(&p_net_core->tx_wake, 0, 0);
+	p_net_core->tx_write_ms = yamc_net_core_timestamp(p_net_core);
 
-	// create thread
 	pthread_create(&p_net_core->rx_tid, NULL, yamc_net_core_rx_thread, p_net_core);
+	pthread_create(&p_net_core->tx_tid, NULL, yamc_net_core_tx_thread, p_net_core);
+}
+
+// persist sent QoS>0 PUBLISH
+static void yamc_net_core_inflight_save(void* p_ctx, uint16_t slot, const yamc_inflight_entry_t* const p_entry)
+{
+	YAMC_ASSERT(p_ctx != NULL);
+	yamc_net_core_t* const p_net_core = (yamc_net_core_t*)p_ctx;
+
+	yamc_mmap_store_save(p_net_core->p_store, slot, p_entry);
+}
+
+// drop acknowledged QoS>0 PUBLISH from store
+static void yamc_net_core_inflight_release(void* p_ctx, uint16_t slot)
+{
+	YAMC_ASSERT(p_ctx != NULL);
+	yamc_net_core_t* const p_net_core = (yamc_net_core_t*)p_ctx;
+
+	yamc_mmap_store_release(p_net_core->p_store, slot);
+}
+
+// persist unacknowledged messages in store, restore: load messages left by previous run, otherwise they are dropped
+// returns number of restored messages, call yamc_retransmit(p_instance, 0) after connection is accepted to resend them
+uint16_t yamc_net_core_attach_store(yamc_net_core_t* const p_net_core, yamc_mmap_store_t* const p_store, bool restore)
+{
+	YAMC_ASSERT(p_net_core != NULL);
+	YAMC_ASSERT(p_store != NULL);
+
+	uint16_t restored_cnt = 0;
+
+	pthread_mutex_lock(&p_net_core->lock);
+
+	if (restore)
+		restored_cnt = yamc_mmap_store_restore(p_store, &p_net_core->instance);
+	else
+		yamc_mmap_store_clear(p_store);
+
+	p_net_core->p_store								= p_store;
+	p_net_core->instance.handlers.inflight_save	= yamc_net_core_inflight_save;
+	p_net_core->instance.handlers.inflight_release = yamc_net_core_inflight_release;
+
+	pthread_mutex_unlock(&p_net_core->lock);
+
+	return restored_cnt;
+}
+
+// queue messages in spool instead of blocking or failing, call after connection is accepted and user handlers are set
+// messages left unacknowledged by previous connection are published again, spool stays attached over reconnection
+void yamc_net_core_attach_spool(yamc_net_core_t* const p_net_core, yamc_spool_t* const p_spool)
+{
+	YAMC_ASSERT(p_net_core != NULL);
+	YAMC_ASSERT(p_spool != NULL);
+
+	pthread_mutex_lock(&p_net_core->lock);
+
+	p_net_core->p_spool							= p_spool;
+	p_net_core->pub_complete					= p_net_core->instance.handlers.pub_complete;
+	p_net_core->instance.handlers.pub_complete = yamc_net_core_spool_pub_complete;
+
+	yamc_spool_requeue(p_spool);
+
+	pthread_mutex_lock(&p_net_core->tx_lock);
+	yamc_spool_drain(p_spool, &p_net_core->instance);
+	pthread_mutex_unlock(&p_net_core->tx_lock);
+
+	pthread_mutex_unlock(&p_net_core->lock);
+}
+
+// take exclusive access to yamc instance, rx thread holds the lock while packet handlers run
+// tx thread is held off too, so packets sent meanwhile aren't interleaved with queued ones
+void yamc_net_core_lock(yamc_net_core_t* const p_net_core)
+{
+	YAMC_ASSERT(p_net_core != NULL);
+
+	pthread_mutex_lock(&p_net_core->lock);
+	pthread_mutex_lock(&p_net_core->tx_lock);
+}
+
+void yamc_net_core_unlock(yamc_net_core_t* const p_net_core)
+{
+	YAMC_ASSERT(p_net_core != NULL);
+
+	pthread_mutex_unlock(&p_net_core->tx_lock);
+	pthread_mutex_unlock(&p_net_core->lock);
+}
+
+// wait for rx thread to parse incoming data, has to be called with lock held
+static void yamc_net_core_wait_rx(yamc_net_core_t* const p_net_core)
+{
+	YAMC_ASSERT(p_net_core != NULL);
+
+	// wake up periodically, Ctrl+C handler can't signal condition variable
+	struct timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+
+	deadline.tv_nsec += YAMC_WAIT_RX_NS;
+	if (deadline.tv_nsec >= 1000000000L)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000L;
+	}
+
+	pthread_cond_timedwait(&p_net_core->rx_done, &p_net_core->lock, &deadline);
+}
+
+// publish message with tx lock held so tx thread can't write between parts of the packet, caller holds lock
+static yamc_retcode_t yamc_net_core_publish_locked(yamc_net_core_t* const p_net_core, const yamc_publish_data_t* const p_data)
+{
+	pthread_mutex_lock(&p_net_core->tx_lock);
+	const yamc_retcode_t ret = yamc_publish(&p_net_core->instance, p_data);
+	pthread_mutex_unlock(&p_net_core->tx_lock);
+
+	return ret;
+}
+
+// publish message, blocks while in-flight window is full
+yamc_retcode_t yamc_net_core_publish(yamc_net_core_t* const p_net_core, const yamc_publish_data_t* const p_data)
+{
+	YAMC_ASSERT(p_net_core != NULL);
+	YAMC_ASSERT(p_data != NULL);
+
+	pthread_mutex_lock(&p_net_core->lock);
+
+	yamc_retcode_t ret;
+
+	// message that can't be persisted is refused rather than silently losing its delivery guarantee over restart
+	if (p_net_core->p_store != NULL && p_data->QOS != YAMC_QOS_LVL0 &&
+		!yamc_mmap_store_fits(p_net_core->p_store, p_data->topic.len, p_data->data_len))
+	{
+		pthread_mutex_unlock(&p_net_core->lock);
+
+		YAMC_ERROR_PRINTF("Message is too long to be stored: %u bytes\n", p_data->topic.len + p_data->data_len);
+		return YAMC_RET_INVALID_DATA;
+	}
+
+	// spooled messages go first to keep order, connection loss or full window doesn't block publisher
+	if (p_net_core->p_spool != NULL)
+	{
+		if (p_net_core->exit_now || !yamc_spool_is_empty(p_net_core->p_spool))
+			ret = YAMC_RET_WOULD_BLOCK;
+		else
+			ret = yamc_net_core_publish_locked(p_net_core, p_data);
+
+		if (ret != YAMC_RET_SUCCESS) ret = yamc_spool_put(p_net_core->p_spool, p_data);
+
+		pthread_mutex_unlock(&p_net_core->lock);
+
+		return ret;
+	}
+
+	ret = yamc_net_core_publish_locked(p_net_core, p_data);
+
+	while (ret == YAMC_RET_WOULD_BLOCK && !yamc_net_core_should_exit(p_net_core))
+	{
+		yamc_net_core_wait_rx(p_net_core);
+		ret = yamc_net_core_publish_locked(p_net_core, p_data);
+	}
+
+	pthread_mutex_unlock(&p_net_core->lock);
+
+	return ret;
+}
+
+// claim free tx slot, returns NULL if all are queued
+static yamc_net_core_tx_slot_t* yamc_net_core_tx_slot_alloc(yamc_net_core_t* const p_net_core)
+{
+	for (uint32_t word = 0; word < YAMC_NET_TX_SLOTS / 32; word++)
+	{
+		uint32_t used = __atomic_load_n(&p_net_core->tx_slot_used[word], __ATOMIC_RELAXED);
+
+		// another producer may take the same bit first, try next free one
+		while (used != UINT32_MAX)
+		{
+			const uint32_t bit = __builtin_ctz(~used);
+
+			used = __atomic_fetch_or(&p_net_core->tx_slot_used[word], 1u << bit, __ATOMIC_ACQUIRE);
+			if (!(used & (1u << bit))) return &p_net_core->tx_slots[word * 32 + bit];
+		}
+	}
+
+	return NULL;
+}
+
+// thread safe QoS0 publish without yamc instance lock, message is encoded by caller to preallocated slot and queued for tx thread
+// QoS>0 messages need packet ids and in-flight tracking owned by yamc instance, use yamc_net_core_publish() for them
+yamc_retcode_t yamc_net_core_publish_async(yamc_net_core_t* const p_net_core, const yamc_publish_data_t* const p_data)
+{
+	YAMC_ASSERT(p_net_core != NULL);
+	YAMC_ASSERT(p_data != NULL);
+
+	if (p_data->QOS != YAMC_QOS_LVL0) return YAMC_RET_INVALID_DATA;
+
+	const uint32_t len = yamc_publish_encoded_len(p_data);
+	if (len == 0 || len > YAMC_NET_TX_SLOT_LEN) return YAMC_RET_INVALID_DATA;
+
+	// disconnect waits for producers that got past closed flag before it stops tx thread
+	__atomic_fetch_add(&p_net_core->tx_users, 1, __ATOMIC_SEQ_CST);
+
+	yamc_retcode_t ret = YAMC_RET_SUCCESS;
+
+	if (__atomic_load_n(&p_net_core->tx_closed, __ATOMIC_SEQ_CST) || yamc_net_core_should_exit(p_net_core))
+	{
+		ret = YAMC_RET_INVALID_STATE;
+	}
+	else
+	{
+		yamc_net_core_tx_slot_t* const p_slot = yamc_net_core_tx_slot_alloc(p_net_core);
+
+		if (p_slot == NULL)
+		{
+			ret = YAMC_RET_WOULD_BLOCK;
+		}
+		else
+		{
+			p_slot->len = yamc_publish_encode(p_data, 0, p_slot->data, len);
+
+			yamc_mpsc_push(&p_net_core->tx_queue, &p_slot->node);
+
+			// tx thread drains queue until counter drops to zero, wake it up only when it might be waiting
+			if (__atomic_fetch_add(&p_net_core->tx_pending, 1, __ATOMIC_ACQ_REL) == 0) sem_post(&p_net_core->tx_wake);
+		}
+	}
+
+	__atomic_fetch_sub(&p_net_core->tx_users, 1, __ATOMIC_SEQ_CST);
+
+	return ret;
+}
+
+// wait until connection is closed or exit is requested, keepalive is handled by timer thread meanwhile
+void yamc_net_core_wait_exit(yamc_net_core_t* const p_net_core)
+{
+	YAMC_ASSERT(p_net_core != NULL);
+
+	pthread_mutex_lock(&p_net_core->lock);
+
+	while (!yamc_net_core_should_exit(p_net_core)) yamc_net_core_wait_rx(p_net_core);
+
+	pthread_mutex_unlock(&p_net_core->lock);
+}
+
+// wait until all QoS>0 messages are acknowledged and queued messages are written or connection is closed
+void yamc_net_core_wait_inflight(yamc_net_core_t* const p_net_core)
+{
+	YAMC_ASSERT(p_net_core != NULL);
+
+	pthread_mutex_lock(&p_net_core->lock);
+
+	while ((yamc_inflight_pending(&p_net_core->instance) > 0 || (p_net_core->p_spool != NULL && !yamc_spool_is_empty(p_net_core->p_spool)) ||
+			__atomic_load_n(&p_net_core->tx_pending, __ATOMIC_ACQUIRE) > 0) &&
+		   !yamc_net_core_should_exit(p_net_core))
+		yamc_net_core_wait_rx(p_net_core);
+
+	pthread_mutex_unlock(&p_net_core->lock);
 }
 
 bool yamc_net_core_should_exit(yamc_net_core_t* const p_net_core)
@@ -277,16 +775,47 @@ void yamc_net_core_disconnect(yamc_net_core_t* const p_net_core)
 {
 	YAMC_ASSERT(p_net_core != NULL);
 
-	//signal rx thread to exit
+	// no new packets are queued once producers already inside yamc_net_core_publish_async() leave
+	__atomic_store_n(&p_net_core->tx_closed, true, __ATOMIC_SEQ_CST);
+	while (__atomic_load_n(&p_net_core->tx_users, __ATOMIC_SEQ_CST) > 0) sched_yield();
+
+	// queued packets are written before DISCONNECT
+	__atomic_store_n(&p_net_core->tx_exit, true, __ATOMIC_RELEASE);
+	sem_post(&p_net_core->tx_wake);
+	pthread_join(p_net_core->tx_tid, NULL);
+
+	sem_destroy(&p_net_core->tx_wake);
+
+	yamc_retcode_t ret = YAMC_RET_SUCCESS;
+
+	// send MQTT disconnect packet unless connection is already gone, signal rx thread to exit
+	pthread_mutex_lock(&p_net_core->lock);
+	pthread_mutex_lock(&p_net_core->tx_lock);
+	if (!p_net_core->exit_now) ret = yamc_disconnect(&p_net_core->instance);
+	pthread_mutex_unlock(&p_net_core->tx_lock);
 	p_net_core->exit_now = true;
+	pthread_mutex_unlock(&p_net_core->lock);
 
-	// send MQTT disconnect packet
-	yamc_retcode_t ret = yamc_disconnect(&p_net_core->instance);
 	if (ret != YAMC_RET_SUCCESS)
 	{
 		printf("Error sending disconnect packet: %u\n", ret);
 		exit(-1);
 	}
 
+	timer_delete(p_net_core->timeout_timer);
+
+	// server closes connection after DISCONNECT, whatever it sends meanwhile is read so close() doesn't reset connection
+	shutdown(p_net_core->server_socket, SHUT_WR);
+
+	struct timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += YAMC_WAIT_CLOSE_S;
+
+	if (pthread_timedjoin_np(p_net_core->rx_tid, NULL, &deadline) != 0)
+	{
+		shutdown(p_net_core->server_socket, SHUT_RD);
+		pthread_join(p_net_core->rx_tid, NULL);
+	}
+
 	close(p_net_core->server_socket);
 }
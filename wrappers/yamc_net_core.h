@@ -10,23 +10,72 @@
  */
 
 #include <pthread.h>
+#include <semaphore.h>
 #include <time.h>
 #include "yamc.h"
+#include "yamc_mmap_store.h"
+#include "yamc_mpsc.h"
+#include "yamc_spool.h"
+
+// PUBLISH encoded by producer thread, written by tx thread
+typedef struct
+{
+	yamc_mpsc_node_t node;  // has to stay first
+	uint32_t len;
+	uint8_t data[YAMC_NET_TX_SLOT_LEN];
+
+} yamc_net_core_tx_slot_t;
 
 typedef struct 
 {
 	yamc_instance_t instance;
+	uint8_t rx_pkt_buff[YAMC_RX_PKT_MAX_LEN];
+	uint8_t tx_pkt_buff[YAMC_TX_PKT_MAX_LEN];
+	uint32_t pkt_id_bitmap[YAMC_PKT_ID_BITMAP_WORDS(YAMC_PKT_ID_WINDOW)];
+	yamc_inflight_entry_t inflight[YAMC_INFLIGHT_WINDOW];
 	volatile uint8_t exit_now;
 	int server_socket;
 	pthread_t rx_tid;
 	timer_t timeout_timer;
+	pthread_mutex_t lock;		// serializes yamc instance access between rx thread and application
+	pthread_cond_t rx_done;		// signalled after each chunk of incoming data is parsed and after tx queue is written
+	pthread_t tx_tid;
+	pthread_mutex_t tx_lock;	// held for each packet sent by yamc instance and each tx thread write, taken after lock
+	yamc_mpsc_t tx_queue;		// packets encoded by yamc_net_core_publish_async(), written by tx thread
+	uint32_t tx_pending;		// number of queued packets, tx thread is woken up when it becomes non-zero
+	sem_t tx_wake;
+	uint8_t tx_exit;			// tx thread exits once queue is empty
+	uint8_t tx_closed;			// set by disconnect, yamc_net_core_publish_async() refuses new packets
+	uint32_t tx_users;			// yamc_net_core_publish_async() calls in progress, disconnect waits for them to leave
+	uint32_t tx_write_ms;		// timestamp of last tx thread write, folded into keepalive by timeout handler
+	uint32_t tx_slot_used[YAMC_NET_TX_SLOTS / 32];	// bit set for each queued slot
+	yamc_net_core_tx_slot_t tx_slots[YAMC_NET_TX_SLOTS];
+	yamc_mmap_store_t* p_store;	// (optional) persistent store for unacknowledged QoS>0 messages
+	yamc_spool_t* p_spool;		// (optional) queue for messages published while disconnected or in-flight window is full
+	yamc_pub_complete_handler_t pub_complete;	// user publish complete handler, called after spool is updated
 
 
 } yamc_net_core_t;
 
+// p_net_core has to be zeroed before first connection, i.e. static, attached spool is kept when connecting again
 void yamc_net_core_connect(yamc_net_core_t* const p_net_core, const char* const hostname, const int port, yamc_pkt_handler_t pkt_handler);
  
 bool yamc_net_core_should_exit(yamc_net_core_t* const p_net_core);
 
 void yamc_net_core_disconnect(yamc_net_core_t* const p_net_core);
 
+void yamc_net_core_lock(yamc_net_core_t* const p_net_core);
+
+void yamc_net_core_unlock(yamc_net_core_t* const p_net_core);
+
+yamc_retcode_t yamc_net_core_publish(yamc_net_core_t* const p_net_core, const yamc_publish_data_t* const p_data);
+
+yamc_retcode_t yamc_net_core_publish_async(yamc_net_core_t* const p_net_core, const yamc_publish_data_t* const p_data);
+
+void yamc_net_core_wait_inflight(yamc_net_core_t* const p_net_core);
+
+void yamc_net_core_wait_exit(yamc_net_core_t* const p_net_core);
+
+uint16_t yamc_net_core_attach_store(yamc_net_core_t* const p_net_core, yamc_mmap_store_t* const p_store, bool restore);
+
+void yamc_net_core_attach_spool(yamc_net_core_t* const p_net_core, yamc_spool_t* const p_spool);
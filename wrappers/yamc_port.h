@@ -17,9 +17,96 @@
  *
  *************************/
 
-/// Payload buffer length, any payload longer than this will not be processed
+/// Receive buffer length used by wrappers, split packets longer than this are grown, streamed or skipped
 #define YAMC_RX_PKT_MAX_LEN 1024
 
+/// Transmit buffer length used by wrappers, packets shorter than this are sent with single write
+#define YAMC_TX_PKT_MAX_LEN 1024
+
+/// Read buffer length used by wrappers, incoming data is passed to yamc_parse_buff() in chunks up to this long
+#define YAMC_NET_READ_BUFF_LEN (64 * 1024)
+
+/// Wrappers start with reads this long and grow them up to YAMC_NET_READ_BUFF_LEN while reads fill the whole request.
+/// Set to YAMC_NET_READ_BUFF_LEN to always request full buffer.
+#define YAMC_NET_READ_MIN_LEN 2048
+
+/// Read request length is halved after this many consecutive reads shorter than quarter of request
+#define YAMC_NET_READ_SHRINK_CNT 16
+
+/// Maximum number of queued packets net core tx thread writes with single writev() call
+#define YAMC_NET_TX_BATCH_MAX 64
+
+/// Number of preallocated net core tx slots, multiple of 32. yamc_net_core_publish_async() returns YAMC_RET_WOULD_BLOCK when all are queued
+#define YAMC_NET_TX_SLOTS 128
+
+/// Longest encoded PUBLISH packet yamc_net_core_publish_async() can queue
+#define YAMC_NET_TX_SLOT_LEN 256
+
+/// Maximum number of segments passed to scatter/gather write handler in one call
+#define YAMC_TX_IOV_MAX 8
+
+/// With scatter/gather write handler packet fields at least this long are sent in place instead of being copied to tx buffer
+#define YAMC_TX_IOV_REF_MIN_LEN 64
+
+/// Number of protocol acknowledgements collected during single yamc_parse_buff() call before they are written
+#define YAMC_ACK_QUEUE_LEN 16
+
+/// Incoming QoS2 PUBLISH packet ids are tracked between PUBREC and PUBREL for duplicate suppression
+/// Table size has to be power of 2, one slot is always kept empty
+#define YAMC_QOS2_RX_IDS_LEN 32
+
+/// Connection is considered dead if PINGRESP doesn't arrive within this time, keepalive interval is used if shorter
+#define YAMC_PINGRESP_TIMEOUT_MS 10000
+
+/// Wrappers resend QoS>0 PUBLISH packets not acknowledged within this time
+#define YAMC_RETRANSMIT_TIMEOUT_MS 20000
+
+/// Maximum number of unacknowledged QoS>0 PUBLISH packets sent by wrappers
+#define YAMC_INFLIGHT_WINDOW 256
+
+/// Packet ids used by wrappers are allocated from range 1..YAMC_PKT_ID_WINDOW, ids waiting for acknowledgement are skipped
+#define YAMC_PKT_ID_WINDOW 1024
+
+/// Maximum topic + payload length of QoS>0 PUBLISH packet persisted by memory mapped store
+#define YAMC_MMAP_STORE_SLOT_LEN 1024
+
+/// Memory mapped store asks kernel to start writeback after this many stored messages
+#define YAMC_MMAP_STORE_SYNC_EVERY 256
+
+/// Offline spool starts new segment file once current one is at least this long
+#define YAMC_SPOOL_SEGMENT_LEN (4 * 1024 * 1024)
+
+/// Read buffer shared by all connections of epoll reactor
+#define YAMC_REACTOR_RX_BUFF_LEN (64 * 1024)
+
+/// Maximum amount of data reactor keeps for single connection while socket is not writable
+#define YAMC_REACTOR_OUT_MAX_LEN (1024 * 1024)
+
+/// Number of socket events reactor handles per epoll_wait() call
+#define YAMC_REACTOR_EVENTS_MAX 256
+
+/// Resolution of reactor timers
+#define YAMC_REACTOR_TICK_MS 100
+
+/// Reactor closes connection if server doesn't respond within this time
+#define YAMC_REACTOR_TIMEOUT_MS 30000
+
+/// Timer wheel has this many levels of 2^YAMC_TIMER_WHEEL_BITS slots, longest timeout is 2^(levels*bits) ticks
+#define YAMC_TIMER_WHEEL_LEVELS 4
+#define YAMC_TIMER_WHEEL_BITS 6
+
+/// Reactor uses io_uring when kernel supports it, set to 0 to always use epoll
+#define YAMC_REACTOR_URING 1
+
+/// Submission queue size of reactor io_uring
+#define YAMC_REACTOR_URING_ENTRIES 1024
+
+/// Number of receive buffers kernel picks from, shared by all connections of reactor. Has to be power of 2.
+#define YAMC_REACTOR_URING_BUF_CNT 256
+
+/// Length of each io_uring receive buffer
+#define YAMC_REACTOR_URING_BUF_LEN (16 * 1024)
+
 /*************************
  *
  * Debug macros
@@ -47,6 +134,35 @@
 #include <assert.h>
 #define YAMC_ASSERT(...) assert(__VA_ARGS__)
 
+/**************************
+ *
+ * Bit manipulation
+ *
+ **************************/
+
+/// count trailing zero bits of non-zero 32 bit value, portable fallback is used when not defined
+#if defined(__GNUC__)
+#define YAMC_CTZ32(x) ((uint32_t)__builtin_ctz(x))
+#endif
+
+/**************************
+ *
+ * Memory layout
+ *
+ **************************/
+
+/// cache line size of target CPU
+#define YAMC_CACHE_LINE_LEN 64
+
+/// starts struct member on new cache line, define as empty to pack yamc_instance_t tightly (i.e. on small MCUs)
+#ifndef YAMC_CACHE_ALIGNED
+#if defined(__GNUC__)
+#define YAMC_CACHE_ALIGNED __attribute__((aligned(YAMC_CACHE_LINE_LEN)))
+#else
+#define YAMC_CACHE_ALIGNED
+#endif
+#endif
+
 /**************************
  *
  * Unused parameter macro
@@ -0,0 +1,920 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_reactor.c - Drives many yamc instances from single io_uring or epoll loop on Linux
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include <errno.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "yamc_reactor.h"
+#include "yamc.h"
+#include "yamc_port.h"
+#include "yamc_log.h"
+
+#if YAMC_REACTOR_URING
+// io_uring request type, kept in low bits of user_data next to connection pointer. Zero user_data marks cancel requests.
+#define YAMC_REACTOR_OP_CONNECT 1u
+#define YAMC_REACTOR_OP_RECV 2u
+#define YAMC_REACTOR_OP_SEND 3u
+#define YAMC_REACTOR_OP_MASK 3u
+#endif
+
+// monotonic millisecond timestamp, wraps around
+static uint32_t yamc_reactor_now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint32_t)ts.tv_sec * 1000u + (uint32_t)(ts.tv_nsec / 1000000L);
+}
+
+// put connection on pending list: io_uring output to submit or close requested outside of its dispatch
+static void yamc_reactor_pending_queue(yamc_reactor_conn_t* const p_conn)
+{
+	YAMC_ASSERT(p_conn != NULL);
+
+	if (p_conn->pending) return;
+
+	p_conn->pending				 = true;
+	p_conn->p_pending_next		 = p_conn->p_reactor->p_pending;
+	p_conn->p_reactor->p_pending = p_conn;
+}
+
+// mark connection for closing, it's closed once reactor is done with it
+static void yamc_reactor_set_closing(yamc_reactor_conn_t* const p_conn)
+{
+	YAMC_ASSERT(p_conn != NULL);
+
+	p_conn->closing = true;
+
+	// dispatch closes connection after handlers return
+	if (!p_conn->busy) yamc_reactor_pending_queue(p_conn);
+}
+
+// register events connection is interested in, epoll is updated only when they change
+static void yamc_reactor_update_events(yamc_reactor_conn_t* const p_conn)
+{
+	YAMC_ASSERT(p_conn != NULL);
+
+	const uint32_t events = (p_conn->connecting || p_conn->out_len > 0) ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+
+	if (events == p_conn->events) return;
+
+	struct epoll_event ev = {.events = events, .data.ptr = p_conn};
+
+	if (epoll_ctl(p_conn->p_reactor->epoll_fd, EPOLL_CTL_MOD, p_conn->fd, &ev) < 0)
+	{
+		YAMC_ERROR_PRINTF("epoll_ctl() error: %s\n", strerror(errno));
+		yamc_reactor_set_closing(p_conn);
+		return;
+	}
+
+	p_conn->events = events;
+}
+
+// keep data socket didn't accept, sent when it becomes writable
+static yamc_retcode_t yamc_reactor_out_append(yamc_reactor_conn_t* const p_conn, const uint8_t* const p_data, uint32_t len)
+{
+	YAMC_ASSERT(p_conn != NULL);
+
+	if (len == 0) return YAMC_RET_SUCCESS;
+
+	if (p_conn->out_len + p_conn->send_len + len > YAMC_REACTOR_OUT_MAX_LEN)
+	{
+		YAMC_ERROR_PRINTF("Output buffer overflow, server doesn't read data\n");
+		yamc_reactor_set_closing(p_conn);
+		return YAMC_RET_INVALID_STATE;
+	}
+
+	// reuse space of already sent data
+	if (p_conn->out_pos + p_conn->out_len + len > p_conn->out_cap && p_conn->out_pos > 0)
+	{
+		memmove(p_conn->p_out, p_conn->p_out + p_conn->out_pos, p_conn->out_len);
+		p_conn->out_pos = 0;
+	}
+
+	if (p_conn->out_len + len > p_conn->out_cap)
+	{
+		uint32_t new_cap = p_conn->out_cap ? p_conn->out_cap * 2 : YAMC_TX_PKT_MAX_LEN;
+		while (new_cap < p_conn->out_len + len) new_cap *= 2;
+
+		uint8_t* const p_new = realloc(p_conn->p_out, new_cap);
+		if (p_new == NULL)
+		{
+			YAMC_ERROR_PRINTF("Can't allocate output buffer\n");
+			yamc_reactor_set_closing(p_conn);
+			return YAMC_RET_INVALID_STATE;
+		}
+
+		p_conn->p_out   = p_new;
+		p_conn->out_cap = new_cap;
+	}
+
+	memcpy(p_conn->p_out + p_conn->out_pos + p_conn->out_len, p_data, len);
+	p_conn->out_len += len;
+
+	// io_uring sends are submitted by next poll, with epoll register EPOLLOUT now unless it's done after handlers return
+	if (p_conn->p_reactor->use_uring)
+		yamc_reactor_pending_queue(p_conn);
+	else if (!p_conn->busy)
+		yamc_reactor_update_events(p_conn);
+
+	return YAMC_RET_SUCCESS;
+}
+
+// returns number of bytes socket accepted or -1 on error, 0 if socket isn't writable
+static ssize_t yamc_reactor_sendmsg(yamc_reactor_conn_t* const p_conn, struct iovec* const p_iov, const size_t iov_len)
+{
+	YAMC_ASSERT(p_conn != NULL);
+
+	struct msghdr msg = {.msg_iov = p_iov, .msg_iovlen = iov_len};
+
+	while (true)
+	{
+		ssize_t n = sendmsg(p_conn->fd, &msg, MSG_NOSIGNAL);
+		if (n >= 0) return n;
+
+		if (errno == EINTR) continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+
+		YAMC_ERROR_PRINTF("Error writing to socket: %s\n", strerror(errno));
+		yamc_reactor_set_closing(p_conn);
+
+		return -1;
+	}
+}
+
+// write to socket handler, never blocks
+static yamc_retcode_t yamc_reactor_write(void* p_ctx, const uint8_t* const p_buff, uint32_t buff_len)
+{
+	YAMC_ASSERT(p_ctx != NULL);
+	yamc_reactor_conn_t* const p_conn = (yamc_reactor_conn_t*)p_ctx;
+
+	if (p_conn->closing) return YAMC_RET_INVALID_STATE;
+
+	ssize_t sent = 0;
+
+	// queued data goes first, io_uring writes everything from output buffer
+	if (!p_conn->p_reactor->use_uring && !p_conn->connecting && p_conn->out_len == 0)
+	{
+		struct iovec iov = {.iov_base = (void*)p_buff, .iov_len = buff_len};
+
+		sent = yamc_reactor_sendmsg(p_conn, &iov, 1);
+		if (sent < 0) return YAMC_RET_INVALID_STATE;
+	}
+
+	return yamc_reactor_out_append(p_conn, p_buff + sent, buff_len - (uint32_t)sent);
+}
+
+// scatter/gather write to socket handler, never blocks
+static yamc_retcode_t yamc_reactor_writev(void* p_ctx, const yamc_iovec_t* const p_iov, uint32_t iov_len)
+{
+	YAMC_ASSERT(p_ctx != NULL);
+	YAMC_ASSERT(p_iov != NULL);
+	YAMC_ASSERT(iov_len <= YAMC_TX_IOV_MAX);
+
+	yamc_reactor_conn_t* const p_conn = (yamc_reactor_conn_t*)p_ctx;
+
+	if (p_conn->closing) return YAMC_RET_INVALID_STATE;
+
+	ssize_t sent = 0;
+
+	if (!p_conn->p_reactor->use_uring && !p_conn->connecting && p_conn->out_len == 0)
+	{
+		struct iovec iov[YAMC_TX_IOV_MAX];
+
+		for (uint32_t i = 0; i < iov_len; i++)
+		{
+			iov[i].iov_base = (void*)p_iov[i].p_data;
+			iov[i].iov_len  = p_iov[i].len;
+		}
+
+		sent = yamc_reactor_sendmsg(p_conn, iov, iov_len);
+		if (sent < 0) return YAMC_RET_INVALID_STATE;
+	}
+
+	// keep whatever socket didn't accept
+	for (uint32_t i = 0; i < iov_len; i++)
+	{
+		if ((size_t)sent >= p_iov[i].len)
+		{
+			sent -= p_iov[i].len;
+			continue;
+		}
+
+		yamc_retcode_t ret = yamc_reactor_out_append(p_conn, p_iov[i].p_data + sent, p_iov[i].len - (uint32_t)sent);
+		if (ret != YAMC_RET_SUCCESS) return ret;
+
+		sent = 0;
+	}
+
+	return YAMC_RET_SUCCESS;
+}
+
+// write queued data, returns false on socket error
+static bool yamc_reactor_out_flush(yamc_reactor_conn_t* const p_conn)
+{
+	YAMC_ASSERT(p_conn != NULL);
+
+	while (p_conn->out_len > 0)
+	{
+		struct iovec iov = {.iov_base = p_conn->p_out + p_conn->out_pos, .iov_len = p_conn->out_len};
+
+		ssize_t n = yamc_reactor_sendmsg(p_conn, &iov, 1);
+		if (n < 0) return false;
+		if (n == 0) break;
+
+		p_conn->out_pos += n;
+		p_conn->out_len -= n;
+	}
+
+	if (p_conn->out_len == 0) p_conn->out_pos = 0;
+
+	return true;
+}
+
+static void yamc_reactor_disconnect_handler(void* p_ctx)
+{
+	YAMC_ASSERT(p_ctx != NULL);
+	yamc_reactor_conn_t* const p_conn = (yamc_reactor_conn_t*)p_ctx;
+
+	YAMC_ERROR_PRINTF("yamc requested to drop connection!\n");
+
+	// instance is still in use, reactor closes connection later
+	yamc_reactor_set_closing(p_conn);
+}
+
+// time of current loop iteration, saves clock reads for each parsed buffer
+static uint32_t yamc_reactor_timestamp(void* p_ctx)
+{
+	YAMC_ASSERT(p_ctx != NULL);
+	yamc_reactor_conn_t* const p_conn = (yamc_reactor_conn_t*)p_ctx;
+
+	return p_conn->p_reactor->now_ms;
+}
+
+// check incoming packet timeout and keepalive, timer runs as long as connection is open
+static void yamc_reactor_timer_handler(yamc_timer_t* const p_timer, void* p_ctx)
+{
+	YAMC_ASSERT(p_ctx != NULL);
+	yamc_reactor_conn_t* const p_conn	= (yamc_reactor_conn_t*)p_ctx;
+	yamc_reactor_t* const	  p_reactor = p_conn->p_reactor;
+
+	// closing connection waits for io_uring requests to be cancelled, try again
+	if (p_conn->closing)
+	{
+		yamc_reactor_conn_close(p_conn);
+		return;
+	}
+
+	const uint32_t left_ms = yamc_rx_timeout_left(&p_conn->instance, p_reactor->now_ms, YAMC_REACTOR_TIMEOUT_MS);
+
+	if (left_ms == 0)
+	{
+		YAMC_ERROR_PRINTF("Timeout!\n");
+		yamc_reactor_conn_close(p_conn);
+		return;
+	}
+
+	// PINGREQ is sent only on idle connection, missing PINGRESP calls disconnect handler
+	const uint32_t keepalive_ms = yamc_keepalive_poll(&p_conn->instance, p_reactor->now_ms);
+	if (p_conn->closing) return;
+
+	// unacknowledged QoS>0 PUBLISH packets are resent with DUP flag
+	const uint32_t retransmit_ms = yamc_retransmit_poll(&p_conn->instance, p_reactor->now_ms, YAMC_RETRANSMIT_TIMEOUT_MS);
+	if (p_conn->closing) return;
+
+	// no packet is being received, look again after whole timeout period
+	uint32_t next_ms = (left_ms == UINT32_MAX) ? YAMC_REACTOR_TIMEOUT_MS : left_ms;
+	if (keepalive_ms < next_ms) next_ms = keepalive_ms;
+	if (retransmit_ms < next_ms) next_ms = retransmit_ms;
+
+	yamc_timer_start(&p_reactor->wheel, p_timer, next_ms);
+}
+
+#if YAMC_REACTOR_URING
+// get submission queue entry for request of connection, marks connection for closing if ring is broken
+static struct io_uring_sqe* yamc_reactor_uring_sqe(yamc_reactor_conn_t* const p_conn, const uint32_t op)
+{
+	YAMC_ASSERT(p_conn != NULL);
+
+	struct io_uring_sqe* const p_sqe = yamc_uring_get_sqe(&p_conn->p_reactor->uring);
+	if (p_sqe == NULL)
+	{
+		YAMC_ERROR_PRINTF("io_uring submission queue is full\n");
+		p_conn->closing = true;
+		return NULL;
+	}
+
+	p_sqe->fd		 = p_conn->fd;
+	p_sqe->user_data = (uint64_t)(uintptr_t)p_conn | op;
+
+	p_conn->ops_cnt++;
+
+	return p_sqe;
+}
+
+// wait for non-blocking connect() to finish
+static void yamc_reactor_uring_connect(yamc_reactor_conn_t* const p_conn)
+{
+	struct io_uring_sqe* const p_sqe = yamc_reactor_uring_sqe(p_conn, YAMC_REACTOR_OP_CONNECT);
+	if (p_sqe == NULL) return;
+
+	p_sqe->opcode		 = IORING_OP_POLL_ADD;
+	p_sqe->poll32_events = POLLOUT;
+}
+
+// receive into buffer picked by kernel from provided buffers, multishot request stays active for many completions
+static void yamc_reactor_uring_recv(yamc_reactor_conn_t* const p_conn)
+{
+	struct io_uring_sqe* const p_sqe = yamc_reactor_uring_sqe(p_conn, YAMC_REACTOR_OP_RECV);
+	if (p_sqe == NULL) return;
+
+	p_sqe->opcode	= IORING_OP_RECV;
+	p_sqe->flags	 = IOSQE_BUFFER_SELECT;
+	p_sqe->buf_group = YAMC_URING_BGID;
+	p_sqe->ioprio	= p_conn->p_reactor->recv_multishot ? IORING_RECV_MULTISHOT : 0;
+
+	p_conn->recv_armed = true;
+}
+
+// send rest of send buffer
+static void yamc_reactor_uring_send(yamc_reactor_conn_t* const p_conn)
+{
+	YAMC_ASSERT(p_conn->send_len > 0);
+
+	struct io_uring_sqe* const p_sqe = yamc_reactor_uring_sqe(p_conn, YAMC_REACTOR_OP_SEND);
+	if (p_sqe == NULL) return;
+
+	p_sqe->opcode	= IORING_OP_SEND;
+	p_sqe->addr		 = (uint64_t)(uintptr_t)(p_conn->p_send + p_conn->send_pos);
+	p_sqe->len		 = p_conn->send_len;
+	p_sqe->msg_flags = MSG_NOSIGNAL;
+}
+
+// submit collected output, kernel owns send buffer until send completes so new writes go to output buffer
+static void yamc_reactor_uring_flush(yamc_reactor_conn_t* const p_conn)
+{
+	YAMC_ASSERT(p_conn != NULL);
+
+	// connection is queued again once connect or send in flight completes
+	if (p_conn->connecting || p_conn->send_len > 0 || p_conn->out_len == 0) return;
+
+	uint8_t* const p_send = p_conn->p_send;
+	const uint32_t cap	= p_conn->send_cap;
+
+	p_conn->p_send   = p_conn->p_out;
+	p_conn->send_cap = p_conn->out_cap;
+	p_conn->send_pos = p_conn->out_pos;
+	p_conn->send_len = p_conn->out_len;
+
+	p_conn->p_out   = p_send;
+	p_conn->out_cap = cap;
+	p_conn->out_pos = 0;
+	p_conn->out_len = 0;
+
+	yamc_reactor_uring_send(p_conn);
+}
+#endif
+
+// handle connections queued outside of dispatch
+static void yamc_reactor_process_pending(yamc_reactor_t* const p_reactor)
+{
+	YAMC_ASSERT(p_reactor != NULL);
+
+	while (p_reactor->p_pending != NULL)
+	{
+		yamc_reactor_conn_t* const p_conn = p_reactor->p_pending;
+
+		p_reactor->p_pending   = p_conn->p_pending_next;
+		p_conn->p_pending_next = NULL;
+		p_conn->pending		   = false;
+
+#if YAMC_REACTOR_URING
+		if (!p_conn->closing && p_reactor->use_uring) yamc_reactor_uring_flush(p_conn);
+#endif
+		if (!p_conn->closing && !p_reactor->use_uring) yamc_reactor_update_events(p_conn);
+
+		if (p_conn->closing) yamc_reactor_conn_close(p_conn);
+	}
+}
+
+yamc_retcode_t yamc_reactor_init(yamc_reactor_t* const p_reactor)
+{
+	YAMC_ASSERT(p_reactor != NULL);
+
+	memset(p_reactor, 0, sizeof(yamc_reactor_t));
+
+	p_reactor->epoll_fd = -1;
+
+#if YAMC_REACTOR_URING
+	p_reactor->recv_multishot = true;
+	p_reactor->use_uring	  = (yamc_uring_init(&p_reactor->uring, YAMC_REACTOR_URING_ENTRIES, YAMC_REACTOR_URING_BUF_CNT,
+											  YAMC_REACTOR_URING_BUF_LEN) == YAMC_RET_SUCCESS);
+#endif
+
+	if (!p_reactor->use_uring)
+	{
+		p_reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (p_reactor->epoll_fd < 0)
+		{
+			YAMC_ERROR_PRINTF("epoll_create1() error: %s\n", strerror(errno));
+			return YAMC_RET_INVALID_STATE;
+		}
+	}
+
+	p_reactor->now_ms = yamc_reactor_now_ms();
+
+	yamc_timer_wheel_init(&p_reactor->wheel, YAMC_REACTOR_TICK_MS, p_reactor->now_ms);
+
+	return YAMC_RET_SUCCESS;
+}
+
+// start non-blocking connection to server and initialize its yamc instance
+yamc_retcode_t yamc_reactor_conn_open(yamc_reactor_t* const p_reactor, yamc_reactor_conn_t* const p_conn, const char* const hostname,
+									  const int port, yamc_pkt_handler_t pkt_handler, yamc_reactor_connected_handler_t connected,
+									  yamc_reactor_close_handler_t close_handler, void* p_user_ctx)
+{
+	YAMC_ASSERT(p_reactor != NULL);
+	YAMC_ASSERT(p_conn != NULL);
+	YAMC_ASSERT(hostname != NULL);
+	YAMC_ASSERT(pkt_handler != NULL);
+
+	memset(p_conn, 0, sizeof(yamc_reactor_conn_t));
+
+	char port_str[8];
+	snprintf(port_str, sizeof(port_str), "%d", port);
+
+	struct addrinfo  hints  = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+	struct addrinfo* p_addr = NULL;
+
+	int err_code = getaddrinfo(hostname, port_str, &hints, &p_addr);
+	if (err_code != 0)
+	{
+		YAMC_ERROR_PRINTF("Can't resolve %s: %s\n", hostname, gai_strerror(err_code));
+		return YAMC_RET_INVALID_STATE;
+	}
+
+	p_conn->fd = socket(p_addr->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (p_conn->fd < 0)
+	{
+		YAMC_ERROR_PRINTF("ERROR opening socket: %s\n", strerror(errno));
+		freeaddrinfo(p_addr);
+		return YAMC_RET_INVALID_STATE;
+	}
+
+	// completion is reported as writable socket, even when connect() succeeds right away
+	err_code = connect(p_conn->fd, p_addr->ai_addr, p_addr->ai_addrlen);
+	freeaddrinfo(p_addr);
+
+	if (err_code < 0 && errno != EINPROGRESS)
+	{
+		YAMC_ERROR_PRINTF("ERROR connecting: %s\n", strerror(errno));
+		close(p_conn->fd);
+		return YAMC_RET_INVALID_STATE;
+	}
+
+	p_conn->p_reactor  = p_reactor;
+	p_conn->connecting = true;
+	p_conn->events	 = EPOLLIN | EPOLLOUT;
+	p_conn->connected  = connected;
+	p_conn->close	  = close_handler;
+	p_conn->p_user_ctx = p_user_ctx;
+
+#if YAMC_REACTOR_URING
+	if (p_reactor->use_uring)
+	{
+		yamc_reactor_uring_connect(p_conn);
+
+		if (p_conn->closing)
+		{
+			close(p_conn->fd);
+			return YAMC_RET_INVALID_STATE;
+		}
+	}
+#endif
+
+	struct epoll_event ev = {.events = p_conn->events, .data.ptr = p_conn};
+
+	if (!p_reactor->use_uring && epoll_ctl(p_reactor->epoll_fd, EPOLL_CTL_ADD, p_conn->fd, &ev) < 0)
+	{
+		YAMC_ERROR_PRINTF("epoll_ctl() error: %s\n", strerror(errno));
+		close(p_conn->fd);
+		return YAMC_RET_INVALID_STATE;
+	}
+
+	yamc_handler_cfg_t handler_cfg = {.disconnect	= yamc_reactor_disconnect_handler,
+									  .write		 = yamc_reactor_write,
+									  .writev		 = yamc_reactor_writev,
+									  .pkt_handler   = pkt_handler,
+									  .timestamp	 = yamc_reactor_timestamp,
+									  .p_handler_ctx = p_conn};
+
+	yamc_buff_cfg_t buff_cfg = {.p_rx_buff   = p_conn->rx_pkt_buff,
+								.rx_buff_len = sizeof(p_conn->rx_pkt_buff),
+								.p_tx_buff   = p_conn->tx_pkt_buff,
+								.tx_buff_len = sizeof(p_conn->tx_pkt_buff)};
+
+	yamc_init(&p_conn->instance, &handler_cfg, &buff_cfg);
+
+	yamc_timer_init(&p_conn->timer, yamc_reactor_timer_handler, p_conn);
+	yamc_timer_start(&p_reactor->wheel, &p_conn->timer, YAMC_REACTOR_TIMEOUT_MS);
+
+	// add to connection list
+	p_conn->p_next = p_reactor->p_conns;
+	if (p_reactor->p_conns != NULL) p_reactor->p_conns->p_prev = p_conn;
+	p_reactor->p_conns = p_conn;
+	p_reactor->conn_cnt++;
+
+	return YAMC_RET_SUCCESS;
+}
+
+// close connection, deferred while its events are dispatched
+void yamc_reactor_conn_close(yamc_reactor_conn_t* const p_conn)
+{
+	YAMC_ASSERT(p_conn != NULL);
+
+	p_conn->closing = true;
+
+	if (p_conn->busy) return;
+
+	yamc_reactor_t* const p_reactor = p_conn->p_reactor;
+
+	// later events of the same batch may belong to this connection, it's closed once all of them are handled
+	if (p_reactor->dispatching)
+	{
+		yamc_reactor_pending_queue(p_conn);
+		return;
+	}
+
+	yamc_timer_stop(&p_conn->timer);
+
+#if YAMC_REACTOR_URING
+	// requests in flight reference connection and its buffers, it's released once kernel completes all of them
+	if (p_conn->ops_cnt > 0)
+	{
+		// each request type has at most one request in flight, it's cancelled by its user_data which works on any
+		// io_uring kernel, unlike cancelling by fd. Cancelling request that already completed just fails.
+		for (uint32_t op = YAMC_REACTOR_OP_CONNECT; op <= YAMC_REACTOR_OP_SEND; op++)
+		{
+			if (p_conn->cancel_sent & (1u << op)) continue;
+
+			struct io_uring_sqe* const p_sqe = yamc_uring_get_sqe(&p_reactor->uring);
+			if (p_sqe == NULL)
+			{
+				// timer handler tries again
+				yamc_timer_start(&p_reactor->wheel, &p_conn->timer, YAMC_REACTOR_TICK_MS);
+				return;
+			}
+
+			p_sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			p_sqe->fd	 = -1;
+			p_sqe->addr   = (uint64_t)(uintptr_t)p_conn | op;
+
+			p_conn->cancel_sent |= 1u << op;
+		}
+
+		return;
+	}
+#endif
+
+	if (p_conn->pending)
+	{
+		yamc_reactor_conn_t** pp_conn = &p_reactor->p_pending;
+		while (*pp_conn != p_conn) pp_conn = &(*pp_conn)->p_pending_next;
+
+		*pp_conn		= p_conn->p_pending_next;
+		p_conn->pending = false;
+	}
+
+	if (!p_reactor->use_uring) epoll_ctl(p_reactor->epoll_fd, EPOLL_CTL_DEL, p_conn->fd, NULL);
+	close(p_conn->fd);
+
+	if (p_conn->p_prev != NULL)
+		p_conn->p_prev->p_next = p_conn->p_next;
+	else
+		p_reactor->p_conns = p_conn->p_next;
+
+	if (p_conn->p_next != NULL) p_conn->p_next->p_prev = p_conn->p_prev;
+
+	p_reactor->conn_cnt--;
+
+	free(p_conn->p_out);
+	p_conn->p_out   = NULL;
+	p_conn->out_cap = 0;
+	p_conn->out_len = 0;
+
+	free(p_conn->p_send);
+	p_conn->p_send   = NULL;
+	p_conn->send_cap = 0;
+	p_conn->send_len = 0;
+
+	// connection struct belongs to user from now on
+	if (p_conn->close != NULL) p_conn->close(p_conn, p_conn->p_user_ctx);
+}
+
+// check result of non-blocking connect() once socket reports it's done
+static void yamc_reactor_connect_done(yamc_reactor_conn_t* const p_conn)
+{
+	YAMC_ASSERT(p_conn != NULL);
+
+	int		  sock_err = 0;
+	socklen_t len	  = sizeof(sock_err);
+
+	getsockopt(p_conn->fd, SOL_SOCKET, SO_ERROR, &sock_err, &len);
+
+	if (sock_err != 0)
+	{
+		YAMC_ERROR_PRINTF("ERROR connecting: %s\n", strerror(sock_err));
+		yamc_reactor_set_closing(p_conn);
+	}
+	else
+	{
+		p_conn->connecting = false;
+		if (p_conn->connected != NULL) p_conn->connected(p_conn, p_conn->p_user_ctx);
+
+		// CONNECT has been sent by now, reschedule timer for keepalive interval it set
+		if (!p_conn->closing) yamc_reactor_timer_handler(&p_conn->timer, p_conn);
+	}
+}
+
+// handle socket events of single connection
+static void yamc_reactor_dispatch(yamc_reactor_t* const p_reactor, yamc_reactor_conn_t* const p_conn, const uint32_t events)
+{
+	YAMC_ASSERT(p_reactor != NULL);
+	YAMC_ASSERT(p_conn != NULL);
+
+	// closed by handler of other connection in the same batch
+	if (p_conn->closing) return;
+
+	p_conn->busy = true;
+
+	if (p_conn->connecting && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) yamc_reactor_connect_done(p_conn);
+
+	if (!p_conn->closing && !p_conn->connecting && p_conn->out_len > 0 && (events & EPOLLOUT))
+		p_conn->closing = !yamc_reactor_out_flush(p_conn);
+
+	if (!p_conn->closing && !p_conn->connecting && (events & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+	{
+		ssize_t n = read(p_conn->fd, p_reactor->rx_buff, sizeof(p_reactor->rx_buff));
+
+		if (n > 0)
+			yamc_parse_buff(&p_conn->instance, p_reactor->rx_buff, (uint32_t)n);
+		else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+			yamc_reactor_set_closing(p_conn);
+	}
+
+	p_conn->busy = false;
+
+	if (p_conn->closing)
+		yamc_reactor_conn_close(p_conn);
+	else
+		yamc_reactor_update_events(p_conn);
+}
+
+#if YAMC_REACTOR_URING
+// handle completion of receive request
+static void yamc_reactor_uring_recv_done(yamc_reactor_t* const p_reactor, yamc_reactor_conn_t* const p_conn,
+										 const struct io_uring_cqe* const p_cqe)
+{
+	if (p_cqe->flags & IORING_CQE_F_BUFFER)
+	{
+		const uint16_t bid = (uint16_t)(p_cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+
+		if (p_cqe->res > 0 && !p_conn->closing)
+			yamc_parse_buff(&p_conn->instance, yamc_uring_buf(&p_reactor->uring, bid), (uint32_t)p_cqe->res);
+
+		yamc_uring_buf_recycle(&p_reactor->uring, bid);
+	}
+	else if (p_cqe->res == 0)
+	{
+		// server closed connection
+		yamc_reactor_set_closing(p_conn);
+	}
+	else if (p_cqe->res == -EINVAL && p_reactor->recv_multishot)
+	{
+		// kernel older than 6.0, receive request is submitted again for each completion
+		YAMC_LOG_DEBUG("Multishot receive is not supported\n");
+		p_reactor->recv_multishot = false;
+	}
+	else if (p_cqe->res < 0 && p_cqe->res != -ENOBUFS && p_cqe->res != -ECANCELED)
+	{
+		// ENOBUFS - all buffers were taken, they are recycled by now
+		YAMC_ERROR_PRINTF("Error reading from socket: %s\n", strerror(-p_cqe->res));
+		yamc_reactor_set_closing(p_conn);
+	}
+
+	if (!(p_cqe->flags & IORING_CQE_F_MORE)) p_conn->recv_armed = false;
+
+	if (!p_conn->closing && !p_conn->recv_armed) yamc_reactor_uring_recv(p_conn);
+}
+
+// handle completion of send request
+static void yamc_reactor_uring_send_done(yamc_reactor_conn_t* const p_conn, const struct io_uring_cqe* const p_cqe)
+{
+	if (p_cqe->res < 0)
+	{
+		if (p_cqe->res != -ECANCELED) YAMC_ERROR_PRINTF("Error writing to socket: %s\n", strerror(-p_cqe->res));
+		yamc_reactor_set_closing(p_conn);
+	}
+	else if ((uint32_t)p_cqe->res < p_conn->send_len)
+	{
+		p_conn->send_pos += p_cqe->res;
+		p_conn->send_len -= p_cqe->res;
+
+		if (!p_conn->closing) yamc_reactor_uring_send(p_conn);
+	}
+	else
+	{
+		p_conn->send_pos = 0;
+		p_conn->send_len = 0;
+
+		if (p_conn->out_len > 0) yamc_reactor_pending_queue(p_conn);
+	}
+}
+
+// handle single io_uring completion
+static void yamc_reactor_uring_dispatch(yamc_reactor_t* const p_reactor, const struct io_uring_cqe* const p_cqe)
+{
+	YAMC_ASSERT(p_reactor != NULL);
+	YAMC_ASSERT(p_cqe != NULL);
+
+	if (p_cqe->user_data == 0) return;
+
+	yamc_reactor_conn_t* const p_conn = (yamc_reactor_conn_t*)(uintptr_t)(p_cqe->user_data & ~(uint64_t)YAMC_REACTOR_OP_MASK);
+	const uint32_t			   op	 = (uint32_t)(p_cqe->user_data & YAMC_REACTOR_OP_MASK);
+
+	// multishot receive keeps going while kernel sets IORING_CQE_F_MORE
+	if (op != YAMC_REACTOR_OP_RECV || !(p_cqe->flags & IORING_CQE_F_MORE)) p_conn->ops_cnt--;
+
+	p_conn->busy = true;
+
+	switch (op)
+	{
+		case YAMC_REACTOR_OP_CONNECT:
+			if (p_conn->closing) break;
+
+			yamc_reactor_connect_done(p_conn);
+
+			if (!p_conn->closing)
+			{
+				yamc_reactor_uring_recv(p_conn);
+				if (p_conn->out_len > 0) yamc_reactor_pending_queue(p_conn);
+			}
+			break;
+
+		case YAMC_REACTOR_OP_RECV:
+			yamc_reactor_uring_recv_done(p_reactor, p_conn, p_cqe);
+			break;
+
+		case YAMC_REACTOR_OP_SEND:
+			yamc_reactor_uring_send_done(p_conn, p_cqe);
+			break;
+
+		default:
+			break;
+	}
+
+	p_conn->busy = false;
+
+	if (p_conn->closing) yamc_reactor_conn_close(p_conn);
+}
+
+// submit queued requests, wait for completions and process them
+static int yamc_reactor_uring_poll(yamc_reactor_t* const p_reactor, int timeout_ms)
+{
+	YAMC_ASSERT(p_reactor != NULL);
+
+	if (yamc_uring_submit_and_wait(&p_reactor->uring, timeout_ms) < 0) return -1;
+
+	p_reactor->now_ms = yamc_reactor_now_ms();
+
+	int cqe_cnt = 0;
+
+	p_reactor->dispatching = true;
+
+	struct io_uring_cqe* p_cqe;
+	while ((p_cqe = yamc_uring_peek_cqe(&p_reactor->uring)) != NULL)
+	{
+		// free completion queue slot before handlers queue more requests
+		const struct io_uring_cqe cqe = *p_cqe;
+		yamc_uring_cqe_seen(&p_reactor->uring);
+
+		yamc_reactor_uring_dispatch(p_reactor, &cqe);
+		cqe_cnt++;
+	}
+
+	p_reactor->dispatching = false;
+
+	yamc_reactor_process_pending(p_reactor);
+
+	return cqe_cnt;
+}
+#endif
+
+// wait for socket events and process them
+int yamc_reactor_poll(yamc_reactor_t* const p_reactor, int timeout_ms)
+{
+	YAMC_ASSERT(p_reactor != NULL);
+
+	yamc_reactor_process_pending(p_reactor);
+
+#if YAMC_REACTOR_URING
+	if (p_reactor->use_uring)
+	{
+		int cqe_cnt = yamc_reactor_uring_poll(p_reactor, timeout_ms);
+
+		if (cqe_cnt >= 0) yamc_timer_wheel_advance(&p_reactor->wheel, p_reactor->now_ms);
+
+		return cqe_cnt;
+	}
+#endif
+
+	struct epoll_event events[YAMC_REACTOR_EVENTS_MAX];
+
+	int events_cnt = epoll_wait(p_reactor->epoll_fd, events, YAMC_REACTOR_EVENTS_MAX, timeout_ms);
+	if (events_cnt < 0)
+	{
+		if (errno == EINTR) return 0;
+
+		YAMC_ERROR_PRINTF("epoll_wait() error: %s\n", strerror(errno));
+		return -1;
+	}
+
+	p_reactor->now_ms = yamc_reactor_now_ms();
+
+	p_reactor->dispatching = true;
+
+	for (int i = 0; i < events_cnt; i++) yamc_reactor_dispatch(p_reactor, (yamc_reactor_conn_t*)events[i].data.ptr, events[i].events);
+
+	p_reactor->dispatching = false;
+
+	yamc_reactor_process_pending(p_reactor);
+
+	yamc_timer_wheel_advance(&p_reactor->wheel, p_reactor->now_ms);
+
+	return events_cnt;
+}
+
+// process events until stopped or all connections are closed
+void yamc_reactor_run(yamc_reactor_t* const p_reactor)
+{
+	YAMC_ASSERT(p_reactor != NULL);
+
+	while (!p_reactor->exit_now && p_reactor->conn_cnt > 0)
+	{
+		if (yamc_reactor_poll(p_reactor, YAMC_REACTOR_TICK_MS) < 0) break;
+	}
+}
+
+void yamc_reactor_stop(yamc_reactor_t* const p_reactor)
+{
+	YAMC_ASSERT(p_reactor != NULL);
+
+	p_reactor->exit_now = true;
+}
+
+// close all connections and io_uring or epoll instance
+void yamc_reactor_free(yamc_reactor_t* const p_reactor)
+{
+	YAMC_ASSERT(p_reactor != NULL);
+
+#if YAMC_REACTOR_URING
+	if (p_reactor->use_uring)
+	{
+		yamc_reactor_conn_t* p_conn = p_reactor->p_conns;
+
+		while (p_conn != NULL)
+		{
+			yamc_reactor_conn_t* const p_next = p_conn->p_next;
+
+			yamc_reactor_conn_close(p_conn);
+			p_conn = p_next;
+		}
+
+		// connections with requests in flight are released as cancelled requests complete
+		while (p_reactor->p_conns != NULL && yamc_reactor_poll(p_reactor, YAMC_REACTOR_TICK_MS) >= 0)
+			;
+
+		yamc_uring_free(&p_reactor->uring);
+		return;
+	}
+#endif
+
+	while (p_reactor->p_conns != NULL) yamc_reactor_conn_close(p_reactor->p_conns);
+
+	close(p_reactor->epoll_fd);
+}
@@ -0,0 +1,133 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_reactor.h - Drives many yamc instances from single io_uring or epoll loop on Linux
+ *
+ * Sockets are non-blocking, data that can't be written immediately is kept in per connection output buffer
+ * and sent when socket becomes writable. Timeouts and keepalive are checked by the loop, no threads or POSIX timers are used.
+ * Each reactor is single threaded, run one reactor per core to use more of them.
+ *
+ * When kernel supports it, all connections of reactor share one io_uring: data are received by multishot receive
+ * into provided buffers and output collected during loop iteration is submitted as one send per connection,
+ * together with other requests in single syscall. Otherwise reactor falls back to epoll.
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#ifndef __YAMC_REACTOR_H__
+#define __YAMC_REACTOR_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "yamc.h"
+#include "yamc_port.h"
+#include "yamc_timer_wheel.h"
+#include "yamc_uring.h"
+
+struct yamc_reactor_s;
+struct yamc_reactor_conn_s;
+
+/// Connection closed handler, connection struct can be reused or freed from here
+typedef void (*yamc_reactor_close_handler_t)(struct yamc_reactor_conn_s* const p_conn, void* p_ctx);
+
+/// Connection established handler, i.e. to send CONNECT. Packets sent before connection is established are buffered anyway.
+typedef void (*yamc_reactor_connected_handler_t)(struct yamc_reactor_conn_s* const p_conn, void* p_ctx);
+
+/// Single server connection, yamc handler context points to it
+typedef struct yamc_reactor_conn_s
+{
+	yamc_instance_t instance;  // has to stay first, packet handlers can cast instance pointer to connection
+
+	struct yamc_reactor_s*		p_reactor;
+	struct yamc_reactor_conn_s* p_next;  // reactor connection list
+	struct yamc_reactor_conn_s* p_prev;
+
+	int		 fd;
+	bool	 connecting;  // non-blocking connect() in progress
+	bool	 closing;	 // close requested, done once reactor is done with the connection
+	bool	 busy;		  // reactor is dispatching events of this connection
+	uint32_t events;	  // epoll events currently registered
+
+	uint8_t tx_pkt_buff[YAMC_TX_PKT_MAX_LEN];
+	uint8_t rx_pkt_buff[YAMC_RX_PKT_MAX_LEN];
+
+	uint8_t* p_out;	// data waiting for socket to become writable
+	uint32_t out_pos;  // first byte waiting
+	uint32_t out_len;  // bytes waiting
+	uint32_t out_cap;  // output buffer capacity
+
+	uint8_t* p_send;	// io_uring only, output handed to kernel, swapped with output buffer when send completes
+	uint32_t send_pos;  // first byte not sent yet
+	uint32_t send_len;  // bytes not sent yet, send request is in flight while non-zero
+	uint32_t send_cap;  // send buffer capacity
+
+	uint16_t ops_cnt;	  // io_uring requests in flight, connection is released once they all complete
+	bool	 recv_armed;   // io_uring receive request is active
+	uint8_t	 cancel_sent;  // io_uring request types of closing connection already cancelled, bit per request type
+	bool	 pending;		// connection is on reactor list handled by next poll
+
+	struct yamc_reactor_conn_s* p_pending_next;  // pending list of reactor
+
+	yamc_timer_t timer;  // checks incoming packet timeout and keepalive
+
+	yamc_reactor_connected_handler_t connected;
+	yamc_reactor_close_handler_t	 close;
+	void*							 p_user_ctx;  // passed to connected and close handlers
+
+} yamc_reactor_conn_t;
+
+typedef struct yamc_reactor_s
+{
+	bool use_uring;		  // io_uring backend is used, epoll otherwise
+	bool recv_multishot;  // kernel supports multishot receive
+
+#if YAMC_REACTOR_URING
+	yamc_uring_t uring;
+#endif
+	struct yamc_reactor_conn_s* p_pending;  // connections with io_uring output to submit or closed outside of their dispatch
+	bool dispatching;  // events of current poll are handled, closes are deferred to pending list
+
+	int					 epoll_fd;  // -1 with io_uring backend
+	yamc_reactor_conn_t* p_conns;	// open connections
+	uint32_t			 conn_cnt;   // number of open connections
+	uint32_t			 now_ms;	 // monotonic time of current loop iteration
+	yamc_timer_wheel_t	 wheel;	  // connection timers
+	volatile bool		 exit_now;   // set by yamc_reactor_stop()
+
+	uint8_t rx_buff[YAMC_REACTOR_RX_BUFF_LEN];  // shared by all connections of the reactor
+
+} yamc_reactor_t;
+
+/// set up io_uring or, if not available, epoll instance. YAMC_RET_INVALID_STATE on failure
+yamc_retcode_t yamc_reactor_init(yamc_reactor_t* const p_reactor);
+
+/**
+ * \brief start non-blocking connection to server and initialize its yamc instance
+ *
+ * Set parser_enables and other instance options after this call. Packets can be sent right away,
+ * they are written once connection is established.
+ * Allocate connections with aligned_alloc(YAMC_CACHE_LINE_LEN, ...), instance contains cache line aligned members.
+ *
+ * \return YAMC_RET_SUCCESS or YAMC_RET_INVALID_STATE if host can't be resolved or socket can't be created
+ */
+yamc_retcode_t yamc_reactor_conn_open(yamc_reactor_t* const p_reactor, yamc_reactor_conn_t* const p_conn, const char* const hostname,
+									  const int port, yamc_pkt_handler_t pkt_handler, yamc_reactor_connected_handler_t connected,
+									  yamc_reactor_close_handler_t close_handler, void* p_user_ctx);
+
+/// close connection, pending output is dropped. Close handler is called, deferred if called while reactor handles events.
+void yamc_reactor_conn_close(yamc_reactor_conn_t* const p_conn);
+
+/// wait up to timeout_ms for socket events and process them, returns number of handled events or -1 on error
+int yamc_reactor_poll(yamc_reactor_t* const p_reactor, int timeout_ms);
+
+/// process events until yamc_reactor_stop() is called or all connections are closed
+void yamc_reactor_run(yamc_reactor_t* const p_reactor);
+
+/// make yamc_reactor_run() return, can be called from handlers or signal handler
+void yamc_reactor_stop(yamc_reactor_t* const p_reactor);
+
+/// close all connections and release io_uring or epoll instance
+void yamc_reactor_free(yamc_reactor_t* const p_reactor);
+
+#endif /* __YAMC_REACTOR_H__ */
@@ -0,0 +1,52 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_read_len.h - Adapts read() request length of wrappers to recent read sizes
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#ifndef __YAMC_READ_LEN_H__
+#define __YAMC_READ_LEN_H__
+
+#include <stdint.h>
+#include "yamc_port.h"
+
+typedef struct
+{
+	uint32_t len;		  // next read request length
+	uint32_t short_cnt;  // consecutive reads shorter than quarter of request
+
+} yamc_read_len_t;
+
+static inline void yamc_read_len_init(yamc_read_len_t* const p_read_len)
+{
+	p_read_len->len		  = YAMC_NET_READ_MIN_LEN;
+	p_read_len->short_cnt = 0;
+}
+
+// grow request while reads fill it, shrink it after a run of short reads
+static inline void yamc_read_len_update(yamc_read_len_t* const p_read_len, const uint32_t rx_bytes)
+{
+	if (rx_bytes == p_read_len->len)
+	{
+		p_read_len->short_cnt = 0;
+		if (p_read_len->len < YAMC_NET_READ_BUFF_LEN)
+			p_read_len->len = (p_read_len->len * 2 < YAMC_NET_READ_BUFF_LEN) ? p_read_len->len * 2 : YAMC_NET_READ_BUFF_LEN;
+	}
+	else if (rx_bytes < p_read_len->len / 4)
+	{
+		if (++p_read_len->short_cnt < YAMC_NET_READ_SHRINK_CNT) return;
+
+		p_read_len->short_cnt = 0;
+		if (p_read_len->len > YAMC_NET_READ_MIN_LEN)
+			p_read_len->len = (p_read_len->len / 2 > YAMC_NET_READ_MIN_LEN) ? p_read_len->len / 2 : YAMC_NET_READ_MIN_LEN;
+	}
+	else
+	{
+		p_read_len->short_cnt = 0;
+	}
+}
+
+#endif /* __YAMC_READ_LEN_H__ */
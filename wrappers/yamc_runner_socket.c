@@ -65,10 +65,12 @@ int main(int argc, char* argv[])
 
 	// process sending data to socket here...
 
-	// send MQTT connect packet
+	// send MQTT connect packet, timer thread sending keepalive pings shares the instance
 	yamc_retcode_t		ret;
 	yamc_connect_data_t connect_data;
 
+	yamc_net_core_lock(&yamc_net_core);
+
 	memset(&connect_data, 0, sizeof(yamc_connect_data_t));
 
 	connect_data.clean_session		 = true;
@@ -121,18 +123,10 @@ int main(int argc, char* argv[])
 		exit(-1);
 	}
 
-	// repeatedly send ping request to keep connection alive
-	while (!yamc_net_core_should_exit(&yamc_net_core))
-	{
-		ret = yamc_ping(&yamc_net_core.instance);
-		if (ret != YAMC_RET_SUCCESS)
-		{
-			printf("Error sending pingreq packet: %u\n", ret);
-			exit(-1);
-		}
-
-		sleep(25);
-	}
+	yamc_net_core_unlock(&yamc_net_core);
+
+	// yamc sends ping requests while connection is idle, wait for Ctrl+C or connection loss
+	yamc_net_core_wait_exit(&yamc_net_core);
 
 	// cleanup
 	yamc_net_core_disconnect(&yamc_net_core);
@@ -21,6 +21,7 @@
 
 #include "yamc.h"
 #include "yamc_port.h"
+#include "yamc_read_len.h"
 
 // example user defined packet handlers, overwrite parsed data to detect memory allocation problems
 #include "yamc_fuzzing_pkt_handler.h"
@@ -28,6 +29,13 @@
 // yamc state instance
 static yamc_instance_t yamc_instance;
 
+// yamc receive and transmit buffers
+static uint8_t yamc_rx_pkt_buff[YAMC_RX_PKT_MAX_LEN];
+static uint8_t yamc_tx_pkt_buff[YAMC_TX_PKT_MAX_LEN];
+
+// buffer for incoming data
+static uint8_t rx_buff[YAMC_NET_READ_BUFF_LEN];
+
 // timeout timer settings
 #define YAMC_TIMEOUT_S 30  // seconds
 #define YAMC_TIMEOUT_NS 0  // nanoseconds
@@ -132,7 +140,12 @@ int main(void)
 									  .timeout_stop = timeout_stop,
 									  .pkt_handler  = yamc_fuzzing_pkt_handler_main};
 
-	yamc_init(&yamc_instance, &handler_cfg);
+	yamc_buff_cfg_t buff_cfg = {.p_rx_buff   = yamc_rx_pkt_buff,
+								.rx_buff_len = sizeof(yamc_rx_pkt_buff),
+								.p_tx_buff   = yamc_tx_pkt_buff,
+								.tx_buff_len = sizeof(yamc_tx_pkt_buff)};
+
+	yamc_init(&yamc_instance, &handler_cfg, &buff_cfg);
 
 	// enable all packet handlers for fuzzing
 	yamc_instance.parser_enables.CONNACK  = true;
@@ -145,18 +158,18 @@ int main(void)
 	yamc_instance.parser_enables.PUBREL   = true;
 	yamc_instance.parser_enables.UNSUBACK = true;
 
-	// buffer for incoming data
-	uint8_t rx_buff[10];
+	yamc_read_len_t read_len;
+	yamc_read_len_init(&read_len);
 
 	// how many bytes were received in single read operation or read() error code
 	int rx_bytes = 0;
 
-	// zero rx buffer
-	memset(rx_buff, 0, sizeof(rx_buff));
-
 	// read stdin and pass it to yamc_parse_buff()
-	while ((rx_bytes = read(STDIN_FILENO, rx_buff, sizeof(rx_buff))) > 0)
-		if (rx_bytes > 0) yamc_parse_buff(&yamc_instance, rx_buff, rx_bytes);
+	while ((rx_bytes = read(STDIN_FILENO, rx_buff, read_len.len)) > 0)
+	{
+		yamc_read_len_update(&read_len, rx_bytes);
+		yamc_parse_buff(&yamc_instance, rx_buff, rx_bytes);
+	}
 
 	exit(0);
 }
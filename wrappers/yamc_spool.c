@@ -0,0 +1,475 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_spool.c - Queues outgoing PUBLISH packets while connection is down or in-flight window is full
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "yamc_spool.h"
+#include "yamc.h"
+#include "yamc_port.h"
+
+// record delivery state
+typedef enum {
+	YAMC_SPOOL_PENDING = 0,  // not published yet
+	YAMC_SPOOL_SENT,		 // QoS>0 message published, waiting for acknowledgement
+	YAMC_SPOOL_DONE			 // ring space can be reused
+
+} yamc_spool_state_t;
+
+// spooled message, the same layout is used in memory ring and segment files
+typedef struct
+{
+	uint32_t len;		  // record length including header, 0 marks space skipped at ring end
+	uint8_t  state;		  // yamc_spool_state_t
+	uint8_t  QOS;		  // QoS level
+	uint8_t  RETAIN;	  // packet RETAIN flag
+	uint8_t  reserved;
+	uint16_t topic_len;  // topic length
+	uint16_t packet_id;  // packet id of QoS>0 message once it was sent, 0 before
+	uint32_t data_len;   // payload length
+	void*	p_msg_ctx;  // user message context, passed to publish complete handler
+	uint8_t  data[];	 // topic followed by payload
+
+} yamc_spool_rec_t;
+
+// records are 8 byte aligned
+#define YAMC_SPOOL_ALIGN(x) (((x) + 7u) / 8u * 8u)
+
+static inline yamc_spool_rec_t* yamc_spool_rec(const yamc_spool_t* const p_spool, const uint32_t off)
+{
+	YAMC_ASSERT(p_spool != NULL);
+	YAMC_ASSERT(off < p_spool->buff_len);
+
+	return (yamc_spool_rec_t*)(p_spool->p_buff + off);
+}
+
+// offset of record stored at or after given position, skips unused space at ring end
+static inline uint32_t yamc_spool_rec_off(const yamc_spool_t* const p_spool, const uint32_t off)
+{
+	return (yamc_spool_rec(p_spool, off)->len == 0) ? 0 : off;
+}
+
+// offset following record at given position
+static inline uint32_t yamc_spool_next_off(const yamc_spool_t* const p_spool, const uint32_t off)
+{
+	const uint32_t next = off + yamc_spool_rec(p_spool, off)->len;
+
+	return (next == p_spool->buff_len) ? 0 : next;
+}
+
+static void yamc_spool_seg_path(const yamc_spool_t* const p_spool, const uint32_t seg, char* const p_path, const size_t path_len)
+{
+	YAMC_ASSERT(p_spool != NULL);
+
+	snprintf(p_path, path_len, "%s/yamc_spool_%08u.seg", p_spool->p_dir, seg);
+}
+
+void yamc_spool_init(yamc_spool_t* const p_spool, uint8_t* const p_buff, uint32_t buff_len, uint32_t spill_threshold,
+					 const char* const p_dir)
+{
+	YAMC_ASSERT(p_spool != NULL);
+	YAMC_ASSERT(p_buff != NULL);
+	YAMC_ASSERT(((uintptr_t)p_buff & 7u) == 0);
+	YAMC_ASSERT(p_dir != NULL);
+
+	memset(p_spool, 0, sizeof(yamc_spool_t));
+
+	p_spool->p_buff			 = p_buff;
+	p_spool->buff_len		 = buff_len & ~(uint32_t)7u;
+	p_spool->spill_threshold = spill_threshold;
+	p_spool->p_dir			 = p_dir;
+	p_spool->wr_fd			 = -1;
+	p_spool->rd_fd			 = -1;
+}
+
+bool yamc_spool_is_empty(const yamc_spool_t* const p_spool)
+{
+	YAMC_ASSERT(p_spool != NULL);
+
+	return p_spool->rec_cnt == 0 && p_spool->disk_cnt == 0;
+}
+
+// reserve contiguous ring space for record, NULL if there's no room
+static yamc_spool_rec_t* yamc_spool_ring_alloc(yamc_spool_t* const p_spool, const uint32_t len)
+{
+	YAMC_ASSERT(p_spool != NULL);
+
+	if (p_spool->rec_cnt == 0)
+	{
+		p_spool->head = 0;
+		p_spool->tail = 0;
+		p_spool->used = 0;
+	}
+
+	const bool wrapped = p_spool->head < p_spool->tail || (p_spool->head == p_spool->tail && p_spool->rec_cnt > 0);
+
+	if (wrapped)
+	{
+		if (p_spool->tail - p_spool->head < len) return NULL;
+	}
+	else if (p_spool->buff_len - p_spool->head < len)
+	{
+		if (p_spool->tail < len) return NULL;
+
+		// record doesn't fit at ring end, continue from the beginning
+		yamc_spool_rec(p_spool, p_spool->head)->len = 0;
+		p_spool->used += p_spool->buff_len - p_spool->head;
+		p_spool->head = 0;
+	}
+
+	const uint32_t off = p_spool->head;
+
+	if (p_spool->rec_cnt == 0) p_spool->tail = off;
+	if (p_spool->pending_cnt == 0) p_spool->send = off;
+
+	p_spool->head += len;
+	p_spool->used += len;
+	if (p_spool->head == p_spool->buff_len) p_spool->head = 0;
+
+	p_spool->rec_cnt++;
+	p_spool->pending_cnt++;
+
+	yamc_spool_rec_t* const p_rec = yamc_spool_rec(p_spool, off);
+	p_rec->len					  = len;
+	p_rec->state				  = YAMC_SPOOL_PENDING;
+
+	return p_rec;
+}
+
+// release ring space of published and acknowledged records
+static void yamc_spool_ring_trim(yamc_spool_t* const p_spool)
+{
+	YAMC_ASSERT(p_spool != NULL);
+
+	while (p_spool->rec_cnt > 0)
+	{
+		const uint32_t off = yamc_spool_rec_off(p_spool, p_spool->tail);
+
+		if (off != p_spool->tail)
+		{
+			p_spool->used -= p_spool->buff_len - p_spool->tail;
+			p_spool->tail = off;
+		}
+
+		yamc_spool_rec_t* const p_rec = yamc_spool_rec(p_spool, off);
+
+		if (p_rec->state != YAMC_SPOOL_DONE) break;
+
+		p_spool->used -= p_rec->len;
+		p_spool->tail = yamc_spool_next_off(p_spool, off);
+		p_spool->rec_cnt--;
+	}
+}
+
+// close and remove segment files after all spilled records were moved to ring
+static void yamc_spool_disk_reset(yamc_spool_t* const p_spool)
+{
+	YAMC_ASSERT(p_spool != NULL);
+
+	char path[PATH_MAX];
+
+	if (p_spool->rd_fd >= 0) close(p_spool->rd_fd);
+	if (p_spool->wr_fd >= 0) close(p_spool->wr_fd);
+
+	for (uint32_t seg = p_spool->rd_seg; seg != p_spool->wr_seg + 1; seg++)
+	{
+		yamc_spool_seg_path(p_spool, seg, path, sizeof(path));
+		unlink(path);
+	}
+
+	p_spool->rd_fd	= -1;
+	p_spool->wr_fd	= -1;
+	p_spool->rd_off   = 0;
+	p_spool->wr_len   = 0;
+	p_spool->disk_cnt = 0;
+	p_spool->wr_seg++;
+	p_spool->rd_seg = p_spool->wr_seg;
+}
+
+// append record to current segment file
+static yamc_retcode_t yamc_spool_spill(yamc_spool_t* const p_spool, const yamc_spool_rec_t* const p_hdr, const yamc_publish_data_t* const p_data)
+{
+	YAMC_ASSERT(p_spool != NULL);
+	YAMC_ASSERT(p_hdr != NULL);
+	YAMC_ASSERT(p_data != NULL);
+
+	if (p_spool->wr_fd < 0)
+	{
+		char path[PATH_MAX];
+		yamc_spool_seg_path(p_spool, p_spool->wr_seg, path, sizeof(path));
+
+		p_spool->wr_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0600);
+		if (p_spool->wr_fd < 0)
+		{
+			YAMC_ERROR_PRINTF("Error creating spool segment %s: %s\n", path, strerror(errno));
+			return YAMC_RET_INVALID_STATE;
+		}
+	}
+
+	static const uint8_t padding[8] = {0};
+
+	struct iovec iov[4] = {{.iov_base = (void*)p_hdr, .iov_len = sizeof(yamc_spool_rec_t)},
+						   {.iov_base = (void*)p_data->topic.str, .iov_len = p_data->topic.len},
+						   {.iov_base = (void*)p_data->p_data, .iov_len = p_data->data_len},
+						   {.iov_base = (void*)padding,
+							.iov_len  = p_hdr->len - sizeof(yamc_spool_rec_t) - p_data->topic.len - p_data->data_len}};
+
+	// whole record goes out in single append
+	ssize_t n = writev(p_spool->wr_fd, iov, 4);
+	if (n != (ssize_t)p_hdr->len)
+	{
+		YAMC_ERROR_PRINTF("Error writing spool segment: %s\n", (n < 0) ? strerror(errno) : "short write");
+		return YAMC_RET_INVALID_STATE;
+	}
+
+	p_spool->disk_cnt++;
+	p_spool->wr_len += p_hdr->len;
+
+	// start new segment so drained ones can be removed
+	if (p_spool->wr_len >= YAMC_SPOOL_SEGMENT_LEN)
+	{
+		close(p_spool->wr_fd);
+		p_spool->wr_fd  = -1;
+		p_spool->wr_len = 0;
+		p_spool->wr_seg++;
+	}
+
+	return YAMC_RET_SUCCESS;
+}
+
+// move spilled records to ring while there's room, records on disk are always newer than ones in ring
+static void yamc_spool_refill(yamc_spool_t* const p_spool)
+{
+	YAMC_ASSERT(p_spool != NULL);
+
+	char path[PATH_MAX];
+
+	while (p_spool->disk_cnt > 0)
+	{
+		if (p_spool->rd_fd < 0)
+		{
+			yamc_spool_seg_path(p_spool, p_spool->rd_seg, path, sizeof(path));
+
+			p_spool->rd_fd = open(path, O_RDONLY | O_CLOEXEC);
+			if (p_spool->rd_fd < 0)
+			{
+				YAMC_ERROR_PRINTF("Error opening spool segment %s: %s, %u messages lost\n", path, strerror(errno), p_spool->disk_cnt);
+				yamc_spool_disk_reset(p_spool);
+				return;
+			}
+
+			p_spool->rd_off = 0;
+		}
+
+		yamc_spool_rec_t hdr;
+		ssize_t			 n = pread(p_spool->rd_fd, &hdr, sizeof(hdr), p_spool->rd_off);
+
+		// segment drained, writer has moved on to next one
+		if (n == 0 && p_spool->rd_seg != p_spool->wr_seg)
+		{
+			close(p_spool->rd_fd);
+			yamc_spool_seg_path(p_spool, p_spool->rd_seg, path, sizeof(path));
+			unlink(path);
+
+			p_spool->rd_fd = -1;
+			p_spool->rd_seg++;
+			continue;
+		}
+
+		if (n != sizeof(hdr) || hdr.len < sizeof(hdr) || hdr.len > p_spool->buff_len)
+		{
+			YAMC_ERROR_PRINTF("Error reading spool segment, %u messages lost\n", p_spool->disk_cnt);
+			yamc_spool_disk_reset(p_spool);
+			return;
+		}
+
+		yamc_spool_rec_t* const p_rec = yamc_spool_ring_alloc(p_spool, hdr.len);
+		if (p_rec == NULL) return;
+
+		memcpy(p_rec, &hdr, sizeof(hdr));
+
+		n = pread(p_spool->rd_fd, p_rec->data, hdr.len - sizeof(hdr), p_spool->rd_off + sizeof(hdr));
+		if (n != (ssize_t)(hdr.len - sizeof(hdr)))
+		{
+			// drop the record, ring space is released on next trim
+			YAMC_ERROR_PRINTF("Error reading spool segment, message lost\n");
+			p_rec->state = YAMC_SPOOL_DONE;
+			p_spool->pending_cnt--;
+		}
+
+		p_spool->rd_off += hdr.len;
+		p_spool->disk_cnt--;
+	}
+
+	if (p_spool->rd_fd >= 0 || p_spool->wr_fd >= 0) yamc_spool_disk_reset(p_spool);
+}
+
+// copy message to spool
+yamc_retcode_t yamc_spool_put(yamc_spool_t* const p_spool, const yamc_publish_data_t* const p_data)
+{
+	YAMC_ASSERT(p_spool != NULL);
+	YAMC_ASSERT(p_data != NULL);
+
+	const uint64_t rec_len = YAMC_SPOOL_ALIGN((uint64_t)sizeof(yamc_spool_rec_t) + p_data->topic.len + p_data->data_len);
+
+	// record has to fit memory ring to be published
+	if (rec_len > p_spool->buff_len) return YAMC_RET_INVALID_DATA;
+
+	yamc_spool_rec_t hdr = {.len	   = (uint32_t)rec_len,
+							.state	 = YAMC_SPOOL_PENDING,
+							.QOS	   = p_data->QOS,
+							.RETAIN	= p_data->RETAIN,
+							.topic_len = p_data->topic.len,
+							.data_len  = p_data->data_len,
+							.p_msg_ctx = p_data->p_msg_ctx};
+
+	// keep order, once anything was spilled newer messages go to disk too
+	if (p_spool->disk_cnt == 0 && p_spool->used + hdr.len <= p_spool->spill_threshold)
+	{
+		yamc_spool_rec_t* const p_rec = yamc_spool_ring_alloc(p_spool, hdr.len);
+
+		if (p_rec != NULL)
+		{
+			memcpy(p_rec, &hdr, sizeof(hdr));
+			memcpy(p_rec->data, p_data->topic.str, p_data->topic.len);
+			if (p_data->data_len) memcpy(p_rec->data + p_data->topic.len, p_data->p_data, p_data->data_len);
+
+			return YAMC_RET_SUCCESS;
+		}
+	}
+
+	return yamc_spool_spill(p_spool, &hdr, p_data);
+}
+
+// publish queued messages in order
+yamc_retcode_t yamc_spool_drain(yamc_spool_t* const p_spool, yamc_instance_t* const p_instance)
+{
+	YAMC_ASSERT(p_spool != NULL);
+	YAMC_ASSERT(p_instance != NULL);
+
+	yamc_retcode_t ret = YAMC_RET_SUCCESS;
+
+	// messages sent in one go share single write
+	yamc_batch_begin(p_instance);
+
+	while (true)
+	{
+		if (p_spool->pending_cnt == 0)
+		{
+			yamc_spool_ring_trim(p_spool);
+			yamc_spool_refill(p_spool);
+
+			if (p_spool->pending_cnt == 0) break;
+		}
+
+		const uint32_t			off   = yamc_spool_rec_off(p_spool, p_spool->send);
+		yamc_spool_rec_t* const p_rec = yamc_spool_rec(p_spool, off);
+
+		// requeued ring may contain messages acknowledged before reconnection
+		if (p_rec->state != YAMC_SPOOL_PENDING)
+		{
+			p_spool->send = yamc_spool_next_off(p_spool, off);
+			continue;
+		}
+
+		// requeued message is sent again as duplicate with its original packet id
+		yamc_publish_data_t publish_data = {.topic	 = {.str = p_rec->data, .len = p_rec->topic_len},
+											.QOS	   = p_rec->QOS,
+											.DUP	   = p_rec->packet_id != 0,
+											.RETAIN	= p_rec->RETAIN,
+											.p_data	= p_rec->data + p_rec->topic_len,
+											.data_len  = p_rec->data_len,
+											.p_msg_ctx = p_rec,
+											.packet_id = p_rec->packet_id};
+
+		ret = yamc_publish(p_instance, &publish_data);
+
+		// in-flight window is full, continue after acknowledgement
+		if (ret == YAMC_RET_WOULD_BLOCK)
+		{
+			ret = YAMC_RET_SUCCESS;
+			break;
+		}
+
+		if (ret != YAMC_RET_SUCCESS) break;
+
+		// id was just assigned by yamc_publish()
+		if (p_rec->QOS != YAMC_QOS_LVL0 && p_rec->packet_id == 0) p_rec->packet_id = p_instance->last_packet_id;
+
+		p_rec->state = (p_rec->QOS == YAMC_QOS_LVL0) ? YAMC_SPOOL_DONE : YAMC_SPOOL_SENT;
+		p_spool->send = yamc_spool_next_off(p_spool, off);
+		p_spool->pending_cnt--;
+	}
+
+	yamc_spool_ring_trim(p_spool);
+
+	yamc_retcode_t flush_ret = yamc_batch_end(p_instance);
+
+	return (ret != YAMC_RET_SUCCESS) ? ret : flush_ret;
+}
+
+// release ring space of acknowledged message
+bool yamc_spool_complete(yamc_spool_t* const p_spool, void** const pp_msg_ctx)
+{
+	YAMC_ASSERT(p_spool != NULL);
+	YAMC_ASSERT(pp_msg_ctx != NULL);
+
+	uint8_t* const p_msg = (uint8_t*)*pp_msg_ctx;
+
+	if (p_msg < p_spool->p_buff || p_msg >= p_spool->p_buff + p_spool->buff_len) return false;
+
+	yamc_spool_rec_t* const p_rec = (yamc_spool_rec_t*)p_msg;
+
+	p_rec->state = YAMC_SPOOL_DONE;
+	*pp_msg_ctx  = p_rec->p_msg_ctx;
+
+	yamc_spool_ring_trim(p_spool);
+
+	return true;
+}
+
+// publish unacknowledged messages again on next drain
+void yamc_spool_requeue(yamc_spool_t* const p_spool)
+{
+	YAMC_ASSERT(p_spool != NULL);
+
+	yamc_spool_ring_trim(p_spool);
+
+	uint32_t off = p_spool->tail;
+
+	p_spool->send		 = off;
+	p_spool->pending_cnt = 0;
+
+	for (uint32_t i = 0; i < p_spool->rec_cnt; i++)
+	{
+		off = yamc_spool_rec_off(p_spool, off);
+
+		yamc_spool_rec_t* const p_rec = yamc_spool_rec(p_spool, off);
+
+		if (p_rec->state == YAMC_SPOOL_SENT) p_rec->state = YAMC_SPOOL_PENDING;
+		if (p_rec->state == YAMC_SPOOL_PENDING) p_spool->pending_cnt++;
+
+		off = yamc_spool_next_off(p_spool, off);
+	}
+}
+
+// close and remove segment files
+void yamc_spool_close(yamc_spool_t* const p_spool)
+{
+	YAMC_ASSERT(p_spool != NULL);
+
+	if (p_spool->disk_cnt > 0) YAMC_ERROR_PRINTF("Dropping %u spooled messages\n", p_spool->disk_cnt);
+
+	yamc_spool_disk_reset(p_spool);
+}
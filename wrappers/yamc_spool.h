@@ -0,0 +1,84 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_spool.h - Queues outgoing PUBLISH packets while connection is down or in-flight window is full
+ *
+ * Messages are copied to memory ring, once it fills above threshold they are appended to segment files instead.
+ * Draining refills the ring from segment files and publishes in original order. Ring space of QoS>0 messages
+ * is reused only after they are acknowledged, since yamc in-flight table references topic and payload.
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#ifndef __YAMC_SPOOL_H__
+#define __YAMC_SPOOL_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "yamc.h"
+
+typedef struct
+{
+	uint8_t* p_buff;		   // memory ring, owned by user
+	uint32_t buff_len;		   // memory ring capacity
+	uint32_t spill_threshold;  // new messages go to disk once this many ring bytes are used
+
+	uint32_t head;		   // ring write offset
+	uint32_t tail;		   // oldest record offset
+	uint32_t send;		   // oldest record not published yet
+	uint32_t used;		   // ring bytes in use, including space skipped at ring end
+	uint32_t rec_cnt;	  // records in ring
+	uint32_t pending_cnt;  // records in ring not published yet
+
+	const char* p_dir;	// segment file directory
+	uint32_t	wr_seg;   // segment file currently appended to
+	int			wr_fd;	// its descriptor, -1 if not open
+	uint32_t	wr_len;   // its length
+	uint32_t	rd_seg;   // segment file currently read
+	int			rd_fd;	// its descriptor, -1 if not open
+	uint32_t	rd_off;   // read offset
+	uint32_t	disk_cnt;  // records in segment files
+
+} yamc_spool_t;
+
+/**
+ * \brief initialize spool
+ *
+ * \param p_buff memory ring, has to stay valid as long as spool is used
+ * \param spill_threshold messages are written to segment files once this many ring bytes are used
+ * \param p_dir directory for segment files, existing segment files are overwritten
+ */
+void yamc_spool_init(yamc_spool_t* const p_spool, uint8_t* const p_buff, uint32_t buff_len, uint32_t spill_threshold,
+					 const char* const p_dir);
+
+/// returns true if there are no messages waiting to be published or acknowledged
+bool yamc_spool_is_empty(const yamc_spool_t* const p_spool);
+
+/// copy message to spool, YAMC_RET_INVALID_DATA if message can never fit in memory ring, YAMC_RET_INVALID_STATE on I/O error
+yamc_retcode_t yamc_spool_put(yamc_spool_t* const p_spool, const yamc_publish_data_t* const p_data);
+
+/**
+ * \brief publish queued messages in order
+ *
+ * Stops when in-flight window is full, continue after next acknowledgement.
+ *
+ * \return YAMC_RET_SUCCESS when all messages were sent or window is full, error returned by yamc_publish() otherwise
+ */
+yamc_retcode_t yamc_spool_drain(yamc_spool_t* const p_spool, yamc_instance_t* const p_instance);
+
+/**
+ * \brief release ring space of acknowledged message, call from publish complete handler
+ *
+ * \param pp_msg_ctx message context passed to handler, replaced with context of original message if it was spooled
+ * \return true if message was published from spool
+ */
+bool yamc_spool_complete(yamc_spool_t* const p_spool, void** const pp_msg_ctx);
+
+/// publish unacknowledged messages again on next drain with DUP flag and their packet ids, call after reconnection
+void yamc_spool_requeue(yamc_spool_t* const p_spool);
+
+/// close and remove segment files
+void yamc_spool_close(yamc_spool_t* const p_spool);
+
+#endif /* __YAMC_SPOOL_H__ */
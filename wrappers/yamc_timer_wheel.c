@@ -0,0 +1,153 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_timer_wheel.c - Hierarchical timer wheel for event loops driving many yamc instances
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include <string.h>
+
+#include "yamc_timer_wheel.h"
+#include "yamc.h"
+
+#define YAMC_TIMER_WHEEL_MASK (YAMC_TIMER_WHEEL_SLOTS - 1u)
+
+// longest timeout in ticks wheel can hold
+#define YAMC_TIMER_WHEEL_MAX_TICKS ((1u << (YAMC_TIMER_WHEEL_LEVELS * YAMC_TIMER_WHEEL_BITS)) - 1u)
+
+// slot index of tick on given level
+#define YAMC_TIMER_WHEEL_IDX(tick, level) (((tick) >> ((level)*YAMC_TIMER_WHEEL_BITS)) & YAMC_TIMER_WHEEL_MASK)
+
+void yamc_timer_wheel_init(yamc_timer_wheel_t* const p_wheel, uint32_t tick_ms, uint32_t now_ms)
+{
+	YAMC_ASSERT(p_wheel != NULL);
+	YAMC_ASSERT(tick_ms > 0);
+
+	memset(p_wheel, 0, sizeof(yamc_timer_wheel_t));
+
+	p_wheel->tick_ms = tick_ms;
+	p_wheel->last_ms = now_ms;
+	p_wheel->now_ms  = now_ms;
+}
+
+void yamc_timer_init(yamc_timer_t* const p_timer, yamc_timer_handler_t handler, void* p_ctx)
+{
+	YAMC_ASSERT(p_timer != NULL);
+	YAMC_ASSERT(handler != NULL);
+
+	memset(p_timer, 0, sizeof(yamc_timer_t));
+
+	p_timer->handler = handler;
+	p_timer->p_ctx   = p_ctx;
+}
+
+// put timer to slot matching its expiry, level is picked by distance from current tick
+static void yamc_timer_wheel_add(yamc_timer_wheel_t* const p_wheel, yamc_timer_t* const p_timer)
+{
+	const uint32_t delta = p_timer->expire_tick - p_wheel->tick;
+
+	yamc_timer_t** pp_slot = &p_wheel->slots[0][YAMC_TIMER_WHEEL_IDX(p_timer->expire_tick, 0)];
+
+	for (uint32_t level = 1; level < YAMC_TIMER_WHEEL_LEVELS; level++)
+	{
+		if (delta < (1u << (level * YAMC_TIMER_WHEEL_BITS))) break;
+
+		pp_slot = &p_wheel->slots[level][YAMC_TIMER_WHEEL_IDX(p_timer->expire_tick, level)];
+	}
+
+	p_timer->p_next  = *pp_slot;
+	p_timer->pp_prev = pp_slot;
+
+	if (*pp_slot != NULL) (*pp_slot)->pp_prev = &p_timer->p_next;
+	*pp_slot = p_timer;
+}
+
+void yamc_timer_start(yamc_timer_wheel_t* const p_wheel, yamc_timer_t* const p_timer, uint32_t timeout_ms)
+{
+	YAMC_ASSERT(p_wheel != NULL);
+	YAMC_ASSERT(p_timer != NULL);
+
+	yamc_timer_stop(p_timer);
+
+	// wheel may be behind current time while it catches up, round up so timer never fires early
+	const uint64_t delay_ms = (uint64_t)(p_wheel->now_ms - p_wheel->last_ms) + timeout_ms;
+
+	uint64_t ticks = (delay_ms + p_wheel->tick_ms - 1) / p_wheel->tick_ms;
+	if (ticks > YAMC_TIMER_WHEEL_MAX_TICKS) ticks = YAMC_TIMER_WHEEL_MAX_TICKS;
+
+	p_timer->expire_tick = p_wheel->tick + (uint32_t)ticks;
+
+	yamc_timer_wheel_add(p_wheel, p_timer);
+}
+
+void yamc_timer_stop(yamc_timer_t* const p_timer)
+{
+	YAMC_ASSERT(p_timer != NULL);
+
+	if (p_timer->pp_prev == NULL) return;
+
+	*p_timer->pp_prev = p_timer->p_next;
+	if (p_timer->p_next != NULL) p_timer->p_next->pp_prev = p_timer->pp_prev;
+
+	p_timer->p_next  = NULL;
+	p_timer->pp_prev = NULL;
+}
+
+// move timers of higher level slot closer to expiry, returns slot index
+static uint32_t yamc_timer_wheel_cascade(yamc_timer_wheel_t* const p_wheel, uint32_t level)
+{
+	const uint32_t idx	 = YAMC_TIMER_WHEEL_IDX(p_wheel->tick, level);
+	yamc_timer_t*  p_timer = p_wheel->slots[level][idx];
+
+	p_wheel->slots[level][idx] = NULL;
+
+	while (p_timer != NULL)
+	{
+		yamc_timer_t* const p_next = p_timer->p_next;
+
+		yamc_timer_wheel_add(p_wheel, p_timer);
+		p_timer = p_next;
+	}
+
+	return idx;
+}
+
+// process elapsed ticks
+void yamc_timer_wheel_advance(yamc_timer_wheel_t* const p_wheel, uint32_t now_ms)
+{
+	YAMC_ASSERT(p_wheel != NULL);
+
+	p_wheel->now_ms = now_ms;
+
+	while ((uint32_t)(now_ms - p_wheel->last_ms) >= p_wheel->tick_ms)
+	{
+		p_wheel->last_ms += p_wheel->tick_ms;
+
+		const uint32_t idx = YAMC_TIMER_WHEEL_IDX(p_wheel->tick, 0);
+
+		// lowest level wrapped around, refill it from higher levels
+		if (idx == 0)
+		{
+			for (uint32_t level = 1; level < YAMC_TIMER_WHEEL_LEVELS; level++)
+				if (yamc_timer_wheel_cascade(p_wheel, level) != 0) break;
+		}
+
+		// handlers may start or stop any timer, expired ones are taken off the wheel first
+		yamc_timer_t* p_expired = p_wheel->slots[0][idx];
+
+		p_wheel->slots[0][idx] = NULL;
+		if (p_expired != NULL) p_expired->pp_prev = &p_expired;
+
+		p_wheel->tick++;
+
+		while (p_expired != NULL)
+		{
+			yamc_timer_t* const p_timer = p_expired;
+
+			yamc_timer_stop(p_timer);
+			p_timer->handler(p_timer, p_timer->p_ctx);
+		}
+	}
+}
@@ -0,0 +1,73 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_timer_wheel.h - Hierarchical timer wheel for event loops driving many yamc instances
+ *
+ * Timers are embedded in user structures, starting or stopping one is O(1) and no memory is allocated.
+ * Each of YAMC_TIMER_WHEEL_LEVELS levels has 2^YAMC_TIMER_WHEEL_BITS slots covering progressively longer time spans,
+ * timers move to lower levels as their expiry gets closer. Timers never fire early and fire at most 2 ticks late.
+ * Wheel is not thread safe, use it from event loop thread only.
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#ifndef __YAMC_TIMER_WHEEL_H__
+#define __YAMC_TIMER_WHEEL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "yamc_port.h"
+
+#define YAMC_TIMER_WHEEL_SLOTS (1u << YAMC_TIMER_WHEEL_BITS)
+
+struct yamc_timer_s;
+
+/// Timer expired handler, timer can be started again from here
+typedef void (*yamc_timer_handler_t)(struct yamc_timer_s* const p_timer, void* p_ctx);
+
+typedef struct yamc_timer_s
+{
+	struct yamc_timer_s*  p_next;	// next timer in wheel slot
+	struct yamc_timer_s** pp_prev;   // pointer pointing to this timer, NULL when timer isn't running
+	uint32_t			  expire_tick;
+
+	yamc_timer_handler_t handler;
+	void*				 p_ctx;  // passed to handler
+
+} yamc_timer_t;
+
+typedef struct
+{
+	uint32_t tick_ms;  // wheel resolution
+	uint32_t last_ms;  // time of last processed tick
+	uint32_t now_ms;   // time passed to last advance, timeouts are measured from it
+	uint32_t tick;	 // next tick to process
+
+	yamc_timer_t* slots[YAMC_TIMER_WHEEL_LEVELS][YAMC_TIMER_WHEEL_SLOTS];
+
+} yamc_timer_wheel_t;
+
+/// initialize wheel, now_ms: current monotonic time, allowed to wrap around
+void yamc_timer_wheel_init(yamc_timer_wheel_t* const p_wheel, uint32_t tick_ms, uint32_t now_ms);
+
+/// initialize stopped timer
+void yamc_timer_init(yamc_timer_t* const p_timer, yamc_timer_handler_t handler, void* p_ctx);
+
+/// start or restart timer, timeout counts from last yamc_timer_wheel_advance() and is capped to wheel range
+void yamc_timer_start(yamc_timer_wheel_t* const p_wheel, yamc_timer_t* const p_timer, uint32_t timeout_ms);
+
+/// stop timer, does nothing if timer isn't running
+void yamc_timer_stop(yamc_timer_t* const p_timer);
+
+/// returns true if timer is waiting to expire
+static inline bool yamc_timer_is_running(const yamc_timer_t* const p_timer)
+{
+	return p_timer->pp_prev != NULL;
+}
+
+/// process ticks elapsed until now_ms and call handlers of expired timers
+void yamc_timer_wheel_advance(yamc_timer_wheel_t* const p_wheel, uint32_t now_ms);
+
+#endif /* __YAMC_TIMER_WHEEL_H__ */
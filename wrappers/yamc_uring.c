@@ -0,0 +1,256 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_uring.c - Minimal io_uring ring on top of raw Linux syscalls, used by reactor
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include "yamc_uring.h"
+
+#if YAMC_REACTOR_URING
+
+#include <errno.h>
+#include <linux/time_types.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "yamc_log.h"
+
+static int yamc_uring_setup(uint32_t entries, struct io_uring_params* const p_params)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, p_params);
+}
+
+static int yamc_uring_enter(int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags, void* p_arg, size_t arg_len)
+{
+	return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, p_arg, arg_len);
+}
+
+static int yamc_uring_register(int fd, uint32_t opcode, void* p_arg, uint32_t nr_args)
+{
+	return (int)syscall(__NR_io_uring_register, fd, opcode, p_arg, nr_args);
+}
+
+// map queues and entries of new ring
+static yamc_retcode_t yamc_uring_map(yamc_uring_t* const p_uring, const struct io_uring_params* const p_params)
+{
+	YAMC_ASSERT(p_uring != NULL);
+	YAMC_ASSERT(p_params != NULL);
+
+	p_uring->sq_map_len   = p_params->sq_off.array + p_params->sq_entries * sizeof(uint32_t);
+	p_uring->cq_map_len   = p_params->cq_off.cqes + p_params->cq_entries * sizeof(struct io_uring_cqe);
+	p_uring->sqes_map_len = p_params->sq_entries * sizeof(struct io_uring_sqe);
+
+	const bool single_map = (p_params->features & IORING_FEAT_SINGLE_MMAP) != 0;
+	if (single_map && p_uring->cq_map_len > p_uring->sq_map_len) p_uring->sq_map_len = p_uring->cq_map_len;
+
+	p_uring->p_sq_map =
+		mmap(NULL, p_uring->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, p_uring->fd, IORING_OFF_SQ_RING);
+	if (p_uring->p_sq_map == MAP_FAILED)
+	{
+		p_uring->p_sq_map = NULL;
+		return YAMC_RET_INVALID_STATE;
+	}
+
+	uint8_t* p_cq_base = p_uring->p_sq_map;
+
+	if (!single_map)
+	{
+		p_uring->p_cq_map =
+			mmap(NULL, p_uring->cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, p_uring->fd, IORING_OFF_CQ_RING);
+		if (p_uring->p_cq_map == MAP_FAILED)
+		{
+			p_uring->p_cq_map = NULL;
+			return YAMC_RET_INVALID_STATE;
+		}
+
+		p_cq_base = p_uring->p_cq_map;
+	}
+
+	p_uring->p_sqes =
+		mmap(NULL, p_uring->sqes_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, p_uring->fd, IORING_OFF_SQES);
+	if (p_uring->p_sqes == MAP_FAILED)
+	{
+		p_uring->p_sqes = NULL;
+		return YAMC_RET_INVALID_STATE;
+	}
+
+	uint8_t* const p_sq_base = p_uring->p_sq_map;
+
+	p_uring->p_sq_head  = (uint32_t*)(p_sq_base + p_params->sq_off.head);
+	p_uring->p_sq_tail  = (uint32_t*)(p_sq_base + p_params->sq_off.tail);
+	p_uring->p_sq_array = (uint32_t*)(p_sq_base + p_params->sq_off.array);
+	p_uring->sq_mask	= *(uint32_t*)(p_sq_base + p_params->sq_off.ring_mask);
+	p_uring->sq_entries = p_params->sq_entries;
+	p_uring->sq_tail	= *p_uring->p_sq_tail;
+
+	p_uring->p_cq_head = (uint32_t*)(p_cq_base + p_params->cq_off.head);
+	p_uring->p_cq_tail = (uint32_t*)(p_cq_base + p_params->cq_off.tail);
+	p_uring->cq_mask   = *(uint32_t*)(p_cq_base + p_params->cq_off.ring_mask);
+	p_uring->p_cqes	= (struct io_uring_cqe*)(p_cq_base + p_params->cq_off.cqes);
+
+	return YAMC_RET_SUCCESS;
+}
+
+// allocate receive buffers and their ring, register them as provided buffer group
+static yamc_retcode_t yamc_uring_buf_setup(yamc_uring_t* const p_uring, uint16_t buf_cnt, uint32_t buf_len)
+{
+	YAMC_ASSERT(p_uring != NULL);
+	YAMC_ASSERT(buf_cnt > 0 && (buf_cnt & (buf_cnt - 1)) == 0);
+
+	p_uring->buf_cnt	  = buf_cnt;
+	p_uring->buf_len	  = buf_len;
+	p_uring->buf_ring_len = (size_t)buf_cnt * sizeof(struct io_uring_buf);
+
+	// buffer ring has to be page aligned, buffers follow it in the same mapping
+	const size_t map_len = p_uring->buf_ring_len + (size_t)buf_cnt * buf_len;
+
+	void* p_map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p_map == MAP_FAILED) return YAMC_RET_INVALID_STATE;
+
+	p_uring->p_buf_ring = p_map;
+	p_uring->p_bufs		= (uint8_t*)p_map + p_uring->buf_ring_len;
+
+	struct io_uring_buf_reg reg = {.ring_addr = (uint64_t)(uintptr_t)p_map, .ring_entries = buf_cnt, .bgid = YAMC_URING_BGID};
+
+	if (yamc_uring_register(p_uring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+	{
+		munmap(p_map, map_len);
+		p_uring->p_buf_ring = NULL;
+		return YAMC_RET_INVALID_STATE;
+	}
+
+	for (uint16_t bid = 0; bid < buf_cnt; bid++) yamc_uring_buf_recycle(p_uring, bid);
+
+	return YAMC_RET_SUCCESS;
+}
+
+yamc_retcode_t yamc_uring_init(yamc_uring_t* const p_uring, uint32_t entries, uint16_t buf_cnt, uint32_t buf_len)
+{
+	YAMC_ASSERT(p_uring != NULL);
+
+	memset(p_uring, 0, sizeof(yamc_uring_t));
+
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	p_uring->fd = yamc_uring_setup(entries, &params);
+	if (p_uring->fd < 0)
+	{
+		YAMC_LOG_DEBUG("io_uring_setup() error: %s\n", strerror(errno));
+		return YAMC_RET_INVALID_STATE;
+	}
+
+	// reactor relies on waiting with timeout and completions never being dropped
+	const uint32_t required_features = IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+
+	if ((params.features & required_features) != required_features || yamc_uring_map(p_uring, &params) != YAMC_RET_SUCCESS ||
+		yamc_uring_buf_setup(p_uring, buf_cnt, buf_len) != YAMC_RET_SUCCESS)
+	{
+		YAMC_LOG_DEBUG("io_uring lacks features reactor needs\n");
+		yamc_uring_free(p_uring);
+		return YAMC_RET_INVALID_STATE;
+	}
+
+	return YAMC_RET_SUCCESS;
+}
+
+// get free submission queue entry
+struct io_uring_sqe* yamc_uring_get_sqe(yamc_uring_t* const p_uring)
+{
+	YAMC_ASSERT(p_uring != NULL);
+
+	// queue full, make room by submitting without waiting
+	if (p_uring->sq_tail - __atomic_load_n(p_uring->p_sq_head, __ATOMIC_ACQUIRE) >= p_uring->sq_entries)
+	{
+		if (yamc_uring_submit_and_wait(p_uring, 0) < 0) return NULL;
+		if (p_uring->sq_tail - __atomic_load_n(p_uring->p_sq_head, __ATOMIC_ACQUIRE) >= p_uring->sq_entries) return NULL;
+	}
+
+	const uint32_t idx = p_uring->sq_tail & p_uring->sq_mask;
+
+	struct io_uring_sqe* const p_sqe = &p_uring->p_sqes[idx];
+	memset(p_sqe, 0, sizeof(struct io_uring_sqe));
+
+	p_uring->p_sq_array[idx] = idx;
+	p_uring->sq_tail++;
+
+	return p_sqe;
+}
+
+// submit pending entries, optionally waiting for completion
+int yamc_uring_submit_and_wait(yamc_uring_t* const p_uring, int timeout_ms)
+{
+	YAMC_ASSERT(p_uring != NULL);
+
+	// entries left over by interrupted enter are submitted again
+	const uint32_t to_submit = p_uring->sq_tail - __atomic_load_n(p_uring->p_sq_head, __ATOMIC_ACQUIRE);
+
+	__atomic_store_n(p_uring->p_sq_tail, p_uring->sq_tail, __ATOMIC_RELEASE);
+
+	struct __kernel_timespec	 ts  = {.tv_sec = timeout_ms / 1000, .tv_nsec = (long long)(timeout_ms % 1000) * 1000000LL};
+	struct io_uring_getevents_arg arg = {.ts = (uint64_t)(uintptr_t)&ts};
+
+	const bool	 wait		  = (timeout_ms != 0);
+	const bool	 has_timeout  = (timeout_ms > 0);
+	const uint32_t flags		  = (wait ? IORING_ENTER_GETEVENTS : 0) | (has_timeout ? IORING_ENTER_EXT_ARG : 0);
+
+	if (to_submit == 0 && !wait) return 0;
+
+	int ret = yamc_uring_enter(p_uring->fd, to_submit, (wait ? 1 : 0), flags, (has_timeout ? &arg : NULL), (has_timeout ? sizeof(arg) : 0));
+	if (ret >= 0) return ret;
+
+	// wait ended by timeout or signal, or kernel is short of resources, pending entries stay queued
+	if (errno == ETIME || errno == EINTR || errno == EAGAIN || errno == EBUSY) return 0;
+
+	YAMC_ERROR_PRINTF("io_uring_enter() error: %s\n", strerror(errno));
+	return -1;
+}
+
+// put receive buffer back to kernel buffer ring
+void yamc_uring_buf_recycle(yamc_uring_t* const p_uring, uint16_t bid)
+{
+	YAMC_ASSERT(p_uring != NULL);
+	YAMC_ASSERT(bid < p_uring->buf_cnt);
+
+	struct io_uring_buf* const p_buf = &p_uring->p_buf_ring->bufs[p_uring->buf_tail & (p_uring->buf_cnt - 1)];
+
+	p_buf->addr = (uint64_t)(uintptr_t)yamc_uring_buf(p_uring, bid);
+	p_buf->len  = p_uring->buf_len;
+	p_buf->bid  = bid;
+
+	p_uring->buf_tail++;
+	__atomic_store_n(&p_uring->p_buf_ring->tail, p_uring->buf_tail, __ATOMIC_RELEASE);
+}
+
+// release ring resources
+void yamc_uring_free(yamc_uring_t* const p_uring)
+{
+	YAMC_ASSERT(p_uring != NULL);
+
+	if (p_uring->p_buf_ring != NULL)
+	{
+		struct io_uring_buf_reg reg = {.bgid = YAMC_URING_BGID};
+		yamc_uring_register(p_uring->fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+
+		munmap(p_uring->p_buf_ring, p_uring->buf_ring_len + (size_t)p_uring->buf_cnt * p_uring->buf_len);
+		p_uring->p_buf_ring = NULL;
+	}
+
+	if (p_uring->p_sqes != NULL) munmap(p_uring->p_sqes, p_uring->sqes_map_len);
+	if (p_uring->p_cq_map != NULL) munmap(p_uring->p_cq_map, p_uring->cq_map_len);
+	if (p_uring->p_sq_map != NULL) munmap(p_uring->p_sq_map, p_uring->sq_map_len);
+
+	p_uring->p_sqes   = NULL;
+	p_uring->p_cq_map = NULL;
+	p_uring->p_sq_map = NULL;
+
+	if (p_uring->fd >= 0) close(p_uring->fd);
+	p_uring->fd = -1;
+}
+
+#endif /* YAMC_REACTOR_URING */
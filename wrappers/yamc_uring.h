@@ -0,0 +1,123 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_uring.h - Minimal io_uring ring on top of raw Linux syscalls, used by reactor
+ *
+ * Only what reactor needs is covered: submission and completion queues and single group of provided receive buffers.
+ * Ring is not thread safe, it belongs to reactor thread.
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#ifndef __YAMC_URING_H__
+#define __YAMC_URING_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "yamc.h"
+#include "yamc_port.h"
+
+#if YAMC_REACTOR_URING
+#include <linux/io_uring.h>
+
+// kernel headers older than 6.0 lack multishot receive, reactor uses epoll then
+#ifndef IORING_RECV_MULTISHOT
+#undef YAMC_REACTOR_URING
+#define YAMC_REACTOR_URING 0
+#endif
+#endif
+
+#if YAMC_REACTOR_URING
+
+/// provided buffer group used for receive
+#define YAMC_URING_BGID 0
+
+typedef struct
+{
+	int fd;
+
+	// submission queue
+	uint32_t*			 p_sq_head;
+	uint32_t*			 p_sq_tail;
+	uint32_t*			 p_sq_array;
+	uint32_t			 sq_mask;
+	uint32_t			 sq_entries;
+	uint32_t			 sq_tail;	// local tail, entries up to it are submitted on next enter
+	struct io_uring_sqe* p_sqes;
+
+	// completion queue
+	uint32_t*			 p_cq_head;
+	uint32_t*			 p_cq_tail;
+	uint32_t			 cq_mask;
+	struct io_uring_cqe* p_cqes;
+
+	void*  p_sq_map;
+	size_t sq_map_len;
+	void*  p_cq_map;  // NULL if both queues share mapping
+	size_t cq_map_len;
+	size_t sqes_map_len;
+
+	// provided receive buffers
+	struct io_uring_buf_ring* p_buf_ring;
+	size_t					  buf_ring_len;
+	uint8_t*				  p_bufs;
+	uint32_t				  buf_len;
+	uint16_t				  buf_cnt;
+	uint16_t				  buf_tail;  // local copy of buffer ring tail
+
+} yamc_uring_t;
+
+/**
+ * \brief set up ring and register provided receive buffers
+ *
+ * \param entries submission queue size
+ * \param buf_cnt number of receive buffers, power of 2
+ * \param buf_len length of each receive buffer
+ * \return YAMC_RET_SUCCESS or YAMC_RET_INVALID_STATE if kernel doesn't support io_uring or features reactor needs
+ */
+yamc_retcode_t yamc_uring_init(yamc_uring_t* const p_uring, uint32_t entries, uint16_t buf_cnt, uint32_t buf_len);
+
+/// returns zeroed submission queue entry, pending entries are submitted first if queue is full. NULL on error.
+struct io_uring_sqe* yamc_uring_get_sqe(yamc_uring_t* const p_uring);
+
+/**
+ * \brief submit pending entries and wait for at least one completion
+ *
+ * \param timeout_ms maximum wait time, 0 doesn't wait, negative waits until completion arrives
+ * \return number of submitted entries or -1 on error, waiting interrupted by timeout or signal isn't an error
+ */
+int yamc_uring_submit_and_wait(yamc_uring_t* const p_uring, int timeout_ms);
+
+/// returns oldest completion not consumed yet or NULL
+static inline struct io_uring_cqe* yamc_uring_peek_cqe(yamc_uring_t* const p_uring)
+{
+	const uint32_t head = *p_uring->p_cq_head;
+
+	if (head == __atomic_load_n(p_uring->p_cq_tail, __ATOMIC_ACQUIRE)) return NULL;
+
+	return &p_uring->p_cqes[head & p_uring->cq_mask];
+}
+
+/// hand completion returned by yamc_uring_peek_cqe() back to kernel
+static inline void yamc_uring_cqe_seen(yamc_uring_t* const p_uring)
+{
+	__atomic_store_n(p_uring->p_cq_head, *p_uring->p_cq_head + 1, __ATOMIC_RELEASE);
+}
+
+/// receive buffer selected by kernel for completion with IORING_CQE_F_BUFFER flag
+static inline uint8_t* yamc_uring_buf(const yamc_uring_t* const p_uring, const uint16_t bid)
+{
+	return p_uring->p_bufs + (size_t)bid * p_uring->buf_len;
+}
+
+/// give receive buffer back to kernel once its data were processed
+void yamc_uring_buf_recycle(yamc_uring_t* const p_uring, uint16_t bid);
+
+/// unregister buffers and tear down ring, requests still in flight are dropped
+void yamc_uring_free(yamc_uring_t* const p_uring);
+
+#endif /* YAMC_REACTOR_URING */
+
+#endif /* __YAMC_URING_H__ */
@@ -22,6 +22,7 @@ typedef enum {
 	YAMC_RET_INVALID_DATA,   /// Data format error
 	YAMC_RET_INVALID_STATE,  /// Invalid state
 	YAMC_RET_CANT_PARSE,	 /// Parser error
+	YAMC_RET_WOULD_BLOCK,	/// No room for another in-flight packet, retry after acknowledgement arrives
 
 } yamc_retcode_t;
 
@@ -102,9 +103,66 @@ typedef struct
 	bool			 RETAIN;	///< packet RETAIN flag
 	const uint8_t*   p_data;	///< payload data
 	uint32_t		 data_len;  ///< payload data length
+	void*			 p_msg_ctx; ///< (optional) passed to publish complete handler when QoS>0 message is acknowledged
+	uint16_t		 packet_id; ///< (optional) QoS>0 resend keeps packet id of earlier transmission, 0: new id is allocated
 
 } yamc_publish_data_t;
 
+/**
+ * \brief Pre-encoded PUBLISH packet header for fixed topic
+ *
+ * Prepared once with yamc_publish_template_init(), then used by yamc_publish_template()
+ * which only has to add remaining length, packet id and payload.
+ */
+typedef struct
+{
+	uint8_t			 pkt_type_raw;	  ///< encoded packet type and flags byte
+	uint8_t			 topic_len_raw[2];  ///< encoded topic length field
+	yamc_mqtt_string topic;			  ///< publish topic, owned by user, has to stay valid as long as template is used
+	uint32_t		 var_hdr_len;	   ///< variable header length: topic field and packet id
+
+} yamc_publish_template_t;
+
+/// Highest valid MQTT packet identifier, 0 is not allowed
+#define YAMC_PKT_ID_MAX 65535
+
+/// Number of 32 bit words in packet id in-use bitmap covering given id window
+#define YAMC_PKT_ID_USE_WORDS(window) (((uint32_t)(window) + 31) / 32)
+
+/// Number of 32 bit words in packet id bitmap: in-use bits followed by 2 bits per id recording expected acknowledgement
+#define YAMC_PKT_ID_BITMAP_WORDS(window) (3 * YAMC_PKT_ID_USE_WORDS(window))
+
+/// Outgoing QoS>0 PUBLISH delivery state
+typedef enum {
+	YAMC_INFLIGHT_FREE = 0,		///< entry not in use
+	YAMC_INFLIGHT_WAIT_PUBACK,  ///< QoS1 PUBLISH sent, waiting for PUBACK
+	YAMC_INFLIGHT_WAIT_PUBREC,  ///< QoS2 PUBLISH sent, waiting for PUBREC
+	YAMC_INFLIGHT_WAIT_PUBCOMP  ///< QoS2 PUBREL sent, waiting for PUBCOMP
+
+} yamc_inflight_state_t;
+
+/// In-flight table index marking end of entry list
+#define YAMC_INFLIGHT_NONE UINT16_MAX
+
+/**
+ * \brief Outgoing QoS>0 PUBLISH waiting for acknowledgement
+ *
+ * Topic and payload are not copied, they are owned by user and have to stay valid until message is acknowledged.
+ */
+typedef struct
+{
+	yamc_inflight_state_t state;	  ///< delivery state
+	uint16_t			  packet_id;  ///< packet identifier
+	bool				  RETAIN;	 ///< packet RETAIN flag
+	uint32_t			  sent_ms;	///< timestamp of last (re)transmission
+	yamc_mqtt_string	  topic;	  ///< publish topic
+	const uint8_t*		  p_data;	 ///< payload data
+	uint32_t			  data_len;   ///< payload data length
+	void*				  p_msg_ctx;  ///< user context passed to publish complete handler
+	uint16_t			  next;	   ///< internal: next entry in send order, next free entry when unused
+
+} yamc_inflight_entry_t;
+
 ///Outgoing SUBSCRIBE packet definition
 typedef yamc_mqtt_pkt_subscribe_topic_t yamc_subscribe_data_t;
 
@@ -114,9 +172,23 @@ struct yamc_instance_s;
 /// Socket write handler
 typedef yamc_retcode_t (*yamc_write_handler_t)(void* p_ctx, const uint8_t* const p_buff, uint32_t buff_len);
 
+/// Scatter/gather write segment
+typedef struct
+{
+	const uint8_t* p_data;  ///< segment data
+	uint32_t	   len;		///< segment length
+
+} yamc_iovec_t;
+
+/// Scatter/gather socket write handler, has to write all segments in order
+typedef yamc_retcode_t (*yamc_writev_handler_t)(void* p_ctx, const yamc_iovec_t* const p_iov, uint32_t iov_len);
+
 /// Disconnection request handler - signal main application that we should disconnect form server
 typedef void (*yamc_disconnect_handler_t)(void* p_ctx);
 
+/// Get monotonic timestamp in milliseconds, allowed to wrap around
+typedef uint32_t (*yamc_timestamp_handler_t)(void* p_ctx);
+
 /// Start or pat (prolong) timeout timer
 typedef void (*yamc_timeout_pat_handler_t)(void* p_ctx);
 
@@ -126,13 +198,70 @@ typedef void (*yamc_timeout_stop_handler_t)(void* p_ctx);
 /// New packet handler
 typedef void (*yamc_pkt_handler_t)(struct yamc_instance_s* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data, void* p_ctx);
 
+/**
+ * \brief Outgoing QoS>0 PUBLISH delivery complete handler
+ *
+ * Called on PUBACK (QoS1) or PUBCOMP (QoS2) of a message stored in in-flight table. Topic and payload
+ * of the message are no longer referenced by yamc. Next message can be published from this handler.
+ */
+typedef void (*yamc_pub_complete_handler_t)(struct yamc_instance_s* const p_instance, uint16_t packet_id, void* p_msg_ctx, void* p_ctx);
+
+/**
+ * \brief In-flight entry save handler
+ *
+ * Called when QoS>0 PUBLISH is stored in slot of in-flight table and when its delivery state changes.
+ * Lets user persist unacknowledged messages, slot index stays the same until entry is released.
+ */
+typedef void (*yamc_inflight_save_handler_t)(void* p_ctx, uint16_t slot, const yamc_inflight_entry_t* const p_entry);
+
+/// In-flight entry release handler, message stored in given slot has been acknowledged
+typedef void (*yamc_inflight_release_handler_t)(void* p_ctx, uint16_t slot);
+
+/**
+ * \brief Streamed PUBLISH begin handler
+ *
+ * Called for PUBLISH packets split across yamc_parse_buff() calls and too long for receive buffer once topic and packet id
+ * are decoded. Packets that arrive whole in one buffer are passed to packet handler instead.
+ * payload.p_data is NULL and payload.data_len holds total payload length.
+ */
+typedef void (*yamc_stream_begin_handler_t)(struct yamc_instance_s* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data,
+											void* p_ctx);
+
+/// Streamed PUBLISH payload chunk handler, p_chunk points directly into buffer passed to yamc_parse_buff()
+typedef void (*yamc_stream_chunk_handler_t)(struct yamc_instance_s* const p_instance, const uint8_t* const p_chunk, uint32_t chunk_len,
+											void* p_ctx);
+
+/// Streamed PUBLISH end handler, called after last payload chunk with the same packet data as begin handler
+typedef void (*yamc_stream_end_handler_t)(struct yamc_instance_s* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data,
+										  void* p_ctx);
+
+/**
+ * \brief Receive buffer grow handler
+ *
+ * Called when incoming packet split across yamc_parse_buff() calls doesn't fit current receive buffer.
+ * Packets that arrive whole in one buffer are decoded in place and never grow receive buffer.
+ * Return buffer at least required_len bytes long and store its capacity in p_new_len
+ * or return NULL to stream or skip the packet. Previous buffer is not used by yamc after new one is returned.
+ */
+typedef uint8_t* (*yamc_rx_buff_grow_handler_t)(void* p_ctx, uint32_t required_len, uint32_t* const p_new_len);
+
+/**
+ * \brief Incoming PUBLISH topic filter handler
+ *
+ * Called as soon as topic of incoming PUBLISH packet has arrived, before payload is copied to receive buffer or decoded.
+ * Return false to drop the packet. Dropped QoS>0 packets are still acknowledged with PUBACK or PUBREC.
+ */
+typedef bool (*yamc_topic_filter_handler_t)(struct yamc_instance_s* const p_instance, const yamc_mqtt_string* const p_topic,
+											void* p_ctx);
+
 /// MQTT parser state enum
 typedef enum {
 	YAMC_PARSER_IDLE = 0,  ///< Idle state packet type and length unknown
 	YAMC_PARSER_FIX_HDR,   ///< Parser is collecting fixed header data
 	YAMC_PARSER_VAR_DATA,  ///< Parser is collecting variable header and/or data
 	YAMC_PARSER_DONE,	  ///< Complete packet has been received
-	YAMC_PARSER_SKIP_PKT   ///< Packet is too long to process, drop data until next one arrives
+	YAMC_PARSER_SKIP_PKT,  ///< Packet is too long to process, drop data until next one arrives
+	YAMC_PARSER_STREAM	 ///< PUBLISH packet is too long for rx buffer, pass payload to stream handlers
 
 } yamc_parser_state_t;
 
@@ -140,20 +269,54 @@ typedef struct
 {
 	yamc_disconnect_handler_t   disconnect;		///< Server disconnection handler
 	yamc_write_handler_t		write;			///< Write data to server handler
-	yamc_timeout_pat_handler_t  timeout_pat;	///< start/restart timeout timer handler
-	yamc_timeout_stop_handler_t timeout_stop;   ///< stop timeout timer handler
+	yamc_writev_handler_t		writev;			///< (optional) scatter/gather write handler, requires tx buffer
+	yamc_timeout_pat_handler_t  timeout_pat;	///< (optional) start/restart timeout timer, called once per yamc_parse_buff() ending mid-packet
+	yamc_timeout_stop_handler_t timeout_stop;   ///< (optional) stop timeout timer, called once per yamc_parse_buff() ending on packet boundary
 	yamc_pkt_handler_t			pkt_handler;	///< New packet handler
+	yamc_stream_begin_handler_t stream_begin;   ///< (optional) streamed PUBLISH begin handler
+	yamc_stream_chunk_handler_t stream_chunk;   ///< (optional) streamed PUBLISH payload chunk handler
+	yamc_stream_end_handler_t   stream_end;		///< (optional) streamed PUBLISH end handler
+	yamc_rx_buff_grow_handler_t rx_buff_grow;   ///< (optional) receive buffer grow handler
+	yamc_topic_filter_handler_t topic_filter;   ///< (optional) drop incoming PUBLISH packets by topic before payload is processed
+	yamc_timestamp_handler_t	timestamp;		///< (optional) millisecond timestamp, required for timed retransmission, yamc_rx_timeout_left() and keepalive
+	yamc_pub_complete_handler_t pub_complete;   ///< (optional) outgoing QoS>0 PUBLISH acknowledged, requires in-flight table
+	yamc_inflight_save_handler_t	inflight_save;		///< (optional) persist in-flight entry, requires in-flight table
+	yamc_inflight_release_handler_t inflight_release;   ///< (optional) drop persisted in-flight entry, requires in-flight table
 	void*						p_handler_ctx;  ///< handler context, can be null
 
 } yamc_handler_cfg_t;
 
-/// yamc instance struct
+/// User supplied buffers, owned by user and have to stay valid as long as yamc instance is used
+typedef struct
+{
+	uint8_t* p_rx_buff;	///< receive buffer for packets split across yamc_parse_buff() calls
+	uint32_t rx_buff_len;  ///< receive buffer capacity, at least 4 bytes. Longer split packets are grown, streamed or skipped
+	uint8_t* p_tx_buff;	///< (optional) transmit buffer, outgoing packets are encoded here and sent with single write
+	uint32_t tx_buff_len;  ///< transmit buffer capacity, packet fields that don't fit are written separately
+
+	yamc_inflight_entry_t* p_inflight;	///< (optional) table for outgoing QoS>0 PUBLISH packets waiting for acknowledgement
+	uint16_t			   inflight_len;  ///< in-flight table length, maximum number of unacknowledged QoS>0 PUBLISH packets
+
+	uint32_t* p_pkt_id_bitmap;  ///< (optional) in-use packet id bitmap, YAMC_PKT_ID_BITMAP_WORDS(pkt_id_window) words long
+	uint16_t  pkt_id_window;	///< packet ids are allocated from range 1..pkt_id_window, max. YAMC_PKT_ID_MAX
+
+} yamc_buff_cfg_t;
+
+/**
+ * \brief yamc instance struct
+ *
+ * Fields are grouped by who writes them: configuration read on every call, state written while incoming data
+ * are parsed and state written when packets are sent. Groups start on separate cache lines, so receiving and sending
+ * from different cores doesn't make them steal the same line from each other. Dynamically allocated instances
+ * (or structs embedding them) need YAMC_CACHE_LINE_LEN aligned memory, i.e. from aligned_alloc().
+ */
 typedef struct yamc_instance_s
 {
+	/*
+	 * Configuration, written at initialization only
+	 */
+
 	yamc_handler_cfg_t  handlers;		 ///< event handlers
-	yamc_mqtt_pkt_t		rx_pkt;			 ///< Incoming packet buffer
-	yamc_parser_state_t parser_state;	///< Incoming packet parser state
-	uint16_t			last_packet_id;  ///< id of last packet sent to server
 
 	/// Enable parsing of given packet type
 	struct
@@ -169,19 +332,128 @@ typedef struct yamc_instance_s
 		uint8_t PINGRESP : 1;
 	} parser_enables;
 
+	/// Optional protocol handling, disabled by default
+	struct
+	{
+		/**
+		 * \brief acknowledge QoS>0 packets automatically
+		 *
+		 * PUBACK/PUBREC are sent for incoming PUBLISH, PUBREL for PUBREC and PUBCOMP for PUBREL.
+		 * Acks are queued and written together after incoming data is parsed.
+		 * PUBREC and PUBREL are not passed to packet handler.
+		 */
+		uint8_t auto_ack : 1;
+	} options;
+
+	/// Packet ids waiting for acknowledgement
+	struct
+	{
+		uint32_t* p_bitmap;  ///< in-use bitmap, bit n set: id n+1 in use, then acknowledgement type bits. Owned by user, NULL: ids are not tracked
+		uint16_t  window;	///< number of ids covered by bitmap
+
+	} pkt_ids;
+
+	/*
+	 * Receive state, written while incoming data are parsed
+	 */
+
+	yamc_parser_state_t parser_state YAMC_CACHE_ALIGNED;  ///< Incoming packet parser state
+	uint32_t			rx_data_ms;		 ///< timestamp of last data of incomplete packet, see yamc_rx_timeout_left()
+	yamc_mqtt_pkt_t		rx_pkt;			 ///< Incoming packet buffer
+
+	/// Protocol acknowledgements written at the end of yamc_parse_buff() call
+	struct
+	{
+		uint8_t frames[YAMC_ACK_QUEUE_LEN][4];  ///< encoded PUBACK, PUBREC, PUBREL or PUBCOMP packets
+		uint8_t cnt;							///< number of queued packets
+		uint8_t in_parse;						///< yamc_parse_buff() is running, acks sent from packet handler are queued too
+
+	} ack_queue;
+
+	/// Packet ids of incoming QoS2 PUBLISH packets waiting for PUBREL, hash set with 0 as empty slot
+	struct
+	{
+		uint16_t ids[YAMC_QOS2_RX_IDS_LEN];  ///< hash set slots
+		uint16_t cnt;						 ///< number of stored ids
+
+	} qos2_rx;
+
+	/// Acknowledgements of transmit side state, kept apart from it so receiving doesn't write transmit cache line
+	struct
+	{
+		uint32_t ack_queue_tx_ms;  ///< timestamp of last ack queue write, counts as connection activity for keepalive
+		uint16_t inflight_cnt;	 ///< number of acknowledged in-flight entries, wraps around, see inflight.sent_cnt
+		uint8_t  pingresp_cnt;	 ///< number of PINGRESP packets answering PINGREQ, wraps around, see keepalive.pingreq_cnt
+
+	} rx_acks;
+
+	/*
+	 * Transmit state, written when packets are sent
+	 */
+
+	/// Outgoing packet buffer
+	struct
+	{
+		uint8_t* data;		 ///< packet data buffer, owned by user. NULL: write packet fields one by one
+		uint32_t data_size;  ///< data buffer capacity
+		uint32_t pos;		 ///< data write pointer position
+
+		yamc_iovec_t iov[YAMC_TX_IOV_MAX];  ///< segments for scatter/gather write handler
+		uint8_t		 iov_cnt;				///< number of segments in use
+		uint8_t		 iov_open;				///< last segment points to tx buffer and can be extended
+		uint8_t		 iov_in_place;			///< a segment points to caller's data, has to be flushed before send function returns
+
+		uint8_t batch_depth;  ///< yamc_batch_begin() nesting level, packets are not flushed individually when non-zero
+
+	} tx_buff YAMC_CACHE_ALIGNED;
+
+	uint16_t			last_packet_id;  ///< id of last packet sent to server
+
+	/// Keepalive state, see yamc_keepalive_poll()
+	struct
+	{
+		uint32_t interval_ms;   ///< keepalive interval sent in CONNECT, 0: keepalive is not managed by yamc
+		uint32_t tx_ms;		 ///< timestamp of last write to server
+		uint32_t ping_ms;	   ///< timestamp of PINGREQ waiting for PINGRESP
+		uint8_t  pingreq_cnt;   ///< number of PINGREQ packets expecting PINGRESP, wraps around. PINGREQ is pending while it differs from rx_acks.pingresp_cnt
+
+	} keepalive;
+
+	/// Outgoing QoS>0 PUBLISH packets waiting for acknowledgement, linked in send order. Acknowledged slots are reused
+	/// regardless of their position, so single lost acknowledgement doesn't block the table.
+	struct
+	{
+		yamc_inflight_entry_t* p_entries;	///< entry table, owned by user. NULL: in-flight tracking disabled
+		uint16_t			   entries_len;  ///< entry table length
+		uint16_t			   oldest;	   ///< first entry in send order, YAMC_INFLIGHT_NONE if list is empty
+		uint16_t			   newest;	   ///< last entry in send order, YAMC_INFLIGHT_NONE if list is empty
+		uint16_t			   free;		 ///< first unused entry, acknowledged entries are unlinked when list runs out
+		uint16_t			   sent_cnt;	 ///< number of added entries, wraps around. Acknowledged ones are counted by rx_acks.inflight_cnt
+
+	} inflight;
+
 } yamc_instance_t;
 
 /// Initialize yamc instance
-void yamc_init(yamc_instance_t* const p_instance, const yamc_handler_cfg_t* const p_handler_cfg);
+void yamc_init(yamc_instance_t* const p_instance, const yamc_handler_cfg_t* const p_handler_cfg, const yamc_buff_cfg_t* const p_buff_cfg);
 
 /// parse incoming data buffer
 void yamc_parse_buff(yamc_instance_t* const p_instance, const uint8_t* const p_buff, uint32_t len);
 
+/**
+ * \brief check incoming packet timeout without timer per instance, i.e. from event loop or timer wheel
+ *
+ * Incomplete packet times out when no more data arrive within timeout_ms. Requires timestamp handler.
+ *
+ * \return milliseconds left, 0 if packet timed out or UINT32_MAX if no packet is being received
+ */
+uint32_t yamc_rx_timeout_left(const yamc_instance_t* const p_instance, uint32_t now_ms, uint32_t timeout_ms);
+
 ///assign NULL terminated c string to yamc_mqtt_string object
 void yamc_char_to_mqtt_str(const char* const p_char, yamc_mqtt_string* const p_str);
 
 ///Send CONNECT packet
-yamc_retcode_t yamc_connect(const yamc_instance_t* const p_instance, const yamc_connect_data_t* const p_data);
+yamc_retcode_t yamc_connect(yamc_instance_t* const p_instance, const yamc_connect_data_t* const p_data);
 
 ///Set NULL terminated C string as PUBLISH message payload
 void yamc_publish_set_char_payload(const char* const p_char, yamc_publish_data_t* const p_data);
@@ -189,28 +461,86 @@ void yamc_publish_set_char_payload(const char* const p_char, yamc_publish_data_t
 ///Send PUBLISH packet
 yamc_retcode_t yamc_publish(yamc_instance_t* const p_instance, const yamc_publish_data_t* const p_data);
 
+///Validate topic and pre-encode PUBLISH header into template
+yamc_retcode_t yamc_publish_template_init(yamc_publish_template_t* const p_template, const yamc_mqtt_string* const p_topic,
+										  yamc_qos_lvl_t qos, bool retain);
+
+///Send PUBLISH packet with topic and flags from template
+yamc_retcode_t yamc_publish_template(yamc_instance_t* const p_instance, const yamc_publish_template_t* const p_template,
+									 const uint8_t* const p_data, uint32_t data_len);
+
+///Length of PUBLISH packet encoded by yamc_publish_encode(), 0 if data are invalid
+uint32_t yamc_publish_encoded_len(const yamc_publish_data_t* const p_data);
+
+/**
+ * \brief encode complete PUBLISH packet into caller's buffer without touching any yamc instance
+ *
+ * Thread safe, i.e. for producers handing packets over to single writer thread. Packet isn't tracked in in-flight
+ * table, caller assigns packet_id of QoS>0 packet from range not used by yamc instance writing to the same connection.
+ *
+ * \return encoded packet length, 0 if data are invalid or buffer is shorter than yamc_publish_encoded_len()
+ */
+uint32_t yamc_publish_encode(const yamc_publish_data_t* const p_data, uint16_t packet_id, uint8_t* const p_buff, uint32_t buff_len);
+
+///Put persisted QoS>0 PUBLISH back into in-flight table slot, entries have to be restored in original send order
+yamc_retcode_t yamc_inflight_restore(yamc_instance_t* const p_instance, uint16_t slot, const yamc_inflight_entry_t* const p_entry);
+
+///Number of outgoing QoS>0 PUBLISH packets waiting for acknowledgement, 0 if in-flight tracking is disabled
+uint16_t yamc_inflight_pending(const yamc_instance_t* const p_instance);
+
+///Retransmit in-flight packets not acknowledged within timeout_ms with DUP flag set, 0: retransmit all i.e. after reconnect
+yamc_retcode_t yamc_retransmit(yamc_instance_t* const p_instance, uint32_t timeout_ms);
+
+/**
+ * \brief retransmission scheduler, to be called from the same timer as yamc_keepalive_poll()
+ *
+ * Resends in-flight packets not acknowledged within timeout_ms, see yamc_retransmit(). Failed write is retried
+ * on next timeout, lost connection is caught by keepalive.
+ *
+ * \return milliseconds until oldest in-flight packet expires or UINT32_MAX if nothing waits for acknowledgement
+ */
+uint32_t yamc_retransmit_poll(yamc_instance_t* const p_instance, uint32_t now_ms, uint32_t timeout_ms);
+
 ///Send SUBSCRIBE packet
 yamc_retcode_t yamc_subscribe(yamc_instance_t* const p_instance, const yamc_subscribe_data_t* const p_data, uint16_t data_len);
 
 //Send UNSUBSCRIBE packet
 yamc_retcode_t yamc_unsubscribe(yamc_instance_t* const p_instance, const yamc_mqtt_string* const p_topics, uint16_t topics_len);
 
+///Start collecting outgoing packets in tx buffer, they are written on yamc_batch_end() or when tx buffer fills up
+void yamc_batch_begin(yamc_instance_t* const p_instance);
+
+///Write packets collected since matching yamc_batch_begin()
+yamc_retcode_t yamc_batch_end(yamc_instance_t* const p_instance);
+
 ///Send PINGREQ packet
-yamc_retcode_t yamc_ping(const yamc_instance_t* const p_instance);
+yamc_retcode_t yamc_ping(yamc_instance_t* const p_instance);
+
+/**
+ * \brief keepalive scheduler, sends PINGREQ only when connection is idle
+ *
+ * Keepalive is enabled by yamc_connect() with non-zero keepalive_timeout_s and timestamp handler set.
+ * PINGREQ is sent once nothing was written to server for keepalive interval. If PINGRESP doesn't arrive
+ * within YAMC_PINGRESP_TIMEOUT_MS (or keepalive interval if shorter) disconnect handler is called.
+ * Writes only postpone the deadline, so it's enough to call this when returned time elapses.
+ *
+ * \return milliseconds until next call is due or UINT32_MAX if keepalive is disabled
+ */
+uint32_t yamc_keepalive_poll(yamc_instance_t* const p_instance, uint32_t now_ms);
 
 ///Send DISCONNECT packet
-yamc_retcode_t yamc_disconnect(const yamc_instance_t* const p_instance);
+yamc_retcode_t yamc_disconnect(yamc_instance_t* const p_instance);
 
 ///Send PUBACK packet
-yamc_retcode_t yamc_puback(const yamc_instance_t* const p_instance, uint16_t packet_id);
+yamc_retcode_t yamc_puback(yamc_instance_t* const p_instance, uint16_t packet_id);
 
 ///Send PUBREL packet
-yamc_retcode_t yamc_pubrel(const yamc_instance_t* const p_instance, uint16_t packet_id);
+yamc_retcode_t yamc_pubrel(yamc_instance_t* const p_instance, uint16_t packet_id);
 
 ///Send PUBREC packet
-yamc_retcode_t yamc_pubrec(const yamc_instance_t* const p_instance, uint16_t packet_id);
+yamc_retcode_t yamc_pubrec(yamc_instance_t* const p_instance, uint16_t packet_id);
 
 ///Send PUBCOMP packet
-yamc_retcode_t yamc_pubcomp(const yamc_instance_t* const p_instance, uint16_t packet_id);
+yamc_retcode_t yamc_pubcomp(yamc_instance_t* const p_instance, uint16_t packet_id);
 
 #endif /* YAMC_H_ */
@@ -0,0 +1,25 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_ack_queue.h - Collects protocol acknowledgements sent while incoming data is parsed
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#ifndef __YAMC_ACK_QUEUE_H__
+#define __YAMC_ACK_QUEUE_H__
+
+#include "yamc.h"
+
+/**
+ * \brief encode PUBACK, PUBREC, PUBREL or PUBCOMP into ack queue
+ *
+ * Full queue is written out first. Queued acks are written by yamc_ack_queue_flush().
+ */
+yamc_retcode_t yamc_ack_queue_push(yamc_instance_t* const p_instance, const yamc_pkt_type_t pkt_type, const uint16_t packet_id);
+
+/// write all queued acks at once
+yamc_retcode_t yamc_ack_queue_flush(yamc_instance_t* const p_instance);
+
+#endif /* __YAMC_ACK_QUEUE_H__ */
@@ -0,0 +1,246 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_inflight.c - Tracks outgoing QoS>0 PUBLISH packets until they are acknowledged
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include <string.h>
+#include "yamc.h"
+#include "yamc_inflight.h"
+#include "yamc_log.h"
+#include "yamc_pkt_id.h"
+
+// append entry to the end of send order list
+static inline void yamc_inflight_link(yamc_instance_t* const p_instance, const uint16_t slot)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	p_instance->inflight.p_entries[slot].next = YAMC_INFLIGHT_NONE;
+
+	if (p_instance->inflight.newest == YAMC_INFLIGHT_NONE)
+		p_instance->inflight.oldest = slot;
+	else
+		p_instance->inflight.p_entries[p_instance->inflight.newest].next = slot;
+
+	p_instance->inflight.newest = slot;
+}
+
+/**
+ * \brief find entry in given state by packet id
+ *
+ * Search starts from the oldest entry, since acknowledgements usually arrive in send order
+ * matching entry is found on first try.
+ */
+static yamc_inflight_entry_t* yamc_inflight_find(yamc_instance_t* const p_instance, const yamc_inflight_state_t state,
+												 const uint16_t packet_id)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	for (uint16_t idx = p_instance->inflight.oldest; idx != YAMC_INFLIGHT_NONE; idx = p_instance->inflight.p_entries[idx].next)
+	{
+		yamc_inflight_entry_t* const p_entry = &p_instance->inflight.p_entries[idx];
+
+		if (p_entry->packet_id == packet_id && p_entry->state == state) return p_entry;
+	}
+
+	return NULL;
+}
+
+/**
+ * \brief move acknowledged entries from send order list to free list
+ *
+ * Acknowledgement only marks entry as free, so receiving side never touches list links. Sender collects
+ * free entries once it runs out of unused ones, wherever they are in send order.
+ */
+static void yamc_inflight_reclaim(yamc_instance_t* const p_instance)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	yamc_inflight_entry_t* const p_entries = p_instance->inflight.p_entries;
+
+	uint16_t* p_link = &p_instance->inflight.oldest;
+	uint16_t  last   = YAMC_INFLIGHT_NONE;
+
+	while (*p_link != YAMC_INFLIGHT_NONE)
+	{
+		const uint16_t idx = *p_link;
+
+		if (p_entries[idx].state == YAMC_INFLIGHT_FREE)
+		{
+			*p_link					 = p_entries[idx].next;
+			p_entries[idx].next		 = p_instance->inflight.free;
+			p_instance->inflight.free = idx;
+		}
+		else
+		{
+			last   = idx;
+			p_link = &p_entries[idx].next;
+		}
+	}
+
+	p_instance->inflight.newest = last;
+}
+
+// clear entry table and put all entries on free list
+void yamc_inflight_init(yamc_instance_t* const p_instance, yamc_inflight_entry_t* const p_entries, const uint16_t entries_len)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	p_instance->inflight.p_entries   = p_entries;
+	p_instance->inflight.entries_len = entries_len;
+	p_instance->inflight.oldest		 = YAMC_INFLIGHT_NONE;
+	p_instance->inflight.newest		 = YAMC_INFLIGHT_NONE;
+	p_instance->inflight.free		 = YAMC_INFLIGHT_NONE;
+	p_instance->inflight.sent_cnt	= 0;
+	p_instance->rx_acks.inflight_cnt = 0;
+
+	if (p_entries == NULL) return;
+
+	memset(p_entries, 0, entries_len * sizeof(yamc_inflight_entry_t));
+
+	for (uint16_t i = 0; i < entries_len; i++) p_entries[i].next = (i + 1u < entries_len) ? i + 1u : YAMC_INFLIGHT_NONE;
+
+	p_instance->inflight.free = (entries_len > 0) ? 0 : YAMC_INFLIGHT_NONE;
+}
+
+// returns true if in-flight tracking is enabled and there's no room for another packet
+bool yamc_inflight_is_full(const yamc_instance_t* const p_instance)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	return p_instance->inflight.p_entries != NULL && yamc_inflight_pending(p_instance) == p_instance->inflight.entries_len;
+}
+
+///Number of outgoing QoS>0 PUBLISH packets waiting for acknowledgement
+uint16_t yamc_inflight_pending(const yamc_instance_t* const p_instance)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	// counters wrap around
+	return (uint16_t)(p_instance->inflight.sent_cnt - p_instance->rx_acks.inflight_cnt);
+}
+
+// store sent QoS>0 PUBLISH packet
+void yamc_inflight_add(yamc_instance_t* const p_instance, const yamc_inflight_entry_t* const p_entry)
+{
+	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_entry != NULL);
+	YAMC_ASSERT(p_entry->state != YAMC_INFLIGHT_FREE);
+
+	if (p_instance->inflight.p_entries == NULL) return;
+
+	YAMC_ASSERT(!yamc_inflight_is_full(p_instance));
+
+	if (p_instance->inflight.free == YAMC_INFLIGHT_NONE) yamc_inflight_reclaim(p_instance);
+
+	const uint16_t slot = p_instance->inflight.free;
+
+	YAMC_ASSERT(slot != YAMC_INFLIGHT_NONE);
+
+	p_instance->inflight.free = p_instance->inflight.p_entries[slot].next;
+
+	memcpy(&p_instance->inflight.p_entries[slot], p_entry, sizeof(yamc_inflight_entry_t));
+	yamc_inflight_link(p_instance, slot);
+
+	if (p_instance->handlers.inflight_save != NULL)
+		p_instance->handlers.inflight_save(p_instance->handlers.p_handler_ctx, slot, &p_instance->inflight.p_entries[slot]);
+
+	p_instance->inflight.sent_cnt++;
+}
+
+// update in-flight table on incoming PUBACK, PUBREC or PUBCOMP
+void yamc_inflight_ack(yamc_instance_t* const p_instance, const yamc_pkt_type_t pkt_type, const uint16_t packet_id)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	if (p_instance->inflight.p_entries == NULL) return;
+
+	yamc_inflight_entry_t* p_entry = NULL;
+
+	switch (pkt_type)
+	{
+		// QoS1 delivery complete
+		case YAMC_PKT_PUBACK:
+			p_entry = yamc_inflight_find(p_instance, YAMC_INFLIGHT_WAIT_PUBACK, packet_id);
+			break;
+
+		// QoS2 PUBLISH received by server, PUBREL is sent next
+		case YAMC_PKT_PUBREC:
+			p_entry = yamc_inflight_find(p_instance, YAMC_INFLIGHT_WAIT_PUBREC, packet_id);
+			if (p_entry != NULL)
+			{
+				p_entry->state   = YAMC_INFLIGHT_WAIT_PUBCOMP;
+				p_entry->sent_ms = yamc_timestamp_ms(p_instance);
+
+				if (p_instance->handlers.inflight_save != NULL)
+				{
+					const uint16_t slot = (uint16_t)(p_entry - p_instance->inflight.p_entries);
+					p_instance->handlers.inflight_save(p_instance->handlers.p_handler_ctx, slot, p_entry);
+				}
+			}
+			return;
+
+		// QoS2 delivery complete
+		case YAMC_PKT_PUBCOMP:
+			p_entry = yamc_inflight_find(p_instance, YAMC_INFLIGHT_WAIT_PUBCOMP, packet_id);
+			break;
+
+		default:
+			return;
+	}
+
+	if (p_entry == NULL)
+	{
+		YAMC_LOG_DEBUG("%s for unknown packet id: %u\n", yamc_mqtt_pkt_type_to_str(pkt_type), packet_id);
+		return;
+	}
+
+	void* const p_msg_ctx = p_entry->p_msg_ctx;
+
+	p_entry->state = YAMC_INFLIGHT_FREE;
+
+	if (p_instance->handlers.inflight_release != NULL)
+		p_instance->handlers.inflight_release(p_instance->handlers.p_handler_ctx, (uint16_t)(p_entry - p_instance->inflight.p_entries));
+
+	p_instance->rx_acks.inflight_cnt++;
+
+	// table is consistent again, handler is free to publish next message
+	if (p_instance->handlers.pub_complete != NULL)
+		p_instance->handlers.pub_complete(p_instance, packet_id, p_msg_ctx, p_instance->handlers.p_handler_ctx);
+}
+
+// put persisted QoS>0 PUBLISH back into in-flight table slot
+yamc_retcode_t yamc_inflight_restore(yamc_instance_t* const p_instance, uint16_t slot, const yamc_inflight_entry_t* const p_entry)
+{
+	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_entry != NULL);
+
+	if (p_instance->inflight.p_entries == NULL) return YAMC_RET_INVALID_STATE;
+
+	if (slot >= p_instance->inflight.entries_len || p_entry->state == YAMC_INFLIGHT_FREE || p_entry->packet_id == 0)
+		return YAMC_RET_INVALID_DATA;
+
+	// each slot can be restored only once
+	if (p_instance->inflight.p_entries[slot].state != YAMC_INFLIGHT_FREE) return YAMC_RET_INVALID_DATA;
+
+	// slot is taken out of free list, it can be anywhere in it
+	yamc_inflight_reclaim(p_instance);
+
+	uint16_t* p_link = &p_instance->inflight.free;
+	while (*p_link != slot) p_link = &p_instance->inflight.p_entries[*p_link].next;
+
+	*p_link = p_instance->inflight.p_entries[slot].next;
+
+	memcpy(&p_instance->inflight.p_entries[slot], p_entry, sizeof(yamc_inflight_entry_t));
+	yamc_inflight_link(p_instance, slot);
+
+	p_instance->inflight.sent_cnt++;
+
+	yamc_pkt_id_reserve(p_instance, p_entry->packet_id,
+						(p_entry->state == YAMC_INFLIGHT_WAIT_PUBACK) ? YAMC_PKT_PUBACK : YAMC_PKT_PUBCOMP);
+
+	return YAMC_RET_SUCCESS;
+}
@@ -0,0 +1,38 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_inflight.h - Tracks outgoing QoS>0 PUBLISH packets until they are acknowledged
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#ifndef __YAMC_INFLIGHT_H__
+#define __YAMC_INFLIGHT_H__
+
+#include <stdbool.h>
+#include "yamc.h"
+
+/// get timestamp from user handler, 0 if handler is not set
+static inline uint32_t yamc_timestamp_ms(const yamc_instance_t* const p_instance)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	if (p_instance->handlers.timestamp == NULL) return 0;
+
+	return p_instance->handlers.timestamp(p_instance->handlers.p_handler_ctx);
+}
+
+/// clear entry table and put all entries on free list, NULL table disables in-flight tracking
+void yamc_inflight_init(yamc_instance_t* const p_instance, yamc_inflight_entry_t* const p_entries, const uint16_t entries_len);
+
+/// returns true if in-flight tracking is enabled and there's no room for another packet
+bool yamc_inflight_is_full(const yamc_instance_t* const p_instance);
+
+/// store sent QoS>0 PUBLISH packet, does nothing if in-flight tracking is disabled
+void yamc_inflight_add(yamc_instance_t* const p_instance, const yamc_inflight_entry_t* const p_entry);
+
+/// update in-flight table on incoming PUBACK, PUBREC or PUBCOMP
+void yamc_inflight_ack(yamc_instance_t* const p_instance, const yamc_pkt_type_t pkt_type, const uint16_t packet_id);
+
+#endif /* __YAMC_INFLIGHT_H__ */
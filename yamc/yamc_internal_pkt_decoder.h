@@ -22,6 +22,10 @@
 
 #include "yamc.h"
 #include "yamc_log.h"
+#include "yamc_inflight.h"
+#include "yamc_pkt_id.h"
+#include "yamc_ack_queue.h"
+#include "yamc_qos2_ids.h"
 
 /// returns true if user enabled parsing of given packet type
 static inline uint8_t is_parsing_enabled(const yamc_instance_t* const p_instance, yamc_pkt_type_t pkt_type)
@@ -92,7 +96,7 @@ static inline uint16_t decode_mqtt_word(const uint8_t* const p_word)
  * \return YAMC_SUCCESS or YAMC_ERROR_INVALID_DATA when decoded string length exceeds remaining var_data length
  * \param[in/out] len in: remaining var_data length, out: by how many bytes to advance parse buffer position
  */
-static yamc_retcode_t decode_mqtt_string(uint8_t* const p_raw_data, uint32_t* p_len, yamc_mqtt_string* const p_mqtt_str)
+static yamc_retcode_t decode_mqtt_string(const uint8_t* const p_raw_data, uint32_t* p_len, yamc_mqtt_string* const p_mqtt_str)
 {
 	YAMC_ASSERT(p_raw_data != NULL);
 	YAMC_ASSERT(p_mqtt_str != NULL);
@@ -118,9 +122,11 @@ static yamc_retcode_t decode_mqtt_string(uint8_t* const p_raw_data, uint32_t* p_
 	return YAMC_RET_SUCCESS;
 }
 
-static inline yamc_retcode_t yamc_decode_connack(const yamc_instance_t* const p_instance, yamc_mqtt_pkt_data_t* const p_pkt_data)
+static inline yamc_retcode_t yamc_decode_connack(const yamc_instance_t* const p_instance, const uint8_t* const p_raw_data,
+												 yamc_mqtt_pkt_data_t* const p_pkt_data)
 {
 	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_raw_data != NULL);
 	YAMC_ASSERT(p_pkt_data != NULL);
 
 	if (p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val != 2)
@@ -131,7 +137,6 @@ static inline yamc_retcode_t yamc_decode_connack(const yamc_instance_t* const p_
 	}
 
 	yamc_mqtt_pkt_connack_t* const p_dest_pkt = &p_pkt_data->pkt_data.connack;
-	const uint8_t* const		   p_raw_data = p_instance->rx_pkt.var_data.data;
 
 	p_dest_pkt->ack_flags.raw = p_raw_data[0];
 	p_dest_pkt->return_code   = (yamc_mqtt_connack_retcode_t)p_raw_data[1];
@@ -139,13 +144,14 @@ static inline yamc_retcode_t yamc_decode_connack(const yamc_instance_t* const p_
 	return YAMC_RET_SUCCESS;
 }
 
-static inline yamc_retcode_t yamc_decode_publish(yamc_instance_t* const p_instance, yamc_mqtt_pkt_data_t* const p_pkt_data)
+static inline yamc_retcode_t yamc_decode_publish(const yamc_instance_t* const p_instance, const uint8_t* const p_raw_data,
+												 yamc_mqtt_pkt_data_t* const p_pkt_data)
 {
 	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_raw_data != NULL);
 	YAMC_ASSERT(p_pkt_data != NULL);
 
 	yamc_mqtt_pkt_publish_t* const p_dest_pkt = &p_pkt_data->pkt_data.publish;
-	uint8_t* const				   p_raw_data = p_instance->rx_pkt.var_data.data;
 
 	uint32_t raw_data_pos = 0;
 	uint32_t pkt_length   = p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val;
@@ -162,11 +168,12 @@ static inline yamc_retcode_t yamc_decode_publish(yamc_instance_t* const p_instan
 	// on QoS greater than zero there's 2 byte packet id field
 	if (p_pkt_data->flags.QOS > 0)
 	{
+		// check length before reading, p_raw_data may point directly into caller's buffer
+		if (raw_data_pos + 2 > pkt_length) return YAMC_RET_CANT_PARSE;
+
 		p_dest_pkt->packet_id = decode_mqtt_word(&p_raw_data[raw_data_pos]);
 		raw_data_pos += 2;
 
-		if (raw_data_pos > pkt_length) return YAMC_RET_CANT_PARSE;
-
 		rem_length = pkt_length - raw_data_pos;
 	}
 
@@ -180,9 +187,11 @@ static inline yamc_retcode_t yamc_decode_publish(yamc_instance_t* const p_instan
 	return YAMC_RET_SUCCESS;
 }
 
-static inline yamc_retcode_t yamc_decode_pub_x(const yamc_instance_t* const p_instance, yamc_mqtt_pkt_data_t* const p_pkt_data)
+static inline yamc_retcode_t yamc_decode_pub_x(const yamc_instance_t* const p_instance, const uint8_t* const p_raw_data,
+											   yamc_mqtt_pkt_data_t* const p_pkt_data)
 {
 	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_raw_data != NULL);
 	YAMC_ASSERT(p_pkt_data != NULL);
 
 	if (p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val != 2)
@@ -192,7 +201,6 @@ static inline yamc_retcode_t yamc_decode_pub_x(const yamc_instance_t* const p_in
 		return YAMC_RET_CANT_PARSE;
 	}
 
-	const uint8_t* const		  p_raw_data = p_instance->rx_pkt.var_data.data;
 	yamc_mqtt_pkt_generic_pubx_t* p_dest_pkt;
 
 	switch (p_pkt_data->pkt_type)
@@ -226,13 +234,14 @@ static inline yamc_retcode_t yamc_decode_pub_x(const yamc_instance_t* const p_in
 	return YAMC_RET_SUCCESS;
 }
 
-static inline yamc_retcode_t yamc_decode_suback(yamc_instance_t* const p_instance, yamc_mqtt_pkt_data_t* const p_pkt_data)
+static inline yamc_retcode_t yamc_decode_suback(const yamc_instance_t* const p_instance, const uint8_t* const p_raw_data,
+												yamc_mqtt_pkt_data_t* const p_pkt_data)
 {
 	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_raw_data != NULL);
 	YAMC_ASSERT(p_pkt_data != NULL);
 
 	yamc_mqtt_pkt_suback_t* const p_dest_pkt = &p_pkt_data->pkt_data.suback;
-	uint8_t* const				  p_raw_data = p_instance->rx_pkt.var_data.data;
 	uint32_t					  pkt_length = p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val;
 
 	// minimal suback packet is 3 bytes long
@@ -248,16 +257,254 @@ static inline yamc_retcode_t yamc_decode_suback(yamc_instance_t* const p_instanc
 	return YAMC_RET_SUCCESS;
 }
 
-// decode assembled MQTT packet data and call user defined event handler
-static inline void yamc_decode_pkt(yamc_instance_t* const p_instance)
+/// returns true if PUBLISH packet too long for rx buffer should be passed to stream handlers
+static inline uint8_t is_streaming_enabled(const yamc_instance_t* const p_instance)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	return p_instance->rx_pkt.fixed_hdr.pkt_type.flags.type == YAMC_PKT_PUBLISH && p_instance->parser_enables.PUBLISH &&
+		   p_instance->handlers.stream_begin != NULL;
+}
+
+/**
+ * \brief decode variable header of streamed PUBLISH packet collected in rx_pkt
+ *
+ * payload.p_data is left NULL, payload.data_len is set to total payload length
+ */
+static inline yamc_retcode_t yamc_decode_stream_hdr(const yamc_instance_t* const p_instance, yamc_mqtt_pkt_data_t* const p_pkt_data)
+{
+	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_pkt_data != NULL);
+
+	yamc_mqtt_pkt_publish_t* const p_dest_pkt = &p_pkt_data->pkt_data.publish;
+	const uint8_t* const		   p_raw_data = p_instance->rx_pkt.var_data.data;
+	const uint32_t				   hdr_len	= p_instance->rx_pkt.var_data.stream_hdr_len;
+
+	uint32_t	   str_len = hdr_len;
+	yamc_retcode_t ret_code;
+
+	ret_code = decode_mqtt_string(p_raw_data, &str_len, &p_dest_pkt->topic_name);
+	if (ret_code != YAMC_RET_SUCCESS) return YAMC_RET_CANT_PARSE;
+
+	// on QoS greater than zero there's 2 byte packet id field
+	if (p_pkt_data->flags.QOS > 0)
+	{
+		if (str_len + 2 > hdr_len) return YAMC_RET_CANT_PARSE;
+
+		p_dest_pkt->packet_id = decode_mqtt_word(&p_raw_data[str_len]);
+	}
+
+	// payload is passed to stream_chunk handler
+	p_dest_pkt->payload.data_len = p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val - hdr_len;
+
+	return YAMC_RET_SUCCESS;
+}
+
+/// returns true if library sends protocol acknowledgement for given incoming packet
+static inline bool is_auto_ack_pkt(const yamc_instance_t* const p_instance, const yamc_pkt_type_t pkt_type)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	if (!p_instance->options.auto_ack) return false;
+
+	if (pkt_type == YAMC_PKT_PUBLISH) return p_instance->rx_pkt.fixed_hdr.pkt_type.flags.QOS > 0;
+
+	return pkt_type == YAMC_PKT_PUBREC || pkt_type == YAMC_PKT_PUBREL;
+}
+
+// queue acknowledgement of incoming QoS>0 packet, it's written after incoming data is parsed
+static inline void yamc_auto_ack(yamc_instance_t* const p_instance, const yamc_pkt_type_t pkt_type, const uint16_t packet_id)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	yamc_pkt_type_t ack_type;
+
+	switch (pkt_type)
+	{
+		case YAMC_PKT_PUBLISH:
+			ack_type = (p_instance->rx_pkt.fixed_hdr.pkt_type.flags.QOS == YAMC_QOS_LVL1) ? YAMC_PKT_PUBACK : YAMC_PKT_PUBREC;
+			break;
+
+		case YAMC_PKT_PUBREC:
+			ack_type = YAMC_PKT_PUBREL;
+			break;
+
+		case YAMC_PKT_PUBREL:
+			ack_type = YAMC_PKT_PUBCOMP;
+			break;
+
+		default:
+			return;
+	}
+
+	if (yamc_ack_queue_push(p_instance, ack_type, packet_id) != YAMC_RET_SUCCESS)
+	{
+		YAMC_LOG_ERROR("Can't send acknowledgements\n");
+		p_instance->handlers.disconnect(p_instance->handlers.p_handler_ctx);
+	}
+}
+
+/// returns true if incoming packet is PUBLISH checked by user topic filter before its payload is processed
+static inline bool is_topic_filter_pkt(const yamc_instance_t* const p_instance)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	return p_instance->rx_pkt.fixed_hdr.pkt_type.flags.type == YAMC_PKT_PUBLISH && p_instance->handlers.topic_filter != NULL;
+}
+
+/// length of incoming PUBLISH variable header, p_var_data holds at least topic length field
+static inline uint32_t yamc_publish_var_hdr_len(const yamc_instance_t* const p_instance, const uint8_t* const p_var_data)
+{
+	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_var_data != NULL);
+
+	// packet id is present on QoS > 0
+	uint32_t hdr_len = 2 + decode_mqtt_word(p_var_data);
+	if (p_instance->rx_pkt.fixed_hdr.pkt_type.flags.QOS > 0) hdr_len += 2;
+
+	return hdr_len;
+}
+
+/**
+ * \brief check topic length of incoming PUBLISH, packet with zero length topic is malformed and connection is closed
+ *
+ * \param p_var_data holds at least topic length field
+ * \return true if connection was closed, parser has to stop
+ */
+static inline bool yamc_publish_topic_empty(yamc_instance_t* const p_instance, const uint8_t* const p_var_data)
+{
+	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_var_data != NULL);
+
+	if (decode_mqtt_word(p_var_data) != 0) return false;
+
+	YAMC_LOG_ERROR("Malformed PUBLISH: empty topic\n");
+	p_instance->parser_state = YAMC_PARSER_IDLE;
+	p_instance->handlers.disconnect(p_instance->handlers.p_handler_ctx);
+	return true;
+}
+
+/**
+ * \brief pass topic of incoming PUBLISH to user topic filter
+ *
+ * \param p_var_data complete variable header, not longer than packet remaining length
+ * \return true if packet is dropped, dropped QoS>0 packet is acknowledged
+ */
+static inline bool yamc_topic_filter_reject(yamc_instance_t* const p_instance, const uint8_t* const p_var_data)
+{
+	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_var_data != NULL);
+
+	const yamc_mqtt_string topic = {.str = &p_var_data[2], .len = decode_mqtt_word(p_var_data)};
+
+	if (p_instance->handlers.topic_filter(p_instance, &topic, p_instance->handlers.p_handler_ctx)) return false;
+
+	YAMC_LOG_DEBUG("PUBLISH dropped by topic filter\n");
+
+	if (p_instance->rx_pkt.fixed_hdr.pkt_type.flags.QOS > 0)
+	{
+		const uint16_t packet_id = decode_mqtt_word(&p_var_data[2 + topic.len]);
+
+		// QoS2 flow continues as if packet was delivered, PUBREL releases its id
+		if (p_instance->rx_pkt.fixed_hdr.pkt_type.flags.QOS == YAMC_QOS_LVL2) yamc_qos2_ids_insert(p_instance, packet_id);
+
+		yamc_auto_ack(p_instance, YAMC_PKT_PUBLISH, packet_id);
+	}
+
+	return true;
+}
+
+/**
+ * \brief decode streamed PUBLISH header and call user defined stream begin or end handler
+ *
+ * \param stream_end false: payload is about to start, true: whole payload was passed to stream_chunk handler
+ */
+static inline yamc_retcode_t yamc_decode_stream_pkt(yamc_instance_t* const p_instance, const bool stream_end)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+//Suppress '#370-D: variable "mqtt_pkt"  has an uninitialized const field' warning on Keil
+#if defined(__CC_ARM)
+#pragma push
+#pragma diag_suppress 370
+#endif
+
+	yamc_mqtt_pkt_data_t mqtt_pkt_data;
+
+#if defined(__CC_ARM)
+#pragma pop
+#endif
+
+	memset(&mqtt_pkt_data, 0, sizeof(yamc_mqtt_pkt_data_t));
+
+	/// fill in packet type and flags using instance data
+	fill_pkt_header(p_instance, &mqtt_pkt_data);
+
+	yamc_retcode_t decoder_retcode = yamc_decode_stream_hdr(p_instance, &mqtt_pkt_data);
+	if (decoder_retcode != YAMC_RET_SUCCESS) return decoder_retcode;
+
+	// redelivered QoS2 PUBLISH was already passed to user, acknowledge it again and drop the payload
+	if (!stream_end && mqtt_pkt_data.flags.QOS == YAMC_QOS_LVL2 &&
+		!yamc_qos2_ids_insert(p_instance, mqtt_pkt_data.pkt_data.publish.packet_id))
+	{
+		YAMC_LOG_DEBUG("Dropping duplicate QoS2 PUBLISH, packet id: %u\n", mqtt_pkt_data.pkt_data.publish.packet_id);
+		yamc_auto_ack(p_instance, YAMC_PKT_PUBLISH, mqtt_pkt_data.pkt_data.publish.packet_id);
+		p_instance->parser_state = YAMC_PARSER_SKIP_PKT;
+		return YAMC_RET_SUCCESS;
+	}
+
+	// streamed PUBLISH is acknowledged once whole payload has arrived
+	if (stream_end && is_auto_ack_pkt(p_instance, YAMC_PKT_PUBLISH))
+		yamc_auto_ack(p_instance, YAMC_PKT_PUBLISH, mqtt_pkt_data.pkt_data.publish.packet_id);
+
+	if (stream_end)
+		p_instance->handlers.stream_end(p_instance, &mqtt_pkt_data, p_instance->handlers.p_handler_ctx);
+	else
+		p_instance->handlers.stream_begin(p_instance, &mqtt_pkt_data, p_instance->handlers.p_handler_ctx);
+
+	return YAMC_RET_SUCCESS;
+}
+
+/**
+ * \brief decode assembled MQTT packet data and call user defined event handler
+ *
+ * \param p_var_data packet var_data, either rx_pkt.var_data.data or a pointer directly into buffer passed to yamc_parse_buff()
+ */
+static inline void yamc_decode_pkt(yamc_instance_t* const p_instance, const uint8_t* const p_var_data)
 {
 	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_var_data != NULL);
 
 	// log raw packet data, TODO: remove logging after we're done
-	yamc_log_raw_pkt(p_instance);
+	yamc_log_raw_pkt(p_instance, p_var_data);
+
+	const yamc_pkt_type_t pkt_type = p_instance->rx_pkt.fixed_hdr.pkt_type.flags.type;
+
+	// acknowledgements of outgoing QoS>0 PUBLISH packets are always decoded when in-flight tracking is enabled
+	const bool is_inflight_ack = p_instance->inflight.p_entries != NULL &&
+								 (pkt_type == YAMC_PKT_PUBACK || pkt_type == YAMC_PKT_PUBREC || pkt_type == YAMC_PKT_PUBCOMP);
+
+	// final acknowledgements release packet ids when in-use bitmap is enabled
+	const bool is_pkt_id_ack = p_instance->pkt_ids.p_bitmap != NULL && (pkt_type == YAMC_PKT_PUBACK || pkt_type == YAMC_PKT_PUBCOMP ||
+																		pkt_type == YAMC_PKT_SUBACK || pkt_type == YAMC_PKT_UNSUBACK);
+
+	// QoS>0 flow packets are always decoded when library acknowledges them
+	const bool is_auto_ack = is_auto_ack_pkt(p_instance, pkt_type);
+
+	// PUBREL ends incoming QoS2 flow, server may reuse its packet id
+	const bool is_qos2_release = pkt_type == YAMC_PKT_PUBREL && p_instance->qos2_rx.cnt > 0;
+
+	// CONNACK without session present drops QoS2 flows server had with previous session
+	const bool is_qos2_session = pkt_type == YAMC_PKT_CONNACK && p_instance->qos2_rx.cnt > 0;
+
+	// PINGRESP is counted only while PINGREQ is outstanding
+	if (pkt_type == YAMC_PKT_PINGRESP && p_instance->rx_acks.pingresp_cnt != p_instance->keepalive.pingreq_cnt)
+		p_instance->rx_acks.pingresp_cnt++;
 
 	// terminate if parsing of given packet type is not enabled
-	if (!is_parsing_enabled(p_instance, p_instance->rx_pkt.fixed_hdr.pkt_type.flags.type)) return;
+	if (!is_parsing_enabled(p_instance, pkt_type) && !is_inflight_ack && !is_pkt_id_ack && !is_auto_ack && !is_qos2_release &&
+		!is_qos2_session)
+		return;
 
 	yamc_retcode_t decoder_retcode = YAMC_RET_CANT_PARSE;
 
@@ -279,14 +526,14 @@ static inline void yamc_decode_pkt(yamc_instance_t* const p_instance)
 	fill_pkt_header(p_instance, &mqtt_pkt_data);
 
 	// decode data according to packet type
-	switch (p_instance->rx_pkt.fixed_hdr.pkt_type.flags.type)
+	switch (pkt_type)
 	{
 		case YAMC_PKT_CONNACK:
-			decoder_retcode = yamc_decode_connack(p_instance, &mqtt_pkt_data);
+			decoder_retcode = yamc_decode_connack(p_instance, p_var_data, &mqtt_pkt_data);
 			break;
 
 		case YAMC_PKT_PUBLISH:
-			decoder_retcode = yamc_decode_publish(p_instance, &mqtt_pkt_data);
+			decoder_retcode = yamc_decode_publish(p_instance, p_var_data, &mqtt_pkt_data);
 			break;
 
 		case YAMC_PKT_PUBACK:
@@ -294,11 +541,11 @@ static inline void yamc_decode_pkt(yamc_instance_t* const p_instance)
 		case YAMC_PKT_PUBREL:
 		case YAMC_PKT_PUBCOMP:
 		case YAMC_PKT_UNSUBACK:
-			decoder_retcode = yamc_decode_pub_x(p_instance, &mqtt_pkt_data);
+			decoder_retcode = yamc_decode_pub_x(p_instance, p_var_data, &mqtt_pkt_data);
 			break;
 
 		case YAMC_PKT_SUBACK:
-			decoder_retcode = yamc_decode_suback(p_instance, &mqtt_pkt_data);
+			decoder_retcode = yamc_decode_suback(p_instance, p_var_data, &mqtt_pkt_data);
 			break;
 
 		case YAMC_PKT_PINGRESP:
@@ -307,12 +554,50 @@ static inline void yamc_decode_pkt(yamc_instance_t* const p_instance)
 			break;
 
 		default:
-			YAMC_LOG_ERROR("Unknown packet type %d\n", p_instance->rx_pkt.fixed_hdr.pkt_type.flags.type);
+			YAMC_LOG_ERROR("Unknown packet type %d\n", pkt_type);
 			break;
 	}
 
+	if (decoder_retcode != YAMC_RET_SUCCESS) return;
+
+	// release or advance acknowledged in-flight packet before user sees the acknowledgement
+	if (is_inflight_ack) yamc_inflight_ack(p_instance, pkt_type, mqtt_pkt_data.pkt_data.puback.packet_id);
+
+	if (is_pkt_id_ack)
+	{
+		yamc_pkt_id_release(p_instance,
+							(pkt_type == YAMC_PKT_SUBACK) ? mqtt_pkt_data.pkt_data.suback.pkt_id : mqtt_pkt_data.pkt_data.puback.packet_id,
+							pkt_type);
+	}
+
+	if (is_qos2_release) yamc_qos2_ids_remove(p_instance, mqtt_pkt_data.pkt_data.pubrel.packet_id);
+
+	if (is_qos2_session && mqtt_pkt_data.pkt_data.connack.return_code == YAMC_CONNACK_ACCEPTED &&
+		!mqtt_pkt_data.pkt_data.connack.ack_flags.flags.session_present)
+	{
+		yamc_qos2_ids_clear(p_instance);
+	}
+
+	// redelivered QoS2 PUBLISH was already passed to user, only acknowledge it again
+	if (pkt_type == YAMC_PKT_PUBLISH && mqtt_pkt_data.flags.QOS == YAMC_QOS_LVL2 &&
+		!yamc_qos2_ids_insert(p_instance, mqtt_pkt_data.pkt_data.publish.packet_id))
+	{
+		YAMC_LOG_DEBUG("Dropping duplicate QoS2 PUBLISH, packet id: %u\n", mqtt_pkt_data.pkt_data.publish.packet_id);
+		yamc_auto_ack(p_instance, YAMC_PKT_PUBLISH, mqtt_pkt_data.pkt_data.publish.packet_id);
+		return;
+	}
+
+	if (is_auto_ack)
+	{
+		yamc_auto_ack(p_instance, pkt_type, (pkt_type == YAMC_PKT_PUBLISH) ? mqtt_pkt_data.pkt_data.publish.packet_id
+																		   : mqtt_pkt_data.pkt_data.pubrec.packet_id);
+
+		// PUBREC and PUBREL are fully handled by the library
+		if (pkt_type != YAMC_PKT_PUBLISH) return;
+	}
+
 	// if packet was decoded successfully launch user handler
-	if (decoder_retcode == YAMC_RET_SUCCESS)
+	if (is_parsing_enabled(p_instance, pkt_type))
 		p_instance->handlers.pkt_handler(p_instance, &mqtt_pkt_data, p_instance->handlers.p_handler_ctx);
 }
 
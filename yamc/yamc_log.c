@@ -75,14 +75,15 @@ void yamc_log_hex(const uint8_t* const p_buff, const uint32_t buff_len)
 	YAMC_LOG_DEBUG("\n");
 }
 
-void yamc_log_raw_pkt(const yamc_instance_t* const p_instance)
+void yamc_log_raw_pkt(const yamc_instance_t* const p_instance, const uint8_t* const p_var_data)
 {
 	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_var_data != NULL);
 
 	YAMC_LOG_DEBUG("> %s - %d bytes: ", yamc_mqtt_pkt_type_to_str(p_instance->rx_pkt.fixed_hdr.pkt_type.flags.type),
 				   p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val);
 
-	yamc_log_hex(p_instance->rx_pkt.var_data.data, p_instance->rx_pkt.var_data.pos);
+	yamc_log_hex(p_var_data, p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val);
 }
 
 #endif /* ifdef YAMC_DEBUG */
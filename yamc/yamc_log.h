@@ -26,7 +26,7 @@ const char* yamc_mqtt_pkt_type_to_str(yamc_pkt_type_t pkt_type);
 #define YAMC_LOG_ERROR(...) YAMC_ERROR_PRINTF(__VA_ARGS__)
 
 void yamc_log_hex(const uint8_t* const p_buff, const uint32_t buff_len);
-void yamc_log_raw_pkt(const yamc_instance_t* const p_instance);
+void yamc_log_raw_pkt(const yamc_instance_t* const p_instance, const uint8_t* const p_var_data);
 
 #else /* YAMC_DEBUG not defined */
 
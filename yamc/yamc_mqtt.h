@@ -185,7 +185,11 @@ typedef struct
 {
 	// variable header
 
-	/// Topic name in MQTT string format
+	/**
+	 * \brief Topic name in MQTT string format
+	 *
+	 * Points into packet var_data, see payload.p_data for lifetime rules.
+	 */
 	yamc_mqtt_string topic_name;
 
 	/**
@@ -206,6 +210,10 @@ typedef struct
 		 *
 		 * Payload contains the Application Message that is being published.
 		 * The content and format of the data is application specific
+		 *
+		 * Points either into yamc receive buffer or, when whole packet arrived in a single chunk,
+		 * directly into the buffer passed to yamc_parse_buff(). In both cases data is valid only
+		 * until packet handler returns.
 		 */
 		const uint8_t* p_data;
 
@@ -302,7 +310,7 @@ typedef struct
 	// payload
 	struct
 	{
-		uint8_t* p_retcodes;	///< array of return codes
+		const uint8_t* p_retcodes;	  ///< array of return codes
 		uint16_t retcodes_len;  ///< length of return codes array
 
 	} payload;
@@ -317,8 +325,10 @@ typedef struct
 	/// var_data - buffer for variable header and payload packet fields
 	struct
 	{
-		uint8_t  data[YAMC_RX_PKT_MAX_LEN + 1];  ///< Raw packet data buffer except fixed header
-		uint32_t pos;							 ///< raw data write pointer position
+		uint8_t* data;			  ///< Raw packet data buffer except fixed header, owned by user
+		uint32_t data_size;		  ///< data buffer capacity
+		uint32_t pos;			  ///< raw data write pointer position
+		uint32_t stream_hdr_len;  ///< PUBLISH variable header length when streamed or checked by topic filter, 0 if not yet known
 
 	} var_data;
 
@@ -13,6 +13,9 @@
 #include <string.h>
 #include "yamc.h"
 #include "yamc_log.h"
+#include "yamc_inflight.h"
+#include "yamc_pkt_id.h"
+#include "yamc_ack_queue.h"
 
 typedef union {
 	uint16_t val;
@@ -60,12 +63,144 @@ static inline uint16_t yamc_mqtt_string_raw_length(const yamc_mqtt_string* const
 	return (p_mqtt_str->len) ? p_mqtt_str->len + 2 : 0;
 }
 
-static inline yamc_retcode_t yamc_send_buff(const yamc_instance_t* const p_instance, const uint8_t* const p_buff, uint32_t buff_len)
+// data written to server postpone keepalive PINGREQ
+static inline void yamc_keepalive_tx(yamc_instance_t* const p_instance)
 {
-	return p_instance->handlers.write(p_instance->handlers.p_handler_ctx, p_buff, buff_len);
+	YAMC_ASSERT(p_instance != NULL);
+
+	if (p_instance->keepalive.interval_ms != 0) p_instance->keepalive.tx_ms = yamc_timestamp_ms(p_instance);
+}
+
+// PINGREQ was sent, PINGRESP hasn't arrived yet
+static inline bool yamc_keepalive_ping_pending(const yamc_instance_t* const p_instance)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	return p_instance->keepalive.pingreq_cnt != p_instance->rx_acks.pingresp_cnt;
+}
+
+// write contents of outgoing packet buffer
+static inline yamc_retcode_t yamc_send_flush(yamc_instance_t* const p_instance)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	// scatter/gather mode, tx buffer contents are referenced by segments
+	if (p_instance->handlers.writev != NULL)
+	{
+		if (p_instance->tx_buff.iov_cnt == 0) return YAMC_RET_SUCCESS;
+
+		const uint8_t iov_cnt = p_instance->tx_buff.iov_cnt;
+
+		p_instance->tx_buff.pos			 = 0;
+		p_instance->tx_buff.iov_cnt		 = 0;
+		p_instance->tx_buff.iov_open	 = false;
+		p_instance->tx_buff.iov_in_place = false;
+
+		yamc_keepalive_tx(p_instance);
+
+		return p_instance->handlers.writev(p_instance->handlers.p_handler_ctx, p_instance->tx_buff.iov, iov_cnt);
+	}
+
+	if (p_instance->tx_buff.pos == 0) return YAMC_RET_SUCCESS;
+
+	const uint32_t data_len = p_instance->tx_buff.pos;
+
+	// buffer is emptied even if write fails, partial packet must not be sent later
+	p_instance->tx_buff.pos = 0;
+
+	yamc_keepalive_tx(p_instance);
+
+	return p_instance->handlers.write(p_instance->handlers.p_handler_ctx, p_instance->tx_buff.data, data_len);
+}
+
+// append data to outgoing packet as scatter/gather segment
+static inline yamc_retcode_t yamc_send_iov(yamc_instance_t* const p_instance, const uint8_t* const p_buff, uint32_t buff_len)
+{
+	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_buff != NULL);
+
+	// long fields are sent in place, caller's data stays valid until packet is flushed
+	// in batch mode fields are copied unless they don't fit into empty tx buffer
+	const bool send_in_place = p_instance->tx_buff.batch_depth == 0 ? buff_len >= YAMC_TX_IOV_REF_MIN_LEN
+																	: buff_len > p_instance->tx_buff.data_size;
+
+	// flush if there's no free segment or no room for a copy in tx buffer
+	if ((p_instance->tx_buff.iov_cnt == YAMC_TX_IOV_MAX && (send_in_place || !p_instance->tx_buff.iov_open)) ||
+		(!send_in_place && buff_len > p_instance->tx_buff.data_size - p_instance->tx_buff.pos))
+	{
+		yamc_retcode_t ret = yamc_send_flush(p_instance);
+		if (ret != YAMC_RET_SUCCESS) return ret;
+	}
+
+	if (send_in_place)
+	{
+		p_instance->tx_buff.iov[p_instance->tx_buff.iov_cnt].p_data = p_buff;
+		p_instance->tx_buff.iov[p_instance->tx_buff.iov_cnt].len	= buff_len;
+		p_instance->tx_buff.iov_cnt++;
+		p_instance->tx_buff.iov_open	 = false;
+		p_instance->tx_buff.iov_in_place = true;
+
+		return YAMC_RET_SUCCESS;
+	}
+
+	// short fields are copied, consecutive copies share single segment
+	if (!p_instance->tx_buff.iov_open)
+	{
+		p_instance->tx_buff.iov[p_instance->tx_buff.iov_cnt].p_data = &p_instance->tx_buff.data[p_instance->tx_buff.pos];
+		p_instance->tx_buff.iov[p_instance->tx_buff.iov_cnt].len	= 0;
+		p_instance->tx_buff.iov_cnt++;
+		p_instance->tx_buff.iov_open = true;
+	}
+
+	memcpy(&p_instance->tx_buff.data[p_instance->tx_buff.pos], p_buff, buff_len);
+	p_instance->tx_buff.pos += buff_len;
+	p_instance->tx_buff.iov[p_instance->tx_buff.iov_cnt - 1].len += buff_len;
+
+	return YAMC_RET_SUCCESS;
 }
 
-static inline yamc_retcode_t yamc_send_word(const yamc_instance_t* const p_instance, const uint16_t word)
+// append data to outgoing packet buffer, data that doesn't fit is written directly
+static inline yamc_retcode_t yamc_send_buff(yamc_instance_t* const p_instance, const uint8_t* const p_buff, uint32_t buff_len)
+{
+	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_buff != NULL);
+
+	if (buff_len == 0) return YAMC_RET_SUCCESS;
+
+	if (p_instance->handlers.writev != NULL) return yamc_send_iov(p_instance, p_buff, buff_len);
+
+	if (buff_len > p_instance->tx_buff.data_size - p_instance->tx_buff.pos)
+	{
+		yamc_retcode_t ret = yamc_send_flush(p_instance);
+		if (ret != YAMC_RET_SUCCESS) return ret;
+
+		// too long for empty buffer, bypass it
+		if (buff_len > p_instance->tx_buff.data_size)
+		{
+			yamc_keepalive_tx(p_instance);
+			return p_instance->handlers.write(p_instance->handlers.p_handler_ctx, p_buff, buff_len);
+		}
+	}
+
+	memcpy(&p_instance->tx_buff.data[p_instance->tx_buff.pos], p_buff, buff_len);
+	p_instance->tx_buff.pos += buff_len;
+
+	return YAMC_RET_SUCCESS;
+}
+
+// outgoing packet is complete, write it unless packets are batched
+static inline yamc_retcode_t yamc_send_pkt_end(yamc_instance_t* const p_instance)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	// segments pointing to caller's data can't outlive send function call
+	if (p_instance->tx_buff.batch_depth > 0 && !p_instance->tx_buff.iov_in_place) return YAMC_RET_SUCCESS;
+
+	// write whole packet at once
+	return yamc_send_flush(p_instance);
+}
+
+static inline yamc_retcode_t yamc_send_word(yamc_instance_t* const p_instance, const uint16_t word)
 {
 	YAMC_ASSERT(p_instance != NULL);
 
@@ -75,7 +210,7 @@ static inline yamc_retcode_t yamc_send_word(const yamc_instance_t* const p_insta
 	return yamc_send_buff(p_instance, mqtt_word.raw, 2);
 }
 
-static inline yamc_retcode_t yamc_send_str(const yamc_instance_t* const p_instance, const yamc_mqtt_string* const p_mqtt_str)
+static inline yamc_retcode_t yamc_send_str(yamc_instance_t* const p_instance, const yamc_mqtt_string* const p_mqtt_str)
 {
 	YAMC_ASSERT(p_instance != NULL);
 	YAMC_ASSERT(p_mqtt_str != NULL);
@@ -96,7 +231,7 @@ static inline yamc_retcode_t yamc_send_str(const yamc_instance_t* const p_instan
 	}
 }
 
-static inline yamc_retcode_t yamc_send_fixed_hdr(const yamc_instance_t* const p_instance, const yamc_mqtt_hdr_fixed_t* const p_fixed_hdr)
+static inline yamc_retcode_t yamc_send_fixed_hdr(yamc_instance_t* const p_instance, const yamc_mqtt_hdr_fixed_t* const p_fixed_hdr)
 {
 	YAMC_ASSERT(p_instance != NULL);
 	YAMC_ASSERT(p_fixed_hdr != NULL);
@@ -109,7 +244,7 @@ static inline yamc_retcode_t yamc_send_fixed_hdr(const yamc_instance_t* const p_
 	return yamc_send_buff(p_instance, send_buff, p_fixed_hdr->remaining_len.raw_len + 1);
 }
 
-static inline yamc_retcode_t yamc_send_connect(const yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
+static inline yamc_retcode_t yamc_send_connect(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
 {
 	YAMC_ASSERT(p_instance != NULL);
 	YAMC_ASSERT(p_pkt_data != NULL);
@@ -224,10 +359,10 @@ static inline yamc_retcode_t yamc_send_connect(const yamc_instance_t* const p_in
 		if (ret != YAMC_RET_SUCCESS) return ret;
 	}
 
-	return YAMC_RET_SUCCESS;
+	return yamc_send_pkt_end(p_instance);
 }
 
-static inline yamc_retcode_t yamc_send_publish(const yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
+static inline yamc_retcode_t yamc_send_publish(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
 {
 	YAMC_ASSERT(p_instance != NULL);
 	YAMC_ASSERT(p_pkt_data != NULL);
@@ -292,10 +427,10 @@ static inline yamc_retcode_t yamc_send_publish(const yamc_instance_t* const p_in
 		if (ret != YAMC_RET_SUCCESS) return ret;
 	}
 
-	return YAMC_RET_SUCCESS;
+	return yamc_send_pkt_end(p_instance);
 }
 
-static inline yamc_retcode_t yamc_send_subscribe(const yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
+static inline yamc_retcode_t yamc_send_subscribe(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
 {
 	YAMC_ASSERT(p_instance != NULL);
 	YAMC_ASSERT(p_pkt_data != NULL);
@@ -349,10 +484,10 @@ static inline yamc_retcode_t yamc_send_subscribe(const yamc_instance_t* const p_
 		if (ret != YAMC_RET_SUCCESS) return ret;
 	}
 
-	return YAMC_RET_SUCCESS;
+	return yamc_send_pkt_end(p_instance);
 }
 
-static inline yamc_retcode_t yamc_send_unsubscribe(const yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
+static inline yamc_retcode_t yamc_send_unsubscribe(yamc_instance_t* const p_instance, const yamc_mqtt_pkt_data_t* const p_pkt_data)
 {
 	YAMC_ASSERT(p_instance != NULL);
 	YAMC_ASSERT(p_pkt_data != NULL);
@@ -403,11 +538,11 @@ static inline yamc_retcode_t yamc_send_unsubscribe(const yamc_instance_t* const
 		if (ret != YAMC_RET_SUCCESS) return ret;
 	}
 
-	return YAMC_RET_SUCCESS;
+	return yamc_send_pkt_end(p_instance);
 }
 
 //send packet that contains only fixed header (disconnect, pingreq, pingresp...)
-static inline yamc_retcode_t yamc_send_fixed_hdr_only_pkt(const yamc_instance_t* const p_instance, const yamc_pkt_type_t pkt_type)
+static inline yamc_retcode_t yamc_send_fixed_hdr_only_pkt(yamc_instance_t* const p_instance, const yamc_pkt_type_t pkt_type)
 {
 	YAMC_ASSERT(p_instance != NULL);
 	YAMC_ASSERT(pkt_type == YAMC_PKT_DISCONNECT || pkt_type == YAMC_PKT_PINGREQ);
@@ -424,14 +559,23 @@ static inline yamc_retcode_t yamc_send_fixed_hdr_only_pkt(const yamc_instance_t*
 	yamc_encode_rem_length(rem_len, &fixed_hdr);
 
 	// send the data
-	return yamc_send_fixed_hdr(p_instance, &fixed_hdr);
+	yamc_retcode_t ret = yamc_send_fixed_hdr(p_instance, &fixed_hdr);
+	if (ret != YAMC_RET_SUCCESS) return ret;
+
+	// connection is closed after disconnect, write batched packets too
+	if (pkt_type == YAMC_PKT_DISCONNECT) return yamc_send_flush(p_instance);
+
+	return yamc_send_pkt_end(p_instance);
 }
 
-static inline yamc_retcode_t yamc_send_pub_x(const yamc_instance_t* const p_instance, const yamc_pkt_type_t pkt_type, const uint16_t pkt_id)
+static inline yamc_retcode_t yamc_send_pub_x(yamc_instance_t* const p_instance, const yamc_pkt_type_t pkt_type, const uint16_t pkt_id)
 {
 	YAMC_ASSERT(p_instance != NULL);
 	YAMC_ASSERT(pkt_type == YAMC_PKT_PUBACK || pkt_type == YAMC_PKT_PUBCOMP || pkt_type == YAMC_PKT_PUBREC || pkt_type == YAMC_PKT_PUBREL);
 
+	// called from packet handler, ack is written together with the others when yamc_parse_buff() returns
+	if (p_instance->ack_queue.in_parse) return yamc_ack_queue_push(p_instance, pkt_type, pkt_id);
+
 	yamc_mqtt_hdr_fixed_t fixed_hdr;
 	memset(&fixed_hdr, 0, sizeof(yamc_mqtt_hdr_fixed_t));
 
@@ -463,7 +607,79 @@ static inline yamc_retcode_t yamc_send_pub_x(const yamc_instance_t* const p_inst
 	ret = yamc_send_word(p_instance, pkt_id);
 	if (ret != YAMC_RET_SUCCESS) return ret;
 
-	return YAMC_RET_SUCCESS;
+	return yamc_send_pkt_end(p_instance);
+}
+
+// write all queued acks at once
+yamc_retcode_t yamc_ack_queue_flush(yamc_instance_t* const p_instance)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	if (p_instance->ack_queue.cnt == 0) return YAMC_RET_SUCCESS;
+
+	const uint32_t data_len = p_instance->ack_queue.cnt * sizeof(p_instance->ack_queue.frames[0]);
+
+	// queue is emptied even if write fails, acks will be resent by server retransmissions
+	p_instance->ack_queue.cnt = 0;
+
+	// batched packets waiting in tx buffer go first
+	if (p_instance->tx_buff.pos != 0 || p_instance->tx_buff.iov_cnt != 0)
+	{
+		yamc_retcode_t ret = yamc_send_buff(p_instance, &p_instance->ack_queue.frames[0][0], data_len);
+		if (ret != YAMC_RET_SUCCESS) return ret;
+
+		return yamc_send_pkt_end(p_instance);
+	}
+
+	// frames are contiguous, write them in place so receiving doesn't touch transmit state
+	if (p_instance->keepalive.interval_ms != 0) p_instance->rx_acks.ack_queue_tx_ms = yamc_timestamp_ms(p_instance);
+
+	return p_instance->handlers.write(p_instance->handlers.p_handler_ctx, &p_instance->ack_queue.frames[0][0], data_len);
+}
+
+// encode PUBACK, PUBREC, PUBREL or PUBCOMP into ack queue
+yamc_retcode_t yamc_ack_queue_push(yamc_instance_t* const p_instance, const yamc_pkt_type_t pkt_type, const uint16_t packet_id)
+{
+	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(pkt_type == YAMC_PKT_PUBACK || pkt_type == YAMC_PKT_PUBCOMP || pkt_type == YAMC_PKT_PUBREC || pkt_type == YAMC_PKT_PUBREL);
+
+	yamc_retcode_t ret = YAMC_RET_SUCCESS;
+
+	if (p_instance->ack_queue.cnt == YAMC_ACK_QUEUE_LEN) ret = yamc_ack_queue_flush(p_instance);
+
+	uint8_t* const p_frame = p_instance->ack_queue.frames[p_instance->ack_queue.cnt++];
+
+	//PUBREL has reserved bit set, remaining length is always 2: packet id only
+	p_frame[0] = (pkt_type << 4) | ((pkt_type == YAMC_PKT_PUBREL) ? 2 : 0);
+	p_frame[1] = 2;
+	p_frame[2] = (packet_id >> 8) & 0xFF;
+	p_frame[3] = packet_id & 0xFF;
+
+	return ret;
+}
+
+// remember sent QoS>0 PUBLISH until it's acknowledged
+static inline void yamc_publish_track(yamc_instance_t* const p_instance, const yamc_qos_lvl_t qos, const bool retain,
+									  const uint16_t packet_id, const yamc_mqtt_string* const p_topic, const uint8_t* const p_data,
+									  const uint32_t data_len, void* const p_msg_ctx)
+{
+	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_topic != NULL);
+
+	if (qos == YAMC_QOS_LVL0) return;
+
+	const yamc_inflight_entry_t entry = {
+		.state	 = (qos == YAMC_QOS_LVL1) ? YAMC_INFLIGHT_WAIT_PUBACK : YAMC_INFLIGHT_WAIT_PUBREC,
+		.packet_id = packet_id,
+		.RETAIN	= retain,
+		.sent_ms   = yamc_timestamp_ms(p_instance),
+		.topic	 = *p_topic,
+		.p_data	= p_data,
+		.data_len  = data_len,
+		.p_msg_ctx = p_msg_ctx,
+	};
+
+	yamc_inflight_add(p_instance, &entry);
 }
 
 //assign c string to yamc_mqtt_string object
@@ -486,7 +702,7 @@ static inline void yamc_mqtt_strcpy(yamc_mqtt_string* const p_dest, const yamc_m
 }
 
 ///Send CONNECT packet
-yamc_retcode_t yamc_connect(const yamc_instance_t* const p_instance, const yamc_connect_data_t* const p_data)
+yamc_retcode_t yamc_connect(yamc_instance_t* const p_instance, const yamc_connect_data_t* const p_data)
 {
 	YAMC_ASSERT(p_instance != NULL);
 	YAMC_ASSERT(p_data != NULL);
@@ -499,6 +715,14 @@ yamc_retcode_t yamc_connect(const yamc_instance_t* const p_instance, const yamc_
 
 	};
 
+	// keepalive is managed by yamc only if it can tell time, writing CONNECT starts idle period
+	memset(&p_instance->keepalive, 0, sizeof(p_instance->keepalive));
+	if (p_instance->handlers.timestamp != NULL) p_instance->keepalive.interval_ms = p_data->keepalive_timeout_s * 1000u;
+
+	// no PINGREQ is pending, acks written over previous connection don't count
+	p_instance->keepalive.pingreq_cnt	 = p_instance->rx_acks.pingresp_cnt;
+	p_instance->rx_acks.ack_queue_tx_ms = yamc_timestamp_ms(p_instance);
+
 	if (yamc_is_mqtt_string_present(&p_data->client_id)) yamc_mqtt_strcpy(&mqtt_pkt.pkt_data.connect.client_id, &p_data->client_id);
 
 	if (yamc_is_mqtt_string_present(&p_data->user_name))
@@ -556,13 +780,308 @@ yamc_retcode_t yamc_publish(yamc_instance_t* const p_instance, const yamc_publis
 
 	if (p_data->QOS != YAMC_QOS_LVL0)
 	{
-		p_instance->last_packet_id++;
-		mqtt_pkt.pkt_data.publish.packet_id = p_instance->last_packet_id;
+		// no room to track another unacknowledged packet
+		if (yamc_inflight_is_full(p_instance)) return YAMC_RET_WOULD_BLOCK;
+
+		// resent message keeps its id so server can detect duplicate
+		if (p_data->packet_id != 0)
+		{
+			mqtt_pkt.pkt_data.publish.packet_id = p_data->packet_id;
+			yamc_pkt_id_reserve(p_instance, p_data->packet_id, yamc_pkt_id_publish_ack(p_data->QOS));
+		}
+		else
+		{
+			mqtt_pkt.pkt_data.publish.packet_id = yamc_pkt_id_alloc(p_instance, yamc_pkt_id_publish_ack(p_data->QOS));
+		}
+
+		// all packet ids wait for acknowledgement
+		if (mqtt_pkt.pkt_data.publish.packet_id == 0) return YAMC_RET_WOULD_BLOCK;
+	}
+
+	yamc_retcode_t ret = yamc_send_publish(p_instance, &mqtt_pkt);
+	if (ret != YAMC_RET_SUCCESS)
+	{
+		yamc_pkt_id_release(p_instance, mqtt_pkt.pkt_data.publish.packet_id, yamc_pkt_id_publish_ack(p_data->QOS));
+		return ret;
+	}
+
+	yamc_publish_track(p_instance, p_data->QOS, p_data->RETAIN, mqtt_pkt.pkt_data.publish.packet_id, &p_data->topic, p_data->p_data,
+					   p_data->data_len, p_data->p_msg_ctx);
+
+	return YAMC_RET_SUCCESS;
+}
+
+// remaining length of PUBLISH packet, 0 if data are invalid
+static inline uint32_t yamc_publish_rem_len(const yamc_publish_data_t* const p_data)
+{
+	YAMC_ASSERT(p_data != NULL);
+
+	if (!yamc_is_mqtt_string_present(&p_data->topic) || p_data->QOS > YAMC_QOS_LVL2) return 0;
+
+	// publish data are application specific (not an MQTT string), it is valid for publish to contain empty payload
+	if (p_data->p_data == NULL && p_data->data_len > 0) return 0;
+
+	// packet identifier: 2 bytes when qos>0
+	const uint64_t rem_len = (uint64_t)yamc_mqtt_string_raw_length(&p_data->topic) + (p_data->QOS > 0 ? 2 : 0) + p_data->data_len;
+
+	return (rem_len < YAMC_MQTT_MAX_LEN) ? (uint32_t)rem_len : 0;
+}
+
+///Length of PUBLISH packet encoded by yamc_publish_encode()
+uint32_t yamc_publish_encoded_len(const yamc_publish_data_t* const p_data)
+{
+	YAMC_ASSERT(p_data != NULL);
+
+	const uint32_t rem_len = yamc_publish_rem_len(p_data);
+	if (rem_len == 0) return 0;
+
+	yamc_mqtt_hdr_fixed_t fixed_hdr;
+	memset(&fixed_hdr, 0, sizeof(yamc_mqtt_hdr_fixed_t));
+
+	yamc_encode_rem_length(rem_len, &fixed_hdr);
+
+	return 1 + fixed_hdr.remaining_len.raw_len + rem_len;
+}
+
+///Encode complete PUBLISH packet into caller's buffer
+uint32_t yamc_publish_encode(const yamc_publish_data_t* const p_data, uint16_t packet_id, uint8_t* const p_buff, uint32_t buff_len)
+{
+	YAMC_ASSERT(p_data != NULL);
+	YAMC_ASSERT(p_buff != NULL);
+
+	const uint32_t rem_len = yamc_publish_rem_len(p_data);
+	if (rem_len == 0 || (p_data->QOS > 0 && packet_id == 0)) return 0;
+
+	yamc_mqtt_hdr_fixed_t fixed_hdr;
+	memset(&fixed_hdr, 0, sizeof(yamc_mqtt_hdr_fixed_t));
+
+	fixed_hdr.pkt_type.flags.type	= YAMC_PKT_PUBLISH;
+	fixed_hdr.pkt_type.flags.DUP	= p_data->DUP;
+	fixed_hdr.pkt_type.flags.QOS	= p_data->QOS;
+	fixed_hdr.pkt_type.flags.RETAIN = p_data->RETAIN;
+
+	yamc_encode_rem_length(rem_len, &fixed_hdr);
+
+	if (buff_len < 1 + fixed_hdr.remaining_len.raw_len + rem_len) return 0;
+
+	uint32_t pos = 0;
+
+	p_buff[pos++] = fixed_hdr.pkt_type.raw;
+	memcpy(&p_buff[pos], fixed_hdr.remaining_len.raw, fixed_hdr.remaining_len.raw_len);
+	pos += fixed_hdr.remaining_len.raw_len;
+
+	yamc_mqtt_word_t word;
+	yamc_encode_mqtt_word(p_data->topic.len, &word);
+	memcpy(&p_buff[pos], word.raw, 2);
+	memcpy(&p_buff[pos + 2], p_data->topic.str, p_data->topic.len);
+	pos += 2 + p_data->topic.len;
+
+	if (p_data->QOS > 0)
+	{
+		yamc_encode_mqtt_word(packet_id, &word);
+		memcpy(&p_buff[pos], word.raw, 2);
+		pos += 2;
+	}
+
+	if (p_data->data_len > 0) memcpy(&p_buff[pos], p_data->p_data, p_data->data_len);
+	pos += p_data->data_len;
+
+	return pos;
+}
+
+///Validate topic and pre-encode PUBLISH header into template
+yamc_retcode_t yamc_publish_template_init(yamc_publish_template_t* const p_template, const yamc_mqtt_string* const p_topic,
+										  yamc_qos_lvl_t qos, bool retain)
+{
+	YAMC_ASSERT(p_template != NULL);
+	YAMC_ASSERT(p_topic != NULL);
+
+	memset(p_template, 0, sizeof(yamc_publish_template_t));
+
+	if (!yamc_is_mqtt_string_present(p_topic) || qos > YAMC_QOS_LVL2) return YAMC_RET_INVALID_DATA;
+
+	yamc_mqtt_hdr_fixed_t fixed_hdr;
+	memset(&fixed_hdr, 0, sizeof(yamc_mqtt_hdr_fixed_t));
+
+	fixed_hdr.pkt_type.flags.type   = YAMC_PKT_PUBLISH;
+	fixed_hdr.pkt_type.flags.QOS	= qos;
+	fixed_hdr.pkt_type.flags.RETAIN = retain;
+
+	p_template->pkt_type_raw = fixed_hdr.pkt_type.raw;
+
+	yamc_mqtt_word_t topic_len;
+	yamc_encode_mqtt_word(p_topic->len, &topic_len);
+	memcpy(p_template->topic_len_raw, topic_len.raw, sizeof(p_template->topic_len_raw));
+
+	yamc_mqtt_strcpy(&p_template->topic, p_topic);
+
+	// packet identifier: 2 bytes when qos>0
+	p_template->var_hdr_len = yamc_mqtt_string_raw_length(p_topic);
+	if (qos > 0) p_template->var_hdr_len += 2;
+
+	return YAMC_RET_SUCCESS;
+}
+
+///Send PUBLISH packet with topic and flags from template
+yamc_retcode_t yamc_publish_template(yamc_instance_t* const p_instance, const yamc_publish_template_t* const p_template,
+									 const uint8_t* const p_data, uint32_t data_len)
+{
+	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_template != NULL);
+	YAMC_ASSERT(p_template->var_hdr_len > 0);
+
+	// publish data are application specific (not an MQTT string), it is valid for publish to contain empty payload
+	if (p_data == NULL && data_len > 0) return YAMC_RET_INVALID_DATA;
+
+	yamc_mqtt_hdr_fixed_t fixed_hdr;
+	memset(&fixed_hdr, 0, sizeof(yamc_mqtt_hdr_fixed_t));
+
+	fixed_hdr.pkt_type.raw = p_template->pkt_type_raw;
+
+	uint16_t packet_id = 0;
+
+	if (fixed_hdr.pkt_type.flags.QOS > 0)
+	{
+		// no room to track another unacknowledged packet
+		if (yamc_inflight_is_full(p_instance)) return YAMC_RET_WOULD_BLOCK;
+
+		packet_id = yamc_pkt_id_alloc(p_instance, yamc_pkt_id_publish_ack(fixed_hdr.pkt_type.flags.QOS));
+
+		// all packet ids wait for acknowledgement
+		if (packet_id == 0) return YAMC_RET_WOULD_BLOCK;
 	}
 
+	// encode remaining length in packet header
+	yamc_encode_rem_length(p_template->var_hdr_len + data_len, &fixed_hdr);
+
+	// fixed header and topic length field are sent together
+	uint8_t send_buff[1 + YAMC_MQTT_REM_LEN_MAX + 2];
+	send_buff[0] = fixed_hdr.pkt_type.raw;
+	memcpy(&send_buff[1], fixed_hdr.remaining_len.raw, fixed_hdr.remaining_len.raw_len);
+	memcpy(&send_buff[1 + fixed_hdr.remaining_len.raw_len], p_template->topic_len_raw, 2);
+
+	yamc_retcode_t ret = yamc_send_buff(p_instance, send_buff, 1 + fixed_hdr.remaining_len.raw_len + 2);
+
+	if (ret == YAMC_RET_SUCCESS) ret = yamc_send_buff(p_instance, p_template->topic.str, p_template->topic.len);
+
+	// send packet id
+	if (ret == YAMC_RET_SUCCESS && fixed_hdr.pkt_type.flags.QOS > 0) ret = yamc_send_word(p_instance, packet_id);
+
+	// send payload
+	if (ret == YAMC_RET_SUCCESS) ret = yamc_send_buff(p_instance, p_data, data_len);
+
+	if (ret == YAMC_RET_SUCCESS) ret = yamc_send_pkt_end(p_instance);
+
+	if (ret != YAMC_RET_SUCCESS)
+	{
+		yamc_pkt_id_release(p_instance, packet_id, yamc_pkt_id_publish_ack(fixed_hdr.pkt_type.flags.QOS));
+		return ret;
+	}
+
+	yamc_publish_track(p_instance, fixed_hdr.pkt_type.flags.QOS, fixed_hdr.pkt_type.flags.RETAIN, packet_id, &p_template->topic, p_data,
+					   data_len, NULL);
+
+	return YAMC_RET_SUCCESS;
+}
+
+// resend single in-flight packet: PUBREL if server already received PUBLISH, PUBLISH with DUP flag otherwise
+static inline yamc_retcode_t yamc_retransmit_entry(yamc_instance_t* const p_instance, const yamc_inflight_entry_t* const p_entry)
+{
+	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_entry != NULL);
+
+	if (p_entry->state == YAMC_INFLIGHT_WAIT_PUBCOMP) return yamc_send_pub_x(p_instance, YAMC_PKT_PUBREL, p_entry->packet_id);
+
+	yamc_mqtt_pkt_data_t mqtt_pkt = {
+
+		.pkt_type						   = YAMC_PKT_PUBLISH,
+		.flags.DUP						   = 1,
+		.flags.RETAIN					   = p_entry->RETAIN,
+		.flags.QOS						   = (p_entry->state == YAMC_INFLIGHT_WAIT_PUBACK) ? YAMC_QOS_LVL1 : YAMC_QOS_LVL2,
+		.pkt_data.publish.packet_id		   = p_entry->packet_id,
+		.pkt_data.publish.payload.p_data   = p_entry->p_data,
+		.pkt_data.publish.payload.data_len = p_entry->data_len
+
+	};
+
+	yamc_mqtt_strcpy(&mqtt_pkt.pkt_data.publish.topic_name, &p_entry->topic);
+
 	return yamc_send_publish(p_instance, &mqtt_pkt);
 }
 
+/**
+ * \brief retransmit in-flight packets not acknowledged within timeout_ms
+ *
+ * \param p_next_ms time until next packet expires, UINT32_MAX if nothing waits for acknowledgement
+ */
+static yamc_retcode_t yamc_retransmit_expired(yamc_instance_t* const p_instance, uint32_t now_ms, uint32_t timeout_ms,
+											 uint32_t* const p_next_ms)
+{
+	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_next_ms != NULL);
+
+	*p_next_ms = UINT32_MAX;
+
+	if (p_instance->inflight.p_entries == NULL) return YAMC_RET_SUCCESS;
+
+	yamc_retcode_t ret = YAMC_RET_SUCCESS;
+
+	// all expired packets go out in single write
+	yamc_batch_begin(p_instance);
+
+	for (uint16_t idx = p_instance->inflight.oldest; idx != YAMC_INFLIGHT_NONE && ret == YAMC_RET_SUCCESS;
+		 idx = p_instance->inflight.p_entries[idx].next)
+	{
+		yamc_inflight_entry_t* const p_entry = &p_instance->inflight.p_entries[idx];
+
+		if (p_entry->state == YAMC_INFLIGHT_FREE) continue;
+
+		// timestamps are allowed to wrap around
+		const uint32_t elapsed_ms = now_ms - p_entry->sent_ms;
+
+		if (timeout_ms > 0 && elapsed_ms < timeout_ms)
+		{
+			if (timeout_ms - elapsed_ms < *p_next_ms) *p_next_ms = timeout_ms - elapsed_ms;
+			continue;
+		}
+
+		ret = yamc_retransmit_entry(p_instance, p_entry);
+
+		p_entry->sent_ms = now_ms;
+		if (timeout_ms < *p_next_ms) *p_next_ms = timeout_ms;
+	}
+
+	yamc_retcode_t flush_ret = yamc_batch_end(p_instance);
+
+	return (ret != YAMC_RET_SUCCESS) ? ret : flush_ret;
+}
+
+///Retransmit in-flight packets not acknowledged within timeout_ms
+yamc_retcode_t yamc_retransmit(yamc_instance_t* const p_instance, uint32_t timeout_ms)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	uint32_t next_ms;
+
+	return yamc_retransmit_expired(p_instance, yamc_timestamp_ms(p_instance), timeout_ms, &next_ms);
+}
+
+///Retransmission scheduler
+uint32_t yamc_retransmit_poll(yamc_instance_t* const p_instance, uint32_t now_ms, uint32_t timeout_ms)
+{
+	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(timeout_ms > 0);
+
+	uint32_t next_ms;
+
+	if (yamc_retransmit_expired(p_instance, now_ms, timeout_ms, &next_ms) != YAMC_RET_SUCCESS)
+	{
+		YAMC_LOG_ERROR("In-flight packets retransmission failed\n");
+	}
+
+	return next_ms;
+}
+
 ///Send SUBSCRIBE packet
 yamc_retcode_t yamc_subscribe(yamc_instance_t* const p_instance, const yamc_subscribe_data_t* const p_data, uint16_t data_len)
 {
@@ -571,18 +1090,22 @@ yamc_retcode_t yamc_subscribe(yamc_instance_t* const p_instance, const yamc_subs
 
 	if (!data_len) return YAMC_RET_INVALID_DATA;
 
-	p_instance->last_packet_id++;
-
 	yamc_mqtt_pkt_data_t mqtt_pkt = {
 
 		.pkt_type							   = YAMC_PKT_SUBSCRIBE,
-		.pkt_data.subscribe.pkt_id			   = p_instance->last_packet_id,
+		.pkt_data.subscribe.pkt_id			   = yamc_pkt_id_alloc(p_instance, YAMC_PKT_SUBACK),
 		.pkt_data.subscribe.payload.p_topics   = p_data,
 		.pkt_data.subscribe.payload.topics_len = data_len
 
 	};
 
-	return yamc_send_subscribe(p_instance, &mqtt_pkt);
+	// all packet ids wait for acknowledgement
+	if (mqtt_pkt.pkt_data.subscribe.pkt_id == 0) return YAMC_RET_WOULD_BLOCK;
+
+	yamc_retcode_t ret = yamc_send_subscribe(p_instance, &mqtt_pkt);
+	if (ret != YAMC_RET_SUCCESS) yamc_pkt_id_release(p_instance, mqtt_pkt.pkt_data.subscribe.pkt_id, YAMC_PKT_SUBACK);
+
+	return ret;
 }
 
 //Send UNSUBSCRIBE packet
@@ -593,30 +1116,102 @@ yamc_retcode_t yamc_unsubscribe(yamc_instance_t* const p_instance, const yamc_mq
 
 	if (!topics_len) return YAMC_RET_INVALID_DATA;
 
-	p_instance->last_packet_id++;
-
 	yamc_mqtt_pkt_data_t mqtt_pkt = {
 
 		.pkt_type								 = YAMC_PKT_UNSUBSCRIBE,
 		.pkt_data.unsubscribe.payload.p_topics   = p_topics,
 		.pkt_data.unsubscribe.payload.topics_len = topics_len,
-		.pkt_data.unsubscribe.pkt_id			 = p_instance->last_packet_id
+		.pkt_data.unsubscribe.pkt_id			 = yamc_pkt_id_alloc(p_instance, YAMC_PKT_UNSUBACK)
 
 	};
 
-	return yamc_send_unsubscribe(p_instance, &mqtt_pkt);
+	// all packet ids wait for acknowledgement
+	if (mqtt_pkt.pkt_data.unsubscribe.pkt_id == 0) return YAMC_RET_WOULD_BLOCK;
+
+	yamc_retcode_t ret = yamc_send_unsubscribe(p_instance, &mqtt_pkt);
+	if (ret != YAMC_RET_SUCCESS) yamc_pkt_id_release(p_instance, mqtt_pkt.pkt_data.unsubscribe.pkt_id, YAMC_PKT_UNSUBACK);
+
+	return ret;
+}
+
+///Start collecting outgoing packets in tx buffer
+void yamc_batch_begin(yamc_instance_t* const p_instance)
+{
+	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_instance->tx_buff.batch_depth < UINT8_MAX);
+
+	p_instance->tx_buff.batch_depth++;
+}
+
+///Write packets collected since matching yamc_batch_begin()
+yamc_retcode_t yamc_batch_end(yamc_instance_t* const p_instance)
+{
+	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_instance->tx_buff.batch_depth > 0);
+
+	p_instance->tx_buff.batch_depth--;
+
+	// nested batch, outermost yamc_batch_end() writes the data
+	if (p_instance->tx_buff.batch_depth > 0) return YAMC_RET_SUCCESS;
+
+	return yamc_send_flush(p_instance);
 }
 
 //Send PINGREQ packet
-yamc_retcode_t yamc_ping(const yamc_instance_t* const p_instance)
+yamc_retcode_t yamc_ping(yamc_instance_t* const p_instance)
 {
 	YAMC_ASSERT(p_instance != NULL);
 
+	// response deadline counts from first PINGREQ without PINGRESP
+	if (p_instance->keepalive.interval_ms != 0 && !yamc_keepalive_ping_pending(p_instance))
+	{
+		p_instance->keepalive.ping_ms = yamc_timestamp_ms(p_instance);
+		p_instance->keepalive.pingreq_cnt++;
+	}
+
 	return yamc_send_fixed_hdr_only_pkt(p_instance, YAMC_PKT_PINGREQ);
 }
 
+///Keepalive scheduler, sends PINGREQ only when connection is idle
+uint32_t yamc_keepalive_poll(yamc_instance_t* const p_instance, uint32_t now_ms)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	const uint32_t interval_ms = p_instance->keepalive.interval_ms;
+	if (interval_ms == 0) return UINT32_MAX;
+
+	// timestamps are allowed to wrap around
+	if (yamc_keepalive_ping_pending(p_instance))
+	{
+		const uint32_t resp_timeout_ms = (interval_ms < YAMC_PINGRESP_TIMEOUT_MS) ? interval_ms : YAMC_PINGRESP_TIMEOUT_MS;
+		const uint32_t elapsed_ms	  = now_ms - p_instance->keepalive.ping_ms;
+
+		if (elapsed_ms < resp_timeout_ms) return resp_timeout_ms - elapsed_ms;
+
+		YAMC_LOG_ERROR("PINGRESP not received within %u ms\n", resp_timeout_ms);
+
+		// disconnect is requested only once
+		p_instance->keepalive.interval_ms = 0;
+		p_instance->handlers.disconnect(p_instance->handlers.p_handler_ctx);
+
+		return UINT32_MAX;
+	}
+
+	// acks written by receive side count too, whichever write was later
+	uint32_t tx_ms = p_instance->keepalive.tx_ms;
+	if ((int32_t)(p_instance->rx_acks.ack_queue_tx_ms - tx_ms) > 0) tx_ms = p_instance->rx_acks.ack_queue_tx_ms;
+
+	const uint32_t idle_ms = now_ms - tx_ms;
+	if (idle_ms < interval_ms) return interval_ms - idle_ms;
+
+	// failed write is caught by response deadline
+	yamc_ping(p_instance);
+
+	return yamc_keepalive_poll(p_instance, now_ms);
+}
+
 ///Send DISCONNECT packet
-yamc_retcode_t yamc_disconnect(const yamc_instance_t* const p_instance)
+yamc_retcode_t yamc_disconnect(yamc_instance_t* const p_instance)
 {
 	YAMC_ASSERT(p_instance != NULL);
 
@@ -624,7 +1219,7 @@ yamc_retcode_t yamc_disconnect(const yamc_instance_t* const p_instance)
 }
 
 ///Send PUBACK packet
-yamc_retcode_t yamc_puback(const yamc_instance_t* const p_instance, uint16_t packet_id)
+yamc_retcode_t yamc_puback(yamc_instance_t* const p_instance, uint16_t packet_id)
 {
 	YAMC_ASSERT(p_instance != NULL);
 
@@ -632,7 +1227,7 @@ yamc_retcode_t yamc_puback(const yamc_instance_t* const p_instance, uint16_t pac
 }
 
 ///Send PUBREL packet
-yamc_retcode_t yamc_pubrel(const yamc_instance_t* const p_instance, uint16_t packet_id)
+yamc_retcode_t yamc_pubrel(yamc_instance_t* const p_instance, uint16_t packet_id)
 {
 	YAMC_ASSERT(p_instance != NULL);
 
@@ -640,7 +1235,7 @@ yamc_retcode_t yamc_pubrel(const yamc_instance_t* const p_instance, uint16_t pac
 }
 
 ///Send PUBREC packet
-yamc_retcode_t yamc_pubrec(const yamc_instance_t* const p_instance, uint16_t packet_id)
+yamc_retcode_t yamc_pubrec(yamc_instance_t* const p_instance, uint16_t packet_id)
 {
 	YAMC_ASSERT(p_instance != NULL);
 
@@ -648,7 +1243,7 @@ yamc_retcode_t yamc_pubrec(const yamc_instance_t* const p_instance, uint16_t pac
 }
 
 ///Send PUBCOMP packet
-yamc_retcode_t yamc_pubcomp(const yamc_instance_t* const p_instance, uint16_t packet_id)
+yamc_retcode_t yamc_pubcomp(yamc_instance_t* const p_instance, uint16_t packet_id)
 {
 	YAMC_ASSERT(p_instance != NULL);
 
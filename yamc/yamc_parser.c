@@ -56,7 +56,18 @@ static inline uint8_t yamc_mqtt_decode_remaining_len(yamc_instance_t* const p_in
 	p_mqtt_hdr_fixed->remaining_len.raw[p_mqtt_hdr_fixed->remaining_len.raw_len++] = data;
 
 	// return if field value is not complete
-	if ((data & 0x80) != 0) return false;
+	if ((data & 0x80) != 0)
+	{
+		// field is at most 4 bytes long, stop parsing before next byte overflows raw buffer
+		if (p_mqtt_hdr_fixed->remaining_len.raw_len == YAMC_MQTT_REM_LEN_MAX)
+		{
+			YAMC_LOG_ERROR("Malformed Remaining Length\n");
+			p_instance->parser_state = YAMC_PARSER_IDLE;
+			p_instance->handlers.disconnect(p_instance->handlers.p_handler_ctx);
+		}
+
+		return false;
+	}
 
 	// decode field value - algorithm taken from MQTT specification
 
@@ -83,10 +94,14 @@ static inline uint8_t yamc_mqtt_decode_remaining_len(yamc_instance_t* const p_in
 }
 
 /// Initialize yamc instance
-void yamc_init(yamc_instance_t* const p_instance, const yamc_handler_cfg_t* const p_handler_cfg)
+void yamc_init(yamc_instance_t* const p_instance, const yamc_handler_cfg_t* const p_handler_cfg, const yamc_buff_cfg_t* const p_buff_cfg)
 {
 	YAMC_ASSERT(p_instance != NULL);
 	YAMC_ASSERT(p_handler_cfg != NULL);
+	YAMC_ASSERT(p_buff_cfg != NULL);
+	YAMC_ASSERT(p_buff_cfg->p_rx_buff != NULL);
+	// streamed PUBLISH topic length field and var_data of fixed length packets always have to fit
+	YAMC_ASSERT(p_buff_cfg->rx_buff_len >= 4);
 
 	// null check of handlers
 	YAMC_ASSERT(p_handler_cfg->pkt_handler != NULL);
@@ -95,12 +110,123 @@ void yamc_init(yamc_instance_t* const p_instance, const yamc_handler_cfg_t* cons
 
 	// timeout handlers are optional and null checked at execution
 
+	// stream handlers are optional but have to be provided all together
+	YAMC_ASSERT((p_handler_cfg->stream_begin == NULL) == (p_handler_cfg->stream_chunk == NULL));
+	YAMC_ASSERT((p_handler_cfg->stream_begin == NULL) == (p_handler_cfg->stream_end == NULL));
+
 	memset(p_instance, 0, sizeof(yamc_instance_t));
 	memcpy(&p_instance->handlers, p_handler_cfg, sizeof(yamc_handler_cfg_t));
+
+	p_instance->rx_pkt.var_data.data	  = p_buff_cfg->p_rx_buff;
+	p_instance->rx_pkt.var_data.data_size = p_buff_cfg->rx_buff_len;
+
+	// transmit buffer is optional
+	YAMC_ASSERT(p_buff_cfg->p_tx_buff != NULL || p_buff_cfg->tx_buff_len == 0);
+
+	// scatter/gather write copies short packet fields to tx buffer
+	YAMC_ASSERT(p_handler_cfg->writev == NULL || p_buff_cfg->tx_buff_len >= YAMC_TX_IOV_REF_MIN_LEN);
+
+	p_instance->tx_buff.data	  = p_buff_cfg->p_tx_buff;
+	p_instance->tx_buff.data_size = p_buff_cfg->tx_buff_len;
+
+	// in-flight table is optional
+	YAMC_ASSERT(p_buff_cfg->p_inflight != NULL || p_buff_cfg->inflight_len == 0);
+
+	// publish completion is reported from in-flight table
+	YAMC_ASSERT(p_handler_cfg->pub_complete == NULL || p_buff_cfg->inflight_len > 0);
+
+	// persisted entries are addressed by in-flight table slot
+	YAMC_ASSERT((p_handler_cfg->inflight_save == NULL && p_handler_cfg->inflight_release == NULL) || p_buff_cfg->inflight_len > 0);
+
+	// entries are linked by 16 bit index
+	YAMC_ASSERT(p_buff_cfg->inflight_len < YAMC_INFLIGHT_NONE);
+
+	yamc_inflight_init(p_instance, p_buff_cfg->inflight_len ? p_buff_cfg->p_inflight : NULL, p_buff_cfg->inflight_len);
+
+	// packet id bitmap is optional, all ids start free
+	YAMC_ASSERT(p_buff_cfg->p_pkt_id_bitmap == NULL || p_buff_cfg->pkt_id_window > 0);
+
+	if (p_buff_cfg->p_pkt_id_bitmap != NULL)
+		memset(p_buff_cfg->p_pkt_id_bitmap, 0, YAMC_PKT_ID_BITMAP_WORDS(p_buff_cfg->pkt_id_window) * sizeof(uint32_t));
+
+	p_instance->pkt_ids.p_bitmap = p_buff_cfg->p_pkt_id_bitmap;
+	p_instance->pkt_ids.window	 = p_buff_cfg->pkt_id_window;
 }
 
-// parse incoming data buffer
-void yamc_parse_buff(yamc_instance_t* const p_instance, const uint8_t* const p_buff, uint32_t len)
+// ask user to provide receive buffer long enough for current packet, returns true on success
+static inline uint8_t yamc_rx_buff_grow(yamc_instance_t* const p_instance)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	if (p_instance->handlers.rx_buff_grow == NULL) return false;
+
+	const uint32_t required_len = p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val;
+	uint32_t	   new_len		= 0;
+
+	uint8_t* const p_new_buff = p_instance->handlers.rx_buff_grow(p_instance->handlers.p_handler_ctx, required_len, &new_len);
+	if (p_new_buff == NULL || new_len < required_len) return false;
+
+	YAMC_LOG_DEBUG("rx buffer grown to %u bytes\n", new_len);
+
+	p_instance->rx_pkt.var_data.data	  = p_new_buff;
+	p_instance->rx_pkt.var_data.data_size = new_len;
+
+	return true;
+}
+
+// run packet assembly state machine over incoming data
+typedef enum {
+	YAMC_PUBLISH_HDR_MORE_DATA,  ///< input buffer was consumed, header is not complete yet
+	YAMC_PUBLISH_HDR_COMPLETE,   ///< whole variable header is in rx_pkt
+	YAMC_PUBLISH_HDR_SKIP,		 ///< malformed header, packet has to be skipped
+	YAMC_PUBLISH_HDR_CLOSED		 ///< malformed packet closed connection, parser has to stop
+
+} yamc_publish_hdr_ret_t;
+
+/**
+ * \brief collect variable header of PUBLISH split across buffers into rx_pkt: topic length first, then rest of the topic
+ * and packet id
+ *
+ * Used when payload is not copied together with header, consumed bytes are added to buff_pos.
+ */
+static yamc_publish_hdr_ret_t yamc_publish_hdr_collect(yamc_instance_t* const p_instance, const uint8_t* const p_buff, uint32_t len,
+													   uint32_t* const p_buff_pos)
+{
+	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_buff_pos != NULL);
+
+	while (1)
+	{
+		const uint32_t hdr_len = p_instance->rx_pkt.var_data.stream_hdr_len ? p_instance->rx_pkt.var_data.stream_hdr_len : 2;
+
+		uint32_t bytes_to_copy = hdr_len - p_instance->rx_pkt.var_data.pos;
+		if (bytes_to_copy > len - *p_buff_pos) bytes_to_copy = len - *p_buff_pos;
+
+		memcpy(&p_instance->rx_pkt.var_data.data[p_instance->rx_pkt.var_data.pos], &p_buff[*p_buff_pos], bytes_to_copy);
+		p_instance->rx_pkt.var_data.pos += bytes_to_copy;
+		*p_buff_pos += bytes_to_copy;
+
+		// variable header field is not complete, wait for more data
+		if (p_instance->rx_pkt.var_data.pos < hdr_len) return YAMC_PUBLISH_HDR_MORE_DATA;
+
+		if (p_instance->rx_pkt.var_data.stream_hdr_len != 0) return YAMC_PUBLISH_HDR_COMPLETE;
+
+		// header would end right after topic length field
+		if (yamc_publish_topic_empty(p_instance, p_instance->rx_pkt.var_data.data)) return YAMC_PUBLISH_HDR_CLOSED;
+
+		// topic length is known, continue with rest of the topic and packet id
+		p_instance->rx_pkt.var_data.stream_hdr_len = yamc_publish_var_hdr_len(p_instance, p_instance->rx_pkt.var_data.data);
+
+		if (p_instance->rx_pkt.var_data.stream_hdr_len > p_instance->rx_pkt.var_data.data_size ||
+			p_instance->rx_pkt.var_data.stream_hdr_len > p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val)
+		{
+			YAMC_LOG_ERROR("PUBLISH header doesn't fit rx buffer or packet\n");
+			return YAMC_PUBLISH_HDR_SKIP;
+		}
+	}
+}
+
+static void yamc_parse_buff_internal(yamc_instance_t* const p_instance, const uint8_t* const p_buff, uint32_t len)
 {
 	YAMC_ASSERT(p_instance != NULL);
 	YAMC_ASSERT(p_buff != NULL);
@@ -121,8 +247,8 @@ void yamc_parse_buff(yamc_instance_t* const p_instance, const uint8_t* const p_b
 	uint32_t	   bytes_to_copy = 0;
 	const uint8_t* p_var_data_start;
 
-	// start or reset timeout measurement
-	timeout_pat(p_instance);
+	// var_data of completed packet passed to decoder, points to rx_pkt buffer or directly into p_buff
+	const uint8_t* p_pkt_var_data = NULL;
 
 	// packet assembly state machine
 	do  // while (reparse)
@@ -136,7 +262,10 @@ void yamc_parse_buff(yamc_instance_t* const p_instance, const uint8_t* const p_b
 			case YAMC_PARSER_IDLE:
 				YAMC_LOG_DEBUG("State: YAMC_PARSER_IDLE\n");
 
-				memset(&p_instance->rx_pkt, 0, sizeof(yamc_mqtt_pkt_t));
+				// reset header and write position only, var_data buffer contents are overwritten anyway
+				memset(&p_instance->rx_pkt.fixed_hdr, 0, sizeof(yamc_mqtt_hdr_fixed_t));
+				p_instance->rx_pkt.var_data.pos			   = 0;
+				p_instance->rx_pkt.var_data.stream_hdr_len = 0;
 
 				// store packet type
 				p_instance->rx_pkt.fixed_hdr.pkt_type.raw = p_buff[buff_pos];
@@ -167,7 +296,7 @@ void yamc_parse_buff(yamc_instance_t* const p_instance, const uint8_t* const p_b
 
 				// decode 'remaining length' field in fixed header
 				while ((decode_remaining_len_done = yamc_mqtt_decode_remaining_len(p_instance, p_buff[buff_pos++])) == false &&
-					   buff_pos < len)
+					   buff_pos < len && p_instance->parser_state == YAMC_PARSER_FIX_HDR)
 					;
 
 				//'remaining length' field is not yet fully decoded, wait for more data
@@ -181,12 +310,8 @@ void yamc_parse_buff(yamc_instance_t* const p_instance, const uint8_t* const p_b
 					return;
 				}
 
-				// go to YAMC_PARSER_VAR_DATA or YAMC_PARSER_SKIP_PKT based on if we can fit rest of the packet into
-				// rx_buffer
-				if (p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val < YAMC_RX_PKT_MAX_LEN)
-					p_instance->parser_state = YAMC_PARSER_VAR_DATA;
-				else
-					p_instance->parser_state = YAMC_PARSER_SKIP_PKT;
+				// go to YAMC_PARSER_VAR_DATA, packet too long for rx buffer is dealt with there once it's clear it has to be copied
+				p_instance->parser_state = YAMC_PARSER_VAR_DATA;
 
 				// if there's more data or packet doesn't contain var_data field immediately go to next state via reparse
 				// flag
@@ -207,6 +332,69 @@ void yamc_parse_buff(yamc_instance_t* const p_instance, const uint8_t* const p_b
 
 				// LOG_DEBUG("buff_pos: %d, bytes_to_copy:%d\n",buff_pos,bytes_to_copy);
 
+				// fast path: whole var_data is already present in p_buff, decode it in place without copying
+				if (p_instance->parser_state == YAMC_PARSER_VAR_DATA && p_instance->rx_pkt.var_data.pos == 0 &&
+					bytes_to_copy >= p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val)
+				{
+					YAMC_LOG_DEBUG("var_data complete in input buffer\n");
+
+					p_pkt_var_data					= p_var_data_start;
+					p_instance->rx_pkt.var_data.pos = p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val;
+					buff_pos += p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val;
+
+					// there's more data in p_buff, more than one packet is present
+					if (buff_pos < len) next_packet_present = true;
+
+					p_instance->parser_state = YAMC_PARSER_DONE;
+					reparse					 = true;
+
+					// empty topic can't be passed to topic filter
+					if (is_topic_filter_pkt(p_instance) && p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val >= 2 &&
+						yamc_publish_topic_empty(p_instance, p_var_data_start))
+						return;
+
+					// PUBLISH dropped by topic filter is not decoded, malformed header is left to decoder
+					if (is_topic_filter_pkt(p_instance) && p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val >= 2 &&
+						yamc_publish_var_hdr_len(p_instance, p_var_data_start) <= p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val &&
+						yamc_topic_filter_reject(p_instance, p_var_data_start))
+					{
+						p_instance->parser_state = YAMC_PARSER_IDLE;
+						reparse					 = next_packet_present;
+						next_packet_present		 = false;
+					}
+					break;
+				}
+
+				// packet has to be copied but doesn't fit rx buffer: grow it, otherwise stream PUBLISH payload to user handlers
+				// or skip the packet
+				if (p_instance->parser_state == YAMC_PARSER_VAR_DATA &&
+					p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val > p_instance->rx_pkt.var_data.data_size &&
+					!yamc_rx_buff_grow(p_instance))
+				{
+					p_instance->parser_state = is_streaming_enabled(p_instance) ? YAMC_PARSER_STREAM : YAMC_PARSER_SKIP_PKT;
+					reparse					 = true;
+					break;
+				}
+
+				// PUBLISH split across buffers: collect variable header first, topic filter decides if payload is copied
+				if (p_instance->parser_state == YAMC_PARSER_VAR_DATA && is_topic_filter_pkt(p_instance) &&
+					p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val >= 2 &&
+					(p_instance->rx_pkt.var_data.stream_hdr_len == 0 ||
+					 p_instance->rx_pkt.var_data.pos < p_instance->rx_pkt.var_data.stream_hdr_len))
+				{
+					const yamc_publish_hdr_ret_t hdr_ret = yamc_publish_hdr_collect(p_instance, p_buff, len, &buff_pos);
+
+					if (hdr_ret == YAMC_PUBLISH_HDR_MORE_DATA || hdr_ret == YAMC_PUBLISH_HDR_CLOSED) return;
+
+					if (hdr_ret == YAMC_PUBLISH_HDR_SKIP || yamc_topic_filter_reject(p_instance, p_instance->rx_pkt.var_data.data))
+						p_instance->parser_state = YAMC_PARSER_SKIP_PKT;
+
+					// continue with payload
+					if (buff_pos < len || p_instance->rx_pkt.var_data.pos == p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val)
+						reparse = true;
+					break;
+				}
+
 				// check if this packet is without var_data
 				if (p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val == 0)
 				{
@@ -266,6 +454,7 @@ void yamc_parse_buff(yamc_instance_t* const p_instance, const uint8_t* const p_b
 					if (p_instance->parser_state != YAMC_PARSER_SKIP_PKT)
 					{
 						// LOG_DEBUG("packet rx complete\n");
+						p_pkt_var_data			 = p_instance->rx_pkt.var_data.data;
 						p_instance->parser_state = YAMC_PARSER_DONE;
 						reparse					 = true;
 					}
@@ -277,22 +466,78 @@ void yamc_parse_buff(yamc_instance_t* const p_instance, const uint8_t* const p_b
 						{
 							next_packet_present = false;
 							reparse				= true;
-		
-							// rearm timeout timer
-							timeout_pat(p_instance);
 						}
 					}
 				}
 				break;
 
+			case YAMC_PARSER_STREAM:  ///< PUBLISH packet is too long for rx buffer, pass payload to stream handlers
+				YAMC_LOG_DEBUG("State: YAMC_PARSER_STREAM\n");
+
+				// collect variable header into rx_pkt before payload is streamed
+				if (p_instance->rx_pkt.var_data.stream_hdr_len == 0 ||
+					p_instance->rx_pkt.var_data.pos < p_instance->rx_pkt.var_data.stream_hdr_len)
+				{
+					const yamc_publish_hdr_ret_t hdr_ret = yamc_publish_hdr_collect(p_instance, p_buff, len, &buff_pos);
+
+					if (hdr_ret == YAMC_PUBLISH_HDR_MORE_DATA || hdr_ret == YAMC_PUBLISH_HDR_CLOSED) return;
+
+					if (hdr_ret == YAMC_PUBLISH_HDR_SKIP)
+					{
+						p_instance->parser_state = YAMC_PARSER_SKIP_PKT;
+					}
+					// drop packet rejected by topic filter
+					else if (is_topic_filter_pkt(p_instance) && yamc_topic_filter_reject(p_instance, p_instance->rx_pkt.var_data.data))
+					{
+						p_instance->parser_state = YAMC_PARSER_SKIP_PKT;
+					}
+					// or launch stream begin handler
+					else if (yamc_decode_stream_pkt(p_instance, false) != YAMC_RET_SUCCESS)
+					{
+						YAMC_LOG_ERROR("Can't decode streamed PUBLISH header\n");
+						p_instance->parser_state = YAMC_PARSER_SKIP_PKT;
+					}
+
+					// continue with payload
+					if (buff_pos < len || p_instance->rx_pkt.var_data.pos == p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val)
+						reparse = true;
+					break;
+				}
+
+				// payload is passed to user handler directly from p_buff
+				bytes_to_copy = p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val - p_instance->rx_pkt.var_data.pos;
+				if (bytes_to_copy > len - buff_pos) bytes_to_copy = len - buff_pos;
+
+				if (bytes_to_copy > 0)
+				{
+					p_instance->handlers.stream_chunk(p_instance, &p_buff[buff_pos], bytes_to_copy, p_instance->handlers.p_handler_ctx);
+					p_instance->rx_pkt.var_data.pos += bytes_to_copy;
+					buff_pos += bytes_to_copy;
+				}
+
+				// whole payload has been streamed
+				if (p_instance->rx_pkt.var_data.pos == p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val)
+				{
+					yamc_decode_stream_pkt(p_instance, true);
+
+					// go to idle state and wait for next packet
+					p_instance->parser_state = YAMC_PARSER_IDLE;
+
+					// if there's more data in p_buff reparse immediately
+					if (buff_pos < len) reparse = true;
+				}
+				break;
+
 			case YAMC_PARSER_DONE:  ///< Complete packet has been received
 				YAMC_LOG_DEBUG("State: YAMC_PARSER_DONE\n");
 
-				// stop timeout measurement
-				timeout_stop(p_instance);
+				// malformed PUBLISH closes connection, rest of the buffer is dropped
+				if (p_instance->rx_pkt.fixed_hdr.pkt_type.flags.type == YAMC_PKT_PUBLISH &&
+					p_instance->rx_pkt.fixed_hdr.remaining_len.decoded_val >= 2 && yamc_publish_topic_empty(p_instance, p_pkt_var_data))
+					return;
 
 				// pass execution to packet data decoders, this will launch 'new packet arrived' handler
-				yamc_decode_pkt(p_instance);
+				yamc_decode_pkt(p_instance, p_pkt_var_data);
 
 				// go to idle state and wait for next packet
 				p_instance->parser_state = YAMC_PARSER_IDLE;
@@ -302,9 +547,6 @@ void yamc_parse_buff(yamc_instance_t* const p_instance, const uint8_t* const p_b
 				{
 					next_packet_present = false;
 					reparse				= true;
-
-					// rearm timeout timer
-					timeout_pat(p_instance);
 				}
 
 				break;
@@ -313,3 +555,46 @@ void yamc_parse_buff(yamc_instance_t* const p_instance, const uint8_t* const p_b
 
 	} while (reparse);
 }
+
+// parse incoming data buffer
+void yamc_parse_buff(yamc_instance_t* const p_instance, const uint8_t* const p_buff, uint32_t len)
+{
+	YAMC_ASSERT(p_instance != NULL);
+	YAMC_ASSERT(p_buff != NULL);
+
+	// acks sent from packet handlers are collected as well
+	p_instance->ack_queue.in_parse = true;
+
+	yamc_parse_buff_internal(p_instance, p_buff, len);
+
+	p_instance->ack_queue.in_parse = false;
+
+	// incomplete packet times out unless more data arrive, timeout is updated once per buffer instead of per packet
+	if (p_instance->parser_state != YAMC_PARSER_IDLE)
+	{
+		p_instance->rx_data_ms = yamc_timestamp_ms(p_instance);
+		timeout_pat(p_instance);
+	}
+	else
+		timeout_stop(p_instance);
+
+	// acknowledge all packets from this buffer with single write
+	if (yamc_ack_queue_flush(p_instance) != YAMC_RET_SUCCESS)
+	{
+		YAMC_LOG_ERROR("Can't send acknowledgements\n");
+		p_instance->handlers.disconnect(p_instance->handlers.p_handler_ctx);
+	}
+}
+
+// time left before incomplete packet times out
+uint32_t yamc_rx_timeout_left(const yamc_instance_t* const p_instance, uint32_t now_ms, uint32_t timeout_ms)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	if (p_instance->parser_state == YAMC_PARSER_IDLE) return UINT32_MAX;
+
+	// timestamps are allowed to wrap around
+	const uint32_t elapsed_ms = now_ms - p_instance->rx_data_ms;
+
+	return (elapsed_ms >= timeout_ms) ? 0 : timeout_ms - elapsed_ms;
+}
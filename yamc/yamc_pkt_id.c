@@ -0,0 +1,166 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_pkt_id.c - Allocates packet identifiers for outgoing packets
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include "yamc.h"
+#include "yamc_log.h"
+#include "yamc_pkt_id.h"
+
+// portable count trailing zeros, used when port doesn't provide compiler builtin
+#ifndef YAMC_CTZ32
+static inline uint32_t yamc_ctz32(uint32_t val)
+{
+	YAMC_ASSERT(val != 0);
+
+	uint32_t cnt = 0;
+
+	if ((val & 0xFFFF) == 0) cnt += 16, val >>= 16;
+	if ((val & 0xFF) == 0) cnt += 8, val >>= 8;
+	if ((val & 0xF) == 0) cnt += 4, val >>= 4;
+	if ((val & 0x3) == 0) cnt += 2, val >>= 2;
+	if ((val & 0x1) == 0) cnt += 1;
+
+	return cnt;
+}
+#define YAMC_CTZ32(x) yamc_ctz32(x)
+#endif
+
+// bits of given bitmap word that map to valid packet ids
+static inline uint32_t yamc_pkt_id_word_mask(const yamc_instance_t* const p_instance, const uint16_t word_idx)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	const uint32_t valid_bits = p_instance->pkt_ids.window - (uint32_t)word_idx * 32;
+
+	return (valid_bits >= 32) ? UINT32_MAX : (1u << valid_bits) - 1;
+}
+
+// 2 bit code of acknowledgement finishing packet flow
+static inline uint32_t yamc_pkt_id_ack_code(const yamc_pkt_type_t ack_type)
+{
+	switch (ack_type)
+	{
+		case YAMC_PKT_PUBACK:
+			return 0;
+		case YAMC_PKT_PUBCOMP:
+			return 1;
+		case YAMC_PKT_SUBACK:
+			return 2;
+		case YAMC_PKT_UNSUBACK:
+			return 3;
+		default:
+			YAMC_ASSERT(false);
+			return 0;
+	}
+}
+
+// record acknowledgement type of id, low and high code bits follow in-use bitmap
+static inline void yamc_pkt_id_set_ack(yamc_instance_t* const p_instance, const uint32_t bit, const yamc_pkt_type_t ack_type)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	const uint32_t words_cnt = YAMC_PKT_ID_USE_WORDS(p_instance->pkt_ids.window);
+	uint32_t* const p_lo	 = &p_instance->pkt_ids.p_bitmap[words_cnt + bit / 32];
+	uint32_t* const p_hi	 = p_lo + words_cnt;
+	const uint32_t	code	 = yamc_pkt_id_ack_code(ack_type);
+	const uint32_t	mask	 = 1u << (bit % 32);
+
+	*p_lo = (code & 1) ? (*p_lo | mask) : (*p_lo & ~mask);
+	*p_hi = (code & 2) ? (*p_hi | mask) : (*p_hi & ~mask);
+}
+
+// get acknowledgement type code of id
+static inline uint32_t yamc_pkt_id_get_ack(const yamc_instance_t* const p_instance, const uint32_t bit)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	const uint32_t		  words_cnt = YAMC_PKT_ID_USE_WORDS(p_instance->pkt_ids.window);
+	const uint32_t* const p_lo	  = &p_instance->pkt_ids.p_bitmap[words_cnt + bit / 32];
+	const uint32_t* const p_hi	  = p_lo + words_cnt;
+
+	return ((*p_lo >> (bit % 32)) & 1) | (((*p_hi >> (bit % 32)) & 1) << 1);
+}
+
+// assign packet id to outgoing PUBLISH, SUBSCRIBE or UNSUBSCRIBE packet
+uint16_t yamc_pkt_id_alloc(yamc_instance_t* const p_instance, const yamc_pkt_type_t ack_type)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	// no bitmap: plain counter, zero is not a valid packet id
+	if (p_instance->pkt_ids.p_bitmap == NULL)
+	{
+		p_instance->last_packet_id++;
+		if (p_instance->last_packet_id == 0) p_instance->last_packet_id = 1;
+
+		return p_instance->last_packet_id;
+	}
+
+	uint32_t* const p_bitmap  = p_instance->pkt_ids.p_bitmap;
+	const uint16_t	words_cnt = YAMC_PKT_ID_USE_WORDS(p_instance->pkt_ids.window);
+
+	// search continues after last assigned id so freshly released IDs aren't reused immediately, bit 0 maps to id 1
+	uint32_t start_bit = (p_instance->last_packet_id < p_instance->pkt_ids.window) ? p_instance->last_packet_id : 0;
+	uint16_t word_idx  = start_bit / 32;
+
+	// ids below start bit in first word are checked last, after wrapping around
+	uint32_t skip_mask = UINT32_MAX << (start_bit % 32);
+
+	for (uint32_t i = 0; i <= words_cnt; i++)
+	{
+		const uint32_t free_bits = ~p_bitmap[word_idx] & yamc_pkt_id_word_mask(p_instance, word_idx) & skip_mask;
+
+		if (free_bits != 0)
+		{
+			const uint32_t bit = YAMC_CTZ32(free_bits);
+
+			p_bitmap[word_idx] |= 1u << bit;
+			yamc_pkt_id_set_ack(p_instance, word_idx * 32 + bit, ack_type);
+			p_instance->last_packet_id = word_idx * 32 + bit + 1;
+
+			return p_instance->last_packet_id;
+		}
+
+		skip_mask = UINT32_MAX;
+		word_idx  = (word_idx + 1u == words_cnt) ? 0 : word_idx + 1u;
+	}
+
+	// every id in the window waits for acknowledgement
+	return 0;
+}
+
+// return packet id to the pool
+void yamc_pkt_id_release(yamc_instance_t* const p_instance, const uint16_t packet_id, const yamc_pkt_type_t ack_type)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	if (p_instance->pkt_ids.p_bitmap == NULL || packet_id == 0 || packet_id > p_instance->pkt_ids.window) return;
+
+	const uint32_t bit = packet_id - 1u;
+
+	// id of different packet flow stays in use
+	if (yamc_pkt_id_get_ack(p_instance, bit) != yamc_pkt_id_ack_code(ack_type))
+	{
+		YAMC_LOG_DEBUG("%s doesn't finish flow of packet id: %u\n", yamc_mqtt_pkt_type_to_str(ack_type), packet_id);
+		return;
+	}
+
+	p_instance->pkt_ids.p_bitmap[bit / 32] &= ~(1u << (bit % 32));
+}
+
+// mark packet id restored from persistent storage as in use
+void yamc_pkt_id_reserve(yamc_instance_t* const p_instance, const uint16_t packet_id, const yamc_pkt_type_t ack_type)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	if (p_instance->pkt_ids.p_bitmap == NULL || packet_id == 0 || packet_id > p_instance->pkt_ids.window) return;
+
+	const uint32_t bit = packet_id - 1u;
+
+	p_instance->pkt_ids.p_bitmap[bit / 32] |= 1u << (bit % 32);
+	yamc_pkt_id_set_ack(p_instance, bit, ack_type);
+}
@@ -0,0 +1,41 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_pkt_id.h - Allocates packet identifiers for outgoing packets
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#ifndef __YAMC_PKT_ID_H__
+#define __YAMC_PKT_ID_H__
+
+#include "yamc.h"
+
+/**
+ * \brief assign packet id to outgoing PUBLISH, SUBSCRIBE or UNSUBSCRIBE packet
+ *
+ * With in-use bitmap configured IDs still waiting for acknowledgement are skipped.
+ *
+ * \param ack_type packet finishing the flow: PUBACK, PUBCOMP, SUBACK or UNSUBACK
+ * \return packet id, 0 if all IDs in the window are in use
+ */
+uint16_t yamc_pkt_id_alloc(yamc_instance_t* const p_instance, const yamc_pkt_type_t ack_type);
+
+/**
+ * \brief return packet id to the pool, does nothing if in-use bitmap is not configured
+ *
+ * Id is released only by acknowledgement type it was allocated for, i.e. stray PUBACK doesn't free id of SUBSCRIBE.
+ */
+void yamc_pkt_id_release(yamc_instance_t* const p_instance, const uint16_t packet_id, const yamc_pkt_type_t ack_type);
+
+/// mark packet id restored from persistent storage as in use, does nothing if in-use bitmap is not configured
+void yamc_pkt_id_reserve(yamc_instance_t* const p_instance, const uint16_t packet_id, const yamc_pkt_type_t ack_type);
+
+/// acknowledgement type finishing outgoing PUBLISH flow
+static inline yamc_pkt_type_t yamc_pkt_id_publish_ack(const yamc_qos_lvl_t qos)
+{
+	return (qos == YAMC_QOS_LVL1) ? YAMC_PKT_PUBACK : YAMC_PKT_PUBCOMP;
+}
+
+#endif /* __YAMC_PKT_ID_H__ */
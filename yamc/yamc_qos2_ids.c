@@ -0,0 +1,111 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_qos2_ids.c - Tracks packet ids of incoming QoS2 PUBLISH packets until PUBREL arrives
+ *
+ * Ids are kept in open addressing hash set with linear probing, 0 marks empty slot.
+ * Server assigns ids sequentially, so id itself is a good hash and consecutive ids occupy consecutive slots.
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include <string.h>
+#include "yamc.h"
+#include "yamc_log.h"
+#include "yamc_qos2_ids.h"
+
+#define YAMC_QOS2_IDS_MASK (YAMC_QOS2_RX_IDS_LEN - 1u)
+
+// set size has to be power of 2
+typedef char yamc_qos2_ids_len_check_t[(YAMC_QOS2_RX_IDS_LEN & YAMC_QOS2_IDS_MASK) == 0 ? 1 : -1];
+
+// slot where search for given id starts
+static inline uint16_t yamc_qos2_ids_home(const uint16_t packet_id)
+{
+	return packet_id & YAMC_QOS2_IDS_MASK;
+}
+
+// remember packet id of incoming QoS2 PUBLISH, returns false on redelivery
+bool yamc_qos2_ids_insert(yamc_instance_t* const p_instance, const uint16_t packet_id)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	if (packet_id == 0) return true;
+
+	uint16_t* const p_ids = p_instance->qos2_rx.ids;
+
+	uint16_t idx = yamc_qos2_ids_home(packet_id);
+
+	// there's always at least one empty slot, search ends there
+	while (p_ids[idx] != 0)
+	{
+		if (p_ids[idx] == packet_id) return false;
+
+		idx = (idx + 1u) & YAMC_QOS2_IDS_MASK;
+	}
+
+	// keep one slot empty, message is delivered but its redelivery won't be detected
+	if (p_instance->qos2_rx.cnt == YAMC_QOS2_RX_IDS_LEN - 1)
+	{
+		YAMC_LOG_ERROR("QoS2 id table full, can't track packet id: %u\n", packet_id);
+		return true;
+	}
+
+	p_ids[idx] = packet_id;
+	p_instance->qos2_rx.cnt++;
+
+	return true;
+}
+
+// forget packet id on PUBREL
+void yamc_qos2_ids_remove(yamc_instance_t* const p_instance, const uint16_t packet_id)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	if (packet_id == 0) return;
+
+	uint16_t* const p_ids = p_instance->qos2_rx.ids;
+
+	uint16_t idx = yamc_qos2_ids_home(packet_id);
+
+	while (p_ids[idx] != packet_id)
+	{
+		if (p_ids[idx] == 0) return;
+
+		idx = (idx + 1u) & YAMC_QOS2_IDS_MASK;
+	}
+
+	// backward shift deletion: move following entries of the probe sequence into the gap, no tombstones needed
+	uint16_t next = idx;
+
+	for (;;)
+	{
+		next = (next + 1u) & YAMC_QOS2_IDS_MASK;
+
+		if (p_ids[next] == 0) break;
+
+		const uint16_t home = yamc_qos2_ids_home(p_ids[next]);
+
+		// entry stays if its home slot lies cyclically in (idx, next]
+		const bool stays = (idx <= next) ? (home > idx && home <= next) : (home > idx || home <= next);
+
+		if (!stays)
+		{
+			p_ids[idx] = p_ids[next];
+			idx		   = next;
+		}
+	}
+
+	p_ids[idx] = 0;
+	p_instance->qos2_rx.cnt--;
+}
+
+// forget all packet ids when server starts new session
+void yamc_qos2_ids_clear(yamc_instance_t* const p_instance)
+{
+	YAMC_ASSERT(p_instance != NULL);
+
+	memset(p_instance->qos2_rx.ids, 0, sizeof(p_instance->qos2_rx.ids));
+	p_instance->qos2_rx.cnt = 0;
+}
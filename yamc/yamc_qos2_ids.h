@@ -0,0 +1,29 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_qos2_ids.h - Tracks packet ids of incoming QoS2 PUBLISH packets until PUBREL arrives
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#ifndef __YAMC_QOS2_IDS_H__
+#define __YAMC_QOS2_IDS_H__
+
+#include <stdbool.h>
+#include "yamc.h"
+
+/**
+ * \brief remember packet id of incoming QoS2 PUBLISH
+ *
+ * \return false if id is already stored i.e. PUBLISH is a redelivery that was passed to user before
+ */
+bool yamc_qos2_ids_insert(yamc_instance_t* const p_instance, const uint16_t packet_id);
+
+/// forget packet id on PUBREL, message can't be redelivered anymore
+void yamc_qos2_ids_remove(yamc_instance_t* const p_instance, const uint16_t packet_id);
+
+/// forget all packet ids when server starts new session, its packet ids start over
+void yamc_qos2_ids_clear(yamc_instance_t* const p_instance);
+
+#endif /* __YAMC_QOS2_IDS_H__ */
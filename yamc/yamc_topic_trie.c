@@ -0,0 +1,374 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_topic_trie.c - Routes incoming PUBLISH packets to handlers of matching topic filters
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#include <string.h>
+
+#include "yamc.h"
+#include "yamc_log.h"
+#include "yamc_topic_trie.h"
+
+#define YAMC_TOPIC_TRIE_ROOT 0
+
+// edge hash of parent node and level, FNV-1a mixed with parent index
+static inline uint32_t yamc_topic_trie_hash(uint32_t parent, const uint8_t* const p_level, uint16_t level_len)
+{
+	uint32_t hash = 2166136261u;
+
+	for (uint16_t i = 0; i < level_len; i++)
+	{
+		hash ^= p_level[i];
+		hash *= 16777619u;
+	}
+
+	return hash ^ (parent * 0x9E3779B1u);
+}
+
+static inline const uint8_t* yamc_topic_trie_level(const yamc_topic_node_t* const p_node)
+{
+	return &p_node->p_owner->filter.str[p_node->level_off];
+}
+
+// length of level starting at pos
+static inline uint16_t yamc_topic_trie_level_len(const yamc_mqtt_string* const p_str, uint16_t pos)
+{
+	uint16_t end = pos;
+	while (end < p_str->len && p_str->str[end] != '/') end++;
+
+	return end - pos;
+}
+
+// find exact level child, 0 if there is none
+static uint32_t yamc_topic_trie_child(const yamc_topic_trie_t* const p_trie, uint32_t parent, const uint8_t* const p_level,
+									  uint16_t level_len)
+{
+	const uint32_t hash = yamc_topic_trie_hash(parent, p_level, level_len);
+
+	for (uint32_t slot = hash & p_trie->edges_mask;; slot = (slot + 1) & p_trie->edges_mask)
+	{
+		const uint32_t idx = p_trie->p_edges[slot];
+		if (idx == 0) return 0;
+
+		const yamc_topic_node_t* const p_node = &p_trie->p_nodes[idx];
+
+		if (p_node->hash == hash && p_node->parent == parent && p_node->level_len == level_len &&
+			memcmp(yamc_topic_trie_level(p_node), p_level, level_len) == 0)
+			return idx;
+	}
+}
+
+// remove node from hash table, following entries of its probe sequence are shifted back
+static void yamc_topic_trie_edge_remove(yamc_topic_trie_t* const p_trie, uint32_t idx)
+{
+	const uint32_t mask = p_trie->edges_mask;
+
+	uint32_t hole = p_trie->p_nodes[idx].hash & mask;
+	while (p_trie->p_edges[hole] != idx) hole = (hole + 1) & mask;
+
+	for (uint32_t slot = (hole + 1) & mask; p_trie->p_edges[slot] != 0; slot = (slot + 1) & mask)
+	{
+		const uint32_t home = p_trie->p_nodes[p_trie->p_edges[slot]].hash & mask;
+
+		// entry can move to hole only if hole lies between its home slot and current slot
+		if (((slot - home) & mask) >= ((slot - hole) & mask))
+		{
+			p_trie->p_edges[hole] = p_trie->p_edges[slot];
+			hole				  = slot;
+		}
+	}
+
+	p_trie->p_edges[hole] = 0;
+}
+
+static uint32_t yamc_topic_trie_node_new(yamc_topic_trie_t* const p_trie, const yamc_topic_sub_t* const p_sub, uint32_t parent,
+										 uint16_t level_off, uint16_t level_len)
+{
+	const uint32_t idx = p_trie->free_node;
+	if (idx == 0) return 0;
+
+	yamc_topic_node_t* const p_node = &p_trie->p_nodes[idx];
+
+	p_trie->free_node = p_node->next_sibling;
+
+	memset(p_node, 0, sizeof(yamc_topic_node_t));
+
+	p_node->p_owner   = p_sub;
+	p_node->parent	= parent;
+	p_node->level_off = level_off;
+	p_node->level_len = level_len;
+
+	return idx;
+}
+
+// release nodes without subscriptions and children, from idx towards root
+static void yamc_topic_trie_prune(yamc_topic_trie_t* const p_trie, uint32_t idx)
+{
+	while (idx != YAMC_TOPIC_TRIE_ROOT)
+	{
+		yamc_topic_node_t* const p_node = &p_trie->p_nodes[idx];
+
+		if (p_node->p_subs != NULL || p_node->first_child != 0 || p_node->plus_child != 0 || p_node->hash_child != 0) return;
+
+		const uint32_t			 parent   = p_node->parent;
+		yamc_topic_node_t* const p_parent = &p_trie->p_nodes[parent];
+
+		if (p_parent->plus_child == idx)
+		{
+			p_parent->plus_child = 0;
+		}
+		else if (p_parent->hash_child == idx)
+		{
+			p_parent->hash_child = 0;
+		}
+		else
+		{
+			yamc_topic_trie_edge_remove(p_trie, idx);
+
+			uint32_t* p_link = &p_parent->first_child;
+			while (*p_link != idx) p_link = &p_trie->p_nodes[*p_link].next_sibling;
+
+			*p_link = p_node->next_sibling;
+		}
+
+		p_node->p_owner		 = NULL;
+		p_node->next_sibling = p_trie->free_node;
+		p_trie->free_node	= idx;
+
+		idx = parent;
+	}
+}
+
+void yamc_topic_trie_init(yamc_topic_trie_t* const p_trie, yamc_topic_node_t* const p_nodes, uint32_t nodes_len,
+						  uint32_t* const p_edges, uint32_t edges_len)
+{
+	YAMC_ASSERT(p_trie != NULL);
+	YAMC_ASSERT(p_nodes != NULL);
+	YAMC_ASSERT(nodes_len > 0);
+	YAMC_ASSERT(p_edges != NULL);
+	YAMC_ASSERT(edges_len > nodes_len);
+	YAMC_ASSERT((edges_len & (edges_len - 1)) == 0);
+
+	memset(p_trie, 0, sizeof(yamc_topic_trie_t));
+	memset(p_nodes, 0, nodes_len * sizeof(yamc_topic_node_t));
+	memset(p_edges, 0, edges_len * sizeof(uint32_t));
+
+	p_trie->p_nodes	= p_nodes;
+	p_trie->nodes_len  = nodes_len;
+	p_trie->p_edges	= p_edges;
+	p_trie->edges_mask = edges_len - 1;
+
+	// chain unused nodes, root is never released
+	for (uint32_t i = 1; i < nodes_len; i++) p_nodes[i].next_sibling = (i + 1 < nodes_len) ? i + 1 : 0;
+
+	p_trie->free_node = (nodes_len > 1) ? 1 : 0;
+}
+
+// + and # have to take whole level, # has to be the last one
+static bool yamc_topic_trie_filter_valid(const yamc_mqtt_string* const p_filter)
+{
+	if (p_filter->len == 0 || p_filter->str == NULL) return false;
+
+	for (uint16_t pos = 0;; pos++)
+	{
+		const uint16_t level_len = yamc_topic_trie_level_len(p_filter, pos);
+		const uint8_t* p_level   = &p_filter->str[pos];
+
+		for (uint16_t i = 0; i < level_len; i++)
+			if ((p_level[i] == '+' || p_level[i] == '#') && level_len != 1) return false;
+
+		pos += level_len;
+
+		if (level_len == 1 && p_level[0] == '#' && pos != p_filter->len) return false;
+		if (pos == p_filter->len) return true;
+	}
+}
+
+yamc_retcode_t yamc_topic_trie_add(yamc_topic_trie_t* const p_trie, yamc_topic_sub_t* const p_sub)
+{
+	YAMC_ASSERT(p_trie != NULL);
+	YAMC_ASSERT(p_sub != NULL);
+	YAMC_ASSERT(p_sub->handler != NULL);
+
+	if (!yamc_topic_trie_filter_valid(&p_sub->filter)) return YAMC_RET_INVALID_DATA;
+
+	uint32_t idx = YAMC_TOPIC_TRIE_ROOT;
+
+	for (uint16_t pos = 0;; pos++)
+	{
+		const uint16_t		 level_len = yamc_topic_trie_level_len(&p_sub->filter, pos);
+		const uint8_t* const p_level   = &p_sub->filter.str[pos];
+
+		yamc_topic_node_t* p_node = &p_trie->p_nodes[idx];
+
+		uint32_t* p_wildcard = NULL;
+		if (level_len == 1 && p_level[0] == '+') p_wildcard = &p_node->plus_child;
+		if (level_len == 1 && p_level[0] == '#') p_wildcard = &p_node->hash_child;
+
+		uint32_t child = (p_wildcard != NULL) ? *p_wildcard : yamc_topic_trie_child(p_trie, idx, p_level, level_len);
+
+		if (child == 0)
+		{
+			child = yamc_topic_trie_node_new(p_trie, p_sub, idx, pos, level_len);
+			if (child == 0)
+			{
+				YAMC_LOG_ERROR("Topic trie node pool exhausted\n");
+
+				// drop nodes created for this filter
+				yamc_topic_trie_prune(p_trie, idx);
+				return YAMC_RET_INVALID_STATE;
+			}
+
+			yamc_topic_node_t* const p_child = &p_trie->p_nodes[child];
+
+			if (p_wildcard != NULL)
+			{
+				*p_wildcard = child;
+			}
+			else
+			{
+				p_child->hash		 = yamc_topic_trie_hash(idx, p_level, level_len);
+				p_child->next_sibling = p_node->first_child;
+				p_node->first_child   = child;
+
+				uint32_t slot = p_child->hash & p_trie->edges_mask;
+				while (p_trie->p_edges[slot] != 0) slot = (slot + 1) & p_trie->edges_mask;
+
+				p_trie->p_edges[slot] = child;
+			}
+		}
+
+		idx = child;
+		pos += level_len;
+
+		if (pos == p_sub->filter.len) break;
+	}
+
+	yamc_topic_node_t* const p_node = &p_trie->p_nodes[idx];
+
+	p_sub->node	= idx;
+	p_sub->p_next  = p_node->p_subs;
+	p_node->p_subs = p_sub;
+
+	return YAMC_RET_SUCCESS;
+}
+
+void yamc_topic_trie_remove(yamc_topic_trie_t* const p_trie, yamc_topic_sub_t* const p_sub)
+{
+	YAMC_ASSERT(p_trie != NULL);
+	YAMC_ASSERT(p_sub != NULL);
+
+	uint32_t idx = p_sub->node;
+
+	yamc_topic_sub_t** pp_link = &p_trie->p_nodes[idx].p_subs;
+	while (*pp_link != NULL && *pp_link != p_sub) pp_link = &(*pp_link)->p_next;
+
+	// not registered
+	if (*pp_link == NULL) return;
+
+	*pp_link = p_sub->p_next;
+
+	yamc_topic_trie_prune(p_trie, idx);
+
+	// deepest node of the filter still in use
+	while (idx != YAMC_TOPIC_TRIE_ROOT && p_trie->p_nodes[idx].p_owner == NULL) idx = p_trie->p_nodes[idx].parent;
+
+	if (idx == YAMC_TOPIC_TRIE_ROOT) return;
+
+	// any filter below that node shares level strings of all nodes above, nodes without children have subscriptions
+	const yamc_topic_node_t* p_node = &p_trie->p_nodes[idx];
+	while (p_node->p_subs == NULL)
+	{
+		const uint32_t child = (p_node->first_child != 0) ? p_node->first_child
+														  : (p_node->plus_child != 0) ? p_node->plus_child : p_node->hash_child;
+		p_node = &p_trie->p_nodes[child];
+	}
+
+	const yamc_topic_sub_t* const p_new_owner = p_node->p_subs;
+
+	for (; idx != YAMC_TOPIC_TRIE_ROOT; idx = p_trie->p_nodes[idx].parent)
+		if (p_trie->p_nodes[idx].p_owner == p_sub) p_trie->p_nodes[idx].p_owner = p_new_owner;
+}
+
+// call handlers of subscriptions ending at node, only count them if packet is NULL
+static uint32_t yamc_topic_trie_fire(const yamc_topic_node_t* const p_node, yamc_instance_t* const p_instance,
+									 const yamc_mqtt_pkt_data_t* const p_pkt_data)
+{
+	uint32_t cnt = 0;
+
+	for (const yamc_topic_sub_t* p_sub = p_node->p_subs; p_sub != NULL; p_sub = p_sub->p_next)
+	{
+		if (p_pkt_data != NULL) p_sub->handler(p_instance, p_pkt_data, p_sub->p_ctx);
+		cnt++;
+	}
+
+	return cnt;
+}
+
+/*
+ * match topic level starting at pos against children of node, recursion depth is number of topic levels
+ * done: all levels were matched already
+ * without packet returns after first match
+ */
+static uint32_t yamc_topic_trie_walk(const yamc_topic_trie_t* const p_trie, uint32_t idx, const yamc_mqtt_string* const p_topic,
+									 uint16_t pos, bool done, yamc_instance_t* const p_instance,
+									 const yamc_mqtt_pkt_data_t* const p_pkt_data)
+{
+	const yamc_topic_node_t* const p_node = &p_trie->p_nodes[idx];
+
+	uint32_t cnt = 0;
+
+	// # matches parent level too
+	if (done)
+	{
+		cnt = yamc_topic_trie_fire(p_node, p_instance, p_pkt_data);
+		if (p_node->hash_child != 0) cnt += yamc_topic_trie_fire(&p_trie->p_nodes[p_node->hash_child], p_instance, p_pkt_data);
+
+		return cnt;
+	}
+
+	const uint16_t		 level_len = yamc_topic_trie_level_len(p_topic, pos);
+	const uint8_t* const p_level   = &p_topic->str[pos];
+	const uint16_t		 next	  = pos + level_len + 1;
+	const bool			 last	  = (pos + level_len == p_topic->len);
+
+	// wildcards at first level don't match topics starting with $
+	if (idx != YAMC_TOPIC_TRIE_ROOT || p_topic->len == 0 || p_topic->str[0] != '$')
+	{
+		if (p_node->hash_child != 0) cnt += yamc_topic_trie_fire(&p_trie->p_nodes[p_node->hash_child], p_instance, p_pkt_data);
+		if (cnt > 0 && p_pkt_data == NULL) return cnt;
+
+		if (p_node->plus_child != 0)
+			cnt += yamc_topic_trie_walk(p_trie, p_node->plus_child, p_topic, next, last, p_instance, p_pkt_data);
+		if (cnt > 0 && p_pkt_data == NULL) return cnt;
+	}
+
+	const uint32_t child = yamc_topic_trie_child(p_trie, idx, p_level, level_len);
+	if (child != 0) cnt += yamc_topic_trie_walk(p_trie, child, p_topic, next, last, p_instance, p_pkt_data);
+
+	return cnt;
+}
+
+uint32_t yamc_topic_trie_dispatch(const yamc_topic_trie_t* const p_trie, yamc_instance_t* const p_instance,
+								  const yamc_mqtt_pkt_data_t* const p_pkt_data)
+{
+	YAMC_ASSERT(p_trie != NULL);
+	YAMC_ASSERT(p_pkt_data != NULL);
+
+	if (p_pkt_data->pkt_type != YAMC_PKT_PUBLISH) return 0;
+
+	return yamc_topic_trie_walk(p_trie, YAMC_TOPIC_TRIE_ROOT, &p_pkt_data->pkt_data.publish.topic_name, 0, false, p_instance,
+								p_pkt_data);
+}
+
+bool yamc_topic_trie_match(const yamc_topic_trie_t* const p_trie, const yamc_mqtt_string* const p_topic)
+{
+	YAMC_ASSERT(p_trie != NULL);
+	YAMC_ASSERT(p_topic != NULL);
+
+	return yamc_topic_trie_walk(p_trie, YAMC_TOPIC_TRIE_ROOT, p_topic, 0, false, NULL, NULL) > 0;
+}
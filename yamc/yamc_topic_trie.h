@@ -0,0 +1,97 @@
+/*
+ * YAMC - Yet Another MQTT Client library
+ *
+ * yamc_topic_trie.h - Routes incoming PUBLISH packets to handlers of matching topic filters
+ *
+ * Filters are split to levels and stored in trie. Exact level children of all nodes share one open addressing
+ * hash table keyed by parent node and level, + and # children are linked from their parent directly.
+ * Matching topic costs one hash lookup per topic level and active + branch, regardless of number of filters.
+ * Nodes and hash table are provided by user, trie doesn't allocate memory. Trie is not thread safe.
+ *
+ * Licensed under MIT License (see LICENSE file in main repo directory)
+ *
+ */
+
+#ifndef __YAMC_TOPIC_TRIE_H__
+#define __YAMC_TOPIC_TRIE_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "yamc.h"
+
+/// Subscription, owned by user and has to stay valid until removed from trie
+typedef struct yamc_topic_sub_s
+{
+	yamc_mqtt_string   filter;   ///< topic filter, may contain + and # wildcards
+	yamc_pkt_handler_t handler;  ///< called for each matching PUBLISH packet
+	void*			   p_ctx;	///< passed to handler
+
+	struct yamc_topic_sub_s* p_next;  ///< internal: next subscription of the same filter
+	uint32_t				 node;	///< internal: trie node filter ends at
+
+} yamc_topic_sub_t;
+
+/// Trie node, one per distinct filter prefix
+typedef struct
+{
+	const yamc_topic_sub_t* p_owner;  // subscription whose filter holds level string of this node
+	yamc_topic_sub_t*		p_subs;   // subscriptions with filter ending here
+
+	uint32_t parent;
+	uint32_t first_child;   // exact level children list
+	uint32_t next_sibling;  // next child of parent, next free node when unused
+	uint32_t plus_child;	// + child, 0 if none
+	uint32_t hash_child;	// # child, 0 if none
+	uint32_t hash;			// edge hash of parent and level
+
+	uint16_t level_off;  // level position in owner's filter
+	uint16_t level_len;  // level length
+
+} yamc_topic_node_t;
+
+typedef struct
+{
+	yamc_topic_node_t* p_nodes;	// node pool, owned by user, node 0 is root
+	uint32_t		   nodes_len;  // node pool length
+	uint32_t		   free_node;  // first unused node, 0 if pool is exhausted
+
+	uint32_t* p_edges;	// hash table of exact level children, owned by user, 0: empty slot
+	uint32_t  edges_mask;  // hash table length - 1
+
+} yamc_topic_trie_t;
+
+/**
+ * \brief initialize empty trie
+ *
+ * Every filter level takes one node unless its prefix is shared with another filter.
+ *
+ * \param p_nodes node pool, has to stay valid as long as trie is used
+ * \param p_edges hash table for exact level children, power of 2 long and longer than node pool, 2x pool length recommended
+ */
+void yamc_topic_trie_init(yamc_topic_trie_t* const p_trie, yamc_topic_node_t* const p_nodes, uint32_t nodes_len,
+						  uint32_t* const p_edges, uint32_t edges_len);
+
+/**
+ * \brief register subscription, same filter can be registered by more subscriptions
+ *
+ * \return YAMC_RET_SUCCESS, YAMC_RET_INVALID_DATA if filter is malformed or YAMC_RET_INVALID_STATE if node pool is exhausted
+ */
+yamc_retcode_t yamc_topic_trie_add(yamc_topic_trie_t* const p_trie, yamc_topic_sub_t* const p_sub);
+
+/// unregister subscription added by yamc_topic_trie_add(), nodes no other filter uses are released
+void yamc_topic_trie_remove(yamc_topic_trie_t* const p_trie, yamc_topic_sub_t* const p_sub);
+
+/**
+ * \brief call handlers of all subscriptions matching PUBLISH topic, call from packet handler
+ *
+ * Handlers must not add or remove subscriptions. Other packet types are ignored.
+ *
+ * \return number of handlers called
+ */
+uint32_t yamc_topic_trie_dispatch(const yamc_topic_trie_t* const p_trie, yamc_instance_t* const p_instance,
+								  const yamc_mqtt_pkt_data_t* const p_pkt_data);
+
+/// returns true if at least one subscription matches topic
+bool yamc_topic_trie_match(const yamc_topic_trie_t* const p_trie, const yamc_mqtt_string* const p_topic);
+
+#endif /* __YAMC_TOPIC_TRIE_H__ */